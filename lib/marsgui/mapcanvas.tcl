@@ -207,6 +207,28 @@ snit::widgetadaptor ::marsgui::mapcanvas {
         names ""
     }
 
+    #-------------------------------------------------------------------
+    # Typemethods: Zoom Pyramid
+
+    # PyramidReady win key tmpfile index
+    #
+    # win       A mapcanvas
+    # key       The map key the pyramid was built for
+    # tmpfile   The file the pyramid was written to
+    # index     The {offset length} of each level in the file
+    #
+    # Called by [raster pyramid] when a pyramid has been built.  The
+    # mapcanvas might have been destroyed meanwhile, so this passes
+    # the pyramid along only if it still exists.
+
+    typemethod PyramidReady {win key tmpfile index} {
+        if {[winfo exists $win]} {
+            $win PyramidDone $key $tmpfile $index
+        } else {
+            file delete -force $tmpfile
+        }
+    }
+
     #-------------------------------------------------------------------
     # Typemethods: Icon Management
 
@@ -272,6 +294,9 @@ snit::widgetadaptor ::marsgui::mapcanvas {
         # NEXT, set the zoom to 100%
         set zooms(100) $options(-map)
 
+        # NEXT, get the other zoom levels started.
+        $self BuildPyramid
+
         if {$info(zoom) != 100} {
             $self ScaleMap $info(zoom)
         }
@@ -287,6 +312,57 @@ snit::widgetadaptor ::marsgui::mapcanvas {
 
     option -projection
 
+    # -cachedir
+    #
+    # Directory in which to cache the zoom pyramid for each -map, or
+    # "" for no caching.
+
+    option -cachedir -default ""
+
+    # -tilemap
+    #
+    # A geotiff(n) handle for the map, which must be 8-bit RGB.  If
+    # given, the map is drawn from it a tile at a time, and -map is
+    # ignored.
+
+    option -tilemap                  \
+        -default         ""          \
+        -configuremethod ConfigTilemap
+
+    method ConfigTilemap {opt val} {
+        if {$val ne ""} {
+            set tinfo [geotiff info $val]
+
+            if {[dict get $tinfo samples] != 3 || 
+                [dict get $tinfo bits] != 8
+            } {
+                error "tilemap must be 8-bit RGB: \"$val\""
+            }
+
+            set tiles(levels) [dict get $tinfo levels]
+        }
+
+        $self ClearTiles
+        set options(-tilemap) $val
+    }
+
+    # -tilecache
+    #
+    # The number of decoded tiles to keep for reuse.  Tiles in view 
+    # are always kept.
+
+    option -tilecache \
+        -type    {snit::integer -min 0} \
+        -default 64
+
+    # -xscrollcommand, -yscrollcommand
+    #
+    # As for the canvas; mapcanvas also uses them to learn when the 
+    # view changes, so as to draw the tiles that come into view.
+
+    option -xscrollcommand -default ""
+    option -yscrollcommand -default ""
+
     # -locvariable
     #
     # A variable name.  It is set to the map location string of the
@@ -352,6 +428,32 @@ snit::widgetadaptor ::marsgui::mapcanvas {
         100 {}
     }
 
+    # pyramid array: the zoom pyramid for the -map.  See BuildPyramid.
+    #
+    # key          Key identifying the -map's pixels
+    # file         The pyramid file, once it's ready
+    # $factor      {offset length} of the PPM for the zoom factor
+    #              in the file.
+
+    variable pyramid -array { }
+
+    # tiles array: tiled rendering of the -tilemap.  See ShowTiles.
+    #
+    # levels       List of {width height} of the -tilemap's levels
+    # geom-$zoom   Tile geometry at zoom factor $zoom; see TileGeometry
+    # cache        Dict of decoded tile images by tile key, least
+    #              recently used first.
+    # shown        Dict of canvas item IDs by tile key, for the tiles
+    #              in view.
+    # pending      The "after" ID if ShowTiles is scheduled, or "".
+
+    variable tiles -array {
+        levels  {}
+        cache   {}
+        shown   {}
+        pending {}
+    }
+
     # icons array
     #
     # ids               List of icon ids
@@ -401,6 +503,11 @@ snit::widgetadaptor ::marsgui::mapcanvas {
         # NEXT, create the namespace for icon commands
         namespace eval ${selfns}::icons {}
 
+        # NEXT, watch the view, for -tilemap.
+        $hull configure \
+            -xscrollcommand [mymethod ViewChanged -xscrollcommand] \
+            -yscrollcommand [mymethod ViewChanged -yscrollcommand]
+
         # NEXT, save the options
         $self configurelist $args
 
@@ -409,6 +516,18 @@ snit::widgetadaptor ::marsgui::mapcanvas {
         $self refresh
     }
 
+    #-------------------------------------------------------------------
+    # Destructor
+
+    destructor {
+        # Free the tile images.
+        after cancel $tiles(pending)
+
+        foreach img [dict values $tiles(cache)] {
+            image delete $img
+        }
+    }
+
     #-------------------------------------------------------------------
     # Public Methods
 
@@ -460,7 +579,8 @@ snit::widgetadaptor ::marsgui::mapcanvas {
         }
 
         # NEXT, scale the image, if needed.
-        if {$options(-map) ne "" &&
+        if {$options(-map) ne ""     &&
+            $options(-tilemap) eq "" &&
             ![info exists zooms($factor)]
         } {
             $self ScaleMap $factor
@@ -502,9 +622,17 @@ snit::widgetadaptor ::marsgui::mapcanvas {
     method refresh {} {
         # FIRST, delete all drawn items.
         $hull delete all
+        set tiles(shown) [dict create]
 
         # NEXT, if there's no map, handle it.
-        if {$options(-map) eq ""} {
+        if {$options(-tilemap) ne ""} {
+            # NEXT, get the projection, and set the scroll region; 
+            # the tiles will be drawn when the view is known.
+            $self GetProjection
+            $self GetScrollRegions
+            $self region $info(region)
+            $self ScheduleTiles
+        } elseif {$options(-map) eq ""} {
             $self mode browse
 
             $self GetProjection
@@ -571,7 +699,11 @@ snit::widgetadaptor ::marsgui::mapcanvas {
             # NEXT, if we have a map use the map dimensions; otherwise
             # use 1000x1000
 
-            if {$options(-map) ne ""} {
+            if {$options(-tilemap) ne ""} {
+                $proj configure                             \
+                    -width  [lindex $tiles(levels) 0 0]     \
+                    -height [lindex $tiles(levels) 0 1]
+            } elseif {$options(-map) ne ""} {
                 $proj configure                           \
                     -width  [image width  $options(-map)] \
                     -height [image height $options(-map)]
@@ -594,7 +726,12 @@ snit::widgetadaptor ::marsgui::mapcanvas {
         set winw [winfo width $self]
         set winh [winfo height $self]
 
-        if {[llength $bbox] != 0} {
+        if {$options(-tilemap) ne ""} {
+            # Only the tiles in view are drawn, so use the map's size.
+            lassign [$self TileGeometry] level S T u d width height
+            set x2 [expr {$width*$u/$d}]
+            set y2 [expr {$height*$u/$d}]
+        } elseif {[llength $bbox] != 0} {
             # x1,y1 = 0,0
             lassign $bbox x1 y1 x2 y2
         } else {
@@ -1764,6 +1901,236 @@ snit::widgetadaptor ::marsgui::mapcanvas {
         $hull lower $id marker
     }
 
+    #-------------------------------------------------------------------
+    # Tiled Rendering
+    #
+    # When there's a -tilemap, only the tiles in view are drawn, each
+    # as its own canvas image, decoded from the -tilemap at the level
+    # nearest the zoom and scaled as needed.  Decoded tiles are kept
+    # in a least-recently-used cache of -tilecache tiles, so memory
+    # doesn't grow with the map's size or zoom.
+
+    # ViewChanged option args
+    #
+    # option    -xscrollcommand or -yscrollcommand
+    # args      The view fractions
+    #
+    # Called by the canvas when its view changes.  Passes the call
+    # along to the option's command, if any, and schedules the
+    # tiles to be drawn.
+
+    method ViewChanged {option args} {
+        if {$options($option) ne ""} {
+            uplevel \#0 $options($option) $args
+        }
+
+        $self ScheduleTiles
+    }
+
+    # ScheduleTiles
+    #
+    # Schedules ShowTiles to run when the GUI is idle, if it isn't
+    # already.
+
+    method ScheduleTiles {} {
+        if {$options(-tilemap) ne "" && $tiles(pending) eq ""} {
+            set tiles(pending) [after idle [mymethod ShowTiles]]
+        }
+    }
+
+    # ShowTiles
+    #
+    # Draws the tiles in view, and deletes those out of view.
+
+    method ShowTiles {} {
+        set tiles(pending) ""
+
+        if {$options(-tilemap) eq ""} {
+            return
+        }
+
+        # FIRST, get the visible canvas area, and the tiles in it.
+        lassign [$self TileGeometry] level S T u d width height
+
+        set cx1 [$hull canvasx 0]
+        set cy1 [$hull canvasy 0]
+        set cx2 [$hull canvasx [winfo width $win]]
+        set cy2 [$hull canvasy [winfo height $win]]
+
+        set ncols [expr {($width  + $S - 1)/$S}]
+        set nrows [expr {($height + $S - 1)/$S}]
+
+        set c1 [expr {max(0, int(floor($cx1/$T)))}]
+        set r1 [expr {max(0, int(floor($cy1/$T)))}]
+        set c2 [expr {min($ncols - 1, int(floor($cx2/$T)))}]
+        set r2 [expr {min($nrows - 1, int(floor($cy2/$T)))}]
+
+        # NEXT, draw each visible tile that isn't already shown.
+        set shown [dict create]
+
+        for {set r $r1} {$r <= $r2} {incr r} {
+            for {set c $c1} {$c <= $c2} {incr c} {
+                set key "$info(zoom),$c,$r"
+                set img [$self GetTile $key $c $r]
+
+                if {[dict exists $tiles(shown) $key]} {
+                    dict set shown $key [dict get $tiles(shown) $key]
+                    dict unset tiles(shown) $key
+                } else {
+                    set id [$hull create image \
+                                [expr {$c*$T}] [expr {$r*$T}] \
+                                -anchor nw                   \
+                                -image  $img                 \
+                                -tags   [list map tile]]
+                    $hull lower $id
+                    dict set shown $key $id
+                }
+            }
+        }
+
+        # NEXT, delete the tiles that are no longer in view.
+        foreach id [dict values $tiles(shown)] {
+            $hull delete $id
+        }
+
+        set tiles(shown) $shown
+
+        # NEXT, evict the least recently used tiles, keeping those
+        # in view.
+        set limit [expr {max($options(-tilecache), [dict size $shown])}]
+
+        while {[dict size $tiles(cache)] > $limit} {
+            set key [lindex [dict keys $tiles(cache)] 0]
+            image delete [dict get $tiles(cache) $key]
+            dict unset tiles(cache) $key
+        }
+    }
+
+    # GetTile key c r
+    #
+    # key       The tile's key, "zoom,c,r"
+    # c, r      The tile's column and row
+    #
+    # Returns the image for the tile at the current zoom, decoding it
+    # if it isn't cached, and marks it most recently used.
+
+    method GetTile {key c r} {
+        # FIRST, if it's cached, move it to the end.
+        if {[dict exists $tiles(cache) $key]} {
+            set img [dict get $tiles(cache) $key]
+            dict unset tiles(cache) $key
+            dict set tiles(cache) $key $img
+            return $img
+        }
+
+        # NEXT, find the tile's part of the level.
+        lassign [$self TileGeometry] level S T u d width height
+
+        set x [expr {$c*$S}]
+        set y [expr {$r*$S}]
+        set w [expr {min($S, $width  - $x)}]
+        set h [expr {min($S, $height - $y)}]
+
+        # NEXT, decode it straight into a photo, unless it needs
+        # scaling.
+        if {$u == $d} {
+            set img [image create photo]
+            geotiff tophoto $options(-tilemap) $img $x $y $w $h \
+                -level $level
+        } else {
+            set ppm "P6\n$w $h\n255\n"
+            append ppm \
+                [geotiff region $options(-tilemap) $x $y $w $h -level $level]
+
+            set img [image create photo -format ppm \
+                         -data [raster scale $ppm $u $d]]
+        }
+
+        dict set tiles(cache) $key $img
+
+        return $img
+    }
+
+    # TileGeometry
+    #
+    # Returns the tile geometry for the current zoom, a list
+    # {level S T u d width height}:
+    #
+    # level          The -tilemap level to decode
+    # S              A tile's size in pixels of that level
+    # T              A tile's size in canvas pixels
+    # u, d           The level is scaled by u/d to the zoom
+    # width, height  The level's size
+    #
+    # The level is the smallest overview that's no smaller than the
+    # zoomed map, considering only overviews reduced by a power of 2.
+    # S is chosen so that T is a whole number near 256.
+
+    method TileGeometry {} {
+        if {[info exists tiles(geom-$info(zoom))]} {
+            return $tiles(geom-$info(zoom))
+        }
+
+        # FIRST, find the level.
+        lassign [dict get $zoomfactors $info(zoom)] up down
+        lassign [lindex $tiles(levels) 0] width0
+
+        set level 0
+        set scale 1
+
+        for {set i 1} {$i < [llength $tiles(levels)]} {incr i} {
+            lassign [lindex $tiles(levels) $i] width height
+            set s [expr {round(double($width0)/$width)}]
+
+            if {($s & ($s - 1)) == 0           &&
+                abs($width0/$s - $width) <= 1  &&
+                $s > $scale && $up*$s <= $down
+            } {
+                set level $i
+                set scale $s
+            }
+        }
+
+        # NEXT, reduce the scale factor u/d.
+        set u [expr {$up*$scale}]
+        set d $down
+        set a $u
+        set b $d
+
+        while {$b != 0} {
+            lassign [list $b [expr {$a % $b}]] a b
+        }
+
+        set u [expr {$u/$a}]
+        set d [expr {$d/$a}]
+
+        # NEXT, choose S as a multiple of d, so that T = S*u/d is whole.
+        set S [expr {max(1, round(256.0/$u))*$d}]
+        set T [expr {$S*$u/$d}]
+
+        set tiles(geom-$info(zoom)) \
+            [list $level $S $T $u $d {*}[lindex $tiles(levels) $level]]
+
+        return $tiles(geom-$info(zoom))
+    }
+
+    # ClearTiles
+    #
+    # Deletes all tile images and forgets the tile geometry, as when
+    # the -tilemap changes.
+
+    method ClearTiles {} {
+        $hull delete tile
+
+        foreach img [dict values $tiles(cache)] {
+            image delete $img
+        }
+
+        array unset tiles geom-*
+        set tiles(cache) [dict create]
+        set tiles(shown) [dict create]
+    }
+
     #-------------------------------------------------------------------
     # Utility Methods
 
@@ -1837,6 +2204,144 @@ snit::widgetadaptor ::marsgui::mapcanvas {
         }
     }
 
+    # BuildPyramid
+    #
+    # Gets the -map's zoom pyramid started, if Marsbin is available.
+    # The pyramid holds the -map at each zoom factor below 100 as a 
+    # PPM, in a single file in the -cachedir named for the -map's checksum.
+    # If there's no such file, it's built in the background by 
+    # [raster pyramid].  Meanwhile, and if there's no -cachedir,
+    # ScaleMap scales the -map from its PPM as needed.  The PPM isn't
+    # kept, as it's as large as the -map itself.  Enlargements would
+    # make the file many times the size of the -map, and so are always
+    # scaled on demand.
+
+    method BuildPyramid {} {
+        # FIRST, clear the old pyramid.
+        array unset pyramid
+
+        if {$options(-map) eq "" || [package provide Marsbin] eq ""} {
+            return
+        }
+
+        # NEXT, get the -map's pixels and key.
+        set base [$options(-map) data -format ppm]
+        set pyramid(key) [format %08x-%d \
+                              [zlib crc32 $base]  \
+                              [string length $base]]
+
+        if {$options(-cachedir) eq ""} {
+            return
+        }
+
+        # NEXT, use the cached pyramid, if there is one.
+        set fname [file join $options(-cachedir) map-$pyramid(key).ppm]
+
+        if {[$self LoadPyramid $fname]} {
+            return
+        }
+
+        # NEXT, build it in the background.  Each process writes its
+        # own temporary file, which is renamed when it's complete.
+        if {[catch {file mkdir $options(-cachedir)}]} {
+            return
+        }
+
+        raster pyramid \
+            -file    $fname.[pid] \
+            -command [list [mytypemethod PyramidReady] $win $pyramid(key) \
+                          $fname.[pid]] \
+            $base [dict values [$self PyramidFactors]]
+    }
+
+    # PyramidFactors
+    #
+    # Returns the dictionary of the zoomfactors in the pyramid, the
+    # reductions, in order.
+
+    method PyramidFactors {} {
+        dict filter $zoomfactors script {factor terms} {
+            expr {$factor < 100}
+        }
+    }
+
+    # PyramidDone key tmpfile index
+    #
+    # key       The map key the pyramid was built for
+    # tmpfile   The file the pyramid was written to
+    # index     The {offset length} of each level in the file
+    #
+    # Installs the pyramid file in the -cachedir and starts using it,
+    # provided it's still for the -map.
+
+    method PyramidDone {key tmpfile index} {
+        if {![info exists pyramid(key)] || $key ne $pyramid(key)} {
+            file delete -force $tmpfile
+            return
+        }
+
+        set fname [file rootname $tmpfile]
+
+        if {[catch {file rename -force $tmpfile $fname}]} {
+            file delete -force $tmpfile
+            return
+        }
+
+        foreach factor [dict keys [$self PyramidFactors]] place $index {
+            set pyramid($factor) $place
+        }
+
+        set pyramid(file) $fname
+    }
+
+    # LoadPyramid fname
+    #
+    # fname     A pyramid file
+    #
+    # Indexes the pyramid file, if it exists and is complete.  Returns
+    # 1 on success and 0 otherwise.
+
+    method LoadPyramid {fname} {
+        if {![file exists $fname]} {
+            return 0
+        }
+
+        # FIRST, find each level's PPM in turn.
+        set offset 0
+
+        if {[catch {
+            set f [open $fname r]
+            fconfigure $f -translation binary
+
+            foreach factor [dict keys [$self PyramidFactors]] {
+                seek $f $offset
+                gets $f magic
+                gets $f size
+                gets $f maxval
+                lassign $size width height
+
+                set length [expr {[tell $f] - $offset + 3*$width*$height}]
+                set places($factor) [list $offset $length]
+                incr offset $length
+            }
+
+            close $f
+        }]} {
+            catch {close $f}
+            return 0
+        }
+
+        # NEXT, the levels should fill the file exactly.
+        if {$offset != [file size $fname]} {
+            return 0
+        }
+
+        array set pyramid [array get places]
+        set pyramid(file) $fname
+
+        return 1
+    }
+
     # ScaleMap factor
     #
     # factor    Creates a scaled copy of the the -map at the specified
@@ -1847,9 +2352,28 @@ snit::widgetadaptor ::marsgui::mapcanvas {
     # * factor is a valid zoomfactor
     # * There is a -map
     # * No cached image exists for this factor
+    #
+    # The image comes from the zoom pyramid's file if it's ready, and
+    # then replaces any other cached zoom, as it can be reloaded at
+    # need.  Otherwise the -map is scaled directly.
 
     method ScaleMap {factor} {
-        # FIRST, update the GUI, and set the watch cursor
+        # FIRST, use the pyramid if we have it.
+        if {[info exists pyramid($factor)] && 
+            ![catch {$self ReadPyramid $factor} data]
+        } {
+            foreach f [array names zooms] {
+                if {$f ne "100"} {
+                    image delete $zooms($f)
+                    unset zooms($f)
+                }
+            }
+
+            set zooms($factor) [image create photo -format ppm -data $data]
+            return
+        }
+
+        # NEXT, update the GUI, and set the watch cursor
         set oldCursor [$hull cget -cursor]
         $hull configure -cursor watch
         update idletasks
@@ -1858,22 +2382,57 @@ snit::widgetadaptor ::marsgui::mapcanvas {
         set img $options(-map)
         lassign [dict get $zoomfactors $factor] up down
 
-        # NEXT, upsample, if necessary
-        set temp [image create photo]
-        $temp copy $img -zoom $up
+        if {[info exists pyramid(key)]} {
+            # NEXT, scale it in one pass.
+            set zooms($factor) [image create photo -format ppm \
+                -data [raster scale [$img data -format ppm] $up $down]]
+        } else {
+            # NEXT, upsample, if necessary
+            set temp [image create photo]
+            $temp copy $img -zoom $up
 
-        # NEXT, downsample, if necessary
-        set final [image create photo]
-        $final copy $temp -subsample $down
+            # NEXT, downsample, if necessary
+            set final [image create photo]
+            $final copy $temp -subsample $down
 
-        # NEXT, delete the temp image and save the new image.
-        image delete $temp
-        set zooms($factor) $final
+            # NEXT, delete the temp image and save the new image.
+            image delete $temp
+            set zooms($factor) $final
+        }
 
         # NEXT, restore the cursor
         $hull configure -cursor $oldCursor
     }
 
+    # ReadPyramid factor
+    #
+    # factor    A zoom factor in the pyramid
+    #
+    # Reads the factor's PPM from the pyramid file.
+
+    method ReadPyramid {factor} {
+        lassign $pyramid($factor) offset length
+
+        set f [open $pyramid(file) r]
+        fconfigure $f -translation binary
+
+        if {[catch {
+            seek $f $offset
+            read $f $length
+        } result]} {
+            close $f
+            return -code error $result
+        }
+
+        close $f
+
+        if {[string length $result] != $length} {
+            error "pyramid file is truncated"
+        }
+
+        return $result
+    }
+
     # CanSnap x1 y1 x2 y2
     #
     # x1,y1     A point
@@ -31,10 +31,12 @@ namespace eval ::marsutil:: {
         cedge        \
         cindex       \
         clength      \
+        geoindex     \
         creverse     \
         intersect    \
         avgpoint     \
         point        \
+        polygon      \
         ptinpoly     \
         px           \
         py
@@ -330,7 +332,7 @@ proc ::marsutil::boxaround {radius x y} {
 
 # ptinpoly poly p ?bbox?
 #
-# poly     A polygon -- a list of coordinates.
+# poly     A polygon -- a list of coordinates, or a polygon handle.
 # p        A point   -- a list {x y}
 # bbox     Optionally, the polygon's bounding box; otherwise, the 
 #          bounding box will be computed.
@@ -354,11 +356,55 @@ proc ::marsutil::boxaround {radius x y} {
 #     http://astronomy.swin.edu.au/~pbourke/geometry/insidepoly
 #
 # Returns 1 if p is inside (or on the border) and 0 if p is outside.
+#
+# ptinpoly -batch polys points
+#
+# polys    A list of polygon handles
+# points   A flat list of point coordinates, {x1 y1 x2 y2 ...}
+#
+# Classifies all of the points at once.  Returns a list with one
+# element per point: the index in polys of the last polygon containing
+# the point, or -1 if none do.  As in geoset, later polygons are on
+# top of earlier ones.
 
 if {[llength [info commands ::marsutil::ptinpoly]] == 0} {
 
     proc ::marsutil::ptinpoly {poly p {bbox ""}} {
-        # FIRST, get the coordinates of the point and the bounding box
+        # FIRST, handle -batch.
+        if {$poly eq "-batch"} {
+            set polys  $p
+            set points $bbox
+            set result [list]
+
+            foreach {x y} $points {
+                set found -1
+
+                for {set i [llength $polys]} {[incr i -1] >= 0} {} {
+                    if {[ptinpoly [lindex $polys $i] [list $x $y]]} {
+                        set found $i
+                        break
+                    }
+                }
+
+                lappend result $found
+            }
+
+            return $result
+        }
+
+        # NEXT, if poly is a polygon handle, get its coordinates and
+        # bounding box.  A coordinate list has at least two elements,
+        # so a one-element value must be a handle.
+        if {[llength $poly] == 1} {
+            if {![info exists ::marsutil::polygon::coords($poly)]} {
+                error "unknown polygon: \"$poly\""
+            }
+
+            set bbox $::marsutil::polygon::bbox($poly)
+            set poly $::marsutil::polygon::coords($poly)
+        }
+
+        # NEXT, get the coordinates of the point and the bounding box
         # of the polygon.
         set x [px $p]
         set y [py $p]
@@ -427,5 +473,453 @@ if {[llength [info commands ::marsutil::ptinpoly]] == 0} {
 
 }
 
+#-----------------------------------------------------------------------
+# Polygon Handles
+#
+# A polygon handle stands for a polygon whose coordinates have been
+# parsed and whose bounding box has been computed once, up front; it
+# can be passed to ptinpoly in place of the coordinates.  The Marsbin
+# version also precomputes the polygon's edges, so that ptinpoly
+# does no parsing or allocation at all.
+
+if {[llength [info commands ::marsutil::polygon]] == 0} {
+
+snit::type ::marsutil::polygon {
+    # Make it an ensemble
+    pragma -hastypeinfo 0 -hastypedestroy 0 -hasinstances 0
+
+    #-------------------------------------------------------------------
+    # Type Variables
+
+    # Counter used to generate handle names
+    typevariable counter 0
+
+    # Arrays of coordinates and bounding boxes by handle
+    typevariable coords -array {}
+    typevariable bbox   -array {}
+
+    #-------------------------------------------------------------------
+    # Ensemble subcommands
+
+    # create coords
+    #
+    # coords    A list of three or more x,y coordinate pairs
+    #
+    # Returns a new polygon handle.
+
+    typemethod create {theCoords} {
+        if {[llength $theCoords] % 2 != 0} {
+            error \
+    "expected even number of coordinates, got [llength $theCoords]: \"$theCoords\""
+        }
+
+        if {[llength $theCoords] < 6} {
+            error \
+    "expected at least 3 point(s), got [clength $theCoords]: \"$theCoords\""
+        }
+
+        set handle poly[incr counter]
+        set coords($handle) $theCoords
+        set bbox($handle) [bbox $theCoords]
+
+        return $handle
+    }
+
+    # delete handle
+    #
+    # handle    A polygon handle
+    #
+    # Deletes the handle.
 
+    typemethod delete {handle} {
+        $type Validate $handle
+
+        unset coords($handle)
+        unset bbox($handle)
+        return
+    }
+
+    # coords handle
+    #
+    # handle    A polygon handle
+    #
+    # Returns the polygon's coordinates.
+
+    typemethod coords {handle} {
+        $type Validate $handle
+
+        return $coords($handle)
+    }
+
+    # bbox handle
+    #
+    # handle    A polygon handle
+    #
+    # Returns the polygon's bounding box.
 
+    typemethod bbox {handle} {
+        $type Validate $handle
+
+        return $bbox($handle)
+    }
+
+    # adjacency ?-latlong? ?-tolerance tol? polys
+    #
+    # polys     A list of polygon handles
+    # tol       Tolerance for collinear edges
+    #
+    # Returns a flat list {i j border dist ...} with an entry for each
+    # pair of adjacent polygons, i < j, where i and j are indices into
+    # polys, border is the length of their shared border, and dist is
+    # the distance between their centroids.  With -latlong, the 
+    # coordinates are lat/long pairs and the lengths are in kilometers.
+    # This version compares every pair of edges of every pair of 
+    # polygons whose bounding boxes overlap.
+
+    typemethod adjacency {args} {
+        # FIRST, get the options.
+        set latlong 0
+        set tol 0.0
+
+        while {[llength $args] > 1} {
+            set opt [lindex $args 0]
+
+            if {$opt eq "-latlong"} {
+                set latlong 1
+                set args [lrange $args 1 end]
+            } elseif {$opt eq "-tolerance" && [llength $args] > 2} {
+                set tol [lindex $args 1]
+                set args [lrange $args 2 end]
+
+                if {![string is double -strict $tol] || $tol < 0.0} {
+                    error "invalid tolerance, should be >= 0.0: \"$tol\""
+                }
+            } else {
+                break
+            }
+        }
+
+        if {[llength $args] != 1} {
+            return -code error "wrong # args: should be\
+                \"$type adjacency ?-latlong? ?-tolerance tol? polys\""
+        }
+
+        set polys [lindex $args 0]
+
+        foreach poly $polys {
+            $type Validate $poly
+        }
+
+        # NEXT, compare each pair of polygons.
+        set result [list]
+        set n [llength $polys]
+
+        for {set i 0} {$i < $n} {incr i} {
+            set pi [lindex $polys $i]
+            lassign $bbox($pi) ixmin iymin ixmax iymax
+
+            for {set j [expr {$i + 1}]} {$j < $n} {incr j} {
+                set pj [lindex $polys $j]
+                lassign $bbox($pj) jxmin jymin jxmax jymax
+
+                if {$ixmax + $tol < $jxmin || $jxmax + $tol < $ixmin ||
+                    $iymax + $tol < $jymin || $jymax + $tol < $iymin
+                } {
+                    continue
+                }
+
+                set adjacent 0
+                set border 0.0
+
+                foreach {p1 p2} [$type Edges $coords($pi)] {
+                    foreach {q1 q2} [$type Edges $coords($pj)] {
+                        set len [$type EdgeContact \
+                                     $p1 $p2 $q1 $q2 $tol $latlong]
+
+                        if {$len ne ""} {
+                            set adjacent 1
+                            set border [expr {$border + $len}]
+                        }
+                    }
+                }
+
+                if {$adjacent} {
+                    set ci [$type Centroid $coords($pi)]
+                    set cj [$type Centroid $coords($pj)]
+
+                    if {$latlong} {
+                        set dist [latlong dist $ci $cj]
+                    } else {
+                        set dist [expr {hypot([px $cj] - [px $ci],
+                                              [py $cj] - [py $ci])}]
+                    }
+
+                    lappend result $i $j $border $dist
+                }
+            }
+        }
+
+        return $result
+    }
+
+    # Edges theCoords
+    #
+    # theCoords    A polygon's coordinates
+    #
+    # Returns a list {p1 p2 ...} of the polygon's edges' end points.
+
+    typemethod Edges {theCoords} {
+        set result [list]
+        set n [clength $theCoords]
+
+        for {set i 0} {$i < $n} {incr i} {
+            lappend result [cindex $theCoords $i] \
+                [cindex $theCoords [expr {($i + 1) % $n}]]
+        }
+
+        return $result
+    }
+
+    # EdgeContact p1 p2 q1 q2 tol latlong
+    #
+    # p1,p2     An edge
+    # q1,q2     Another edge
+    # tol       Tolerance for collinearity
+    # latlong   1 if the points are lat/long pairs
+    #
+    # Returns the length of the edges' shared part if they touch, 
+    # cross, or overlap, and "" otherwise.
+
+    typemethod EdgeContact {p1 p2 q1 q2 tol latlong} {
+        lassign $p1 px1 py1
+        lassign $p2 px2 py2
+        lassign $q1 qx1 qy1
+        lassign $q2 qx2 qy2
+
+        set dx [expr {$px2 - $px1}]
+        set dy [expr {$py2 - $py1}]
+        set len [expr {hypot($dx, $dy)}]
+
+        if {$len > 0.0} {
+            set c1 [expr {$dx*($qy1 - $py1) - $dy*($qx1 - $px1)}]
+            set c2 [expr {$dx*($qy2 - $py1) - $dy*($qx2 - $px1)}]
+
+            if {abs($c1) <= $tol*$len && abs($c2) <= $tol*$len} {
+                set t1 [expr {($dx*($qx1 - $px1) + $dy*($qy1 - $py1))/
+                              ($len*$len)}]
+                set t2 [expr {($dx*($qx2 - $px1) + $dy*($qy2 - $py1))/
+                              ($len*$len)}]
+                set lo [expr {max(0.0, min($t1, $t2))}]
+                set hi [expr {min(1.0, max($t1, $t2))}]
+
+                if {$hi > $lo} {
+                    if {$latlong} {
+                        return [latlong dist4 \
+                                    [expr {$px1 + $lo*$dx}] \
+                                    [expr {$py1 + $lo*$dy}] \
+                                    [expr {$px1 + $hi*$dx}] \
+                                    [expr {$py1 + $hi*$dy}]]
+                    }
+
+                    return [expr {($hi - $lo)*$len}]
+                }
+
+                if {$hi == $lo} {
+                    return 0.0
+                }
+            }
+        }
+
+        if {[intersect $p1 $p2 $q1 $q2]} {
+            return 0.0
+        }
+
+        return ""
+    }
+
+    # Centroid theCoords
+    #
+    # theCoords    A polygon's coordinates
+    #
+    # Returns the centroid of the polygon's area, or if it has no
+    # area, the average of its vertices.
+
+    typemethod Centroid {theCoords} {
+        set area2 0.0
+        set cx 0.0
+        set cy 0.0
+
+        foreach {p1 p2} [$type Edges $theCoords] {
+            lassign $p1 x1 y1
+            lassign $p2 x2 y2
+
+            set cross [expr {$x1*$y2 - $x2*$y1}]
+            set area2 [expr {$area2 + $cross}]
+            set cx [expr {$cx + ($x1 + $x2)*$cross}]
+            set cy [expr {$cy + ($y1 + $y2)*$cross}]
+        }
+
+        if {$area2 != 0.0} {
+            return [list [expr {$cx/(3.0*$area2)}] [expr {$cy/(3.0*$area2)}]]
+        }
+
+        return [avgpoint $theCoords]
+    }
+
+    # Validate handle
+    #
+    # handle    A polygon handle
+    #
+    # Throws an error if the handle is unknown.
+
+    typemethod Validate {handle} {
+        if {![info exists coords($handle)]} {
+            error "unknown polygon: \"$handle\""
+        }
+    }
+}
+
+}
+
+#-----------------------------------------------------------------------
+# Spatial Indices
+#
+# A geoindex is a stack of polygon handles, each with an item ID;
+# given a point, it returns the ID of the uppermost polygon containing
+# the point.  The Marsbin version keeps a grid over the polygons'
+# bounding boxes, so that only the polygons near the point are checked;
+# the pure-Tcl version checks every polygon from the top down.
+
+if {[llength [info commands ::marsutil::geoindex]] == 0} {
+
+snit::type ::marsutil::geoindex {
+    # Make it an ensemble
+    pragma -hastypeinfo 0 -hastypedestroy 0 -hasinstances 0
+
+    #-------------------------------------------------------------------
+    # Type Variables
+
+    # Counter used to generate index names
+    typevariable counter 0
+
+    # Array of item ID lists, in stacking order, by index
+    typevariable items -array {}
+
+    # Array of polygon handles by index,id
+    typevariable polys -array {}
+
+    #-------------------------------------------------------------------
+    # Ensemble subcommands
+
+    # create
+    #
+    # Returns a new, empty index.
+
+    typemethod create {} {
+        set index geoindex[incr counter]
+        set items($index) [list]
+
+        return $index
+    }
+
+    # delete index
+    #
+    # index    A geoindex
+    #
+    # Deletes the index.
+
+    typemethod delete {index} {
+        $type Validate $index
+
+        array unset polys "$index,*"
+        unset items($index)
+        return
+    }
+
+    # add index id poly
+    #
+    # index    A geoindex
+    # id       An item ID, unique within the index
+    # poly     A polygon handle
+    #
+    # Adds the polygon to the index as the uppermost polygon.
+
+    typemethod add {index id poly} {
+        $type Validate $index
+
+        if {[info exists polys($index,$id)]} {
+            error "item already in index: \"$id\""
+        }
+
+        polygon coords $poly
+
+        lappend items($index) $id
+        set polys($index,$id) $poly
+        return
+    }
+
+    # remove index id
+    #
+    # index    A geoindex
+    # id       An item ID
+    #
+    # Removes the item from the index, if it's present.
+
+    typemethod remove {index id} {
+        $type Validate $index
+
+        if {[info exists polys($index,$id)]} {
+            ldelete items($index) $id
+            unset polys($index,$id)
+        }
+        return
+    }
+
+    # find index point
+    #
+    # index    A geoindex
+    # point    A point
+    #
+    # Returns the ID of the uppermost polygon containing the point,
+    # or "".
+
+    typemethod find {index point} {
+        $type Validate $index
+
+        for {set i [llength $items($index)]} {[incr i -1] >= 0} {} {
+            set id [lindex $items($index) $i]
+
+            if {[ptinpoly $polys($index,$id) $point]} {
+                return $id
+            }
+        }
+
+        return ""
+    }
+
+    # size index
+    #
+    # index    A geoindex
+    #
+    # Returns the number of polygons in the index.
+
+    typemethod size {index} {
+        $type Validate $index
+
+        return [llength $items($index)]
+    }
+
+    # Validate index
+    #
+    # index    A geoindex
+    #
+    # Throws an error if the index is unknown.
+
+    typemethod Validate {index} {
+        if {![info exists items($index)]} {
+            error "unknown geoindex: \"$index\""
+        }
+    }
+}
+
+}
@@ -47,6 +47,10 @@ snit::type ::marsutil::geoset {
     variable itemtype     ;# Array of itemtypes by item ID
     variable itemcoords   ;# Array of item coordinates by item ID
     variable bbox         ;# Array of bounding boxes by item ID
+    variable polyhandle   ;# Array of polygon(n) handles by polygon ID
+    variable geoindex     ;# Array of geoindex(n) handles by tag; the
+                           # index for all polygons has the tag "".
+                           # Created on demand by find.
 
     # info -- array of scalars
     #
@@ -63,7 +67,16 @@ snit::type ::marsutil::geoset {
     
     # Default Constructor
 
-    # Default Destructor
+    destructor {
+        # Free the spatial indices and compiled polygons
+        foreach {tag index} [array get geoindex] {
+            geoindex delete $index
+        }
+
+        foreach {id handle} [array get polyhandle] {
+            polygon delete $handle
+        }
+    }
 
     #-------------------------------------------------------------------
     # Public Methods
@@ -137,9 +150,23 @@ snit::type ::marsutil::geoset {
         set bbox($id) [bbox $coords]
         set itemtype($id) $theType
 
+        # Compile polygons for fast lookups by find
+        if {$theType eq "polygon"} {
+            set polyhandle($id) [polygon create $coords]
+        }
+
         # Tag it with its type
         set info(tags-$id) $theType
         lappend info(ids-$theType) $id
+
+        # Add polygons to the existing spatial indices
+        if {$theType eq "polygon"} {
+            foreach tag [list "" $theType] {
+                if {[info exists geoindex($tag)]} {
+                    geoindex add $geoindex($tag) $id $polyhandle($id)
+                }
+            }
+        }
         
         # Tag it with all other tags.
         foreach tag $tagList {
@@ -157,6 +184,18 @@ snit::type ::marsutil::geoset {
         ldelete info(ids) $id
         unset itemcoords($id)
         unset bbox($id)
+
+        if {[info exists polyhandle($id)]} {
+            foreach tag [list "" {*}$info(tags-$id)] {
+                if {[info exists geoindex($tag)]} {
+                    geoindex remove $geoindex($tag) $id
+                }
+            }
+
+            polygon delete $polyhandle($id)
+            unset polyhandle($id)
+        }
+
         foreach tag $info(tags-$id) {
             ldelete info(ids-$tag) $id
         }
@@ -255,6 +294,10 @@ snit::type ::marsutil::geoset {
         }
         lappend info(tags-$id) $tag
         lappend info(ids-$tag) $id
+
+        if {[info exists polyhandle($id)] && [info exists geoindex($tag)]} {
+            geoindex add $geoindex($tag) $id $polyhandle($id)
+        }
     }
 
     # tags id
@@ -293,25 +336,41 @@ snit::type ::marsutil::geoset {
     # Returns the ID of the uppermost (i.e., last) polygon 
     # which contains the specified point, or "".  If tag is given,
     # only polygons with that tag are included.
+    #
+    # The search is done by a geoindex(n) spatial index over the
+    # tagged polygons, which is built the first time the tag is
+    # used and kept up to date as items are created, tagged, and
+    # deleted.
 
     method find {point {tag ""}} {
         ValidatePoint $point
 
-        set ids [$self list $tag]
+        if {![info exists geoindex($tag)]} {
+            if {$tag ne "" && ![info exists info(ids-$tag)]} {
+                return ""
+            }
+
+            $self BuildIndex $tag
+        }
+
+        return [geoindex find $geoindex($tag) $point]
+    }
 
-        let last {[llength $ids] - 1}
+    # BuildIndex tag
+    #
+    # tag     A tag, or "" for all items.
+    #
+    # Creates the spatial index for the tagged polygons, adding them
+    # in stacking order.
 
-        for {set i $last} {$i >= 0} {incr i -1} {
-            set id [lindex $ids $i]
+    method BuildIndex {tag} {
+        set geoindex($tag) [geoindex create]
 
+        foreach id [$self list $tag] {
             if {$itemtype($id) eq "polygon"} {
-                if {[ptinpoly $itemcoords($id) $point $bbox($id)]} {
-                    return $id
-                }
+                geoindex add $geoindex($tag) $id $polyhandle($id)
             }
         }
-
-        return ""
     }
 
     # clear
@@ -319,6 +378,16 @@ snit::type ::marsutil::geoset {
     # Deletes all content
 
     method clear {} {
+        foreach {tag index} [array get geoindex] {
+            geoindex delete $index
+        }
+
+        foreach {id handle} [array get polyhandle] {
+            polygon delete $handle
+        }
+
+        array unset geoindex
+        array unset polyhandle
         array unset itemtype
         array unset itemcoords
         array unset bbox
@@ -258,3 +258,80 @@ puts "bbox: [gs bbox]"
 puts "id at 35,50: <[gs find {35 50} nbhood]>"
 
 puts "bench: [time {gs find {35 50} nbhood} 10000]"
+
+#-----------------------------------------------------------------------
+# Scaling
+#
+# For each size N, builds a geoset containing a square grid of N
+# unit-square polygons, and compares [gs find], which uses a spatial
+# index, with a linear top-down search over all of the polygons.
+
+# LinearFind gs point
+#
+# Returns the uppermost polygon in gs containing point by checking
+# every polygon, as [$gs find] did before it had an index.
+
+proc LinearFind {gs point} {
+    set ids [$gs list]
+
+    for {set i [llength $ids]} {[incr i -1] >= 0} {} {
+        set id [lindex $ids $i]
+
+        if {[ptinpoly [$gs coords $id] $point [$gs bbox $id]]} {
+            return $id
+        }
+    }
+
+    return ""
+}
+
+# BenchSize n
+#
+# n     The number of polygons
+#
+# Runs the comparison for n polygons.
+
+proc BenchSize {n} {
+    set side [expr {int(sqrt($n))}]
+
+    geoset bgs
+
+    for {set i 0} {$i < $side} {incr i} {
+        for {set j 0} {$j < $side} {incr j} {
+            set x1 [expr {$i + 1}]
+            set y1 [expr {$j + 1}]
+            bgs create polygon N$i.$j [list $i $j  $x1 $j  $x1 $y1  $i $y1]
+        }
+    }
+
+    # Pick a fixed set of points across the grid.
+    expr {srand(1)}
+    set points {}
+    for {set k 0} {$k < 100} {incr k} {
+        lappend points [list [expr {rand()*$side}] [expr {rand()*$side}]]
+    }
+
+    # The first find builds the index; time it separately.
+    set build [lindex [time {bgs find [lindex $points 0]}] 0]
+
+    set indexed [lindex [time {
+        foreach pt $points { bgs find $pt }
+    } 10] 0]
+
+    set linear [lindex [time {
+        foreach pt [lrange $points 0 9] { LinearFind bgs $pt }
+    }] 0]
+
+    set indexed [expr {$indexed/100.0}]
+    set linear  [expr {$linear/10.0}]
+
+    puts [format "%6d polygons: build %10.0f us, find %8.2f us, linear %10.2f us, speedup %8.1fx" \
+              [expr {$side*$side}] $build $indexed $linear \
+              [expr {$linear/$indexed}]]
+
+    bgs destroy
+}
+
+foreach n {1000 10000 100000} {
+    BenchSize $n
+}
@@ -110,6 +110,96 @@ snit::type ::marsutil::latlong {
                         cos($lat1)*cos($lat2)*$sinHalfDlon*$sinHalfDlon))}
     }
 
+    # distlist ?-bytes? origin locs
+    #
+    # origin    A lat/long pair in decimal degrees.
+    # locs      A flat list of lat/long coordinates in decimal degrees.
+    #
+    # Returns a list of the distances in kilometers from origin to each
+    # of the locs.  With -bytes, returns a byte array of native doubles.
+
+    typemethod distlist {args} {
+        set asBytes [expr {[lindex $args 0] eq "-bytes"}]
+
+        if {$asBytes} {
+            set args [lrange $args 1 end]
+        }
+
+        if {[llength $args] != 2} {
+            return -code error \
+                "wrong # args: should be \"$type distlist ?-bytes? origin locs\""
+        }
+
+        lassign $args origin locs
+        lassign $origin lat1 lon1
+
+        set result [list]
+
+        foreach {lat2 lon2} $locs {
+            lappend result [$type dist4 $lat1 $lon1 $lat2 $lon2]
+        }
+
+        if {$asBytes} {
+            return [binary format d* $result]
+        }
+
+        return $result
+    }
+
+    # distmatrix ?-bytes? locs1 ?locs2?
+    #
+    # locs1     A flat list of lat/long coordinates in decimal degrees.
+    # locs2     Another such list; defaults to locs1.
+    #
+    # Returns the matrix of distances in kilometers from each of locs1
+    # to each of locs2 as a flat list in row-major order.  With -bytes,
+    # returns a byte array of native doubles.
+
+    typemethod distmatrix {args} {
+        set asBytes [expr {[lindex $args 0] eq "-bytes"}]
+
+        if {$asBytes} {
+            set args [lrange $args 1 end]
+        }
+
+        if {[llength $args] < 1 || [llength $args] > 2} {
+            return -code error \
+            "wrong # args: should be \"$type distmatrix ?-bytes? locs1 ?locs2?\""
+        }
+
+        set locs1 [lindex $args 0]
+
+        if {[llength $args] == 2} {
+            set locs2 [lindex $args 1]
+        } else {
+            set locs2 $locs1
+        }
+
+        # The same limit as the Marsbin version, which returns the
+        # result as a list or byte array.
+        set n [expr {[llength $locs1]/2}]
+        set m [expr {[llength $locs2]/2}]
+
+        if {wide($n)*$m > 0x7fffffff/8} {
+            return -code error \
+  "distance matrix too large: $n x $m, at most [expr {0x7fffffff/8}] distances"
+        }
+
+        set result [list]
+
+        foreach {lat1 lon1} $locs1 {
+            foreach {lat2 lon2} $locs2 {
+                lappend result [$type dist4 $lat1 $lon1 $lat2 $lon2]
+            }
+        }
+
+        if {$asBytes} {
+            return [binary format d* $result]
+        }
+
+        return $result
+    }
+
     # pole ?loc?
     #
     # loc       A lat/long pair in decimal degrees.
@@ -138,7 +228,8 @@ snit::type ::marsutil::latlong {
     # area coords
     #
     # coords     The lat/long coordinates in decimal degrees of a
-    #            polygon, expressed in counter-clockwise order.
+    #            polygon, expressed in counter-clockwise order, or a
+    #            polygon(n) handle.
     #
     # Computes the area of the polygon in square kilometers, taking
     # curvature of the earth into account.
@@ -163,7 +254,18 @@ snit::type ::marsutil::latlong {
     #   correct it if not.
 
     typemethod area {coords} {
-        # FIRST, verify the length
+        # FIRST, if it's a polygon handle, get its coordinates.  A 
+        # coordinate list has at least two elements, so a one-element 
+        # value must be a handle.
+        if {[llength $coords] == 1} {
+            if {![info exists ::marsutil::polygon::coords($coords)]} {
+                error "unknown polygon: \"$coords\""
+            }
+
+            set coords $::marsutil::polygon::coords($coords)
+        }
+
+        # NEXT, verify the length
         set len [llength $coords]
         require {$len % 2 == 0} \
             "expected even number of coordinates, got $len: \"$coords\""
@@ -245,6 +347,7 @@ snit::type ::marsutil::latlong {
     delegate typemethod frommgrs to UnimplementedSubcommand
     delegate typemethod togcc    to UnimplementedSubcommand
     delegate typemethod fromgcc  to UnimplementedSubcommand
+    delegate typemethod perimeter to UnimplementedSubcommand
 
     typemethod UnimplementedSubcommand {args} {
         error "subcommand requires libMarsUtil.so"
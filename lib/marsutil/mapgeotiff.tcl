@@ -0,0 +1,238 @@
+#-----------------------------------------------------------------------
+# TITLE:
+#    mapgeotiff.tcl
+#
+# AUTHOR:
+#    Will Duquette
+#
+# DESCRIPTION:
+#    marsutil(n) module: a GeoTIFF projection(i) type.
+#
+#    Routines for conversion between canvas coordinates and map references
+#    for a map image read from a GeoTIFF file, geographic or projected
+#    (Transverse Mercator or UTM).
+#
+#    There are three kinds of coordinate in use:
+#
+#    * Canvas coordinates: cx,cy coordinates extending to the right and
+#      down from the origin, in floating point pixels.  Conversions to
+#      and from canvas coordinates take the zoom factor into account.
+#
+#    * Map units: lat,lon coordinates, as for maprect(n).  The image
+#      pixel for a canvas coordinate is
+#
+#          px = cx / (zoom factor/100.0)
+#
+#      and the lat,lon for a pixel is computed by geotiff(n) from the
+#      file's georeferencing.  For a projected image this is not a
+#      rectangle of lat/long, so the conversion uses the geotiff
+#      handle's interpolation grid rather than a linear formula.
+#
+#    * Map references (map refs): MGRS strings computed from the
+#      lat/long pair.
+#
+#-----------------------------------------------------------------------
+
+#-----------------------------------------------------------------------
+# Export public commands
+
+namespace eval ::marsutil:: {
+    namespace export mapgeotiff
+}
+
+#-----------------------------------------------------------------------
+# mapgeotiff type
+
+snit::type ::marsutil::mapgeotiff {
+    #-------------------------------------------------------------------
+    # Options
+
+    # A handle returned by "geotiff open"; the caller owns it, and
+    # must close it after destroying the projection.
+    option -geotiff -configuremethod ConfigureGeotiff
+
+    # Width and height of map, in pixels; read-only, taken from
+    # the -geotiff.
+    option -width  -default 1000 -readonly yes
+    option -height -default 1000 -readonly yes
+
+    #-------------------------------------------------------------------
+    # Constructor
+
+    constructor {args} {
+        $self configurelist $args
+    }
+
+    #-------------------------------------------------------------------
+    # Configuration
+
+    # ConfigureGeotiff opt val
+    #
+    # Saves the handle and gets the map dimensions from it.
+
+    method ConfigureGeotiff {opt val} {
+        set options($opt) $val
+
+        if {$val ne ""} {
+            set info [geotiff info $val]
+            set options(-width)  [dict get $info width]
+            set options(-height) [dict get $info height]
+        }
+    }
+
+    #-------------------------------------------------------------------
+    # Methods
+
+    # box
+    #
+    # Returns the bounding box of the map in pixels
+
+    method box {} {
+        list 0 0 $options(-width) $options(-height)
+    }
+
+    # dim
+    #
+    # Returns the dimensions of the map in pixels
+
+    method dim {} {
+        list $options(-width) $options(-height)
+    }
+
+    # c2m zoom cx cy
+    #
+    # zoom     Zoom factor
+    # cx,cy    Position in canvas units
+    #
+    # Returns the position in map units
+
+    method c2m {zoom cx cy} {
+        set fac [expr {$zoom/100.0}]
+        geotiff tolatlong $options(-geotiff) \
+            [expr {$cx/$fac}] [expr {$cy/$fac}]
+    }
+
+    # m2c zoom lat lon....
+    #
+    # zoom       Zoom factor
+    # lat,lon    One or more points in map units
+    #
+    # Returns the points in canvas units
+
+    method m2c {zoom args} {
+        set out [list]
+        set fac [expr {$zoom/100.0}]
+
+        foreach {px py} [geotiff topixel $options(-geotiff) {*}$args] {
+            lappend out [expr {round($px*$fac)}] [expr {round($py*$fac)}]
+        }
+
+        return $out
+    }
+
+    # c2ref zoom cx cy
+    #
+    # zoom     Zoom factor
+    # cx,cy    Position in canvas units
+    #
+    # Returns the position as a map reference
+
+    method c2ref {zoom cx cy} {
+        return [latlong tomgrs [clamp {*}[$self c2m $zoom $cx $cy]]]
+    }
+
+    # c2loc zoom cx cy
+    #
+    # zoom     Zoom factor
+    # cx,cy    Position in canvas units
+    #
+    # Returns the position as a map location for purposes of display,
+    # which in this projection is the MGRS location followed by the
+    # corresponding lat/long coordinate pair.
+
+    method c2loc {zoom cx cy} {
+        lassign [clamp {*}[$self c2m $zoom $cx $cy]] lat lon
+
+        # Only 3 digits of precision for display
+        set mgrs [latlong tomgrs [list $lat $lon] 3]
+
+        set flon [format "%.4f" $lon]
+        set flat [format "%.4f" $lat]
+
+        return "$mgrs ($flat, $flon)"
+    }
+
+    # ref2c zoom ref...
+    #
+    # zoom     Zoom factor
+    # ref      A map reference
+    #
+    # Returns a list {cx cy...} in canvas units
+
+    method ref2c {zoom args} {
+        $self m2c $zoom {*}[$self ref2m {*}$args]
+    }
+
+    # m2ref lat lon....
+    #
+    # lat,lon    Position in map units
+    #
+    # Returns the position(s) as mapref strings
+
+    method m2ref {args} {
+        set result [list]
+
+        foreach {lat lon} $args {
+            lappend result [latlong tomgrs [clamp $lat $lon]]
+        }
+
+        return $result
+    }
+
+    # ref2m ref...
+    #
+    # ref   A map reference string
+    #
+    # Returns a list {lat lon...}
+
+    method ref2m {args} {
+        set result [list]
+
+        foreach ref $args {
+            lappend result {*}[latlong frommgrs $ref]
+        }
+
+        return $result
+    }
+
+    # ref validate ref....
+    #
+    # ref   A map reference
+    #
+    # Validates the map reference for form and content.
+
+    method {ref validate} {args} {
+        foreach ref $args {
+            if {[catch {latlong frommgrs $ref} result]} {
+                return -code error -errorcode INVALID\
+                    "invalid MGRS coordinate: \"$ref\""
+            }
+        }
+
+        return $args
+    }
+
+    # clamp lat lon
+    #
+    # Clamps lat/lon to the valid range.  A canvas point off the map
+    # can be outside it.
+
+    proc clamp {lat lon} {
+        if {$lat < -90.0}  {set lat -90.0}
+        if {$lat >  90.0}  {set lat  90.0}
+        if {$lon < -180.0} {set lon -180.0}
+        if {$lon >  180.0} {set lon  180.0}
+
+        return [list $lat $lon]
+    }
+}
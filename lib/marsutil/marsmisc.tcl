@@ -24,6 +24,7 @@ namespace eval ::marsutil:: {
         callwith        \
         commafmt        \
         count           \
+        curvestore      \
         degrees         \
         dicteq          \
         dictglob        \
@@ -34,6 +35,7 @@ namespace eval ::marsutil:: {
         getcode         \
         gettimeofday    \
         geotiff         \
+        gramcontrib     \
         hexcolor        \
         hexquote        \
         identifier      \
@@ -60,6 +62,7 @@ namespace eval ::marsutil:: {
         pickfrom        \
         poisson         \
         radians         \
+        raster          \
         roundrange      \
         readfile        \
         require         \
@@ -1028,6 +1031,36 @@ if {[llength [info commands ::marsutil::geotiff]] == 0} {
     }
 }
 
+#-------------------------------------------------------------------
+# Raster scaling
+
+# ::marsutil::raster exists only if Marsbin.dll is loaded
+if {[llength [info commands ::marsutil::raster]] == 0} {
+    proc ::marsutil::raster {args} {
+        error "raster command requires Marsbin library"
+    }
+}
+
+#-------------------------------------------------------------------
+# Curve storage for ucurve(n)
+
+# ::marsutil::curvestore exists only if Marsbin.dll is loaded
+if {[llength [info commands ::marsutil::curvestore]] == 0} {
+    proc ::marsutil::curvestore {args} {
+        error "curvestore command requires Marsbin library"
+    }
+}
+
+#-------------------------------------------------------------------
+# Effect contributions for gram(n)
+
+# ::marsutil::gramcontrib exists only if Marsbin.dll is loaded
+if {[llength [info commands ::marsutil::gramcontrib]] == 0} {
+    proc ::marsutil::gramcontrib {args} {
+        error "gramcontrib command requires Marsbin library"
+    }
+}
+
 #-------------------------------------------------------------------
 # File Handling Utilities
 
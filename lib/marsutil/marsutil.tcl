@@ -80,6 +80,7 @@ source [file join $::marsutil::library tabletext.tcl      ]
 source [file join $::marsutil::library cellmodel.tcl      ]
 source [file join $::marsutil::library mapref.tcl         ]
 source [file join $::marsutil::library maprect.tcl        ]
+source [file join $::marsutil::library mapgeotiff.tcl     ]
 source [file join $::marsutil::library dynaform.tcl       ]
 source [file join $::marsutil::library dynaform_fields.tcl]
 source [file join $::marsutil::library order.tcl          ]
@@ -783,6 +783,15 @@ snit::type ::marsutil::simclockType {
         expr {($ticks + $offset) * $tickSize * $factor($units,days)}
     }
 
+    # unitDays
+    #
+    # Returns the length of the clock's tick units in decimal days;
+    # toDays computes ticks*tickSize*unitDays.
+
+    method unitDays {} {
+        return $factor($units,days)
+    }
+
     # fromDays days
     #
     # days         A sim time in decimal days
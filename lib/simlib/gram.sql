@@ -190,6 +190,16 @@ ON gram_effects(direct_id,etype,driver,cause,prox);
 CREATE INDEX gram_effects_index_ncontrib
 ON gram_effects(etype,ts,prox);
 
+-- These speed up expiration: each term of the WHERE clause in
+-- DeleteExpiredEffects is a lookup on one of them, so the cost of
+-- a time step is in the effects that expire rather than in all of
+-- the effects, scheduled and active.
+CREATE INDEX gram_effects_index_expiry
+ON gram_effects(etype,te,slope);
+
+CREATE INDEX gram_effects_index_prox
+ON gram_effects(prox);
+
 -- gram(n) Curve Delta History Table
 -- This table contains the actual tock-by-tock deltas for each curve.
 CREATE TABLE gram_deltas (
@@ -223,6 +223,15 @@ snit::type ::simlib::gram {
 
     option -logcomponent -default gram -readonly 1
 
+    # Option: -native
+    #
+    # If on (the default), the nominal contributions of the level and
+    # slope effects are computed in C, using gramcontrib(n), provided
+    # that the Marsbin library is loaded.  If off, or if it isn't, 
+    # they are computed in Tcl.
+
+    option -native -type snit::boolean -default on
+
     #-------------------------------------------------------------------
     # Group: Components
     #
@@ -3689,6 +3698,12 @@ snit::type ::simlib::gram {
         set plimit \
             $proxlimit([$parm get gram.proxlimit])
 
+        # NEXT, do it in C if we can.
+        if {$options(-native) && [package provide Marsbin] ne ""} {
+            $self NativeContributionsForLevelEffects $plimit
+            return
+        }
+
         # NEXT, for each level effect for which the start time has
         # been reached and which has not yet expired, compute its nominal
         # contribution. Accumulate the desired updates, and apply them
@@ -3760,6 +3775,12 @@ snit::type ::simlib::gram {
         set plimit \
             $proxlimit([$parm get gram.proxlimit])
 
+        # NEXT, do it in C if we can.
+        if {$options(-native) && [package provide Marsbin] ne ""} {
+            $self NativeContributionsForSlopeEffects $plimit
+            return
+        }
+
         # NEXT, Get each slope effect that's been active during
         # the last time step, and compute and save their nominal 
         # contributions.
@@ -3859,6 +3880,107 @@ snit::type ::simlib::gram {
         }
     }
 
+    # Method: NativeContributionsForLevelEffects
+    #
+    # plimit - The numeric proximity limit
+    #
+    # Does the work of <ComputeNominalContributionsForLevelEffects>
+    # in C, using gramcontrib(n).  All of the active effects are
+    # stamped with the time and have their contributions zeroed by 
+    # a single UPDATE; only the effects whose nominal contributions
+    # changed are then updated one by one.
+
+    method NativeContributionsForLevelEffects {plimit} {
+        set updates [gramcontrib level $db(time) [$rdb eval {
+            SELECT id, ts, te, llimit, tau, nominal, athresh, dthresh, val
+            FROM gram_effects JOIN gram_curves USING (curve_id)
+            WHERE etype = 'L'
+            AND ts < $db(time)
+            AND prox < $plimit
+        }]]
+
+        $rdb eval {
+            UPDATE gram_effects
+            SET tlast    = $db(time),
+                ncontrib = 0.0,
+                acontrib = 0
+            WHERE etype = 'L'
+            AND ts < $db(time)
+            AND prox < $plimit
+        }
+
+        foreach {id nominal contrib} $updates {
+            $rdb eval {
+                UPDATE gram_effects
+                SET nominal  = $nominal,
+                    ncontrib = $contrib
+                WHERE id=$id;
+            }
+        }
+    }
+
+    # Method: NativeContributionsForSlopeEffects
+    #
+    # plimit - The numeric proximity limit
+    #
+    # Does the work of <ComputeNominalContributionsForSlopeEffects>
+    # in C, using gramcontrib(n), writing back the changes as 
+    # <NativeContributionsForLevelEffects> does.
+
+    method NativeContributionsForSlopeEffects {plimit} {
+        lassign [gramcontrib slope                   \
+                     $db(time)                       \
+                     $db(timelast)                   \
+                     [lindex [$clock cget -tick] 0]  \
+                     [$clock unitDays]               \
+                     $maxEndTime                     \
+                     [$rdb eval {
+                         SELECT id, 
+                                ts, 
+                                te, 
+                                gram_effects.slope AS slope,
+                                future,
+                                nominal,
+                                athresh,
+                                dthresh,
+                                gram_curves.val AS val
+                         FROM gram_effects JOIN gram_curves USING (curve_id)
+                         WHERE etype='S'
+                         AND ts <= $db(time)
+                         AND prox < $plimit
+                     }]] futureUpdates contribUpdates
+
+        $rdb eval {
+            UPDATE gram_effects
+            SET tlast    = $db(time),
+                ncontrib = 0.0,
+                acontrib = 0
+            WHERE etype='S'
+            AND ts <= $db(time)
+            AND prox < $plimit
+        }
+
+        foreach {id ts te slope future} $futureUpdates {
+            $rdb eval {
+                UPDATE gram_effects
+                SET ts     = $ts,
+                    te     = $te,
+                    slope  = $slope,
+                    future = $future
+                WHERE id=$id
+            }
+        }
+
+        foreach {id nominal ncontrib} $contribUpdates {
+            $rdb eval {
+                UPDATE gram_effects
+                SET nominal  = $nominal,
+                    ncontrib = $ncontrib
+                WHERE id=$id
+            }
+        }
+    }
+
     # Method: ComputeActualContributionsByCause
     #
     # Determine the maximum positive and negative contributions
@@ -3958,7 +4080,9 @@ snit::type ::simlib::gram {
 
     # Method: DeleteExpiredEffects
     #
-    # Mark expired effects.
+    # Mark expired effects.  Each term of the WHERE clause is a lookup
+    # on one of the gram_effects indices, so that effects which 
+    # aren't expiring aren't scanned; keep it that way.
 
     method DeleteExpiredEffects {} {
         # FIRST, get the current proximity limit.
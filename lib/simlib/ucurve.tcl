@@ -141,6 +141,16 @@ snit::type ::simlib::ucurve {
         }
     }
 
+    # -native
+    #
+    # If on (the default), [apply] updates the tracked curves in C, 
+    # using a curvestore(n), provided that the Marsbin library is 
+    # loaded.  If off, or if it isn't, [apply] does the work in SQL.
+
+    option -native \
+        -type            snit::boolean     \
+        -default         on
+
     # -undostack
     #
     # The name of an undostack(n) object.  If none is specified, the
@@ -157,6 +167,16 @@ snit::type ::simlib::ucurve {
     component rdb  ;# The RDB, passed in as -rdb.
     component us   ;# The undostack(n)
 
+    #-------------------------------------------------------------------
+    # Instance Variables
+
+    # store
+    #
+    # The curvestore(n) handle used by [apply] when -native is on, or 
+    # "" if none has been created yet.
+
+    variable store ""
+
     #-------------------------------------------------------------------
     # Constructor/Destructor
 
@@ -209,6 +229,10 @@ snit::type ::simlib::ucurve {
             unset -nocomplain rdbTracker($rdb)
             $self clear
         }
+
+        if {$store ne ""} {
+            curvestore delete $store
+        }
     }
 
     #-------------------------------------------------------------------
@@ -842,7 +866,40 @@ snit::type ::simlib::ucurve {
         # NEXT, handle pending adjustments.
         $self SaveAdjustmentContributions $t
 
-        # NEXT, handle baseline effects if the flag is not given.
+        # NEXT, update the tracked curves, in C if we can.
+        if {$options(-native) && [package provide Marsbin] ne ""} {
+            $self ApplyNative $t $opt
+        } else {
+            $self ApplySQL $t $opt
+        }
+
+        # NEXT, clean up for next time.
+        $self PurgeEffectsAndAdjustments
+
+        # NEXT, if t=0, save a0, b0, and c0 for all curves.
+        if {$opt eq "-start"} {
+            $rdb eval {
+                UPDATE ucurve_curves_t
+                SET a0 = a,
+                    b0 = b,
+                    c0 = c;
+            }
+        }
+
+        # NEXT, This cannot be undone.
+        $self edit reset
+    }
+
+    # ApplySQL t opt
+    #
+    # t    - A timestamp
+    # opt  - -start, or ""
+    #
+    # Applies the pending effects to the tracked curves for [apply], 
+    # using SQL, and saves the contributions of each driver.
+
+    method ApplySQL {t opt} {
+        # FIRST, handle baseline effects if the flag is not given.
         if {$opt ne "-start"} {
             # NEXT, compute B.t = alpha*A.t-1 + beta*B.t-1 + gamma*C.t,
             # along with scaling factors for B.t.
@@ -869,22 +926,78 @@ snit::type ::simlib::ucurve {
         # NEXT, save the contributions of each driver due to
         # both baseline and transient effects.
         $self SaveContributionsByDriver $t
+    }
 
-        # NEXT, clean up for next time.
-        $self PurgeEffectsAndAdjustments
+    # ApplyNative t opt
+    #
+    # t    - A timestamp
+    # opt  - -start, or ""
+    #
+    # Does the work of [ApplySQL] in a curvestore(n).  The tracked
+    # curves are loaded into the store with one query, all of the
+    # passes are done in C, and only the curves that changed are 
+    # written back, with one UPDATE each.  The RDB remains the 
+    # curves' home, since uram(n) views and clients query
+    # ucurve_curves_t directly; so the store is reloaded every time.
+    #
+    # The curves come out the same as with [ApplySQL].  The saved
+    # contributions can differ from it in the last few bits (on the
+    # order of 1e-14), because each driver's contributions are summed
+    # in effect order rather than in SQLite's order.
 
-        # NEXT, if t=0, save a0, b0, and c0 for all curves.
-        if {$opt eq "-start"} {
+    method ApplyNative {t opt} {
+        # FIRST, load the tracked curves.
+        if {$store eq ""} {
+            set store [curvestore create]
+        }
+
+        curvestore load $store [$rdb eval {
+            SELECT ct_id, min, max, alpha, beta, gamma
+            FROM ucurve_ctypes
+        }] [$rdb eval {
+            SELECT curve_id, ct_id, a, b, c, delta, posfactor, negfactor
+            FROM ucurve_curves_t
+            WHERE tracked = 1
+            ORDER BY curve_id
+        }]
+
+        # NEXT, apply the effects.
+        set contribs [curvestore apply $store [$rdb eval {
+            SELECT curve_id, cause_id, driver_id, pflag, mag
+            FROM ucurve_effects_t
+            ORDER BY e_id
+        }] {*}$opt]
+
+        # NEXT, write back the changed curves.  Untracked curves
+        # get no effects, so their deltas are zero.
+        $rdb transaction {
             $rdb eval {
                 UPDATE ucurve_curves_t
-                SET a0 = a,
-                    b0 = b,
-                    c0 = c;
+                SET delta = 0.0
+                WHERE tracked = 0 AND delta != 0.0
             }
-        }
 
-        # NEXT, This cannot be undone.
-        $self edit reset
+            foreach {curve_id a b delta posfactor negfactor} \
+                [curvestore changes $store] {
+                $rdb eval {
+                    UPDATE ucurve_curves_t
+                    SET a         = $a,
+                        b         = $b,
+                        delta     = $delta,
+                        posfactor = $posfactor,
+                        negfactor = $negfactor
+                    WHERE curve_id = $curve_id
+                }
+            }
+
+            # NEXT, save the contributions of each driver due to
+            # both baseline and transient effects.
+            if {$options(-savehistory)} {
+                foreach {curve_id driver_id contrib} $contribs {
+                    $self SaveContrib $curve_id $driver_id $t $contrib
+                }
+            }
+        }
     }
 
     # SaveAdjustmentContributions t
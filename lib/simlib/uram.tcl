@@ -205,8 +205,8 @@ snit::type ::simlib::uram {
 
     # sqlsection tempschema
     #
-    # Returns the section's temporary schema definitions, which would
-    # be read from uram_temp.sql if we had any.
+    # Returns the section's temporary schema definitions, which are
+    # read from uram_temp.sql.
 
     typemethod {sqlsection tempschema} {} {
         return [readfile [file join $::simlib::library uram_temp.sql]]
@@ -320,9 +320,6 @@ snit::type ::simlib::uram {
     #                 "advanced" to its initial time.
     #   time        - Simulation Time: integer ticks, starting at -1
     #   nextDriver  - The next driver ID to assign; set from -driverbase.
-    #   ssCache     - Satisfaction spread cache: a dictionary
-    #                 {$g,$s,$p,$q -> spread}, where spread is a dict
-    #                 {$g_id -> $factor}.
     #   scid        - Sat curve_id dict: g_id -> c_id -> curve_id
     #   causeIDs    - Dictionary: cause -> cause_id
     #   groupIDs    - Dictionary: g -> g_id
@@ -348,7 +345,6 @@ snit::type ::simlib::uram {
         started          0
         time             ""
         nextDriver       ""
-        ssCache          {}
         scid             {}
         causeIDs         {}
         groupIDs         {}
@@ -369,6 +365,29 @@ snit::type ::simlib::uram {
         changed   0
     }
 
+    # spread
+    #
+    # Array, the SAT and COOP spread matrices, stored as sparse rows.
+    # The rows are computed from the HREL curves when first needed,
+    # and kept until the HREL curves actually change.  The keys are as
+    # follows.
+    #
+    #   check       - 1 if the HREL curves might have changed since the
+    #                 rows were computed, and 0 otherwise.
+    #   sat         - Dict, g_id -> SAT spread row for directly affected
+    #                 group g_id, a flat list {f_id proximity hrel...}.
+    #                 All rows are computed at once.
+    #   coop        - Dict, f_id,g_id -> COOP spread row for directly
+    #                 affected civilian group f_id and force group g_id,
+    #                 a flat list {curve_id proximity civrel factor...}.
+    #                 Rows are computed one at a time.
+
+    variable spread -array {
+        check     1
+        sat       {}
+        coop      {}
+    }
+
     # trans
     #
     # Transient data, used during loading.
@@ -475,8 +494,10 @@ snit::type ::simlib::uram {
         # NEXT, reset the driver ID
         set db(nextDriver) $options(-driverbase)
 
-        # NEXT, Reset the curves in the curve manager.
+        # NEXT, Reset the curves in the curve manager, and discard
+        # the spread matrices computed from them.
         $cm reset
+        $self ClearSpreads
 
         # NEXT, Compute all roll-ups
         $self ComputeSatRollups
@@ -502,6 +523,7 @@ snit::type ::simlib::uram {
         # FIRST, reset the in-memory data
         array unset db
         array set db $clearedDB
+        $self ClearSpreads
 
         # NEXT, Clear the RDB
         $self ClearTables
@@ -1174,6 +1196,9 @@ snit::type ::simlib::uram {
                 $cm curve untrack $curve_ids
             }
         }
+
+        # NEXT, the spreads skip untracked HRELs.
+        set spread(check) 1
     }
 
     #-------------------------------------------------------------------
@@ -1198,9 +1223,6 @@ snit::type ::simlib::uram {
             "time did not advance, new time $t, old time $db(time)"
         set db(time) $t
 
-        # NEXT, clear the spread caches.
-        set db(ssCache) [dict create]
-
         # NEXT, Apply current effects to the attitude curves.
         if {$db(started)} {
             $cm apply $t
@@ -1208,6 +1230,10 @@ snit::type ::simlib::uram {
             $cm apply $t -start 
             set db(started) 1
         }
+
+        # NEXT, the HREL curves may have changed, so the spreads
+        # need to be checked.
+        set spread(check) 1
         
         # NEXT, Compute all roll-ups
         $self ComputeSatRollups
@@ -1243,6 +1269,10 @@ snit::type ::simlib::uram {
     #           Sum(g,c in A, w.g * L.gc)
     #
     # where w.g is the weight, usually the population of group g.
+    #
+    # Each roll-up is computed into a temporary table by one aggregate
+    # query, and saved to its output table by one UPDATE, so that the
+    # cost doesn't grow with the number of rows passing through Tcl.
 
     # ComputeSatRollups
     #
@@ -1261,24 +1291,24 @@ snit::type ::simlib::uram {
     
     method ComputeSatN {} {
         $rdb eval {
+            DELETE FROM uram_n_rollup;
+
+            INSERT INTO uram_n_rollup(n_id, num, denom)
             SELECT n_id                     AS n_id, 
                    total(sat*saliency*pop)  AS num,
                    total(saliency*pop)      AS denom
             FROM uram_sat
-            GROUP BY n_id
-        } {
-            if {$denom == 0.0} {
-                let nbmood 0.0
-            } else {
-                let nbmood {$num/$denom}
-            }
+            GROUP BY n_id;
 
-            $rdb eval {
-                UPDATE uram_n
-                SET nbmood       = $nbmood,
-                    nbmood_denom = $denom
-                WHERE n_id=$n_id
-            }
+            UPDATE uram_n
+            SET nbmood = (SELECT CASE WHEN R.denom = 0.0 THEN 0.0
+                                      ELSE R.num/R.denom END
+                          FROM uram_n_rollup AS R
+                          WHERE R.n_id = uram_n.n_id),
+                nbmood_denom = (SELECT R.denom
+                                FROM uram_n_rollup AS R
+                                WHERE R.n_id = uram_n.n_id)
+            WHERE n_id IN (SELECT n_id FROM uram_n_rollup);
         }
 
         # Compute neighborhood population.
@@ -1286,16 +1316,19 @@ snit::type ::simlib::uram {
         # In practice though, this happens once a tick, and "update
         # pop" happens once a tick, so it doesn't really matter.
         $rdb eval {
+            DELETE FROM uram_n_rollup;
+
+            INSERT INTO uram_n_rollup(n_id, num)
             SELECT n_id        AS n_id, 
-                   total(pop)  AS pop
+                   total(pop)  AS num
             FROM uram_civ_g
-            GROUP BY n_id
-        } {
-            $rdb eval {
-                UPDATE uram_n
-                SET pop = $pop
-                WHERE n_id=$n_id
-            }
+            GROUP BY n_id;
+
+            UPDATE uram_n
+            SET pop = (SELECT R.num
+                       FROM uram_n_rollup AS R
+                       WHERE R.n_id = uram_n.n_id)
+            WHERE n_id IN (SELECT n_id FROM uram_n_rollup);
         }
     }
     
@@ -1305,24 +1338,24 @@ snit::type ::simlib::uram {
     
     method ComputeSatG {} {
         $rdb eval {
+            DELETE FROM uram_g_rollup;
+
+            INSERT INTO uram_g_rollup(g_id, num, denom)
             SELECT g_id                AS g_id,
                    total(sat*saliency) AS num,
                    total(saliency)     AS denom
             FROM uram_sat
-            GROUP BY g_id
-        } {
-            if {$denom == 0.0} {
-                let mood 0.0
-            } else {
-                let mood {$num/$denom}
-            }
+            GROUP BY g_id;
 
-            $rdb eval {
-                UPDATE uram_civ_g
-                SET mood       = $mood,
-                    mood_denom = $denom
-                WHERE g_id=$g_id
-            }
+            UPDATE uram_civ_g
+            SET mood = (SELECT CASE WHEN R.denom = 0.0 THEN 0.0
+                                    ELSE R.num/R.denom END
+                        FROM uram_g_rollup AS R
+                        WHERE R.g_id = uram_civ_g.g_id),
+                mood_denom = (SELECT R.denom
+                              FROM uram_g_rollup AS R
+                              WHERE R.g_id = uram_civ_g.g_id)
+            WHERE g_id IN (SELECT g_id FROM uram_g_rollup);
         }
     }
 
@@ -1349,24 +1382,25 @@ snit::type ::simlib::uram {
     method ComputeCoopRollups {} {
         # FIRST, compute coop.ng
         $rdb eval {
+            DELETE FROM uram_ng_rollup;
+
+            INSERT INTO uram_ng_rollup(n_id, g_id, num, denom)
             SELECT n_id               AS n_id, 
                    g_id               AS g_id,
                    total(coop * pop)  AS num,
                    total(pop)         AS denom
             FROM uram_coop
-            GROUP BY n_id, g_id
-        } {
-            if {$denom == 0} {
-                let nbcoop 0.0
-            } else {
-                let nbcoop {$num/$denom}
-            }
+            GROUP BY n_id, g_id;
 
-            $rdb eval {
-                UPDATE uram_nbcoop_t
-                SET nbcoop = $nbcoop
-                WHERE n_id=$n_id AND g_id=$g_id
-            }
+            UPDATE uram_nbcoop_t
+            SET nbcoop = (SELECT CASE WHEN R.denom = 0 THEN 0.0
+                                      ELSE R.num/R.denom END
+                          FROM uram_ng_rollup AS R
+                          WHERE R.n_id = uram_nbcoop_t.n_id
+                          AND   R.g_id = uram_nbcoop_t.g_id)
+            WHERE EXISTS (SELECT 1 FROM uram_ng_rollup AS R
+                          WHERE R.n_id = uram_nbcoop_t.n_id
+                          AND   R.g_id = uram_nbcoop_t.g_id);
         }
     }
 
@@ -1819,38 +1853,29 @@ snit::type ::simlib::uram {
     # q      - The -q "far factor".
     #
     # Computes and returns a satisfaction spread, a dictionary
-    # {g_id -> factor}.  The spread is cached for later use during
-    # the same timestep.
+    # {g_id -> factor}, by applying the RAFs and the here, near, and
+    # far factors to g_id's row of the SAT spread matrix.
     #
     # Groups with zero population are excluded from the spread.
     
     method SatSpread {g_id s p q} {
-        # FIRST, if this spread is cached, return the cached value.
-        set tag "$g_id,$s,$p,$q"
-
-        if {[dict exists $db(ssCache) $tag]} {
-            return [dict get $db(ssCache) $tag]
-        }
-
-        # NEXT, get the proximity limit and RAFs
+        # FIRST, get the proximity limit and RAFs
         set plimit [$self GetProxLimit $s $p $q]
         set praf   [$parm get uram.raf.positive]
         set nraf   [$parm get uram.raf.negative]
         
         # NEXT, create the empty dictionary
-        set spread [dict create]
+        set result [dict create]
+
+        # NEXT, get the row.  It omits f's where either f or g has zero 
+        # population.
+        set row [$self SatSpreadRow $g_id]
+
+        foreach {f_id proximity hrel} $row {
+            if {$proximity >= $plimit} {
+                continue
+            }
 
-        # Ignore f's where either f or g has zero population.  We get this
-        # by looking at the tracked flag on the hrel, because the hrel
-        # will be untracked if either group has zero population.
-        $rdb eval {
-            SELECT f_id      AS f_id,
-                   hrel      AS hrel,
-                   proximity AS proximity
-            FROM uram_civrel 
-            WHERE g_id = $g_id AND tracked
-            AND   proximity < $plimit
-        } {
             # FIRST, Apply the RAFs.
             set hrel [expr {$hrel > 0.0 ? $hrel * $praf : $hrel * $nraf}]
 
@@ -1871,15 +1896,45 @@ snit::type ::simlib::uram {
 
             # NEXT, save the data for this group.
             if {$factor != 0.0} {
-                dict set spread $f_id $factor
+                dict set result $f_id $factor
             }
         }
 
-        # NEXT, cache this spread
-        dict set db(ssCache) $tag $spread
-
         # NEXT, return the spread
-        return $spread
+        return $result
+    }
+
+    # SatSpreadRow g_id
+    #
+    # g_id   - The directly affected group
+    #
+    # Returns g_id's row of the SAT spread matrix, a flat list
+    # {f_id proximity hrel...} in uram_civrel_t order.  If the
+    # matrix is out of date, all of its rows are recomputed.
+    #
+    # The row ignores f's where either f or g has zero population.  
+    # We get this by looking at the tracked flag on the hrel, because 
+    # the hrel will be untracked if either group has zero population.
+
+    method SatSpreadRow {g_id} {
+        $self CheckSpreads
+
+        if {$spread(sat) eq ""} {
+            foreach {rg_id f_id proximity hrel} [$rdb eval {
+                SELECT g_id, f_id, proximity, hrel
+                FROM uram_civrel
+                WHERE tracked
+                ORDER BY g_id, fg_id
+            }] {
+                dict lappend spread(sat) $rg_id $f_id $proximity $hrel
+            }
+        }
+
+        if {[dict exists $spread(sat) $g_id]} {
+            return [dict get $spread(sat) $g_id]
+        }
+
+        return [list]
     }
 
 
@@ -2089,18 +2144,12 @@ snit::type ::simlib::uram {
         # Schedule the effects
         set cmlist [list]
 
-        # There are no effects on empty civilian groups.  We check
-        # this using the tracked flag on the relevant hrel curve,
-        # which will always be false if either civilian group is empty.
-        $rdb eval {
-            SELECT curve_id, factor, proximity 
-            FROM uram_coop_spread
-            WHERE df_id     =  $f_id
-            AND   dg_id     =  $g_id
-            AND   proximity <  $plimit
-            AND   civrel    >= $CRL
-            AND   tracked
-        } {
+        foreach {curve_id proximity civrel factor} \
+            [$self CoopSpreadRow $f_id $g_id] {
+            if {$proximity >= $plimit || $civrel < $CRL} {
+                continue
+            }
+
             # FIRST, The factor is the HREL between two force groups,
             # and as such is subject to the RAFs.
             set factor [expr {
@@ -2127,6 +2176,91 @@ snit::type ::simlib::uram {
         return $cmlist
     }
 
+    # CoopSpreadRow f_id g_id
+    #
+    # f_id   - The directly affected civilian group
+    # g_id   - The directly affected force group
+    #
+    # Returns the row of the COOP spread matrix for f_id and g_id,
+    # a flat list {curve_id proximity civrel factor...} in 
+    # uram_coop_t order, computing it if need be.
+    #
+    # There are no effects on empty civilian groups.  We check
+    # this using the tracked flag on the relevant hrel curve,
+    # which will always be false if either civilian group is empty.
+
+    method CoopSpreadRow {f_id g_id} {
+        $self CheckSpreads
+
+        if {![dict exists $spread(coop) $f_id,$g_id]} {
+            dict set spread(coop) $f_id,$g_id [$rdb eval {
+                SELECT curve_id, proximity, civrel, factor
+                FROM uram_coop_spread
+                WHERE df_id = $f_id
+                AND   dg_id = $g_id
+                AND   tracked
+                ORDER BY ifg_id
+            }]
+        }
+
+        return [dict get $spread(coop) $f_id,$g_id]
+    }
+
+    # CheckSpreads
+    #
+    # If the HREL curves might have changed since the spread matrices
+    # were computed, compares them with the values saved in 
+    # uram_spread_hrel, and discards the matrices if any differ.
+
+    method CheckSpreads {} {
+        if {!$spread(check)} {
+            return
+        }
+
+        set spread(check) 0
+
+        if {![$rdb exists {
+            SELECT curve_id
+            FROM (SELECT hrel_id AS curve_id FROM uram_civrel_t
+                  UNION
+                  SELECT hrel_id AS curve_id FROM uram_frcrel_t)
+            JOIN ucurve_curves_t AS C USING (curve_id)
+            LEFT OUTER JOIN uram_spread_hrel AS S USING (curve_id)
+            WHERE S.hrel IS NOT C.a OR S.tracked IS NOT C.tracked
+        }]} {
+            return
+        }
+
+        set spread(sat)  [dict create]
+        set spread(coop) [dict create]
+
+        $rdb eval {
+            DELETE FROM uram_spread_hrel;
+
+            INSERT INTO uram_spread_hrel(curve_id, hrel, tracked)
+            SELECT curve_id, a, tracked
+            FROM ucurve_curves_t
+            WHERE curve_id IN (SELECT hrel_id FROM uram_civrel_t
+                               UNION
+                               SELECT hrel_id FROM uram_frcrel_t);
+        }
+    }
+
+    # ClearSpreads
+    #
+    # Discards the spread matrices, along with the HREL values they
+    # were computed from.
+
+    method ClearSpreads {} {
+        array set spread {
+            check     1
+            sat       {}
+            coop      {}
+        }
+
+        $rdb eval {DELETE FROM uram_spread_hrel}
+    }
+
     # coop badjust driver f g delta
     #
     # driver   - An integer driver ID
@@ -2681,9 +2815,11 @@ snit::type ::simlib::uram {
     # unchanged.
 
     method {saveable restore} {state {option ""}} {
-        # FIRST, restore the state.
+        # FIRST, restore the state.  The HREL curves are restored with
+        # the RDB, so the spreads need to be checked.
         array unset db
         array set db $state
+        set spread(check) 1
 
         # NEXT, set the changed flag
         if {$option eq "-saved"} {
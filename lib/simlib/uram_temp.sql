@@ -21,4 +21,51 @@ CREATE TEMPORARY TABLE uram_contribs (
     contrib   DOUBLE DEFAULT 0.0       -- Net contribution
 );
 
+------------------------------------------------------------------------
+-- Roll-ups
+--
+-- [advance] computes each roll-up into one of these tables with a
+-- single aggregate query, and then saves the results to the output
+-- table with a single UPDATE.
+
+CREATE TEMPORARY TABLE uram_n_rollup (
+    -- Satisfaction roll-up by neighborhood, for uram_n.nbmood
+
+    n_id      INTEGER PRIMARY KEY,     -- URAM unique nbhood ID
+    num       DOUBLE DEFAULT 0.0,      -- Weighted sum of satisfaction
+    denom     DOUBLE DEFAULT 0.0       -- Sum of the weights
+);
+
+CREATE TEMPORARY TABLE uram_g_rollup (
+    -- Satisfaction roll-up by group, for uram_civ_g.mood
+
+    g_id      INTEGER PRIMARY KEY,     -- URAM unique group ID
+    num       DOUBLE DEFAULT 0.0,      -- Weighted sum of satisfaction
+    denom     DOUBLE DEFAULT 0.0       -- Sum of the weights
+);
 
+CREATE TEMPORARY TABLE uram_ng_rollup (
+    -- Cooperation roll-up by nbhood and force group, for 
+    -- uram_nbcoop_t.nbcoop
+
+    n_id      INTEGER,                 -- URAM unique nbhood ID
+    g_id      INTEGER,                 -- URAM unique group ID
+    num       DOUBLE DEFAULT 0.0,      -- Weighted sum of cooperation
+    denom     DOUBLE DEFAULT 0.0,      -- Sum of the weights
+
+    PRIMARY KEY (n_id, g_id)
+);
+
+------------------------------------------------------------------------
+-- Spread matrices
+--
+-- The SAT and COOP spread matrices are computed from the HREL curves
+-- and kept in memory across time advances.  This table saves the
+-- HREL values they were computed from, so that they can be kept
+-- until the relationships actually change.
+
+CREATE TEMPORARY TABLE uram_spread_hrel (
+    curve_id  INTEGER PRIMARY KEY,      -- HREL curve_id
+    hrel      DOUBLE,                   -- Current HREL value
+    tracked   INTEGER                   -- Tracked flag
+);
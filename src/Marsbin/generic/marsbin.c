@@ -12,10 +12,19 @@
  ***********************************************************************/
 
 #include <tcl.h>
+
+/* Tk is optional: its functions are called through the stubs table
+ * of the Tk in the interpreter, if any; see getTkStubs(). */
+#define USE_TK_STUBS
+#include <tk.h>
+
+#include <ctype.h>
+#include <limits.h>
 #include <math.h>
 #include <stdio.h>
 #include <string.h>
 #include <sys/time.h>
+#include <sys/stat.h>
 
 #ifndef WIN32
 #define MARS_NET_API
@@ -38,6 +47,7 @@
 #include <geotiff/xtiffio.h>
 #include <geotiff/geotiffio.h>
 #include <geotiff/geotiff.h>
+#include <geotiff/geo_normalize.h>
 
 #include "marsbin.h"
 
@@ -45,14 +55,28 @@
  * Constants
  */
 
+#define SCRATCH_ALIGN    64      /* Alignment of scratch buffers */
 #define PRECISION_MIN     0
 #define PRECISION_DEFAULT 5
 #define PRECISION_MAX     5
+#define MGRS_STRING_LEN  20      /* An MGRS string and its NUL */
+#define MAX_WORKERS      16      /* Most threads for a -list */
+#define MGRS_MIN_PER_WORKER 1000 /* Fewest elements per MGRS thread */
+#define GCC_MIN_PER_WORKER 20000 /* Fewest elements per GCC thread */
+#define ROWS_PER_WORKER    64    /* Fewest image rows per scaling thread */
+#define PROBE_MIN_PER_WORKER 4  /* Fewest files per probe thread */
+#define MAX_DISTANCES   (INT_MAX/8) /* Most distances in one result */
+#define MAX_RASTER_PIXELS 100000000 /* Most pixels in a scaled image */
 #define LAT_MIN          -90.0
 #define LAT_MAX           90.0
 #define LON_MIN         -180.0
 #define LON_MAX          360.0
 
+#define MEASURE_AREA      1     /* Spherical area, as latlong area */
+#define MEASURE_EAREA     2     /* Ellipsoidal area */
+#define MEASURE_PERIMETER 4     /* Ellipsoidal perimeter */
+#define VINCENTY_MAX_ITER 100   /* Iteration limit for geodesic distance */
+
 const double pi            = M_PI;
 const double radians       = 0.017453292519943295; /* pi/180.0 */
 const double earthDiameter = 12742.0;
@@ -70,6 +94,15 @@ const double earthRadius   = 6371.0; /* earthDiameter/2.0 */
 
 #define MODEL_PIXEL_SCALE_TAG 33550
 #define MODEL_TIEPOINT_TAG    33922
+#define GEO_KEY_DIRECTORY_TAG 34735
+
+#define PROBE_MAX_ENTRIES     4096     /* Most entries in a sane IFD */
+#define PROBE_MAX_VALUES      65536    /* Most values in a probed tag */
+
+#define GRID_TOLERANCE    0.01      /* Most control grid error, in pixels */
+#define GRID_MAX_NODES    66049     /* Most control grid nodes, 257x257 */
+#define GRID_EDGE_POINTS  64        /* Points per edge to bound an image */
+#define METERS_PER_DEGREE 111319.49 /* Of latitude, for grid errors */
 
 /*
  * Structure Definitions
@@ -111,22 +144,478 @@ typedef struct Points {
     int size;
 } Points;
 
+/* A scratch arena for a command's temporary buffers.  Memory from 
+ * scratchAlloc() is SCRATCH_ALIGN-aligned, and lasts until the next
+ * resetScratch(), which each command using the arena calls on entry.
+ * The arena grows to its high-water mark, so that repeated calls 
+ * needn't touch the heap. */
+typedef struct Scratch {
+    char*    raw;              /* The arena's block, as allocated */
+    char*    base;             /* The block, aligned */
+    size_t   size;             /* Usable bytes in the block */
+    size_t   used;             /* Bytes handed out from the block */
+    size_t   wanted;           /* Bytes handed out since the reset */
+    char**   extra;            /* Blocks for requests that didn't fit */
+    int      nextra;
+    int      maxExtra;
+} Scratch;
+
+/* The precomputed data for a polygon's edges, in struct-of-arrays
+ * form so that the crossing test vectorizes.  Edge i runs from
+ * vertex i to vertex i+1; each array has one element per edge. */
+typedef struct Edges {
+    double* x1;                /* The edge's first vertex */
+    double* y1;
+    double* ymin;              /* Minimum and maximum Y of the edge */
+    double* ymax;
+    double* xmax;              /* Maximum X of the edge */
+    double* dx;                /* Edge deltas, x2 - x1 and y2 - y1; the */
+    double* dy;                /* slope is dx/dy, the intercept x1,y1.  */
+} Edges;
+
+/* A compiled polygon, as created by "polygon create" */
+typedef struct Polygon {
+    int      refCount;         /* Number of references: the registry, */
+                               /* handle Tcl_Objs, etc.                */
+    int      deleted;          /* 1 if the handle has been deleted.    */
+    Tcl_Obj* coords;           /* The original coordinate list.        */
+    int      size;             /* Number of vertices.                  */
+    Point*   pts;              /* size+1 vertices; pts[size] == pts[0] */
+    Edges    edges;            /* size edges.                          */
+    Bbox     box;              /* The polygon's bounding box.          */
+
+    /* Measures of a lat/long polygon, cached by measurePolygon(). */
+    int      measured;         /* MEASURE_* flags of the valid values  */
+    int      spheroid;         /* Spheroid of the ellipsoidal values   */
+    double   area;             /* Spherical area, km^2                 */
+    double   earea;            /* Ellipsoidal area, km^2               */
+    double   perimeter;        /* Ellipsoidal perimeter, km            */
+} Polygon;
+
+/* One polygon in a GeoIndex */
+typedef struct GeoIndexEntry {
+    Tcl_Obj* id;               /* The item ID, or NULL if removed */
+    Polygon* poly;             /* The polygon; a counted reference */
+} GeoIndexEntry;
+
+/* A spatial index of polygons, as created by "geoindex create".
+ * The polygons are kept in stacking order, bottom first.  Lookups
+ * use a uniform grid over the polygons' bounding boxes; each grid
+ * cell lists the entries whose bounding boxes overlap it, in stacking
+ * order.  The grid is rebuilt lazily after adds and removes. */
+typedef struct GeoIndex {
+    int            size;       /* Number of entries, including removed */
+    int            maxSize;    /* Allocated size of entries */
+    int            removed;    /* Number of removed entries */
+    GeoIndexEntry* entries;    /* The entries in stacking order */
+    Tcl_HashTable  ids;        /* Entry index by item ID */
+
+    int            dirty;      /* 1 if the grid must be rebuilt */
+    Bbox           extent;     /* Bounding box of all entries */
+    int            nx;         /* Number of grid columns and rows */
+    int            ny;
+    double         cellWidth;  /* Size of one grid cell */
+    double         cellHeight;
+    int*           cellStart;  /* nx*ny+1 offsets into cellItems */
+    int*           cellItems;  /* Entry indices for each cell */
+} GeoIndex;
+
+/* An edge of one of the polygons given to "polygon adjacency", in 
+ * the sweep's order. */
+typedef struct AdjEdge {
+    int      poly;             /* Index of the edge's polygon */
+    Point*   p1;               /* The edge's vertices */
+    Point*   p2;
+    double   xmin;             /* The edge's bounding box */
+    double   xmax;
+    double   ymin;
+    double   ymax;
+} AdjEdge;
+
+/* A pair of adjacent polygons, i < j, as found by "polygon adjacency". */
+typedef struct AdjPair {
+    int      i;
+    int      j;
+    double   border;           /* Length of the shared border */
+} AdjPair;
+
+/* polygon(n) and geoindex(n) data; one per interpreter */
+
+typedef struct PolygonInfo {
+    Tcl_HashTable polygons;    /* Polygon* by handle name */
+    int           counter;     /* Used to generate handle names */
+    Tcl_HashTable indices;     /* GeoIndex* by handle name */
+    int           indexCounter;/* Used to generate index names */
+    Scratch       scratch;     /* Scratch arena for the commands */
+} PolygonInfo;
+
+/* Ellipsoid parameters for geodesic area and distance; see 
+ * setGeodesicData(). */
+
+typedef struct GeodesicData {
+    double a;                  /* Semi-major axis, km */
+    double b;                  /* Semi-minor axis, km */
+    double f;                  /* Flattening */
+    double e;                  /* Eccentricity */
+    double e2;                 /* Eccentricity squared */
+    double qp;                 /* authalicQ() at the pole */
+    double authalicR2;         /* Square of the authalic radius, km^2 */
+} GeodesicData;
+
 /* latlong(n) data */
 
 typedef struct LatlongInfo {
     int spheroid;              /* Spheroid for coordinate conversions. */
     double poleLat;            /* Latitude and longitude for pole/radius. */
     double poleLon;
-    Points* pointsBuffer;      /* Points cache */
+    Scratch scratch;           /* Scratch arena for the subcommands */
+    EllipsoidData ellipsoid;   /* GCC conversion data for the spheroid */
+    GeodesicData geodesic;     /* Area/perimeter data for the spheroid */
+    MGRS_Context mgrs;         /* MGRS conversion state for the spheroid */
+    long mgrsStatus;           /* Result of setting the MGRS parameters */
 } LatlongInfo;
 
+/* A function that processes elements first to last-1 of its data,
+ * possibly on a worker thread; see runWorkers(). */
+
+typedef void (WorkProc)(ClientData data, int first, int last);
+
+typedef struct WorkRange {
+    WorkProc*  proc;           /* The function */
+    ClientData data;           /* Its data */
+    int        first;          /* Index of the first element */
+    int        last;           /* Index after the last element */
+} WorkRange;
+
+/* The data for latlong tomgrs/frommgrs -list.  The workers share the 
+ * MGRS context, which the conversions don't modify. */
+
+typedef struct MgrsBatch {
+    const MGRS_Context* ctx;   /* Conversion state for the spheroid */
+    int      toMgrs;           /* 1 for tomgrs, 0 for frommgrs */
+    int      precision;        /* Precision for tomgrs */
+    Point*   loc;              /* lat/long pairs in decimal degrees */
+    char**   strings;          /* MGRS strings, for frommgrs */
+    char*    mgrs;             /* MGRS_STRING_LEN chars each, for tomgrs */
+    long*    status;           /* Geotrans result code for each element */
+} MgrsBatch;
+
+/* The data for latlong togcc/fromgcc -list. */
+
+typedef struct GccBatch {
+    EllipsoidData* ellipsoid;  /* Derived data for the spheroid */
+    Point*   loc;              /* lat/long pairs in decimal degrees */
+    double*  efg;              /* X Y Z triples in meters */
+} GccBatch;
+
+/* One resolution level of an open GeoTIFF: the full-resolution image
+ * or one of its overviews.  Pixels are read a block at a time, a block
+ * being a tile or a strip. */
+
+typedef struct GeotiffLevel {
+    tdir_t   dir;              /* The level's IFD */
+    uint32   width;            /* Size in pixels */
+    uint32   height;
+    int      tiled;            /* 1 if tiled, 0 if in strips */
+    uint32   blockWidth;       /* Tile size, or width by rows per strip */
+    uint32   blockHeight;
+    tsize_t  blockSize;        /* Bytes in a full decoded block */
+    uint32   nblocks;          /* Number of tiles or strips */
+    uint32*  offsets;          /* If not NULL, the file offset and size */
+    uint32*  counts;           /* of each block, which is stored as is */
+                               /* in the file mapping.                  */
+} GeotiffLevel;
+
+/* How the pixels of a GeoTIFF's full-resolution image map to the earth.
+ * Model coordinates are an affine function of pixel coordinates, given
+ * by the tiepoint and pixel scale.  For a projected image they are
+ * Transverse Mercator easting and northing in meters; otherwise they
+ * are longitude and latitude in decimal degrees. */
+
+typedef struct GeoModel {
+    int      projected;        /* 1 if Transverse Mercator */
+    double   x0;               /* Model coordinates of pixel 0,0 */
+    double   y0;
+    double   sx;               /* Model units per pixel, across and down; */
+    double   sy;               /* 0 if the image has no tiepoint.        */
+    double   lon0;             /* Central meridian, in decimal degrees */
+    Transverse_Mercator_Context tm;
+} GeoModel;
+
+/* A control grid for converting between pixels and lat/long: the exact
+ * conversion at the nodes of a regular grid, interpolated bilinearly 
+ * in between.  The inputs are pixel x,y or lon,lat, and the outputs lat,
+ * lon or pixel x,y; longitudes are unwrapped about the central meridian.
+ * A node the projection can't convert is NaN, so any point in its cells
+ * interpolates to NaN and is converted exactly instead.  See
+ * newGeoGrid(). */
+
+typedef struct GeoGrid {
+    double   x0;               /* Inputs at node 0,0 */
+    double   y0;
+    double   dx;               /* Node spacing, in input units */
+    double   dy;
+    int      cols;             /* Nodes across and down, at least 2 each */
+    int      rows;
+    double*  nodes;            /* The outputs at each node, row by row */
+} GeoGrid;
+
+/* An open GeoTIFF, as returned by "geotiff open". */
+
+typedef struct GeotiffImage {
+    TIFF*         tiff;        /* The open file */
+    Tcl_Obj*      georef;      /* The dict returned by "geotiff read" */
+    uint16        samples;     /* Samples per pixel */
+    uint16        bits;        /* Bits per sample */
+    uint16        photometric; /* Photometric interpretation */
+    int           pixelBytes;  /* Bytes per pixel */
+    int           nlevels;     /* Number of levels */
+    GeotiffLevel* levels;      /* Full resolution, then the overviews */
+                               /* from largest to smallest.           */
+    int           current;     /* Level whose IFD is current */
+    tdata_t       buf;         /* Block buffer for region reads */
+    tsize_t       bufSize;
+    tdata_t       map;         /* The file mapping, or NULL */
+    toff_t        mapSize;
+    char*         path;        /* The file name */
+    GeoModel      model;       /* How its pixels map to the earth */
+    int           gridsBuilt;  /* 1 once the control grids are built; */
+    GeoGrid*      toLatLong;   /* either may be NULL if the projection */
+    GeoGrid*      toPixel;     /* is too irregular for one.            */
+
+    /* More handles on the file for "geotiff region -workers", each
+     * with its own decoder state, current level, and block buffer;
+     * worker 0 uses the fields above, so slot 0 is unused. */
+    int           ndecoders;
+    TIFF*         decoders[MAX_WORKERS];
+    int           decoderLevels[MAX_WORKERS];
+    tdata_t       decoderBufs[MAX_WORKERS];
+} GeotiffImage;
+
+/* A function that stores part of a region, w by h pixels at x,y in the
+ * region, from src, whose rows are pitch bytes apart; it returns 1 on 
+ * success and 0 on failure.  See regionBlocks(). */
+
+struct RegionJob;
+typedef int (RegionProc)(struct RegionJob* job, unsigned char* src, 
+                         int pitch, int x, int y, int w, int h);
+
+/* The data for geotiff region: the region, where its pixels go, and
+ * the grid of blocks that overlap it.  The blocks are numbered from 0
+ * across and then down; with -workers, each worker decodes its own
+ * share of them. */
+
+typedef struct RegionJob {
+    GeotiffImage*  img;
+    GeotiffLevel*  level;
+    int            x;          /* The region, in pixels */
+    int            y;
+    int            w;
+    int            h;
+    uint32         bx;         /* Upper left pixel of the first block */
+    uint32         by;
+    int            cols;       /* Blocks across the region */
+    int            nblocks;    /* Blocks in the region */
+    int            workers;    /* Number of decoders in use */
+    unsigned char* bytes;      /* The region's pixels */
+    int            failed;     /* Set if any block couldn't be decoded */
+    RegionProc*    put;        /* If not NULL, stores each block's part */
+    ClientData     putData;    /* instead of copying it to bytes.      */
+} RegionJob;
+
+/* The data for geotiff tophoto: the photo, and how to present the
+ * image's pixels to it.  Layouts Tk can read as is are put straight
+ * from the block buffer; palette and white-is-zero images are
+ * converted a block at a time into the temp buffer. */
+
+typedef struct PhotoJob {
+    Tcl_Interp*        interp;
+    Tk_PhotoHandle     photo;
+    Tk_PhotoImageBlock block;  /* pixelSize and offsets for the layout */
+    int                convert;  /* PHOTO_ASIS, _PALETTE or _INVERT */
+    unsigned char      cmap[3*256]; /* RGB for each palette index */
+    unsigned char*     temp;   /* Converted pixels */
+} PhotoJob;
+
+#define PHOTO_ASIS    0
+#define PHOTO_PALETTE 1
+#define PHOTO_INVERT  2
+
+/* What geotiff probe finds in a file: the "geotiff read" data, read
+ * straight from the first IFD, or why there is none. */
+
+typedef struct GeoProbe {
+    int          status;       /* PROBE_OK, or a PROBE_ error code */
+    int          modelType;    /* MODEL_TYPE_PROJECTED or _GEOGRAPHIC */
+    Tcl_WideInt  width;        /* Image size, in pixels */
+    Tcl_WideInt  height;
+    int          ntie;         /* Number of tiepoint values */
+    int          nscale;       /* Number of pixel scale values */
+    double*      values;       /* The tiepoint values, then the pixel */
+} GeoProbe;                    /* scale values, or NULL.               */
+
+#define PROBE_OK           0
+#define PROBE_NO_FILE      1
+#define PROBE_NOT_TIFF     2
+#define PROBE_NO_GEOKEYS   3
+#define PROBE_NOT_GEOTIFF  4
+#define PROBE_GEOCENTRIC   5
+#define PROBE_BAD_MODEL    6
+#define PROBE_NO_TIEPOINTS 7
+#define PROBE_NO_PSCALE    8
+
+/* A geotiff probe cache entry: the file's modification time and size
+ * when it was probed, and what was found. */
+
+typedef struct ProbeEntry {
+    Tcl_WideInt  mtime;
+    Tcl_WideInt  size;
+    GeoProbe     probe;
+} ProbeEntry;
+
+/* The data for geotiff probe -directory; each worker probes its own
+ * range of the files. */
+
+typedef struct ProbeBatch {
+    char**       paths;        /* Normalized file names */
+    GeoProbe*    probes;       /* What was found in each */
+} ProbeBatch;
+
 /* geotiff(n) data */
 
 typedef struct GeotiffInfo {
-    TIFF*  tiff;
-    GTIF*  gtif;
+    Tcl_HashTable images;      /* GeotiffImage* by handle name */
+    int           counter;     /* Used to generate handle names */
 } GeotiffInfo;
 
+/* An 8-bit RGB raster, as read from or written to a binary PPM. */
+
+typedef struct Raster {
+    int            width;
+    int            height;
+    unsigned char* pixels;     /* width*height RGB triples, row-major */
+} Raster;
+
+/* A separable resampling filter along one axis: output pixel i is the
+ * sum over k of weights[start[i]+k] times input pixel first[i]+k, for
+ * k from 0 to count[i]-1. */
+
+typedef struct Filter {
+    int*   first;
+    int*   count;
+    int*   start;
+    float* weights;
+} Filter;
+
+/* The data for scaling one raster into another, a range of output
+ * rows per worker; see scaleRange(). */
+
+typedef struct ScaleJob {
+    Raster* src;
+    Raster* dst;
+    Filter  xf;                /* Filter along x */
+    Filter  yf;                /* Filter along y */
+} ScaleJob;
+
+/* A zoom pyramid: a base raster scaled by several factors, possibly
+ * on a background thread, in which case the result is passed to a
+ * callback command on the thread that asked for it.  The levels can
+ * be written to a file as they're built rather than kept. */
+
+typedef struct Pyramid {
+    Tcl_Event    header;       /* For queueing the finished pyramid */
+    Tcl_Interp*  interp;       /* Interp for the callback */
+    Tcl_ThreadId owner;        /* The interp's thread */
+    Tcl_Obj*     command;      /* Callback command prefix, or NULL */
+    int          workers;      /* Threads to scale each level with */
+    char*        file;         /* File to write the levels to, or NULL */
+    int          failed;       /* 1 if the file couldn't be written */
+    Raster       base;         /* A private copy of the base raster */
+    int          nlevels;
+    int*         up;           /* Level i is base*up[i]/down[i] */
+    int*         down;
+    Raster*      levels;       /* The levels, if not written to a file */
+    long*        offsets;      /* Each level's offset and length in the */
+    long*        lengths;      /* file, if written to one.              */
+} Pyramid;
+
+/* A ucurve(n) curve store, as created by "curvestore create": the 
+ * tracked curves of a ucurve(n) instance, in struct-of-arrays form so
+ * that the per-curve updates vectorize.  Curve i is the ith curve in
+ * curve_id order; each array has one element per curve.  The curve
+ * type's bounds and smoothing parameters are copied to each curve. */
+
+typedef struct CurveStore {
+    int          size;         /* Number of curves */
+    int          maxSize;      /* Allocated size of the arrays */
+    Tcl_WideInt* ids;          /* curve_id of each curve, ascending */
+    int*         slots;        /* Index of each curve_id, or -1 */
+    int          nslots;       /* IDs covered by slots; 0 if too sparse */
+    int          maxSlots;     /* Allocated size of slots */
+    double*      a;            /* Current, baseline, and natural levels */
+    double*      b;
+    double*      c;
+    double*      delta;        /* Net effect of the current pass */
+    double*      posfactor;    /* Scaling factors */
+    double*      negfactor;
+    double*      min;          /* The curve type's bounds */
+    double*      max;
+    double*      alpha;        /* The curve type's smoothing parameters */
+    double*      beta;
+    double*      gamma;
+    double*      loaded;       /* a, b, delta, posfactor, and negfactor */
+} CurveStore;                  /* as loaded, 5 per curve.               */
+
+/* An effect, as given to "curvestore apply". */
+
+typedef struct CurveEffect {
+    Tcl_WideInt  curveId;
+    Tcl_WideInt  causeId;
+    Tcl_WideInt  driverId;
+    int          slot;         /* The curve's index, or -1 if none */
+    int          pflag;        /* 1 if persistent, 0 if transient */
+    int          order;        /* Position in the effects list */
+    double       mag;          /* Nominal magnitude */
+    double       actual;       /* Actual magnitude */
+} CurveEffect;
+
+/* curvestore(n) data; one per interpreter */
+
+typedef struct CurveInfo {
+    Tcl_HashTable stores;      /* CurveStore* by handle name */
+    int           counter;     /* Used to generate handle names */
+    Scratch       scratch;     /* Scratch arena for the subcommands */
+} CurveInfo;
+
+/* GRAM level or slope effects, as given to gramcontrib(n), in 
+ * struct-of-arrays form so that the per-effect computations 
+ * vectorize.  Effect i is the ith effect in the list; each array has
+ * one element per effect.  The IDs and the slope effects' future 
+ * links are kept as Tcl_Objs, since they are only passed back. */
+
+typedef struct GramEffects {
+    int          size;         /* Number of effects */
+    Tcl_Obj**    ids;          /* id of each effect */
+    Tcl_WideInt* ts;           /* Start and end times, in ticks */
+    Tcl_WideInt* te;
+    double*      llimit;       /* Level effects: long-term limit */
+    double*      tau;          /* Level effects: time constant, in days */
+    double*      slope;        /* Slope effects: slope, in points/day */
+    Tcl_Obj**    future;       /* Slope effects: future links */
+    double*      loaded;       /* Nominal contribution to date, as loaded */
+    double*      nominal;      /* Nominal contribution to date */
+    double*      ncontrib;     /* Nominal contribution for this step */
+    double*      athresh;      /* Ascending and descending thresholds */
+    double*      dthresh;
+    double*      val;          /* Current level of the effect's curve */
+} GramEffects;
+
+/* gramcontrib(n) data; one per interpreter */
+
+typedef struct GramInfo {
+    Scratch       scratch;     /* Scratch arena for the subcommands */
+} GramInfo;
+
 /*
  * Static Function Prototypes
  */
@@ -160,12 +649,27 @@ static int marsutil_intersectCmd    (ClientData, Tcl_Interp*, int,
 static int marsutil_ptinpolyCmd     (ClientData, Tcl_Interp*, int, 
                                   Tcl_Obj* CONST argv[]);
 
+static int marsutil_polygonCmd      (ClientData, Tcl_Interp*, int, 
+                                  Tcl_Obj* CONST argv[]);
+
+static int marsutil_geoindexCmd     (ClientData, Tcl_Interp*, int, 
+                                  Tcl_Obj* CONST argv[]);
+
 static int marsutil_latlongCmd      (ClientData, Tcl_Interp*, int, 
                                  Tcl_Obj* CONST argv[]);
 
 static int marsutil_geotiffCmd     (ClientData, Tcl_Interp*, int,
                                  Tcl_Obj* CONST argv[]);
 
+static int marsutil_rasterCmd      (ClientData, Tcl_Interp*, int,
+                                 Tcl_Obj* CONST argv[]);
+
+static int marsutil_curvestoreCmd  (ClientData, Tcl_Interp*, int,
+                                 Tcl_Obj* CONST argv[]);
+
+static int marsutil_gramcontribCmd (ClientData, Tcl_Interp*, int,
+                                 Tcl_Obj* CONST argv[]);
+
 /* latlong Subcommands */
 
 static int latlong_spheroid     (ClientData, Tcl_Interp*, int, 
@@ -184,6 +688,12 @@ static int latlong_dist         (ClientData, Tcl_Interp*, int,
                                  Tcl_Obj* CONST objv[]);
 static int latlong_dist4        (ClientData, Tcl_Interp*, int, 
                                  Tcl_Obj* CONST objv[]);
+static int latlong_distlist     (ClientData, Tcl_Interp*, int, 
+                                 Tcl_Obj* CONST objv[]);
+static int latlong_perimeter    (ClientData, Tcl_Interp*, int, 
+                                 Tcl_Obj* CONST objv[]);
+static int latlong_distmatrix   (ClientData, Tcl_Interp*, int, 
+                                 Tcl_Obj* CONST objv[]);
 static int latlong_pole         (ClientData, Tcl_Interp*, int, 
                                  Tcl_Obj* CONST objv[]);
 static int latlong_radius       (ClientData, Tcl_Interp*, int, 
@@ -195,46 +705,272 @@ static int latlong_area         (ClientData, Tcl_Interp*, int,
 /* GeoTIFF subcommands */
 static int geotiff_read         (ClientData, Tcl_Interp*, int,
                                  Tcl_Obj* CONST objv[]);
+static int geotiff_open         (ClientData, Tcl_Interp*, int,
+                                 Tcl_Obj* CONST objv[]);
+static int geotiff_probe        (ClientData, Tcl_Interp*, int,
+                                 Tcl_Obj* CONST objv[]);
+static int geotiff_close        (ClientData, Tcl_Interp*, int,
+                                 Tcl_Obj* CONST objv[]);
+static int geotiff_info         (ClientData, Tcl_Interp*, int,
+                                 Tcl_Obj* CONST objv[]);
+static int geotiff_tile         (ClientData, Tcl_Interp*, int,
+                                 Tcl_Obj* CONST objv[]);
+static int geotiff_strip        (ClientData, Tcl_Interp*, int,
+                                 Tcl_Obj* CONST objv[]);
+static int geotiff_region       (ClientData, Tcl_Interp*, int,
+                                 Tcl_Obj* CONST objv[]);
+static int geotiff_tophoto      (ClientData, Tcl_Interp*, int,
+                                 Tcl_Obj* CONST objv[]);
+static int geotiff_tolatlong    (ClientData, Tcl_Interp*, int,
+                                 Tcl_Obj* CONST objv[]);
+static int geotiff_topixel      (ClientData, Tcl_Interp*, int,
+                                 Tcl_Obj* CONST objv[]);
+
+/* raster Subcommands */
+
+static int raster_pyramid       (ClientData, Tcl_Interp*, int,
+                                 Tcl_Obj* CONST objv[]);
+static int raster_scale         (ClientData, Tcl_Interp*, int,
+                                 Tcl_Obj* CONST objv[]);
+
+/* curvestore Subcommands */
+
+static int curvestore_apply     (ClientData, Tcl_Interp*, int,
+                                 Tcl_Obj* CONST objv[]);
+static int curvestore_changes   (ClientData, Tcl_Interp*, int,
+                                 Tcl_Obj* CONST objv[]);
+static int curvestore_create    (ClientData, Tcl_Interp*, int,
+                                 Tcl_Obj* CONST objv[]);
+static int curvestore_delete    (ClientData, Tcl_Interp*, int,
+                                 Tcl_Obj* CONST objv[]);
+static int curvestore_get       (ClientData, Tcl_Interp*, int,
+                                 Tcl_Obj* CONST objv[]);
+static int curvestore_load      (ClientData, Tcl_Interp*, int,
+                                 Tcl_Obj* CONST objv[]);
+
+/* gramcontrib Subcommands */
+
+static int gramcontrib_level    (ClientData, Tcl_Interp*, int,
+                                 Tcl_Obj* CONST objv[]);
+static int gramcontrib_slope    (ClientData, Tcl_Interp*, int,
+                                 Tcl_Obj* CONST objv[]);
+
+/* polygon subcommands */
+static int polygon_create       (ClientData, Tcl_Interp*, int,
+                                 Tcl_Obj* CONST objv[]);
+static int polygon_delete       (ClientData, Tcl_Interp*, int,
+                                 Tcl_Obj* CONST objv[]);
+static int polygon_coords       (ClientData, Tcl_Interp*, int,
+                                 Tcl_Obj* CONST objv[]);
+static int polygon_bbox         (ClientData, Tcl_Interp*, int,
+                                 Tcl_Obj* CONST objv[]);
+static int polygon_adjacency    (ClientData, Tcl_Interp*, int,
+                                 Tcl_Obj* CONST objv[]);
+
+/* geoindex subcommands */
+static int geoindex_create      (ClientData, Tcl_Interp*, int,
+                                 Tcl_Obj* CONST objv[]);
+static int geoindex_delete      (ClientData, Tcl_Interp*, int,
+                                 Tcl_Obj* CONST objv[]);
+static int geoindex_add         (ClientData, Tcl_Interp*, int,
+                                 Tcl_Obj* CONST objv[]);
+static int geoindex_remove      (ClientData, Tcl_Interp*, int,
+                                 Tcl_Obj* CONST objv[]);
+static int geoindex_find        (ClientData, Tcl_Interp*, int,
+                                 Tcl_Obj* CONST objv[]);
+static int geoindex_size        (ClientData, Tcl_Interp*, int,
+                                 Tcl_Obj* CONST objv[]);
 
 /* utility functions */
 
 static LatlongInfo* newLatlongInfo    (void);
 static void         deleteLatlongInfo (LatlongInfo*);
-static Points*      newPoints         (void);
-static void         deletePoints      (Points*);
+static void*        scratchAlloc      (Scratch*, size_t);
+static void         resetScratch      (Scratch*);
+static void         freeScratch       (Scratch*);
 
 static void         setEllipsoidData  (LatlongInfo*); 
 
 static GeotiffInfo* newGeotiffInfo    (void);
 static void         deleteGeotiffInfo (GeotiffInfo*);
-static void         closeGeotiff      (GeotiffInfo*);
+static int          openTiff          (Tcl_Interp*, Tcl_Obj*, TIFF**);
+static int          getGeoKeys        (Tcl_Interp*, TIFF*, Tcl_Obj**,
+                                       GeoModel*);
+static int          getProjection     (Tcl_Interp*, GTIF*, GeoModel*, 
+                                       double*, Tcl_Obj**);
+static void         probeFile         (const char*, GeoProbe*);
+static int          readGeoProbe      (FILE*, GeoProbe*);
+static unsigned char* probeValues     (FILE*, unsigned char*, int, int, 
+                                       int*);
+static Tcl_WideInt  probeGet          (const unsigned char*, int, int);
+static void         copyGeoProbe      (GeoProbe*, GeoProbe*);
+static Tcl_Obj*     newProbeDict      (GeoProbe*);
+static WorkProc     probeRange;
+static int          compareStrings    (const void*, const void*);
+static int          getGeotiff        (Tcl_Interp*, GeotiffInfo*, Tcl_Obj*,
+                                       GeotiffImage**);
+static int          getLevel          (Tcl_Interp*, GeotiffImage*, int, 
+                                       Tcl_Obj* CONST objv[], int, 
+                                       GeotiffLevel**);
+static void         mapGeotiff        (GeotiffImage*);
+static unsigned char* mappedBlock     (GeotiffImage*, GeotiffLevel*, uint32, 
+                                       tsize_t);
+static void         closeGeotiff      (GeotiffImage*);
+static int          getDecoders       (GeotiffImage*, int, int);
+static int          regionBlocks      (RegionJob*, TIFF*, tdata_t, int, int);
+static WorkProc     regionRange;
+static int          getTkStubs        (Tcl_Interp*);
+static int          photoLayout       (Tcl_Interp*, GeotiffImage*, PhotoJob*);
+static RegionProc   photoBlock;
+static int          pixelToLatLong    (GeoModel*, double, double, 
+                                       double*, double*);
+static int          latLongToPixel    (GeoModel*, double, double, 
+                                       double*, double*);
+static int          gridPoint         (GeoGrid*, double, double, double*);
+static GeoGrid*     newGeoGrid        (GeoModel*, int, double, double, 
+                                       double, double);
+static void         freeGeoGrid       (GeoGrid*);
+static void         buildGeoGrids     (GeotiffImage*);
+static int          geotiffConvert    (GeotiffInfo*, Tcl_Interp*, int,
+                                       Tcl_Obj* CONST objv[], int);
+static int          getPpm            (Tcl_Interp*, Tcl_Obj*, Raster*);
+static Tcl_Obj*     newPpmObj         (Tcl_Interp*, Raster*);
+static int          getZoomFactor     (Tcl_Interp*, Tcl_Obj*, int*, int*);
+static int          getScaledSize     (Tcl_Interp*, Raster*, int, int, 
+                                       Raster*);
+static void         scaleRaster       (Raster*, Raster*, int, int, int);
+static void         buildFilter       (Filter*, int, int, int, int);
+static void         freeFilter        (Filter*);
+static WorkProc     scaleRange;
+static void         buildPyramid      (Pyramid*);
+static int          writeLevel        (FILE*, Raster*, long*, long*);
+static int          getPyramidResult  (Tcl_Interp*, Pyramid*, Tcl_Obj**);
+static Tcl_ThreadCreateType pyramidThread (ClientData);
+static int          pyramidEventProc  (Tcl_Event*, int);
+static void         freePyramid       (Pyramid*);
+
+static CurveInfo*   newCurveInfo      (void);
+static void         deleteCurveInfo   (CurveInfo*);
+static int          getCurveStore     (Tcl_Interp*, CurveInfo*, Tcl_Obj*,
+                                       CurveStore**);
+static void         freeCurveStore    (CurveStore*);
+static void         sizeCurveStore    (CurveStore*, int);
+static int          curveSlot         (CurveStore*, Tcl_WideInt);
+static void         curveBaseline     (CurveStore*);
+static void         curveUpdate       (CurveStore*);
+static int          curveEffects      (CurveStore*, CurveEffect*, int, int);
+static void         curveLevels       (CurveStore*);
+static int          compareEffectsByCause  (const void*, const void*);
+static int          compareEffectsByDriver (const void*, const void*);
+
+static GramInfo*    newGramInfo       (void);
+static void         deleteGramInfo    (GramInfo*);
+static int          getGramEffects    (Tcl_Interp*, Scratch*, Tcl_Obj*, 
+                                       int, GramEffects*);
+static int          gramLevels        (GramEffects*, Tcl_WideInt, double*);
+static int          gramSlopes        (Tcl_Interp*, GramEffects*, 
+                                       Tcl_WideInt, Tcl_WideInt, 
+                                       Tcl_WideInt, double,
+                                       Tcl_WideInt, Tcl_Obj*);
+static void         gramThresholds    (GramEffects*);
+static Tcl_Obj*     gramChanges       (GramEffects*);
+
+static PolygonInfo* newPolygonInfo    (void);
+static void         deletePolygonInfo (ClientData, Tcl_Interp*);
+static Polygon*     newPolygon        (Tcl_Obj*, Points*);
+static void         releasePolygon    (Polygon*);
+
+static GeoIndex*    newGeoIndex       (void);
+static void         deleteGeoIndex    (GeoIndex*);
+static void         buildGeoIndex     (GeoIndex*);
+static GeoIndexEntry* findGeoIndex    (GeoIndex*, Point*);
+static void         geoIndexCell      (GeoIndex*, double, double, 
+                                       int*, int*);
+
+static void         freePolygonIntRep (Tcl_Obj*);
+static void         dupPolygonIntRep  (Tcl_Obj*, Tcl_Obj*);
+static int          setPolygonFromAny (Tcl_Interp*, Tcl_Obj*);
 
 static double spheredist  (double, double, double, double);
+static void   spheredistRow (double, double, double, int, 
+                             const double*, const double*, const double*,
+                             double*);
 static void   bbox        (Points*, Bbox*);
 static int    ccw         (Point*, Point*, Point*);
 static int    intersect   (Point*, Point*, Point*, Point*);
 static int    ptinpoly    (Points*, Point*, Bbox*);
+static int    ptinpolygon (Polygon*, Point*);
+static int    crossings   (Polygon*, double, double, int*);
+static int    ptinpolyBatch(Tcl_Interp*, PolygonInfo*, Tcl_Obj*, Tcl_Obj*);
+static int    edgeContact (Point*, Point*, Point*, Point*, double, int, 
+                           double*);
+static void   centroid    (Polygon*, Point*);
+static int    compareAdjEdges (const void*, const void*);
+static int    compareAdjPairs (const void*, const void*);
 static double dmin        (double a, double b);
 static double dmax        (double a, double b);
 static double ll_area     (Points*);
+static double ll_earea    (GeodesicData*, Points*);
+static double ll_perimeter(GeodesicData*, Points*);
+static double geodist     (GeodesicData*, double, double, double, double);
+static double authalicQ   (GeodesicData*, double);
+static void   setGeodesicData (GeodesicData*, double, double);
 
 static int    getBbox       (Tcl_Interp*, Tcl_Obj*, Bbox*);
 static int    getPoint      (Tcl_Interp*, Tcl_Obj*, Point*);
-static int    getPoints     (Tcl_Interp*, Tcl_Obj*, int minSize, Points*);
+static int    getPoints     (Tcl_Interp*, Scratch*, Tcl_Obj*, int minSize, 
+                             Points**);
+static int    getPolygon    (Tcl_Interp*, PolygonInfo*, Tcl_Obj*, Polygon**);
+static int    getGeoIndex   (Tcl_Interp*, PolygonInfo*, Tcl_Obj*, GeoIndex**);
 static int    getLatLong    (Tcl_Interp*, Tcl_Obj*, double*, double*);
 static int    getGcc        (Tcl_Interp*, Tcl_Obj*, double*, double*, double*);
+static double* getLocArrays (Tcl_Interp*, LatlongInfo*, Tcl_Obj*, int*);
+static void   setDoublesResult (Tcl_Interp*, Scratch*, double*, int, int);
 static int    validateLatLong (Tcl_Interp*, double, double);
+static int    isFlag        (Tcl_Obj*, char*);
+static int    getPrecision  (Tcl_Interp*, Tcl_Obj*, int*);
+static int    cpuCount      (void);
+static int    getWorkers    (Tcl_Interp*, int, Tcl_Obj* CONST objv[], 
+                             int*, int*);
+static int    tomgrsList    (Tcl_Interp*, LatlongInfo*, int,
+                             Tcl_Obj* CONST objv[]);
+static int    frommgrsList  (Tcl_Interp*, LatlongInfo*, int,
+                             Tcl_Obj* CONST objv[]);
+static void   runWorkers    (WorkProc*, ClientData, int, int, int);
+static Tcl_ThreadCreateType workerThread (ClientData);
+static WorkProc mgrsRange;
+static int    togccList     (Tcl_Interp*, LatlongInfo*, int,
+                             Tcl_Obj* CONST objv[]);
+static int    fromgccList   (Tcl_Interp*, LatlongInfo*, int,
+                             Tcl_Obj* CONST objv[]);
+static WorkProc togccRange;
+static WorkProc fromgccRange;
+static void   gccToLatLong  (EllipsoidData*, double*, double*, double*);
+static void   tomgrsError   (char*, long, double, double, int);
+static void   frommgrsError (char*, long, char*);
+static int    measurePolygon (Tcl_Interp*, LatlongInfo*, Tcl_Obj*, int, 
+                              double*);
+static int    measureCmd    (Tcl_Interp*, LatlongInfo*, int, 
+                             Tcl_Obj* CONST objv[], int);
 
 /*
  * Static Variables
  */
 
+/* The Tk stubs table, once getTkStubs() has found it.  It's what the
+ * Tk functions are called through, so it can't be static. */
+
+const TkStubs* tkStubsPtr = NULL;
+
 /* latlong Dispatch table */
 
 static SubcommandVector latlongTable [] = {
     {"area",     latlong_area},
     {"dist",     latlong_dist},
     {"dist4",    latlong_dist4},
+    {"distlist", latlong_distlist},
+    {"distmatrix", latlong_distmatrix},
+    {"perimeter", latlong_perimeter},
     {"pole",     latlong_pole},
     {"radius",   latlong_radius},
     {"validate", latlong_validate},
@@ -249,10 +985,106 @@ static SubcommandVector latlongTable [] = {
 /* geotiff Dispatch table */
 
 static SubcommandVector geotiffTable[] = {
-    {"read",  geotiff_read},
+    {"close",  geotiff_close},
+    {"info",   geotiff_info},
+    {"open",   geotiff_open},
+    {"probe",  geotiff_probe},
+    {"read",   geotiff_read},
+    {"region", geotiff_region},
+    {"strip",  geotiff_strip},
+    {"tile",   geotiff_tile},
+    {"tolatlong", geotiff_tolatlong},
+    {"tophoto", geotiff_tophoto},
+    {"topixel", geotiff_topixel},
+    {NULL}
+};
+
+/* geotiff probe error messages, by PROBE_ code; they match those of
+ * geotiff read. */
+
+static const char* probeErrors[] = {
+    NULL,
+    "file does not exist",
+    "file is not a TIFF",
+    "file does not contain geokeys",
+    "file is not a GeoTIFF",
+    "unsupported model type, must be geographic or projected",
+    "unrecognized model type",
+    "no tiepoints found in image",
+    "no pixel scaling found in image"
+};
+
+/* The geotiff probe cache, shared by every interpreter and thread in 
+ * the process: ProbeEntry* by normalized file name.  Entries are
+ * never removed; an entry is replaced when its file changes. */
+
+static Tcl_HashTable probeCache;
+static int           probeCacheReady = 0;
+TCL_DECLARE_MUTEX(probeMutex)
+
+/* raster Dispatch table */
+
+static SubcommandVector rasterTable[] = {
+    {"pyramid", raster_pyramid},
+    {"scale",   raster_scale},
+    {NULL}
+};
+
+/* curvestore Dispatch table */
+
+static SubcommandVector curvestoreTable[] = {
+    {"apply",   curvestore_apply},
+    {"changes", curvestore_changes},
+    {"create",  curvestore_create},
+    {"delete",  curvestore_delete},
+    {"get",     curvestore_get},
+    {"load",    curvestore_load},
+    {NULL}
+};
+
+/* gramcontrib Dispatch table */
+
+static SubcommandVector gramcontribTable[] = {
+    {"level",   gramcontrib_level},
+    {"slope",   gramcontrib_slope},
+    {NULL}
+};
+
+/* polygon Dispatch table */
+
+static SubcommandVector polygonTable[] = {
+    {"adjacency", polygon_adjacency},
+    {"bbox",   polygon_bbox},
+    {"coords", polygon_coords},
+    {"create", polygon_create},
+    {"delete", polygon_delete},
+    {NULL}
+};
+
+/* geoindex Dispatch table */
+
+static SubcommandVector geoindexTable[] = {
+    {"add",    geoindex_add},
+    {"create", geoindex_create},
+    {"delete", geoindex_delete},
+    {"find",   geoindex_find},
+    {"remove", geoindex_remove},
+    {"size",   geoindex_size},
     {NULL}
 };
 
+/* The Tcl_ObjType for polygon handles.  The internal rep caches the
+ * handle's Polygon* in ptr1 and the owning PolygonInfo* in ptr2, so that
+ * repeated uses of the same handle need no hash lookup. */
+
+static Tcl_ObjType polygonObjType = {
+    "marsutil_polygon",
+    freePolygonIntRep,
+    dupPolygonIntRep,
+    NULL,
+    setPolygonFromAny
+};
+
 /* Ellipsoids */
 
 static Ellipsoid ellipsoidTable [] = {
@@ -282,11 +1114,6 @@ static Ellipsoid ellipsoidTable [] = {
     {NULL}
 };
 
-/* EllipsoidData contains derived data from the reference ellipsoids above. 
- * The struct is defined in geoStars.h
- */
-static EllipsoidData ellipsoidData; 
-
 /*
  * Public Function Definitions
  */
@@ -334,19 +1161,30 @@ Marsbin_Init(Tcl_Interp *interp)
     Tcl_CreateObjCommand(interp, "::marsutil::let", 
                          marsutil_letCmd, NULL, NULL);
 
-    Tcl_CreateObjCommand(interp, "::marsutil::bbox", 
-                         marsutil_bboxCmd, newPoints(), 
-                         (Tcl_CmdDeleteProc*)deletePoints);
-
     Tcl_CreateObjCommand(interp, "::marsutil::ccw", 
                          marsutil_ccwCmd, NULL, NULL);
 
     Tcl_CreateObjCommand(interp, "::marsutil::intersect", 
                          marsutil_intersectCmd, NULL, NULL);
 
+    /* bbox, ptinpoly and polygon share the interp's polygon registry
+     * and scratch arena, which are deleted with the interp. */
+    PolygonInfo* polygonInfo = newPolygonInfo();
+
+    Tcl_SetAssocData(interp, "marsutil_polygon", 
+                     deletePolygonInfo, polygonInfo);
+
+    Tcl_CreateObjCommand(interp, "::marsutil::bbox", 
+                         marsutil_bboxCmd, polygonInfo, NULL);
+
     Tcl_CreateObjCommand(interp, "::marsutil::ptinpoly", 
-                         marsutil_ptinpolyCmd, newPoints(), 
-                         (Tcl_CmdDeleteProc*)deletePoints);
+                         marsutil_ptinpolyCmd, polygonInfo, NULL);
+
+    Tcl_CreateObjCommand(interp, "::marsutil::polygon", 
+                         marsutil_polygonCmd, polygonInfo, NULL);
+
+    Tcl_CreateObjCommand(interp, "::marsutil::geoindex", 
+                         marsutil_geoindexCmd, polygonInfo, NULL);
 
     Tcl_CreateObjCommand(interp, "::marsutil::latlong",
                          marsutil_latlongCmd, newLatlongInfo(), 
@@ -356,6 +1194,17 @@ Marsbin_Init(Tcl_Interp *interp)
                          marsutil_geotiffCmd, newGeotiffInfo(),
                          (Tcl_CmdDeleteProc*)deleteGeotiffInfo);
 
+    Tcl_CreateObjCommand(interp, "::marsutil::raster",
+                         marsutil_rasterCmd, NULL, NULL);
+
+    Tcl_CreateObjCommand(interp, "::marsutil::curvestore",
+                         marsutil_curvestoreCmd, newCurveInfo(),
+                         (Tcl_CmdDeleteProc*)deleteCurveInfo);
+
+    Tcl_CreateObjCommand(interp, "::marsutil::gramcontrib",
+                         marsutil_gramcontribCmd, newGramInfo(),
+                         (Tcl_CmdDeleteProc*)deleteGramInfo);
+
     return TCL_OK;
 }
 
@@ -644,7 +1493,12 @@ static int
 marsutil_bboxCmd(ClientData cd, Tcl_Interp *interp, 
              int objc, Tcl_Obj* CONST objv[])
 {
-    Points* pointsBuffer = (Points*)cd;
+    PolygonInfo* info = (PolygonInfo*)cd;
+    Points*      points;
+    Bbox         box;
+    Tcl_Obj*     result[4];
+
+    resetScratch(&info->scratch);
 
     if (objc != 2) {
         Tcl_WrongNumArgs(interp, 1, objv, "coords");
@@ -652,21 +1506,21 @@ marsutil_bboxCmd(ClientData cd, Tcl_Interp *interp,
     }
 
     /* FIRST, get the points. */
-    if (getPoints(interp, objv[1], 1, pointsBuffer) != TCL_OK)
+    if (getPoints(interp, &info->scratch, objv[1], 1, &points) != TCL_OK)
     {
         return TCL_ERROR;
     }
 
-    Bbox box;
+    /* NEXT, get the box. */
+    bbox(points, &box);
 
-    bbox(pointsBuffer, &box);
+    result[0] = Tcl_NewDoubleObj(box.xmin);
+    result[1] = Tcl_NewDoubleObj(box.ymin);
+    result[2] = Tcl_NewDoubleObj(box.xmax);
+    result[3] = Tcl_NewDoubleObj(box.ymax);
 
-    Tcl_Obj* result = Tcl_GetObjResult(interp);
+    Tcl_SetObjResult(interp, Tcl_NewListObj(4, result));
 
-    Tcl_ListObjAppendElement(interp, result, Tcl_NewDoubleObj(box.xmin));
-    Tcl_ListObjAppendElement(interp, result, Tcl_NewDoubleObj(box.ymin));
-    Tcl_ListObjAppendElement(interp, result, Tcl_NewDoubleObj(box.xmax));
-    Tcl_ListObjAppendElement(interp, result, Tcl_NewDoubleObj(box.ymax));
     return TCL_OK;
 }
 
@@ -795,36 +1649,75 @@ marsutil_intersectCmd(ClientData cd, Tcl_Interp *interp,
  *
  * FUNCTION:
  *	ptinpoly poly p ?bbox?
+ *	ptinpoly -batch polys points
  *
  * INPUTS:
- *	poly	A polygon expressed as a list of coordinates
+ *	poly	A polygon expressed as a list of coordinates, or a 
+ *              polygon handle returned by "polygon create".
  *      p       A point
  *      bbox    The polygon's cached bounding box, or NULL
+ *      polys   A list of polygon handles
+ *      points  A flat list of point coordinates
  *
  * RETURNS:
  *      1 if the point is in the polygon, and 0 otherwise.
+ *      For -batch, see ptinpolyBatch().
+ *
+ * DESCRIPTION:
+ *      If poly is a polygon handle, the compiled polygon is used
+ *      directly and bbox is ignored; no coordinates are parsed.
  */
 
 static int 
 marsutil_ptinpolyCmd(ClientData cd, Tcl_Interp *interp, 
                  int objc, Tcl_Obj* CONST objv[])
 {
-    Points* pointsBuffer = (Points*)cd;
+    PolygonInfo* info = (PolygonInfo*)cd;
+    Polygon*     poly = NULL;
+    Points*      points;
+    Point        p;
+    int          len;
+
+    resetScratch(&info->scratch);
 
     if (objc < 3 || objc > 4) {
         Tcl_WrongNumArgs(interp, 1, objv, "poly p ?bbox?");
         return TCL_ERROR;
     }
 
-    /* FIRST, get the polygon. */
-    if (getPoints(interp, objv[1], 1, pointsBuffer) != TCL_OK)
+    /* FIRST, see if the polygon is a handle or the -batch option.  A
+     * coordinate list always has at least two elements, so a 
+     * one-element value is one of these or an unknown handle. */
+    if (objv[1]->typePtr == &polygonObjType ||
+        (Tcl_ListObjLength(NULL, objv[1], &len) == TCL_OK && len == 1))
+    {
+        if (objc == 4 && strcmp(Tcl_GetString(objv[1]), "-batch") == 0)
+        {
+            return ptinpolyBatch(interp, info, objv[2], objv[3]);
+        }
+
+        if (getPolygon(interp, info, objv[1], &poly) != TCL_OK)
+        {
+            return TCL_ERROR;
+        }
+
+        /* NEXT, use the compiled polygon. */
+        if (getPoint(interp, objv[2], &p) != TCL_OK)
+        {
+            return TCL_ERROR;
+        }
+
+        Tcl_SetIntObj(Tcl_GetObjResult(interp), ptinpolygon(poly, &p));
+        return TCL_OK;
+    }
+
+    /* NEXT, get the polygon. */
+    if (getPoints(interp, &info->scratch, objv[1], 1, &points) != TCL_OK)
     {
         return TCL_ERROR;
     }
 
     /* NEXT, get the point. */
-    Point p;
-
     if (getPoint(interp, objv[2], &p) != TCL_OK)
     {
         return TCL_ERROR;
@@ -842,10 +1735,10 @@ marsutil_ptinpolyCmd(ClientData cd, Tcl_Interp *interp,
     }
     else
     {
-        bbox(pointsBuffer, &box);
+        bbox(points, &box);
     }
 
-    int value = ptinpoly(pointsBuffer, &p, &box);
+    int value = ptinpoly(points, &p, &box);
 
     Tcl_Obj* result = Tcl_GetObjResult(interp);
     Tcl_SetIntObj(result, value);
@@ -853,14 +1746,127 @@ marsutil_ptinpolyCmd(ClientData cd, Tcl_Interp *interp,
     return TCL_OK;
 }
 
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	ptinpolyBatch()
+ *
+ * INPUTS:
+ *	interp		The Tcl interpreter
+ *	info		The PolygonInfo
+ *	polysObj	A list of polygon handles
+ *	pointsObj	A flat list of point coordinates, x1 y1 x2 y2 ...
+ *
+ * RETURNS:
+ *	TCL_OK or TCL_ERROR.
+ *
+ * DESCRIPTION:
+ *	Implements "ptinpoly -batch".  Sets the interpreter result to a
+ *      list with one element per point: the index in polys of the
+ *      last polygon that contains the point, or -1 if none do.  As
+ *      in geoset, later polygons are taken to be on top of earlier
+ *      ones.
+ *
+ *      The polygons' bounding boxes are copied into struct-of-arrays
+ *      form, so that the bounding box test for each point against
+ *      all polygons vectorizes; only the candidates that pass it are
+ *      checked with ptinpolygon().
+ */
+
+static int
+ptinpolyBatch(Tcl_Interp* interp, PolygonInfo* info, 
+              Tcl_Obj* polysObj, Tcl_Obj* pointsObj)
+{
+    Scratch*  scratch = &info->scratch;
+    Points*   points;
+    int       polyc;
+    Tcl_Obj** polyv;
+    int       i;
+    int       j;
+
+    /* FIRST, get the polygons. */
+    if (Tcl_ListObjGetElements(interp, polysObj, &polyc, &polyv) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
+
+    Polygon** polys = (Polygon**)scratchAlloc(scratch, 
+                                              polyc * sizeof(Polygon*));
+
+    for (i = 0; i < polyc; i++)
+    {
+        if (getPolygon(interp, info, polyv[i], &polys[i]) != TCL_OK)
+        {
+            return TCL_ERROR;
+        }
+    }
+
+    /* NEXT, get the points. */
+    if (getPoints(interp, scratch, pointsObj, 0, &points) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
+
+    /* NEXT, copy the bounding boxes into one block of arrays, 
+     * followed by the candidate flags. */
+    double* xmin = (double*)scratchAlloc(scratch, 
+                                         4*polyc * sizeof(double) + polyc);
+    double* ymin = xmin + polyc;
+    double* xmax = ymin + polyc;
+    double* ymax = xmax + polyc;
+    char*   cand = (char*)(ymax + polyc);
+
+    for (i = 0; i < polyc; i++)
+    {
+        xmin[i] = polys[i]->box.xmin;
+        ymin[i] = polys[i]->box.ymin;
+        xmax[i] = polys[i]->box.xmax;
+        ymax[i] = polys[i]->box.ymax;
+    }
+
+    /* NEXT, classify each point. */
+    int       npts    = points->size;
+    Point*    pts     = points->pts;
+    Tcl_Obj** results = (Tcl_Obj**)scratchAlloc(scratch, 
+                                                npts * sizeof(Tcl_Obj*));
+
+    for (j = 0; j < npts; j++)
+    {
+        double px    = pts[j].x;
+        double py    = pts[j].y;
+        int    found = -1;
+
+        for (i = 0; i < polyc; i++)
+        {
+            cand[i] = (px >= xmin[i]) & (px <= xmax[i]) & 
+                      (py >= ymin[i]) & (py <= ymax[i]);
+        }
+
+        for (i = polyc - 1; i >= 0; i--)
+        {
+            if (cand[i] && ptinpolygon(polys[i], &pts[j]))
+            {
+                found = i;
+                break;
+            }
+        }
+
+        results[j] = Tcl_NewIntObj(found);
+    }
+
+    Tcl_SetObjResult(interp, Tcl_NewListObj(npts, results));
+
+    return TCL_OK;
+}
+
 /*
- * latlong command and subcommands
+ * polygon command and subcommands
  */
 
 /***********************************************************************
  *
  * FUNCTION:
- *	marsutil_latlongCmd()
+ *	marsutil_polygonCmd()
  *
  * INPUTS:
  *	subcommand		The subcommand name
@@ -870,14 +1876,14 @@ marsutil_ptinpolyCmd(ClientData cd, Tcl_Interp *interp,
  *	Whatever the subcommand returns.
  *
  * DESCRIPTION:
- *	This is the ensemble command for the latlong subcommands.
+ *	This is the ensemble command for the polygon subcommands.
  *      It looks up the subcommand name, and
  *      then passes execution to the subcommand proc.
  */
 
 static int 
-marsutil_latlongCmd(ClientData cd, Tcl_Interp* interp, 
-                   int objc, Tcl_Obj* CONST objv[])
+marsutil_polygonCmd(ClientData cd, Tcl_Interp* interp, 
+                    int objc, Tcl_Obj* CONST objv[])
 {
     if (objc < 2) 
     {
@@ -885,10 +1891,12 @@ marsutil_latlongCmd(ClientData cd, Tcl_Interp* interp,
         return TCL_ERROR;
     } 
 
+    resetScratch(&((PolygonInfo*)cd)->scratch);
+
     int index = 0;
 
     if (Tcl_GetIndexFromObjStruct(interp, objv[1], 
-                                  latlongTable, sizeof(SubcommandVector),
+                                  polygonTable, sizeof(SubcommandVector),
                                   "subcommand",
                                   TCL_EXACT,
                                   &index) != TCL_OK)
@@ -896,64 +1904,56 @@ marsutil_latlongCmd(ClientData cd, Tcl_Interp* interp,
         return TCL_ERROR;
     }
 
-    return (*latlongTable[index].proc)(cd, interp, objc, objv);
+    return (*polygonTable[index].proc)(cd, interp, objc, objv);
 }
 
-            
-
-
-
 /***********************************************************************
  *
  * FUNCTION:
- *	latlong dist loc1 loc2
+ *	polygon create coords
  *
  * INPUTS:
- *	loc1		A lat/long pair in decimal degrees
- *      loc2            A lat/long pair in decimal degrees
+ *	coords		A list of three or more x,y coordinate pairs
  *
  * RETURNS:
- *	The distance between loc1 and loc2 in kilometers.
+ *	A polygon handle
  *
  * DESCRIPTION:
- *	Computes the distance between the two points and returns
- *      an answer in kilometers.  The algorithm is equivalent to
- *      that used in CBS.
- *
- *      This function is documented in marsutil(n).
+ *	Parses the coordinates once, computing the polygon's bounding
+ *      box and edge data, and returns a handle that can be passed to
+ *      ptinpoly in place of the coordinates.
  */
 
 static int 
-latlong_dist(ClientData cd, Tcl_Interp *interp, 
-             int objc, Tcl_Obj* CONST objv[])
+polygon_create(ClientData cd, Tcl_Interp *interp, 
+               int objc, Tcl_Obj* CONST objv[])
 {
-    if (objc != 4) {
-        Tcl_WrongNumArgs(interp, 2, objv, "loc1 loc2");
-        return TCL_ERROR;
-    }
-
-    /* FIRST, get loc1 and loc2 */
-    double lat1 = 0.0;
-    double lon1 = 0.0;
+    PolygonInfo*   info = (PolygonInfo*)cd;
+    Polygon*       poly;
+    Points*        points;
+    Tcl_HashEntry* entry;
+    int            isNew;
+    char           name[40];
 
-    if (getLatLong(interp, objv[2], &lat1, &lon1) != TCL_OK)
-    {
+    if (objc != 3) {
+        Tcl_WrongNumArgs(interp, 2, objv, "coords");
         return TCL_ERROR;
     }
 
-    double lat2 = 0.0;
-    double lon2 = 0.0;
-
-    if (getLatLong(interp, objv[3], &lat2, &lon2) != TCL_OK)
+    /* FIRST, get the points. */
+    if (getPoints(interp, &info->scratch, objv[2], 3, &points) != TCL_OK)
     {
         return TCL_ERROR;
     }
 
-    /* NEXT, convert points to radians */
-    double dist = spheredist(lat1, lon1, lat2, lon2);
+    /* NEXT, compile the polygon and register it. */
+    poly = newPolygon(objv[2], points);
 
-    Tcl_Obj* result = Tcl_GetObjResult(interp);
-    Tcl_SetDoubleObj(result, dist);
+    sprintf(name, "poly%d", ++info->counter);
+    entry = Tcl_CreateHashEntry(&info->polygons, name, &isNew);
+    Tcl_SetHashValue(entry, poly);
+
+    Tcl_SetResult(interp, name, TCL_VOLATILE);
 
     return TCL_OK;
 }
@@ -961,65 +1961,76 @@ latlong_dist(ClientData cd, Tcl_Interp *interp,
 /***********************************************************************
  *
  * FUNCTION:
- *	latlong dist4 lat1 lon1 lat2 lon2
+ *	polygon delete handle
  *
  * INPUTS:
- *	lat1		Latitude  1 in decimal degrees
- *      lon1            Longitude 1 in decimal degrees
- *	lat2		Latitude  2 in decimal degrees
- *      lon2            Longitude 2 in decimal degrees
+ *	handle		A polygon handle
  *
  * RETURNS:
- *	The distance between lat1,lon1 and lat2,lon2 in kilometers.
+ *	Nothing.
  *
  * DESCRIPTION:
- *	Computes the distance between the two points and returns
- *      an answer in kilometers.  The algorithm is equivalent to
- *      that used in CBS.
- *
- *      This function is documented in marsutil(n).
+ *	Deletes the polygon handle.  The compiled polygon is freed once
+ *      nothing else refers to it.
  */
 
 static int 
-latlong_dist4(ClientData cd, Tcl_Interp *interp, 
-             int objc, Tcl_Obj* CONST objv[])
+polygon_delete(ClientData cd, Tcl_Interp *interp, 
+               int objc, Tcl_Obj* CONST objv[])
 {
-    if (objc != 6) {
-        Tcl_WrongNumArgs(interp, 2, objv, "lat1 lon1 lat2 lon2");
-        return TCL_ERROR;
-    }
-
-    /* FIRST, get the lat/lon values */
-    double lat1 = 0.0;
-    double lon1 = 0.0;
-    double lat2 = 0.0;
-    double lon2 = 0.0;
+    PolygonInfo*   info = (PolygonInfo*)cd;
+    Polygon*       poly;
+    Tcl_HashEntry* entry;
 
-    if (Tcl_GetDoubleFromObj(interp, objv[2], &lat1) != TCL_OK)
-    {
+    if (objc != 3) {
+        Tcl_WrongNumArgs(interp, 2, objv, "handle");
         return TCL_ERROR;
     }
 
-    if (Tcl_GetDoubleFromObj(interp, objv[3], &lon1) != TCL_OK)
+    if (getPolygon(interp, info, objv[2], &poly) != TCL_OK)
     {
         return TCL_ERROR;
     }
 
-    if (Tcl_GetDoubleFromObj(interp, objv[4], &lat2) != TCL_OK)
-    {
-        return TCL_ERROR;
-    }
+    entry = Tcl_FindHashEntry(&info->polygons, Tcl_GetString(objv[2]));
+    Tcl_DeleteHashEntry(entry);
 
-    if (Tcl_GetDoubleFromObj(interp, objv[5], &lon2) != TCL_OK)
-    {
+    poly->deleted = 1;
+    releasePolygon(poly);
+
+    return TCL_OK;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	polygon coords handle
+ *
+ * INPUTS:
+ *	handle		A polygon handle
+ *
+ * RETURNS:
+ *	The polygon's coordinate list, as given to "polygon create".
+ */
+
+static int 
+polygon_coords(ClientData cd, Tcl_Interp *interp, 
+               int objc, Tcl_Obj* CONST objv[])
+{
+    PolygonInfo* info = (PolygonInfo*)cd;
+    Polygon*     poly;
+
+    if (objc != 3) {
+        Tcl_WrongNumArgs(interp, 2, objv, "handle");
         return TCL_ERROR;
     }
 
-    /* NEXT, convert points to radians */
-    double dist = spheredist(lat1, lon1, lat2, lon2);
+    if (getPolygon(interp, info, objv[2], &poly) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
 
-    Tcl_Obj* result = Tcl_GetObjResult(interp);
-    Tcl_SetDoubleObj(result, dist);
+    Tcl_SetObjResult(interp, poly->coords);
 
     return TCL_OK;
 }
@@ -1027,196 +2038,356 @@ latlong_dist4(ClientData cd, Tcl_Interp *interp,
 /***********************************************************************
  *
  * FUNCTION:
- *	latlong pole ?loc?
+ *	polygon bbox handle
  *
  * INPUTS:
- *	loc		A lat/long pair in decimal degrees
+ *	handle		A polygon handle
  *
  * RETURNS:
- *	Nothing.
- *
- * DESCRIPTION:
- *	Sets/gets the location as the pole for the "latlong radius" command.
+ *      The polygon's bounding box, {xmin ymin xmax ymax}
  */
 
 static int 
-latlong_pole(ClientData cd, Tcl_Interp *interp, 
+polygon_bbox(ClientData cd, Tcl_Interp *interp, 
              int objc, Tcl_Obj* CONST objv[])
 {
-    LatlongInfo* info = (LatlongInfo*)cd;
+    PolygonInfo* info = (PolygonInfo*)cd;
+    Polygon*     poly;
 
-    if (objc < 2 || objc > 3) {
-        Tcl_WrongNumArgs(interp, 2, objv, "?loc?");
+    if (objc != 3) {
+        Tcl_WrongNumArgs(interp, 2, objv, "handle");
         return TCL_ERROR;
     }
 
-    /* FIRST, get loc, if any */
-    if (objc == 3) {
-        double lat;
-        double lon;
-
-        if (getLatLong(interp, objv[2], &lat, &lon) != TCL_OK)
-        {
-            return TCL_ERROR;
-        }
-
-        info->poleLat = lat;
-        info->poleLon = lon;
+    if (getPolygon(interp, info, objv[2], &poly) != TCL_OK)
+    {
+        return TCL_ERROR;
     }
 
-    /* NEXT, return lat and lon. */
     Tcl_Obj* result = Tcl_GetObjResult(interp);
-    Tcl_ListObjAppendElement(interp, result, Tcl_NewDoubleObj(info->poleLat));
-    Tcl_ListObjAppendElement(interp, result, Tcl_NewDoubleObj(info->poleLon));
+
+    Tcl_ListObjAppendElement(interp, result, Tcl_NewDoubleObj(poly->box.xmin));
+    Tcl_ListObjAppendElement(interp, result, Tcl_NewDoubleObj(poly->box.ymin));
+    Tcl_ListObjAppendElement(interp, result, Tcl_NewDoubleObj(poly->box.xmax));
+    Tcl_ListObjAppendElement(interp, result, Tcl_NewDoubleObj(poly->box.ymax));
 
     return TCL_OK;
 }
 
-
 /***********************************************************************
  *
  * FUNCTION:
- *	latlong radius lat lon
+ *	polygon adjacency ?-latlong? ?-tolerance tol? polys
  *
  * INPUTS:
- *	lat		A latitude in decimal degrees
- *	lon		A latitude in decimal degrees
+ *	polys		A list of polygon handles
+ *	tol		Tolerance for collinear edges, in coordinate units;
+ *                      defaults to 0.0.
  *
  * RETURNS:
- *	The distance between lat/lon and the pole set with [latlong pole].
+ *      A flat list, i j border dist ..., with one entry for each pair
+ *      of adjacent polygons, i < j being indices into polys.  border
+ *      is the length of the pair's shared border, and dist the 
+ *      distance between their centroids.  With -latlong, the 
+ *      coordinates are lat/long pairs in decimal degrees, and the 
+ *      lengths are in kilometers.
  *
  * DESCRIPTION:
- *	Computes the distance between the two points using
- *      spheredist().
+ *      Two polygons are adjacent if their boundaries touch or cross,
+ *      or if an edge of one lies along an edge of the other to within
+ *      tol.  The edges are found by sweeping across X: the edges of 
+ *      all of the polygons are sorted by their minimum X, and each is
+ *      compared only with the earlier edges whose X and Y extents
+ *      overlap its own.  The result is sorted by i and j.
  */
 
 static int 
-latlong_radius(ClientData cd, Tcl_Interp *interp, 
-               int objc, Tcl_Obj* CONST objv[])
+polygon_adjacency(ClientData cd, Tcl_Interp *interp, 
+                  int objc, Tcl_Obj* CONST objv[])
 {
-    LatlongInfo* info = (LatlongInfo*)cd;
+    PolygonInfo*   info    = (PolygonInfo*)cd;
+    Scratch*       scratch = &info->scratch;
+    int            latlong = 0;
+    double         tol     = 0.0;
+    int            a;
+    int            polyc;
+    Tcl_Obj**      polyv;
+    int            i;
+    int            k;
+
+    /* FIRST, get the options. */
+    for (a = 2; a < objc - 1; a++)
+    {
+        if (isFlag(objv[a], "-latlong"))
+        {
+            latlong = 1;
+        }
+        else if (isFlag(objv[a], "-tolerance") && a + 1 < objc - 1)
+        {
+            a++;
 
-    if (objc != 4) {
-        Tcl_WrongNumArgs(interp, 2, objv, "lat lon");
-        return TCL_ERROR;
-    }
+            if (Tcl_GetDoubleFromObj(interp, objv[a], &tol) != TCL_OK)
+            {
+                return TCL_ERROR;
+            }
 
-    /* FIRST, get lat and lon */
-    double lat = 0.0;
-    double lon = 0.0;
+            if (tol < 0.0)
+            {
+                Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+                    "invalid tolerance, should be >= 0.0: \"%s\"", 
+                    Tcl_GetString(objv[a])));
+                return TCL_ERROR;
+            }
+        }
+        else
+        {
+            break;
+        }
+    }
 
-    if (Tcl_GetDoubleFromObj(interp, objv[2], &lat) != TCL_OK)
+    if (a != objc - 1)
     {
+        Tcl_WrongNumArgs(interp, 2, objv, 
+                         "?-latlong? ?-tolerance tol? polys");
         return TCL_ERROR;
     }
 
-    if (Tcl_GetDoubleFromObj(interp, objv[3], &lon) != TCL_OK)
+    /* NEXT, get the polygons, and count their edges. */
+    if (Tcl_ListObjGetElements(interp, objv[a], &polyc, &polyv) != TCL_OK)
     {
         return TCL_ERROR;
     }
 
-    double dist = spheredist(lat, lon, info->poleLat, info->poleLon);
+    Polygon** polys = (Polygon**)scratchAlloc(scratch, 
+                                              polyc * sizeof(Polygon*));
+    int       nedges = 0;
 
-    Tcl_Obj* result = Tcl_GetObjResult(interp);
-    Tcl_SetDoubleObj(result, dist);
+    for (i = 0; i < polyc; i++)
+    {
+        if (getPolygon(interp, info, polyv[i], &polys[i]) != TCL_OK)
+        {
+            return TCL_ERROR;
+        }
+
+        nedges += polys[i]->size;
+    }
+
+    /* NEXT, list the edges in sweep order. */
+    AdjEdge* edges = (AdjEdge*)scratchAlloc(scratch, 
+                                            nedges * sizeof(AdjEdge));
+    AdjEdge* e     = edges;
+
+    for (i = 0; i < polyc; i++)
+    {
+        Polygon* poly = polys[i];
+
+        for (k = 0; k < poly->size; k++, e++)
+        {
+            e->poly = i;
+            e->p1   = &poly->pts[k];
+            e->p2   = &poly->pts[k + 1];
+            e->xmin = dmin(e->p1->x, e->p2->x);
+            e->xmax = dmax(e->p1->x, e->p2->x);
+            e->ymin = dmin(e->p1->y, e->p2->y);
+            e->ymax = dmax(e->p1->y, e->p2->y);
+        }
+    }
+
+    qsort(edges, nedges, sizeof(AdjEdge), compareAdjEdges);
+
+    /* NEXT, sweep.  active holds the indices of the edges whose X
+     * extents reach the current edge; the pairs found so far are
+     * indexed by i*polyc + j. */
+    int*          active  = (int*)scratchAlloc(scratch, nedges * sizeof(int));
+    int           nactive = 0;
+    AdjPair*      pairs   = NULL;
+    int           npairs  = 0;
+    int           maxPairs = 0;
+    Tcl_HashTable pairIndex;
+
+    Tcl_InitHashTable(&pairIndex, TCL_ONE_WORD_KEYS);
+
+    for (k = 0; k < nedges; k++)
+    {
+        AdjEdge* ek = &edges[k];
+        int      n  = 0;
+        int      m;
+
+        for (m = 0; m < nactive; m++)
+        {
+            AdjEdge* em = &edges[active[m]];
+            double   border = 0.0;
+
+            /* Drop the edges the sweep has passed. */
+            if (em->xmax + tol < ek->xmin)
+            {
+                continue;
+            }
+
+            active[n++] = active[m];
+
+            if (em->poly == ek->poly ||
+                em->ymax + tol < ek->ymin || ek->ymax + tol < em->ymin ||
+                !edgeContact(em->p1, em->p2, ek->p1, ek->p2, tol, latlong,
+                             &border))
+            {
+                continue;
+            }
+
+            /* The polygons are adjacent; accumulate the border. */
+            int            pi1   = (em->poly < ek->poly) ? em->poly : ek->poly;
+            int            pi2   = (em->poly < ek->poly) ? ek->poly : em->poly;
+            int            isNew;
+            Tcl_HashEntry* entry = Tcl_CreateHashEntry(&pairIndex,
+                (char*)((size_t)pi1*polyc + pi2), &isNew);
+
+            if (isNew)
+            {
+                if (npairs == maxPairs)
+                {
+                    maxPairs = 2*maxPairs + 16;
+                    pairs = (AdjPair*)Tcl_Realloc((char*)pairs,
+                                                  maxPairs * sizeof(AdjPair));
+                }
+
+                pairs[npairs].i      = pi1;
+                pairs[npairs].j      = pi2;
+                pairs[npairs].border = 0.0;
+                Tcl_SetHashValue(entry, (ClientData)(size_t)npairs);
+                npairs++;
+            }
+
+            pairs[(size_t)Tcl_GetHashValue(entry)].border += border;
+        }
+
+        nactive = n;
+        active[nactive++] = k;
+    }
+
+    Tcl_DeleteHashTable(&pairIndex);
+
+    /* NEXT, compute the centroid distances, and build the result. */
+    Tcl_Obj** result = (Tcl_Obj**)scratchAlloc(scratch, 
+                                           4*npairs * sizeof(Tcl_Obj*));
+
+    if (npairs > 0)
+    {
+        qsort(pairs, npairs, sizeof(AdjPair), compareAdjPairs);
+    }
+
+    for (k = 0; k < npairs; k++)
+    {
+        Point  ci;
+        Point  cj;
+        double dist;
+
+        centroid(polys[pairs[k].i], &ci);
+        centroid(polys[pairs[k].j], &cj);
+
+        if (latlong)
+        {
+            dist = spheredist(ci.x, ci.y, cj.x, cj.y);
+        }
+        else
+        {
+            dist = hypot(cj.x - ci.x, cj.y - ci.y);
+        }
+
+        result[4*k]     = Tcl_NewIntObj(pairs[k].i);
+        result[4*k + 1] = Tcl_NewIntObj(pairs[k].j);
+        result[4*k + 2] = Tcl_NewDoubleObj(pairs[k].border);
+        result[4*k + 3] = Tcl_NewDoubleObj(dist);
+    }
+
+    Tcl_SetObjResult(interp, Tcl_NewListObj(4*npairs, result));
+
+    if (pairs != NULL)
+    {
+        Tcl_Free((char*)pairs);
+    }
 
     return TCL_OK;
 }
 
+/*
+ * geoindex command and subcommands
+ */
+
 /***********************************************************************
  *
  * FUNCTION:
- *	latlong validate loc
+ *	marsutil_geoindexCmd()
  *
  * INPUTS:
- *	loc		A lat/long pair in decimal degrees
+ *	subcommand		The subcommand name
+ *      args                    Subcommand arguments
  *
  * RETURNS:
- *	Nothing.
+ *	Whatever the subcommand returns.
  *
  * DESCRIPTION:
- *	Validates a lat/long pair.
+ *	This is the ensemble command for the geoindex subcommands.
+ *      It looks up the subcommand name, and
+ *      then passes execution to the subcommand proc.
  */
 
 static int 
-latlong_validate(ClientData cd, Tcl_Interp *interp, 
-                 int objc, Tcl_Obj* CONST objv[])
+marsutil_geoindexCmd(ClientData cd, Tcl_Interp* interp, 
+                     int objc, Tcl_Obj* CONST objv[])
 {
-    if (objc != 3) {
-        Tcl_WrongNumArgs(interp, 2, objv, "loc");
+    if (objc < 2) 
+    {
+        Tcl_WrongNumArgs(interp, 1, objv, "subcommand ?arg arg ...?");
         return TCL_ERROR;
-    }
+    } 
 
-    double lat;
-    double lon;
+    resetScratch(&((PolygonInfo*)cd)->scratch);
 
-    if (getLatLong(interp, objv[2], &lat, &lon) != TCL_OK)
-    {
-        return TCL_ERROR;
-    }
+    int index = 0;
 
-    if (validateLatLong(interp, lat, lon) != TCL_OK)
+    if (Tcl_GetIndexFromObjStruct(interp, objv[1], 
+                                  geoindexTable, sizeof(SubcommandVector),
+                                  "subcommand",
+                                  TCL_EXACT,
+                                  &index) != TCL_OK)
     {
         return TCL_ERROR;
     }
 
-    /* NEXT, return lat and lon. */
-    Tcl_Obj* result = Tcl_GetObjResult(interp);
-    Tcl_ListObjAppendElement(interp, result, Tcl_NewDoubleObj(lat));
-    Tcl_ListObjAppendElement(interp, result, Tcl_NewDoubleObj(lon));
-
-    return TCL_OK;
+    return (*geoindexTable[index].proc)(cd, interp, objc, objv);
 }
 
 /***********************************************************************
  *
  * FUNCTION:
- *	latlong area coords
+ *	geoindex create
  *
  * INPUTS:
- *	coords	A list of lat/long coordinates in decimal degrees.
+ *	none
  *
  * RETURNS:
- *      Given a polygon expressed as 3 or more lat/long coordinate pairs,
- *      computes the area of the polygon in square kilometers.  See 
- *      lib/util/latlong.tcl for a discussion of the algorithm and its
- *      assumptions and limitations.
+ *	A new, empty geoindex handle
  */
 
 static int 
-latlong_area(ClientData cd, Tcl_Interp *interp, 
-             int objc, Tcl_Obj* CONST objv[])
+geoindex_create(ClientData cd, Tcl_Interp *interp, 
+                int objc, Tcl_Obj* CONST objv[])
 {
-    LatlongInfo* info = (LatlongInfo*)cd;
-    int          i;
-    double       area;
-    Tcl_Obj*     result;
+    PolygonInfo*   info = (PolygonInfo*)cd;
+    Tcl_HashEntry* entry;
+    int            isNew;
+    char           name[40];
 
-    if (objc != 3) {
-        Tcl_WrongNumArgs(interp, 2, objv, "coords");
-        return TCL_ERROR;
-    }
-
-    /* FIRST, get the points. */
-    if (getPoints(interp, objv[2], 3, info->pointsBuffer) != TCL_OK)
-    {
+    if (objc != 2) {
+        Tcl_WrongNumArgs(interp, 2, objv, "");
         return TCL_ERROR;
     }
 
-    /* NEXT, ensure that all pairs are valid */
-    for (i = 0; i < info->pointsBuffer->size; i++) {
-        if (validateLatLong(interp, 
-                            info->pointsBuffer->pts[i].x,
-                            info->pointsBuffer->pts[i].y) != TCL_OK)
-        {
-            return TCL_ERROR;
-        }
-    }
+    sprintf(name, "geoindex%d", ++info->indexCounter);
+    entry = Tcl_CreateHashEntry(&info->indices, name, &isNew);
+    Tcl_SetHashValue(entry, newGeoIndex());
 
-    area = ll_area(info->pointsBuffer);
-
-    result = Tcl_GetObjResult(interp);
-    Tcl_SetDoubleObj(result, area);
+    Tcl_SetResult(interp, name, TCL_VOLATILE);
 
     return TCL_OK;
 }
@@ -1224,48 +2395,38 @@ latlong_area(ClientData cd, Tcl_Interp *interp,
 /***********************************************************************
  *
  * FUNCTION:
- *	latlong spheroid ?name?
+ *	geoindex delete index
  *
  * INPUTS:
- *	name          The name of the spheroid.
+ *	index		A geoindex handle
  *
  * RETURNS:
- *      The name of the current spheroid.
+ *	Nothing.
  *
  * DESCRIPTION:
- *	Sets/gets the name of the current spheroid.
+ *	Deletes the index, releasing its polygons.
  */
 
 static int 
-latlong_spheroid(ClientData cd, Tcl_Interp *interp, 
+geoindex_delete(ClientData cd, Tcl_Interp *interp, 
                 int objc, Tcl_Obj* CONST objv[])
 {
-    LatlongInfo* info = (LatlongInfo*)cd;
+    PolygonInfo*   info = (PolygonInfo*)cd;
+    GeoIndex*      gi;
 
-    if (objc < 2 || objc > 3) 
-    {
-        Tcl_WrongNumArgs(interp, 2, objv, "?name");
+    if (objc != 3) {
+        Tcl_WrongNumArgs(interp, 2, objv, "index");
         return TCL_ERROR;
     }
 
-    if (objc == 3)
+    if (getGeoIndex(interp, info, objv[2], &gi) != TCL_OK)
     {
-        int index;
-
-        if (Tcl_GetIndexFromObjStruct(interp, objv[2], 
-                                      ellipsoidTable, sizeof(Ellipsoid),
-                                      "name",
-                                      TCL_EXACT,
-                                      &index) != TCL_OK)
-        {
-            return TCL_ERROR;
-        }
-
-        info->spheroid = index;
-        setEllipsoidData(info);
+        return TCL_ERROR;
     }
 
-    Tcl_SetResult(interp, ellipsoidTable[info->spheroid].code, TCL_STATIC);
+    Tcl_DeleteHashEntry(
+        Tcl_FindHashEntry(&info->indices, Tcl_GetString(objv[2])));
+    deleteGeoIndex(gi);
 
     return TCL_OK;
 }
@@ -1273,221 +2434,130 @@ latlong_spheroid(ClientData cd, Tcl_Interp *interp,
 /***********************************************************************
  *
  * FUNCTION:
- *	latlong tomgrs loc ?precision?
+ *	geoindex add index id poly
  *
  * INPUTS:
- *	loc          A location as a lat/long pair in decimal degrees.
- *      precision    The number of digits of each of easting and northing.
- *                   5 gives one-meter accuracy, 3 gives hundred-meter
- *                   accuracy; 1 gives 10km accuracy.
+ *	index		A geoindex handle
+ *      id		An item ID, unique within the index
+ *      poly		A polygon handle
  *
  * RETURNS:
- *      The MGRS coordination string.
+ *	Nothing.
  *
  * DESCRIPTION:
- *	Computes and returns the MGRS coordinate string associated with
- *      the location.  Takes into account the spheroid.
+ *	Adds the polygon to the index as the uppermost polygon.  The 
+ *      index keeps its own reference to the compiled polygon, so it
+ *      remains valid even if the handle is later deleted.
  */
 
 static int 
-latlong_tomgrs(ClientData cd, Tcl_Interp *interp, 
-            int objc, Tcl_Obj* CONST objv[])
+geoindex_add(ClientData cd, Tcl_Interp *interp, 
+             int objc, Tcl_Obj* CONST objv[])
 {
-    LatlongInfo* info = (LatlongInfo*)cd;
-    double lat;
-    double lon;
-    double latRadians;
-    double lonRadians;
-    int    precision;
-    long   result;
-    char   mgrsString[20];
-    char   errBuf[80];
+    PolygonInfo*   info = (PolygonInfo*)cd;
+    GeoIndex*      gi;
+    Polygon*       poly;
+    Tcl_HashEntry* entry;
+    int            isNew;
 
-
-    if (objc < 3 || objc > 4) 
-    {
-        Tcl_WrongNumArgs(interp, 2, objv, "loc ?precision?");
+    if (objc != 5) {
+        Tcl_WrongNumArgs(interp, 2, objv, "index id poly");
         return TCL_ERROR;
     }
 
-    /* FIRST, get loc, and convert to radians */
-
-    if (getLatLong(interp, objv[2], &lat, &lon) != TCL_OK)
+    if (getGeoIndex(interp, info, objv[2], &gi) != TCL_OK)
     {
         return TCL_ERROR;
     }
 
-    latRadians = lat * radians;
-    lonRadians = lon * radians;
-
-    /* NEXT, get the precision */
-    precision = PRECISION_DEFAULT;
-
-    if (objc == 4)
+    if (getPolygon(interp, info, objv[4], &poly) != TCL_OK)
     {
-
-        if (Tcl_GetIntFromObj(interp, objv[3], &precision) != TCL_OK)
-        {
-            return TCL_ERROR;
-        }
+        return TCL_ERROR;
     }
 
-    /* NEXT, set the ellipsoid parameters */
-    result = 
-        Set_MGRS_Parameters(
-            ellipsoidTable[info->spheroid].semi_major_axis,
-            1.0 / ellipsoidTable[info->spheroid].inv_flattening,
-            ellipsoidTable[info->spheroid].code);
+    entry = Tcl_CreateHashEntry(&gi->ids, Tcl_GetString(objv[3]), &isNew);
 
-    if (result != MGRS_NO_ERROR)
+    if (!isNew)
     {
-        printf("code     %ld\n", 
-               result);
-        printf("spheroid %d\n",  
-               info->spheroid);
-        printf("sm axis  %f\n", 
-               ellipsoidTable[info->spheroid].semi_major_axis);
-        printf("inv flat  %f\n", 
-              ellipsoidTable[info->spheroid].inv_flattening);
-
-        Tcl_SetResult(interp, "flawed ellipsoid definition", TCL_STATIC);
+        Tcl_AppendStringsToObj(Tcl_GetObjResult(interp), 
+                               "item already in index: \"", 
+                               Tcl_GetString(objv[3]), "\"", NULL);
         return TCL_ERROR;
     }
 
-    /* NEXT, Convert our lat/long to an MGRS_String, and handle errors. */
-    result = 
-        Convert_Geodetic_To_MGRS(latRadians, lonRadians, precision, 
-                                 mgrsString);
-
-    if (result == MGRS_NO_ERROR)
+    /* NEXT, append the entry. */
+    if (gi->size == gi->maxSize)
     {
-        Tcl_SetResult(interp, mgrsString, TCL_VOLATILE);
-        return TCL_OK;
+        gi->maxSize = (gi->maxSize == 0) ? 16 : 2*gi->maxSize;
+        gi->entries = (GeoIndexEntry*)
+            Tcl_Realloc((char*)gi->entries, 
+                        gi->maxSize * sizeof(GeoIndexEntry));
     }
 
-    if (result & MGRS_LAT_ERROR) {
-        sprintf(errBuf,
-                "Invalid latitude, should be -90.0 to 90.0 degrees: \"%g\"",
-                lat);
-    } 
-    else if (result & MGRS_LON_ERROR) 
-    {
-        sprintf(errBuf,
-                "Invalid longitude, should be -180.0 to 360.0 degrees: \"%g\"",
-                lon);
-    } 
-    else if (result & MGRS_PRECISION_ERROR) 
-    {
-        sprintf(errBuf, "Invalid precision, should be 0 to 5: \"%d\"",
-                precision);
-    } 
-    else 
-    {
-        sprintf(errBuf, "unexpected error return: %ld", result);
-        
-    }
+    gi->entries[gi->size].id   = objv[3];
+    gi->entries[gi->size].poly = poly;
+    Tcl_IncrRefCount(gi->entries[gi->size].id);
+    poly->refCount++;
 
-    Tcl_SetResult(interp, errBuf, TCL_VOLATILE);
+    Tcl_SetHashValue(entry, (ClientData)(long)gi->size);
+    gi->size++;
+    gi->dirty = 1;
 
-    return TCL_ERROR;
+    return TCL_OK;
 }
 
 /***********************************************************************
  *
  * FUNCTION:
- *	latlong frommgrs utm
+ *	geoindex remove index id
  *
  * INPUTS:
- *	utm          A location as a UTM (MGRS) string.
+ *	index		A geoindex handle
+ *      id		An item ID
  *
  * RETURNS:
- *      The lat/long coordinates in decimal degrees.
+ *	Nothing.
  *
  * DESCRIPTION:
- *	Computes and returns the lat/long coordinates corresponding
- *      to the MGRS string.  Takes into account the spheroid.
+ *	Removes the item from the index, if it's present.
  */
 
 static int 
-latlong_frommgrs(ClientData cd, Tcl_Interp *interp, 
-            int objc, Tcl_Obj* CONST objv[])
+geoindex_remove(ClientData cd, Tcl_Interp *interp, 
+                int objc, Tcl_Obj* CONST objv[])
 {
-    LatlongInfo* info = (LatlongInfo*)cd;
-    char*        mgrsString;
-    long         result;
-    double       lat;
-    double       lon;
-    Tcl_Obj*     pair;
+    PolygonInfo*   info = (PolygonInfo*)cd;
+    GeoIndex*      gi;
+    GeoIndexEntry* e;
+    Tcl_HashEntry* entry;
 
-    if (objc != 3) 
-    {
-        Tcl_WrongNumArgs(interp, 2, objv, "utm");
+    if (objc != 4) {
+        Tcl_WrongNumArgs(interp, 2, objv, "index id");
         return TCL_ERROR;
     }
 
-    /* NEXT, get the UTM string */
-    mgrsString = Tcl_GetStringFromObj(objv[2], NULL);
-
-    /* NEXT, set the ellipsoid parameters 
-     * TBD: Refactor into a separate routine; call at startup and
-     * when the spheroid changes. */
-    result = 
-        Set_MGRS_Parameters(
-            ellipsoidTable[info->spheroid].semi_major_axis,
-            1.0 / ellipsoidTable[info->spheroid].inv_flattening,
-            ellipsoidTable[info->spheroid].code);
-
-    if (result != MGRS_NO_ERROR)
+    if (getGeoIndex(interp, info, objv[2], &gi) != TCL_OK)
     {
-        printf("code     %ld\n", 
-               result);
-        printf("spheroid %d\n",  
-               info->spheroid);
-        printf("sm axis  %f\n", 
-               ellipsoidTable[info->spheroid].semi_major_axis);
-        printf("inv flat  %f\n", 
-              ellipsoidTable[info->spheroid].inv_flattening);
-
-        Tcl_SetResult(interp, "flawed ellipsoid definition", TCL_STATIC);
         return TCL_ERROR;
     }
 
-    /* NEXT, Convert our MGRS_String to a lat/long, and handle errors. */
-
-    result = 
-        Convert_MGRS_To_Geodetic(mgrsString, &lat, &lon);
+    entry = Tcl_FindHashEntry(&gi->ids, Tcl_GetString(objv[3]));
 
-    if (result != MGRS_NO_ERROR)
+    if (entry == NULL)
     {
-        char errBuf[80];
-
-        /* NOTE: The Geotrans documentation says that the constant 
-         * is MGRS_STR_ERROR; the source code defines MGRS_STRING_ERROR. */
-        if (result & MGRS_STRING_ERROR) {
-            sprintf(errBuf,
-                    "Invalid MGRS string: \"%s\"",
-                    mgrsString);
-        } 
-        else 
-        {
-            sprintf(errBuf, "unexpected error return: %ld", result);
-            
-        }
-
-        Tcl_SetResult(interp, errBuf, TCL_VOLATILE);
-
-        return TCL_ERROR;
+        return TCL_OK;
     }
 
-    /* NEXT, convert lat/long to decimal degrees and return the result. */
-    lat /= radians;
-    lon /= radians;
+    e = &gi->entries[(long)Tcl_GetHashValue(entry)];
+    Tcl_DeleteHashEntry(entry);
 
+    Tcl_DecrRefCount(e->id);
+    releasePolygon(e->poly);
+    e->id   = NULL;
+    e->poly = NULL;
 
-    /* TBD: refactor returning a lat/long pair? */
-    pair = Tcl_GetObjResult(interp);
-    Tcl_ListObjAppendElement(interp, pair, Tcl_NewDoubleObj(lat));
-    Tcl_ListObjAppendElement(interp, pair, Tcl_NewDoubleObj(lon));
+    gi->removed++;
+    gi->dirty = 1;
 
     return TCL_OK;
 }
@@ -1495,58 +2565,47 @@ latlong_frommgrs(ClientData cd, Tcl_Interp *interp,
 /***********************************************************************
  *
  * FUNCTION:
- *	latlong togcc loc 
+ *	geoindex find index point
  *
  * INPUTS:
- *	loc          A location as a lat/long pair in decimal degrees.
+ *	index		A geoindex handle
+ *      point		A point
  *
  * RETURNS:
- *      The GCC coordinates in decimal meters as a three-element list.
- *
- * DESCRIPTION:
- *	Computes and returns the GCC coordinates associated with
- *      the lat/lon location.  Elevation is assumed to be 0.
+ *	The ID of the uppermost (i.e., last added) polygon which 
+ *      contains the point, or "".
  */
 
 static int 
-latlong_togcc(ClientData cd, Tcl_Interp *interp, 
+geoindex_find(ClientData cd, Tcl_Interp *interp, 
               int objc, Tcl_Obj* CONST objv[])
 {
-    double lat;
-    double lon;
-    double hgt = 0.0;
-    double efg[3];
-    Tcl_Obj*     xyz;
+    PolygonInfo*   info = (PolygonInfo*)cd;
+    GeoIndex*      gi;
+    GeoIndexEntry* e;
+    Point          p;
 
-    if (objc != 3) 
-    {
-        Tcl_WrongNumArgs(interp, 2, objv, "loc");
+    if (objc != 4) {
+        Tcl_WrongNumArgs(interp, 2, objv, "index point");
         return TCL_ERROR;
     }
 
-    /* FIRST, get loc, and validate */
-    if (getLatLong(interp, objv[2], &lat, &lon) != TCL_OK)
+    if (getGeoIndex(interp, info, objv[2], &gi) != TCL_OK)
     {
         return TCL_ERROR;
     }
 
-    if (validateLatLong(interp, lat, lon) != TCL_OK)
+    if (getPoint(interp, objv[3], &p) != TCL_OK)
     {
         return TCL_ERROR;
     }
 
-    /* NEXT, convert lat/long to radians */
-    lat *= radians;
-    lon *= radians;
+    e = findGeoIndex(gi, &p);
 
-    geoLlh2EfgOpt(lat, lon, hgt, &ellipsoidData, 
-                  &efg[GEO_E], &efg[GEO_F], &efg[GEO_G]);
-        
-    /* NEXT, return X, Y and Z as a list */
-    xyz = Tcl_GetObjResult(interp);
-    Tcl_ListObjAppendElement(interp, xyz, Tcl_NewDoubleObj(efg[GEO_E]));
-    Tcl_ListObjAppendElement(interp, xyz, Tcl_NewDoubleObj(efg[GEO_F]));
-    Tcl_ListObjAppendElement(interp, xyz, Tcl_NewDoubleObj(efg[GEO_G]));
+    if (e != NULL)
+    {
+        Tcl_SetObjResult(interp, e->id);
+    }
 
     return TCL_OK;
 }
@@ -1554,98 +2613,75 @@ latlong_togcc(ClientData cd, Tcl_Interp *interp,
 /***********************************************************************
  *
  * FUNCTION:
- *	latlong fromgcc gcc
+ *	geoindex size index
  *
  * INPUTS:
- *	gcc          A GCC location as three decimal meter values 
+ *	index		A geoindex handle
  *
  * RETURNS:
- *      The lat/long coordinates in decimal degrees.
- *
- * DESCRIPTION:
- *	Computes and returns the lat/long coordinates corresponding
- *      to the GCC coordinates. 
+ *	The number of polygons in the index.
  */
 
 static int 
-latlong_fromgcc(ClientData cd, Tcl_Interp *interp, 
-                int objc, Tcl_Obj* CONST objv[])
+geoindex_size(ClientData cd, Tcl_Interp *interp, 
+              int objc, Tcl_Obj* CONST objv[])
 {
-    double   lat;
-    double   lon;
-    double   hgt;
-    double   efg[3];
-    Tcl_Obj* pair;
+    PolygonInfo*   info = (PolygonInfo*)cd;
+    GeoIndex*      gi;
 
-    if (objc != 3) 
-    {
-        Tcl_WrongNumArgs(interp, 2, objv, "gcc");
+    if (objc != 3) {
+        Tcl_WrongNumArgs(interp, 2, objv, "index");
         return TCL_ERROR;
     }
 
-    /* NEXT, get the GCC coordinates */
-    if (getGcc(interp, objv[2], &efg[GEO_E], &efg[GEO_F], &efg[GEO_G]) 
-        != TCL_OK)
+    if (getGeoIndex(interp, info, objv[2], &gi) != TCL_OK)
     {
         return TCL_ERROR;
     }
 
-    /* NEXT, avoid problems for values on the pole */
-    if (abs(efg[GEO_E]) < 1.0e-10)
-    {
-        efg[GEO_E] = 1.0e-10;
-    }
-
-    geoEfg2LlhOpt(&ellipsoidData, efg,&lat,&lon,&hgt);
-
-    /* NEXT, convert lat/long to decimal degrees and return the result. */
-    lat /= radians;
-    lon /= radians;
-
-    pair = Tcl_GetObjResult(interp);
-    Tcl_ListObjAppendElement(interp, pair, Tcl_NewDoubleObj(lat));
-    Tcl_ListObjAppendElement(interp, pair, Tcl_NewDoubleObj(lon));
+    Tcl_SetIntObj(Tcl_GetObjResult(interp), gi->size - gi->removed);
 
     return TCL_OK;
 }
 
 /*
- * geotiff command and subcommands
+ * latlong command and subcommands
  */
 
 /***********************************************************************
- * 
- * FUNCTION :
- *     marsutil_geotiffCmd()
+ *
+ * FUNCTION:
+ *	marsutil_latlongCmd()
  *
  * INPUTS:
- *     subcommand        The subcommand name
- *     args              Subcommand arguments
+ *	subcommand		The subcommand name
+ *      args                    Subcommand arguments
  *
  * RETURNS:
- *     Whatever the subcommand returns.
+ *	Whatever the subcommand returns.
  *
  * DESCRIPTION:
- *     This is the ensemble command for the geotiff subcommands.
- *     It looks up the subcommand name, and then passes execution
- *     to the subcommand proc.
- *
+ *	This is the ensemble command for the latlong subcommands.
+ *      It looks up the subcommand name, and
+ *      then passes execution to the subcommand proc.
  */
 
-static int
-marsutil_geotiffCmd(ClientData cd, Tcl_Interp* interp,
+static int 
+marsutil_latlongCmd(ClientData cd, Tcl_Interp* interp, 
                    int objc, Tcl_Obj* CONST objv[])
 {
-    if (objc < 2)
+    if (objc < 2) 
     {
         Tcl_WrongNumArgs(interp, 1, objv, "subcommand ?arg arg ...?");
         return TCL_ERROR;
-    }
+    } 
+
+    resetScratch(&((LatlongInfo*)cd)->scratch);
 
     int index = 0;
 
-    if (Tcl_GetIndexFromObjStruct(interp, objv[1],
-                                  geotiffTable, sizeof(SubcommandVector),
+    if (Tcl_GetIndexFromObjStruct(interp, objv[1], 
+                                  latlongTable, sizeof(SubcommandVector),
                                   "subcommand",
                                   TCL_EXACT,
                                   &index) != TCL_OK)
@@ -1653,623 +2689,9507 @@ marsutil_geotiffCmd(ClientData cd, Tcl_Interp* interp,
         return TCL_ERROR;
     }
 
-    return(*geotiffTable[index].proc)(cd, interp, objc, objv);
+    return (*latlongTable[index].proc)(cd, interp, objc, objv);
 }
 
+            
+
+
+
 /***********************************************************************
- * 
- * FUNCTION :
- *     geotiff read filename
+ *
+ * FUNCTION:
+ *	latlong dist loc1 loc2
  *
  * INPUTS:
- *     filename - the name of a GeoTIFF file to read
+ *	loc1		A lat/long pair in decimal degrees
+ *      loc2            A lat/long pair in decimal degrees
  *
  * RETURNS:
- *     Projection information to be used in geo-referencing the
- *     map image contained within the GeoTIFF
+ *	The distance between loc1 and loc2 in kilometers.
  *
  * DESCRIPTION:
- *     Opens a TIFF file and reads the appropriate geokeys and values
- *     from the Geo information embedded in the TIFF. If this file is
- *     not a TIFF or if the appropriate Geo information is not in it
- *     an appropriate error message is returned.
+ *	Computes the distance between the two points and returns
+ *      an answer in kilometers.  The algorithm is equivalent to
+ *      that used in CBS.
  *
+ *      This function is documented in marsutil(n).
  */
 
-static int
-geotiff_read(ClientData cd, Tcl_Interp *interp,
+static int 
+latlong_dist(ClientData cd, Tcl_Interp *interp, 
              int objc, Tcl_Obj* CONST objv[])
 {
-    double    *d_list = NULL;
-    uint16    d_list_count;
-    ttag_t    field;
-    geocode_t code;
-    geokey_t  key;
-    Tcl_Obj   *result = NULL;
-
-    GeotiffInfo* info = (GeotiffInfo*)cd;
-
-    if (objc != 3) {
-        Tcl_WrongNumArgs(interp, 2, objv, "filename");
+    if (objc != 4) {
+        Tcl_WrongNumArgs(interp, 2, objv, "loc1 loc2");
         return TCL_ERROR;
     }
 
-    FILE* f;
-    char* fname = Tcl_GetStringFromObj(objv[2], NULL);
+    /* FIRST, get loc1 and loc2 */
+    double lat1 = 0.0;
+    double lon1 = 0.0;
 
-    /* See if the file exists */
-    if ((f = fopen(fname, "r")) == NULL)
+    if (getLatLong(interp, objv[2], &lat1, &lon1) != TCL_OK)
     {
-        Tcl_SetResult(interp, "file does not exist", TCL_STATIC);
         return TCL_ERROR;
     }
 
-    fclose(f);
+    double lat2 = 0.0;
+    double lon2 = 0.0;
+
+    if (getLatLong(interp, objv[3], &lat2, &lon2) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
+
+    /* NEXT, convert points to radians */
+    double dist = spheredist(lat1, lon1, lat2, lon2);
+
+    Tcl_Obj* result = Tcl_GetObjResult(interp);
+    Tcl_SetDoubleObj(result, dist);
+
+    return TCL_OK;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	latlong dist4 lat1 lon1 lat2 lon2
+ *
+ * INPUTS:
+ *	lat1		Latitude  1 in decimal degrees
+ *      lon1            Longitude 1 in decimal degrees
+ *	lat2		Latitude  2 in decimal degrees
+ *      lon2            Longitude 2 in decimal degrees
+ *
+ * RETURNS:
+ *	The distance between lat1,lon1 and lat2,lon2 in kilometers.
+ *
+ * DESCRIPTION:
+ *	Computes the distance between the two points and returns
+ *      an answer in kilometers.  The algorithm is equivalent to
+ *      that used in CBS.
+ *
+ *      This function is documented in marsutil(n).
+ */
+
+static int 
+latlong_dist4(ClientData cd, Tcl_Interp *interp, 
+             int objc, Tcl_Obj* CONST objv[])
+{
+    if (objc != 6) {
+        Tcl_WrongNumArgs(interp, 2, objv, "lat1 lon1 lat2 lon2");
+        return TCL_ERROR;
+    }
+
+    /* FIRST, get the lat/lon values */
+    double lat1 = 0.0;
+    double lon1 = 0.0;
+    double lat2 = 0.0;
+    double lon2 = 0.0;
+
+    if (Tcl_GetDoubleFromObj(interp, objv[2], &lat1) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
+
+    if (Tcl_GetDoubleFromObj(interp, objv[3], &lon1) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
+
+    if (Tcl_GetDoubleFromObj(interp, objv[4], &lat2) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
+
+    if (Tcl_GetDoubleFromObj(interp, objv[5], &lon2) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
+
+    /* NEXT, convert points to radians */
+    double dist = spheredist(lat1, lon1, lat2, lon2);
+
+    Tcl_Obj* result = Tcl_GetObjResult(interp);
+    Tcl_SetDoubleObj(result, dist);
+
+    return TCL_OK;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	latlong distlist ?-bytes? origin locs
+ *
+ * INPUTS:
+ *	origin		A lat/long pair in decimal degrees
+ *      locs            A flat list of lat/long coordinates in decimal
+ *                      degrees, lat1 lon1 lat2 lon2 ...
+ *
+ * RETURNS:
+ *	A list of the distances in kilometers from origin to each
+ *      location in locs, or with -bytes, a byte array of native doubles.
+ *
+ * DESCRIPTION:
+ *	Computes the distances with spheredistRow(); each distance is
+ *      identical to the result of "latlong dist origin loc".
+ */
+
+static int 
+latlong_distlist(ClientData cd, Tcl_Interp *interp, 
+                 int objc, Tcl_Obj* CONST objv[])
+{
+    LatlongInfo* info    = (LatlongInfo*)cd;
+    int          asBytes = 0;
+    int          a       = 2;
+
+    /* FIRST, check for -bytes. */
+    if (objc > 2 && isFlag(objv[2], "-bytes"))
+    {
+        asBytes = 1;
+        a++;
+    }
+
+    if (objc - a != 2) {
+        Tcl_WrongNumArgs(interp, 2, objv, "?-bytes? origin locs");
+        return TCL_ERROR;
+    }
+
+    /* NEXT, get the origin and the locations */
+    double lat = 0.0;
+    double lon = 0.0;
+
+    if (getLatLong(interp, objv[a], &lat, &lon) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
+
+    int     n;
+    double* locs = getLocArrays(interp, info, objv[a + 1], &n);
+
+    if (locs == NULL)
+    {
+        return TCL_ERROR;
+    }
+
+    /* NEXT, compute the distances */
+    double* dist = (double*)scratchAlloc(&info->scratch, n * sizeof(double));
+
+    lat *= radians;
+    lon *= radians;
+
+    spheredistRow(lat, lon, cos(lat), n, locs, locs + n, locs + 2*n, dist);
+
+    setDoublesResult(interp, &info->scratch, dist, n, asBytes);
+
+    return TCL_OK;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	latlong distmatrix ?-bytes? locs1 ?locs2?
+ *
+ * INPUTS:
+ *      locs1           A flat list of lat/long coordinates in decimal
+ *                      degrees, lat1 lon1 lat2 lon2 ...
+ *      locs2           Another such list; defaults to locs1.
+ *
+ * RETURNS:
+ *	The N x M matrix of distances in kilometers from each location 
+ *      in locs1 to each location in locs2, as a flat list in row
+ *      major order, or with -bytes, a byte array of native doubles.
+ *
+ * DESCRIPTION:
+ *	Computes the distances one row at a time with spheredistRow();
+ *      each distance is identical to the result of "latlong dist".
+ *      If locs2 is omitted the matrix is symmetric, so only the
+ *      upper triangle is computed.  A matrix of more than 
+ *      MAX_DISTANCES distances won't fit in a list or byte array, 
+ *      and is an error.
+ */
+
+static int 
+latlong_distmatrix(ClientData cd, Tcl_Interp *interp, 
+                   int objc, Tcl_Obj* CONST objv[])
+{
+    LatlongInfo* info    = (LatlongInfo*)cd;
+    int          asBytes = 0;
+    int          a       = 2;
+    int          i;
+    int          j;
+
+    /* FIRST, check for -bytes. */
+    if (objc > 2 && isFlag(objv[2], "-bytes"))
+    {
+        asBytes = 1;
+        a++;
+    }
+
+    if (objc - a < 1 || objc - a > 2) {
+        Tcl_WrongNumArgs(interp, 2, objv, "?-bytes? locs1 ?locs2?");
+        return TCL_ERROR;
+    }
+
+    /* NEXT, get the locations */
+    int     n;
+    int     m;
+    double* locs1 = getLocArrays(interp, info, objv[a], &n);
+    double* locs2 = NULL;
+
+    if (locs1 == NULL)
+    {
+        return TCL_ERROR;
+    }
+
+    if (objc - a == 2)
+    {
+        locs2 = getLocArrays(interp, info, objv[a + 1], &m);
+
+        if (locs2 == NULL)
+        {
+            return TCL_ERROR;
+        }
+    }
+    else
+    {
+        m = n;
+    }
+
+    /* NEXT, make sure the result will fit. */
+    Tcl_WideInt ndist = (Tcl_WideInt)n * m;
+
+    if (ndist > MAX_DISTANCES)
+    {
+        Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+            "distance matrix too large: %d x %d, at most %d distances", 
+            n, m, MAX_DISTANCES));
+        return TCL_ERROR;
+    }
+
+    /* NEXT, compute the distances */
+    double* dist = (double*)scratchAlloc(&info->scratch, 
+                                         (size_t)ndist * sizeof(double));
+
+    if (locs2 != NULL)
+    {
+        for (i = 0; i < n; i++)
+        {
+            spheredistRow(locs1[i], locs1[n + i], locs1[2*n + i], 
+                          m, locs2, locs2 + m, locs2 + 2*m, 
+                          dist + (size_t)i*m);
+        }
+    }
+    else
+    {
+        /* Compute the upper triangle, and mirror it; the distance
+         * is symmetric. */
+        for (i = 0; i < n; i++)
+        {
+            double* row = dist + (size_t)i*n;
+
+            row[i] = 0.0;
+
+            spheredistRow(locs1[i], locs1[n + i], locs1[2*n + i], 
+                          n - i - 1, 
+                          locs1 + i + 1, locs1 + n + i + 1, 
+                          locs1 + 2*n + i + 1, 
+                          row + i + 1);
+
+            for (j = i + 1; j < n; j++)
+            {
+                dist[(size_t)j*n + i] = row[j];
+            }
+        }
+    }
+
+    setDoublesResult(interp, &info->scratch, dist, (int)ndist, asBytes);
+
+    return TCL_OK;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	latlong pole ?loc?
+ *
+ * INPUTS:
+ *	loc		A lat/long pair in decimal degrees
+ *
+ * RETURNS:
+ *	Nothing.
+ *
+ * DESCRIPTION:
+ *	Sets/gets the location as the pole for the "latlong radius" command.
+ */
+
+static int 
+latlong_pole(ClientData cd, Tcl_Interp *interp, 
+             int objc, Tcl_Obj* CONST objv[])
+{
+    LatlongInfo* info = (LatlongInfo*)cd;
+
+    if (objc < 2 || objc > 3) {
+        Tcl_WrongNumArgs(interp, 2, objv, "?loc?");
+        return TCL_ERROR;
+    }
+
+    /* FIRST, get loc, if any */
+    if (objc == 3) {
+        double lat;
+        double lon;
+
+        if (getLatLong(interp, objv[2], &lat, &lon) != TCL_OK)
+        {
+            return TCL_ERROR;
+        }
+
+        info->poleLat = lat;
+        info->poleLon = lon;
+    }
+
+    /* NEXT, return lat and lon. */
+    Tcl_Obj* result = Tcl_GetObjResult(interp);
+    Tcl_ListObjAppendElement(interp, result, Tcl_NewDoubleObj(info->poleLat));
+    Tcl_ListObjAppendElement(interp, result, Tcl_NewDoubleObj(info->poleLon));
+
+    return TCL_OK;
+}
+
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	latlong radius lat lon
+ *
+ * INPUTS:
+ *	lat		A latitude in decimal degrees
+ *	lon		A latitude in decimal degrees
+ *
+ * RETURNS:
+ *	The distance between lat/lon and the pole set with [latlong pole].
+ *
+ * DESCRIPTION:
+ *	Computes the distance between the two points using
+ *      spheredist().
+ */
+
+static int 
+latlong_radius(ClientData cd, Tcl_Interp *interp, 
+               int objc, Tcl_Obj* CONST objv[])
+{
+    LatlongInfo* info = (LatlongInfo*)cd;
+
+    if (objc != 4) {
+        Tcl_WrongNumArgs(interp, 2, objv, "lat lon");
+        return TCL_ERROR;
+    }
+
+    /* FIRST, get lat and lon */
+    double lat = 0.0;
+    double lon = 0.0;
+
+    if (Tcl_GetDoubleFromObj(interp, objv[2], &lat) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
+
+    if (Tcl_GetDoubleFromObj(interp, objv[3], &lon) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
+
+    double dist = spheredist(lat, lon, info->poleLat, info->poleLon);
+
+    Tcl_Obj* result = Tcl_GetObjResult(interp);
+    Tcl_SetDoubleObj(result, dist);
+
+    return TCL_OK;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	latlong validate loc
+ *
+ * INPUTS:
+ *	loc		A lat/long pair in decimal degrees
+ *
+ * RETURNS:
+ *	Nothing.
+ *
+ * DESCRIPTION:
+ *	Validates a lat/long pair.
+ */
+
+static int 
+latlong_validate(ClientData cd, Tcl_Interp *interp, 
+                 int objc, Tcl_Obj* CONST objv[])
+{
+    if (objc != 3) {
+        Tcl_WrongNumArgs(interp, 2, objv, "loc");
+        return TCL_ERROR;
+    }
+
+    double lat;
+    double lon;
+
+    if (getLatLong(interp, objv[2], &lat, &lon) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
+
+    if (validateLatLong(interp, lat, lon) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
+
+    /* NEXT, return lat and lon. */
+    Tcl_Obj* result = Tcl_GetObjResult(interp);
+    Tcl_ListObjAppendElement(interp, result, Tcl_NewDoubleObj(lat));
+    Tcl_ListObjAppendElement(interp, result, Tcl_NewDoubleObj(lon));
+
+    return TCL_OK;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	latlong area ?-ellipsoid? coords
+ *	latlong area -list ?-ellipsoid? polys
+ *
+ * INPUTS:
+ *	coords	A list of lat/long coordinates in decimal degrees, or
+ *              a polygon(n) handle.
+ *      polys   A list of such.
+ *
+ * RETURNS:
+ *      Given a polygon expressed as 3 or more lat/long coordinate pairs,
+ *      computes the area of the polygon in square kilometers.  See 
+ *      lib/util/latlong.tcl for a discussion of the algorithm and its
+ *      assumptions and limitations.  With -ellipsoid, the area is 
+ *      computed on the current spheroid by ll_earea().  With -list,
+ *      returns the list of the areas of the polys.
+ */
+
+static int 
+latlong_area(ClientData cd, Tcl_Interp *interp, 
+             int objc, Tcl_Obj* CONST objv[])
+{
+    return measureCmd(interp, (LatlongInfo*)cd, objc, objv, MEASURE_AREA);
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	latlong perimeter coords
+ *	latlong perimeter -list polys
+ *
+ * INPUTS:
+ *	coords	A list of lat/long coordinates in decimal degrees, or
+ *              a polygon(n) handle.
+ *      polys   A list of such.
+ *
+ * RETURNS:
+ *      Given a polygon expressed as 3 or more lat/long coordinate pairs,
+ *      computes the length of its boundary in kilometers along the 
+ *      geodesics of the current spheroid.  With -list, returns the 
+ *      list of the perimeters of the polys.
+ */
+
+static int 
+latlong_perimeter(ClientData cd, Tcl_Interp *interp, 
+                  int objc, Tcl_Obj* CONST objv[])
+{
+    return measureCmd(interp, (LatlongInfo*)cd, objc, objv, 
+                      MEASURE_PERIMETER);
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	measureCmd()
+ *
+ * INPUTS:
+ *	interp		The Tcl interpreter
+ *	info		The LatlongInfo
+ *	objc, objv	The latlong area or latlong perimeter arguments
+ *	measure		MEASURE_AREA or MEASURE_PERIMETER
+ *
+ * RETURNS:
+ *	TCL_OK on success and TCL_ERROR on failure, setting the error
+ *      string in the latter case.
+ *
+ * DESCRIPTION:
+ *	Implements latlong area and latlong perimeter, handling the
+ *      -list and -ellipsoid options.  In the -list form, an error
+ *      names the index of the first bad polygon.
+ */
+
+static int
+measureCmd(Tcl_Interp* interp, LatlongInfo* info, 
+           int objc, Tcl_Obj* CONST objv[], int measure)
+{
+    int       isList = 0;
+    int       a      = 2;
+    int       polyc;
+    Tcl_Obj** polyv;
+    int       i;
+
+    /* FIRST, get the options.  Only area has -ellipsoid. */
+    for (; a < objc - 1; a++)
+    {
+        if (isFlag(objv[a], "-list"))
+        {
+            isList = 1;
+        }
+        else if (measure != MEASURE_PERIMETER && 
+                 isFlag(objv[a], "-ellipsoid"))
+        {
+            measure = MEASURE_EAREA;
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    if (a != objc - 1)
+    {
+        Tcl_WrongNumArgs(interp, 2, objv, 
+                         (measure == MEASURE_PERIMETER) ?
+                         "?-list? coords" : "?-list? ?-ellipsoid? coords");
+        return TCL_ERROR;
+    }
+
+    /* NEXT, measure one polygon. */
+    if (!isList)
+    {
+        double value;
+
+        if (measurePolygon(interp, info, objv[a], measure, &value) 
+            != TCL_OK)
+        {
+            return TCL_ERROR;
+        }
+
+        Tcl_SetObjResult(interp, Tcl_NewDoubleObj(value));
+
+        return TCL_OK;
+    }
+
+    /* NEXT, measure a list of them. */
+    if (Tcl_ListObjGetElements(interp, objv[a], &polyc, &polyv) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
+
+    double* values = (double*)scratchAlloc(&info->scratch, 
+                                           polyc * sizeof(double));
+
+    for (i = 0; i < polyc; i++)
+    {
+        if (measurePolygon(interp, info, polyv[i], measure, &values[i]) 
+            != TCL_OK)
+        {
+            Tcl_SetObjResult(interp, 
+                             Tcl_ObjPrintf("element %d: %s", i, 
+                                           Tcl_GetStringResult(interp)));
+            return TCL_ERROR;
+        }
+    }
+
+    setDoublesResult(interp, &info->scratch, values, polyc, 0);
+
+    return TCL_OK;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	latlong spheroid ?name?
+ *
+ * INPUTS:
+ *	name          The name of the spheroid.
+ *
+ * RETURNS:
+ *      The name of the current spheroid.
+ *
+ * DESCRIPTION:
+ *	Sets/gets the name of the current spheroid.
+ */
+
+static int 
+latlong_spheroid(ClientData cd, Tcl_Interp *interp, 
+                int objc, Tcl_Obj* CONST objv[])
+{
+    LatlongInfo* info = (LatlongInfo*)cd;
+
+    if (objc < 2 || objc > 3) 
+    {
+        Tcl_WrongNumArgs(interp, 2, objv, "?name");
+        return TCL_ERROR;
+    }
+
+    if (objc == 3)
+    {
+        int index;
+
+        if (Tcl_GetIndexFromObjStruct(interp, objv[2], 
+                                      ellipsoidTable, sizeof(Ellipsoid),
+                                      "name",
+                                      TCL_EXACT,
+                                      &index) != TCL_OK)
+        {
+            return TCL_ERROR;
+        }
+
+        info->spheroid = index;
+        setEllipsoidData(info);
+    }
+
+    Tcl_SetResult(interp, ellipsoidTable[info->spheroid].code, TCL_STATIC);
+
+    return TCL_OK;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	latlong tomgrs loc ?precision?
+ *	latlong tomgrs -list ?-workers n? locs ?precision?
+ *
+ * INPUTS:
+ *	loc          A location as a lat/long pair in decimal degrees.
+ *      precision    The number of digits of each of easting and northing.
+ *                   5 gives one-meter accuracy, 3 gives hundred-meter
+ *                   accuracy; 1 gives 10km accuracy.
+ *
+ * RETURNS:
+ *      The MGRS coordination string.
+ *
+ * DESCRIPTION:
+ *	Computes and returns the MGRS coordinate string associated with
+ *      the location.  Takes into account the spheroid.  The -list
+ *      form is handled by tomgrsList().
+ */
+
+static int 
+latlong_tomgrs(ClientData cd, Tcl_Interp *interp, 
+            int objc, Tcl_Obj* CONST objv[])
+{
+    LatlongInfo* info = (LatlongInfo*)cd;
+    double lat;
+    double lon;
+    double latRadians;
+    double lonRadians;
+    int    precision;
+    long   result;
+    char   mgrsString[MGRS_STRING_LEN];
+    char   errBuf[80];
+
+    if (objc > 2 && isFlag(objv[2], "-list"))
+    {
+        return tomgrsList(interp, info, objc, objv);
+    }
+
+    if (objc < 3 || objc > 4) 
+    {
+        Tcl_WrongNumArgs(interp, 2, objv, "loc ?precision?");
+        return TCL_ERROR;
+    }
+
+    /* FIRST, get loc, and convert to radians */
+
+    if (getLatLong(interp, objv[2], &lat, &lon) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
+
+    latRadians = lat * radians;
+    lonRadians = lon * radians;
+
+    /* NEXT, get the precision */
+    precision = PRECISION_DEFAULT;
+
+    if (objc == 4 && getPrecision(interp, objv[3], &precision) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
+
+    /* NEXT, make sure the ellipsoid parameters are OK */
+    if (info->mgrsStatus != MGRS_NO_ERROR)
+    {
+        Tcl_SetResult(interp, "flawed ellipsoid definition", TCL_STATIC);
+        return TCL_ERROR;
+    }
+
+    /* NEXT, Convert our lat/long to an MGRS_String, and handle errors. */
+    result = 
+        Convert_Geodetic_To_MGRS_r(&info->mgrs, latRadians, lonRadians, 
+                                   precision, mgrsString);
+
+    if (result == MGRS_NO_ERROR)
+    {
+        Tcl_SetResult(interp, mgrsString, TCL_VOLATILE);
+        return TCL_OK;
+    }
+
+    tomgrsError(errBuf, result, lat, lon, precision);
+    Tcl_SetResult(interp, errBuf, TCL_VOLATILE);
+
+    return TCL_ERROR;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	latlong frommgrs utm
+ *	latlong frommgrs -list ?-workers n? strings
+ *
+ * INPUTS:
+ *	utm          A location as a UTM (MGRS) string.
+ *
+ * RETURNS:
+ *      The lat/long coordinates in decimal degrees.
+ *
+ * DESCRIPTION:
+ *	Computes and returns the lat/long coordinates corresponding
+ *      to the MGRS string.  Takes into account the spheroid.  The
+ *      -list form is handled by frommgrsList().
+ */
+
+static int 
+latlong_frommgrs(ClientData cd, Tcl_Interp *interp, 
+            int objc, Tcl_Obj* CONST objv[])
+{
+    LatlongInfo* info = (LatlongInfo*)cd;
+    char*        mgrsString;
+    long         result;
+    double       lat;
+    double       lon;
+    Tcl_Obj*     pair;
+
+    if (objc > 2 && isFlag(objv[2], "-list"))
+    {
+        return frommgrsList(interp, info, objc, objv);
+    }
+
+    if (objc != 3) 
+    {
+        Tcl_WrongNumArgs(interp, 2, objv, "utm");
+        return TCL_ERROR;
+    }
+
+    /* NEXT, get the UTM string */
+    mgrsString = Tcl_GetStringFromObj(objv[2], NULL);
+
+    /* NEXT, make sure the ellipsoid parameters are OK */
+    if (info->mgrsStatus != MGRS_NO_ERROR)
+    {
+        Tcl_SetResult(interp, "flawed ellipsoid definition", TCL_STATIC);
+        return TCL_ERROR;
+    }
+
+    /* NEXT, Convert our MGRS_String to a lat/long, and handle errors. */
+
+    result = 
+        Convert_MGRS_To_Geodetic_r(&info->mgrs, mgrsString, &lat, &lon);
+
+    if (result != MGRS_NO_ERROR)
+    {
+        char errBuf[80];
+
+        frommgrsError(errBuf, result, mgrsString);
+        Tcl_SetResult(interp, errBuf, TCL_VOLATILE);
+
+        return TCL_ERROR;
+    }
+
+    /* NEXT, convert lat/long to decimal degrees and return the result. */
+    lat /= radians;
+    lon /= radians;
+
+
+    /* TBD: refactor returning a lat/long pair? */
+    pair = Tcl_GetObjResult(interp);
+    Tcl_ListObjAppendElement(interp, pair, Tcl_NewDoubleObj(lat));
+    Tcl_ListObjAppendElement(interp, pair, Tcl_NewDoubleObj(lon));
+
+    return TCL_OK;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	tomgrsList()
+ *
+ * INPUTS:
+ *	interp		The Tcl interpreter
+ *	info		The LatlongInfo
+ *	objc, objv	The arguments of 
+ *                      "latlong tomgrs -list ?-workers n? locs ?precision?"
+ *
+ * RETURNS:
+ *	TCL_OK or TCL_ERROR
+ *
+ * DESCRIPTION:
+ *	Converts locs, a flat list of lat/long coordinates in decimal 
+ *      degrees, to a list of MGRS strings, as "latlong tomgrs" would 
+ *      one at a time.  If any location can't be converted, the error
+ *      names the first such; otherwise the result is the list of 
+ *      strings.  The conversions are spread over up to n threads.
+ */
+
+static int
+tomgrsList(Tcl_Interp* interp, LatlongInfo* info, 
+           int objc, Tcl_Obj* CONST objv[])
+{
+    MgrsBatch batch;
+    Points*   points;
+    int       workers;
+    int       a;
+    int       n;
+    int       i;
+
+    /* FIRST, get the options. */
+    if (getWorkers(interp, objc, objv, &workers, &a) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
+
+    if (objc - a < 1 || objc - a > 2) 
+    {
+        Tcl_WrongNumArgs(interp, 2, objv, 
+                         "-list ?-workers n? locs ?precision?");
+        return TCL_ERROR;
+    }
+
+    /* NEXT, get the locations and the precision. */
+    if (getPoints(interp, &info->scratch, objv[a], 0, &points) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
+
+    batch.precision = PRECISION_DEFAULT;
+
+    if (objc - a == 2 &&
+        getPrecision(interp, objv[a + 1], &batch.precision) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
+
+    if (info->mgrsStatus != MGRS_NO_ERROR)
+    {
+        Tcl_SetResult(interp, "flawed ellipsoid definition", TCL_STATIC);
+        return TCL_ERROR;
+    }
+
+    /* NEXT, convert them. */
+    n = points->size;
+
+    batch.ctx     = &info->mgrs;
+    batch.toMgrs  = 1;
+    batch.loc     = points->pts;
+    batch.strings = NULL;
+    batch.mgrs    = (char*)scratchAlloc(&info->scratch, n*MGRS_STRING_LEN);
+    batch.status  = (long*)scratchAlloc(&info->scratch, n * sizeof(long));
+
+    runWorkers(mgrsRange, (ClientData)&batch, n, workers, 
+               MGRS_MIN_PER_WORKER);
+
+    /* NEXT, report the first error, if any. */
+    for (i = 0; i < n; i++)
+    {
+        if (batch.status[i] != MGRS_NO_ERROR)
+        {
+            char errBuf[80];
+
+            tomgrsError(errBuf, batch.status[i], 
+                        points->pts[i].x, points->pts[i].y, 
+                        batch.precision);
+            Tcl_SetObjResult(interp, 
+                             Tcl_ObjPrintf("element %d: %s", i, errBuf));
+            return TCL_ERROR;
+        }
+    }
+
+    /* NEXT, return the strings. */
+    Tcl_Obj** result = (Tcl_Obj**)scratchAlloc(&info->scratch, 
+                                               n * sizeof(Tcl_Obj*));
+
+    for (i = 0; i < n; i++)
+    {
+        result[i] = Tcl_NewStringObj(batch.mgrs + i*MGRS_STRING_LEN, -1);
+    }
+
+    Tcl_SetObjResult(interp, Tcl_NewListObj(n, result));
+
+    return TCL_OK;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	frommgrsList()
+ *
+ * INPUTS:
+ *	interp		The Tcl interpreter
+ *	info		The LatlongInfo
+ *	objc, objv	The arguments of 
+ *                      "latlong frommgrs -list ?-workers n? strings"
+ *
+ * RETURNS:
+ *	TCL_OK or TCL_ERROR
+ *
+ * DESCRIPTION:
+ *	Converts strings, a list of MGRS strings, to a flat list of 
+ *      lat/long coordinates in decimal degrees, as "latlong frommgrs"
+ *      would one at a time.  If any string can't be converted, the 
+ *      error names the first such.  The conversions are spread over 
+ *      up to n threads.
+ */
+
+static int
+frommgrsList(Tcl_Interp* interp, LatlongInfo* info, 
+             int objc, Tcl_Obj* CONST objv[])
+{
+    MgrsBatch batch;
+    Tcl_Obj** elems;
+    int       workers;
+    int       a;
+    int       n;
+    int       i;
+
+    /* FIRST, get the options. */
+    if (getWorkers(interp, objc, objv, &workers, &a) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
+
+    if (objc - a != 1) 
+    {
+        Tcl_WrongNumArgs(interp, 2, objv, "-list ?-workers n? strings");
+        return TCL_ERROR;
+    }
+
+    /* NEXT, get the strings.  The workers get the string reps, which
+     * the list keeps alive until we're done. */
+    if (Tcl_ListObjGetElements(interp, objv[a], &n, &elems) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
+
+    if (info->mgrsStatus != MGRS_NO_ERROR)
+    {
+        Tcl_SetResult(interp, "flawed ellipsoid definition", TCL_STATIC);
+        return TCL_ERROR;
+    }
+
+    batch.strings = (char**)scratchAlloc(&info->scratch, n * sizeof(char*));
+
+    for (i = 0; i < n; i++)
+    {
+        batch.strings[i] = Tcl_GetString(elems[i]);
+    }
+
+    /* NEXT, convert them. */
+    batch.ctx       = &info->mgrs;
+    batch.toMgrs    = 0;
+    batch.precision = 0;
+    batch.loc       = (Point*)scratchAlloc(&info->scratch, n * sizeof(Point));
+    batch.mgrs      = NULL;
+    batch.status    = (long*)scratchAlloc(&info->scratch, n * sizeof(long));
+
+    runWorkers(mgrsRange, (ClientData)&batch, n, workers, 
+               MGRS_MIN_PER_WORKER);
+
+    /* NEXT, report the first error, if any; otherwise, return the
+     * locations. */
+    for (i = 0; i < n; i++)
+    {
+        if (batch.status[i] != MGRS_NO_ERROR)
+        {
+            char errBuf[80];
+
+            frommgrsError(errBuf, batch.status[i], batch.strings[i]);
+            Tcl_SetObjResult(interp, 
+                             Tcl_ObjPrintf("element %d: %s", i, errBuf));
+            break;
+        }
+    }
+
+    if (i < n)
+    {
+        return TCL_ERROR;
+    }
+
+    /* A Point is just a lat/long pair of doubles. */
+    setDoublesResult(interp, &info->scratch, (double*)batch.loc, 2*n, 0);
+
+    return TCL_OK;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	getPrecision()
+ *
+ * INPUTS:
+ *	interp		The Tcl interpreter
+ *	obj		A "latlong tomgrs" precision argument
+ *
+ * OUTPUTS:
+ *	precision	The precision
+ *
+ * RETURNS:
+ *	TCL_OK or TCL_ERROR
+ *
+ * DESCRIPTION:
+ *	Parses an MGRS precision, which must be an integer from 
+ *      PRECISION_MIN to PRECISION_MAX.  The error is the one 
+ *      Convert_Geodetic_To_MGRS() would produce, but it's reported
+ *      before any conversion is done.
+ */
+
+static int
+getPrecision(Tcl_Interp* interp, Tcl_Obj* obj, int* precision)
+{
+    if (Tcl_GetIntFromObj(interp, obj, precision) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
+
+    if (*precision < PRECISION_MIN || *precision > PRECISION_MAX)
+    {
+        Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+            "Invalid precision, should be %d to %d: \"%s\"",
+            PRECISION_MIN, PRECISION_MAX, Tcl_GetString(obj)));
+        return TCL_ERROR;
+    }
+
+    return TCL_OK;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	cpuCount()
+ *
+ * RETURNS:
+ *	The number of online processors, from 1 to MAX_WORKERS.
+ *
+ * DESCRIPTION:
+ *	Gives a default thread count for the commands that scale with
+ *      the machine.  Returns 1 where the count isn't available.
+ */
+
+static int
+cpuCount(void)
+{
+    long n = 1;
+
+#ifdef _SC_NPROCESSORS_ONLN
+    n = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+
+    if (n < 1)
+    {
+        n = 1;
+    }
+    else if (n > MAX_WORKERS)
+    {
+        n = MAX_WORKERS;
+    }
+
+    return (int)n;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	getWorkers()
+ *
+ * INPUTS:
+ *	interp		The Tcl interpreter
+ *	objc, objv	The arguments of "latlong <subcommand> -list ..."
+ *
+ * OUTPUTS:
+ *	workers		The number of threads requested, 1 by default
+ *	a		The index of the first argument after the options
+ *
+ * RETURNS:
+ *	TCL_OK or TCL_ERROR
+ *
+ * DESCRIPTION:
+ *	Parses the "?-workers n?" option that follows "-list".
+ */
+
+static int
+getWorkers(Tcl_Interp* interp, int objc, Tcl_Obj* CONST objv[],
+           int* workers, int* a)
+{
+    *workers = 1;
+    *a       = 3;
+
+    if (objc > 4 && isFlag(objv[3], "-workers"))
+    {
+        if (Tcl_GetIntFromObj(interp, objv[4], workers) != TCL_OK)
+        {
+            return TCL_ERROR;
+        }
+
+        if (*workers < 1)
+        {
+            Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+                "invalid -workers, should be at least 1: \"%s\"",
+                Tcl_GetString(objv[4])));
+            return TCL_ERROR;
+        }
+
+        *a = 5;
+    }
+
+    return TCL_OK;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	runWorkers()
+ *
+ * INPUTS:
+ *	proc		The WorkProc that processes a range of elements
+ *	data		The proc's data
+ *	n		The number of elements
+ *	workers		The number of threads requested
+ *	minPerWorker	The fewest elements worth giving a thread
+ *
+ * RETURNS:
+ *	nothing
+ *
+ * DESCRIPTION:
+ *	Calls proc on elements 0 to n-1, splitting them into contiguous
+ *      ranges over up to "workers" threads, but at most MAX_WORKERS,
+ *      and so that each range has at least minPerWorker elements; 
+ *      small inputs are processed on the calling thread.  The calling 
+ *      thread processes the first range itself, and returns when all
+ *      of the ranges are done.  If a thread can't be created, or Tcl
+ *      is unthreaded, its range is processed on the calling thread 
+ *      too.
+ *
+ *      The proc must not touch Tcl objects or the interpreter, and
+ *      must write only to its own range of the output.
+ */
+
+static void
+runWorkers(WorkProc* proc, ClientData data, int n, int workers,
+           int minPerWorker)
+{
+    /* FIRST, decide how many threads to use. */
+    if (workers > n / minPerWorker)
+    {
+        workers = n / minPerWorker;
+    }
+
+    if (workers > MAX_WORKERS)
+    {
+        workers = MAX_WORKERS;
+    }
+
+#ifdef TCL_THREADS
+    if (workers > 1)
+    {
+        WorkRange    ranges[MAX_WORKERS];
+        Tcl_ThreadId ids[MAX_WORKERS];
+        int          started[MAX_WORKERS];
+        int          w;
+
+        /* NEXT, give each worker its range, and start all but
+         * the first. */
+        for (w = 0; w < workers; w++)
+        {
+            ranges[w].proc  = proc;
+            ranges[w].data  = data;
+            ranges[w].first = (int)((long)n*w/workers);
+            ranges[w].last  = (int)((long)n*(w + 1)/workers);
+            started[w]      = 0;
+
+            if (w > 0 &&
+                Tcl_CreateThread(&ids[w], workerThread, 
+                                 (ClientData)&ranges[w],
+                                 TCL_THREAD_STACK_DEFAULT, 
+                                 TCL_THREAD_JOINABLE) == TCL_OK)
+            {
+                started[w] = 1;
+            }
+        }
+
+        /* NEXT, do the first range here, and any that didn't start. */
+        for (w = 0; w < workers; w++)
+        {
+            if (!started[w])
+            {
+                proc(data, ranges[w].first, ranges[w].last);
+            }
+        }
+
+        /* NEXT, wait for the rest. */
+        for (w = 1; w < workers; w++)
+        {
+            if (started[w])
+            {
+                int code;
+
+                Tcl_JoinThread(ids[w], &code);
+            }
+        }
+
+        return;
+    }
+#endif /* TCL_THREADS */
+
+    proc(data, 0, n);
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	workerThread()
+ *
+ * INPUTS:
+ *	cd		A WorkRange*
+ *
+ * RETURNS:
+ *	nothing
+ *
+ * DESCRIPTION:
+ *	The body of a runWorkers() thread: processes its range.
+ */
+
+static Tcl_ThreadCreateType
+workerThread(ClientData cd)
+{
+    WorkRange* range = (WorkRange*)cd;
+
+    range->proc(range->data, range->first, range->last);
+
+    TCL_THREAD_CREATE_RETURN;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	mgrsRange()
+ *
+ * INPUTS:
+ *	cd		An MgrsBatch*
+ *	first		The index of the first element to convert
+ *	last		The index after the last element
+ *
+ * RETURNS:
+ *	nothing
+ *
+ * DESCRIPTION:
+ *	A WorkProc that converts the batch's elements from first to last,
+ *      storing each one's result and Geotrans status.  It allocates
+ *      nothing, and touches only its own range.
+ */
+
+static void
+mgrsRange(ClientData cd, int first, int last)
+{
+    MgrsBatch* batch = (MgrsBatch*)cd;
+    int        i;
+
+    for (i = first; i < last; i++)
+    {
+        Point* loc = batch->loc + i;
+
+        if (batch->toMgrs)
+        {
+            batch->status[i] = 
+                Convert_Geodetic_To_MGRS_r(batch->ctx, 
+                                           loc->x*radians, loc->y*radians,
+                                           batch->precision,
+                                           batch->mgrs + i*MGRS_STRING_LEN);
+        }
+        else
+        {
+            batch->status[i] = 
+                Convert_MGRS_To_Geodetic_r(batch->ctx, batch->strings[i],
+                                           &loc->x, &loc->y);
+
+            loc->x /= radians;
+            loc->y /= radians;
+        }
+    }
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	tomgrsError()
+ *
+ * INPUTS:
+ *	errBuf		A buffer of at least 80 characters
+ *	result		A Convert_Geodetic_To_MGRS() error code
+ *	lat, lon	The location, in decimal degrees
+ *	precision	The requested precision
+ *
+ * OUTPUTS:
+ *	errBuf		The error message
+ *
+ * RETURNS:
+ *	nothing
+ *
+ * DESCRIPTION:
+ *	Formats the error message for a failed "latlong tomgrs".
+ */
+
+static void
+tomgrsError(char* errBuf, long result, double lat, double lon, 
+            int precision)
+{
+    if (result & MGRS_LAT_ERROR) {
+        sprintf(errBuf,
+                "Invalid latitude, should be -90.0 to 90.0 degrees: \"%g\"",
+                lat);
+    } 
+    else if (result & MGRS_LON_ERROR) 
+    {
+        sprintf(errBuf,
+                "Invalid longitude, should be -180.0 to 360.0 degrees: \"%g\"",
+                lon);
+    } 
+    else if (result & MGRS_PRECISION_ERROR) 
+    {
+        sprintf(errBuf, "Invalid precision, should be 0 to 5: \"%d\"",
+                precision);
+    } 
+    else 
+    {
+        sprintf(errBuf, "unexpected error return: %ld", result);
+    }
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	frommgrsError()
+ *
+ * INPUTS:
+ *	errBuf		A buffer of at least 80 characters
+ *	result		A Convert_MGRS_To_Geodetic() error code
+ *	mgrsString	The MGRS string
+ *
+ * OUTPUTS:
+ *	errBuf		The error message
+ *
+ * RETURNS:
+ *	nothing
+ *
+ * DESCRIPTION:
+ *	Formats the error message for a failed "latlong frommgrs".
+ *      Long strings are truncated to fit the buffer.
+ */
+
+static void
+frommgrsError(char* errBuf, long result, char* mgrsString)
+{
+    /* NOTE: The Geotrans documentation says that the constant 
+     * is MGRS_STR_ERROR; the source code defines MGRS_STRING_ERROR. */
+    if (result & MGRS_STRING_ERROR) {
+        sprintf(errBuf,
+                "Invalid MGRS string: \"%.50s\"",
+                mgrsString);
+    } 
+    else 
+    {
+        sprintf(errBuf, "unexpected error return: %ld", result);
+    }
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	latlong togcc loc 
+ *	latlong togcc -list ?-workers n? locs
+ *
+ * INPUTS:
+ *	loc          A location as a lat/long pair in decimal degrees.
+ *
+ * RETURNS:
+ *      The GCC coordinates in decimal meters as a three-element list.
+ *
+ * DESCRIPTION:
+ *	Computes and returns the GCC coordinates associated with
+ *      the lat/lon location.  Elevation is assumed to be 0.  The
+ *      -list form is handled by togccList().
+ */
+
+static int 
+latlong_togcc(ClientData cd, Tcl_Interp *interp, 
+              int objc, Tcl_Obj* CONST objv[])
+{
+    LatlongInfo* info = (LatlongInfo*)cd;
+    double lat;
+    double lon;
+    double hgt = 0.0;
+    double efg[3];
+    Tcl_Obj*     xyz;
+
+    if (objc > 2 && isFlag(objv[2], "-list"))
+    {
+        return togccList(interp, info, objc, objv);
+    }
+
+    if (objc != 3) 
+    {
+        Tcl_WrongNumArgs(interp, 2, objv, "loc");
+        return TCL_ERROR;
+    }
+
+    /* FIRST, get loc, and validate */
+    if (getLatLong(interp, objv[2], &lat, &lon) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
+
+    if (validateLatLong(interp, lat, lon) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
+
+    /* NEXT, convert lat/long to radians */
+    lat *= radians;
+    lon *= radians;
+
+    geoLlh2EfgOpt(lat, lon, hgt, &info->ellipsoid, 
+                  &efg[GEO_E], &efg[GEO_F], &efg[GEO_G]);
+        
+    /* NEXT, return X, Y and Z as a list */
+    xyz = Tcl_GetObjResult(interp);
+    Tcl_ListObjAppendElement(interp, xyz, Tcl_NewDoubleObj(efg[GEO_E]));
+    Tcl_ListObjAppendElement(interp, xyz, Tcl_NewDoubleObj(efg[GEO_F]));
+    Tcl_ListObjAppendElement(interp, xyz, Tcl_NewDoubleObj(efg[GEO_G]));
+
+    return TCL_OK;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	latlong fromgcc gcc
+ *	latlong fromgcc -list ?-workers n? gccs
+ *
+ * INPUTS:
+ *	gcc          A GCC location as three decimal meter values 
+ *
+ * RETURNS:
+ *      The lat/long coordinates in decimal degrees.
+ *
+ * DESCRIPTION:
+ *	Computes and returns the lat/long coordinates corresponding
+ *      to the GCC coordinates.  The -list form is handled by 
+ *      fromgccList().
+ */
+
+static int 
+latlong_fromgcc(ClientData cd, Tcl_Interp *interp, 
+                int objc, Tcl_Obj* CONST objv[])
+{
+    LatlongInfo* info = (LatlongInfo*)cd;
+    double   lat;
+    double   lon;
+    double   efg[3];
+    Tcl_Obj* pair;
+
+    if (objc > 2 && isFlag(objv[2], "-list"))
+    {
+        return fromgccList(interp, info, objc, objv);
+    }
+
+    if (objc != 3) 
+    {
+        Tcl_WrongNumArgs(interp, 2, objv, "gcc");
+        return TCL_ERROR;
+    }
+
+    /* NEXT, get the GCC coordinates */
+    if (getGcc(interp, objv[2], &efg[GEO_E], &efg[GEO_F], &efg[GEO_G]) 
+        != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
+
+    gccToLatLong(&info->ellipsoid, efg, &lat, &lon);
+
+    pair = Tcl_GetObjResult(interp);
+    Tcl_ListObjAppendElement(interp, pair, Tcl_NewDoubleObj(lat));
+    Tcl_ListObjAppendElement(interp, pair, Tcl_NewDoubleObj(lon));
+
+    return TCL_OK;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	togccList()
+ *
+ * INPUTS:
+ *	interp		The Tcl interpreter
+ *	info		The LatlongInfo
+ *	objc, objv	The arguments of 
+ *                      "latlong togcc -list ?-workers n? locs"
+ *
+ * RETURNS:
+ *	TCL_OK or TCL_ERROR
+ *
+ * DESCRIPTION:
+ *	Converts locs, a flat list of lat/long coordinates in decimal 
+ *      degrees, to a flat list of X Y Z coordinates, as "latlong togcc" 
+ *      would one at a time.  If any location is invalid, the error 
+ *      names the first such.  The conversions are spread over up to n 
+ *      threads.
+ */
+
+static int
+togccList(Tcl_Interp* interp, LatlongInfo* info, 
+          int objc, Tcl_Obj* CONST objv[])
+{
+    GccBatch batch;
+    Points*  points;
+    int      workers;
+    int      a;
+    int      i;
+
+    /* FIRST, get the options and the locations. */
+    if (getWorkers(interp, objc, objv, &workers, &a) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
+
+    if (objc - a != 1) 
+    {
+        Tcl_WrongNumArgs(interp, 2, objv, "-list ?-workers n? locs");
+        return TCL_ERROR;
+    }
+
+    if (getPoints(interp, &info->scratch, objv[a], 0, &points) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
+
+    /* NEXT, validate them. */
+    for (i = 0; i < points->size; i++)
+    {
+        if (validateLatLong(interp, points->pts[i].x, points->pts[i].y) 
+            != TCL_OK)
+        {
+            Tcl_SetObjResult(interp, 
+                             Tcl_ObjPrintf("element %d: %s", i, 
+                                           Tcl_GetStringResult(interp)));
+            return TCL_ERROR;
+        }
+    }
+
+    /* NEXT, convert them. */
+    batch.ellipsoid = &info->ellipsoid;
+    batch.loc       = points->pts;
+    batch.efg       = (double*)scratchAlloc(&info->scratch, 
+                                            3*points->size * sizeof(double));
+
+    runWorkers(togccRange, (ClientData)&batch, points->size, workers,
+               GCC_MIN_PER_WORKER);
+
+    setDoublesResult(interp, &info->scratch, batch.efg, 3*points->size, 0);
+
+    return TCL_OK;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	fromgccList()
+ *
+ * INPUTS:
+ *	interp		The Tcl interpreter
+ *	info		The LatlongInfo
+ *	objc, objv	The arguments of 
+ *                      "latlong fromgcc -list ?-workers n? gccs"
+ *
+ * RETURNS:
+ *	TCL_OK or TCL_ERROR
+ *
+ * DESCRIPTION:
+ *	Converts gccs, a flat list of X Y Z coordinates in meters, to a
+ *      flat list of lat/long coordinates in decimal degrees, as 
+ *      "latlong fromgcc" would one at a time.  The conversions are 
+ *      spread over up to n threads.
+ */
+
+static int
+fromgccList(Tcl_Interp* interp, LatlongInfo* info, 
+            int objc, Tcl_Obj* CONST objv[])
+{
+    GccBatch  batch;
+    Tcl_Obj** elems;
+    int       workers;
+    int       a;
+    int       len;
+    int       n;
+    int       i;
+
+    /* FIRST, get the options and the coordinates. */
+    if (getWorkers(interp, objc, objv, &workers, &a) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
+
+    if (objc - a != 1) 
+    {
+        Tcl_WrongNumArgs(interp, 2, objv, "-list ?-workers n? gccs");
+        return TCL_ERROR;
+    }
+
+    if (Tcl_ListObjGetElements(interp, objv[a], &len, &elems) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
+
+    if (len % 3 != 0)
+    {
+        Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+            "expected X Y Z triples, got %d coordinates: \"%s\"",
+            len, Tcl_GetString(objv[a])));
+        return TCL_ERROR;
+    }
+
+    n = len/3;
+
+    batch.ellipsoid = &info->ellipsoid;
+    batch.efg       = (double*)scratchAlloc(&info->scratch, 
+                                            len * sizeof(double));
+
+    for (i = 0; i < len; i++)
+    {
+        if (Tcl_GetDoubleFromObj(interp, elems[i], &batch.efg[i]) != TCL_OK)
+        {
+            return TCL_ERROR;
+        }
+    }
+
+    /* NEXT, convert them. */
+    batch.loc = (Point*)scratchAlloc(&info->scratch, n * sizeof(Point));
+
+    runWorkers(fromgccRange, (ClientData)&batch, n, workers,
+               GCC_MIN_PER_WORKER);
+
+    /* A Point is just a lat/long pair of doubles. */
+    setDoublesResult(interp, &info->scratch, (double*)batch.loc, 2*n, 0);
+
+    return TCL_OK;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	togccRange(), fromgccRange()
+ *
+ * INPUTS:
+ *	cd		A GccBatch*
+ *	first		The index of the first element to convert
+ *	last		The index after the last element
+ *
+ * RETURNS:
+ *	nothing
+ *
+ * DESCRIPTION:
+ *	WorkProcs that convert the batch's locations from first to last
+ *      to GCC coordinates and back again, exactly as "latlong togcc"
+ *      and "latlong fromgcc" do.
+ */
+
+static void
+togccRange(ClientData cd, int first, int last)
+{
+    GccBatch* batch = (GccBatch*)cd;
+    int       i;
+
+    for (i = first; i < last; i++)
+    {
+        double* efg = batch->efg + 3*i;
+
+        geoLlh2EfgOpt(batch->loc[i].x * radians, batch->loc[i].y * radians,
+                      0.0, batch->ellipsoid, 
+                      &efg[GEO_E], &efg[GEO_F], &efg[GEO_G]);
+    }
+}
+
+static void
+fromgccRange(ClientData cd, int first, int last)
+{
+    GccBatch* batch = (GccBatch*)cd;
+    int       i;
+
+    for (i = first; i < last; i++)
+    {
+        gccToLatLong(batch->ellipsoid, batch->efg + 3*i,
+                     &batch->loc[i].x, &batch->loc[i].y);
+    }
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	gccToLatLong()
+ *
+ * INPUTS:
+ *	eld		The EllipsoidData for the spheroid
+ *	efg		A GCC location as three decimal meter values; the
+ *                      E value may be adjusted.
+ *
+ * OUTPUTS:
+ *	lat, lon	The location in decimal degrees
+ *
+ * RETURNS:
+ *	nothing
+ *
+ * DESCRIPTION:
+ *	Converts a GCC location to lat/long, for "latlong fromgcc".
+ */
+
+static void
+gccToLatLong(EllipsoidData* eld, double efg[], double* lat, double* lon)
+{
+    double hgt;
+
+    /* FIRST, avoid problems for values on the pole */
+    if (abs(efg[GEO_E]) < 1.0e-10)
+    {
+        efg[GEO_E] = 1.0e-10;
+    }
+
+    geoEfg2LlhOpt(eld, efg, lat, lon, &hgt);
+
+    /* NEXT, convert lat/long to decimal degrees. */
+    *lat /= radians;
+    *lon /= radians;
+}
+
+/*
+ * geotiff command and subcommands
+ */
+
+/***********************************************************************
+ * 
+ * FUNCTION :
+ *     marsutil_geotiffCmd()
+ *
+ * INPUTS:
+ *     subcommand        The subcommand name
+ *     args              Subcommand arguments
+ *
+ * RETURNS:
+ *     Whatever the subcommand returns.
+ *
+ * DESCRIPTION:
+ *     This is the ensemble command for the geotiff subcommands.
+ *     It looks up the subcommand name, and then passes execution
+ *     to the subcommand proc.
+ *
+ */
+
+static int
+marsutil_geotiffCmd(ClientData cd, Tcl_Interp* interp,
+                   int objc, Tcl_Obj* CONST objv[])
+{
+    if (objc < 2)
+    {
+        Tcl_WrongNumArgs(interp, 1, objv, "subcommand ?arg arg ...?");
+        return TCL_ERROR;
+    }
+
+    int index = 0;
+
+    if (Tcl_GetIndexFromObjStruct(interp, objv[1],
+                                  geotiffTable, sizeof(SubcommandVector),
+                                  "subcommand",
+                                  TCL_EXACT,
+                                  &index) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
+
+    return(*geotiffTable[index].proc)(cd, interp, objc, objv);
+}
+
+/***********************************************************************
+ * 
+ * FUNCTION :
+ *     geotiff read filename
+ *
+ * INPUTS:
+ *     filename - the name of a GeoTIFF file to read
+ *
+ * RETURNS:
+ *     Projection information to be used in geo-referencing the
+ *     map image contained within the GeoTIFF
+ *
+ * DESCRIPTION:
+ *     Opens a TIFF file and reads the appropriate geokeys and values
+ *     from the Geo information embedded in the TIFF. If this file is
+ *     not a TIFF or if the appropriate Geo information is not in it
+ *     an appropriate error message is returned.
+ *
+ */
+
+static int
+geotiff_read(ClientData cd, Tcl_Interp *interp,
+             int objc, Tcl_Obj* CONST objv[])
+{
+    TIFF*    tiff;
+    Tcl_Obj* result;
+    int      code;
+
+    if (objc != 3) {
+        Tcl_WrongNumArgs(interp, 2, objv, "filename");
+        return TCL_ERROR;
+    }
+
+    if (openTiff(interp, objv[2], &tiff) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
+
+    code = getGeoKeys(interp, tiff, &result, NULL);
+
+    XTIFFClose(tiff);
+
+    if (code == TCL_OK)
+    {
+        Tcl_SetObjResult(interp, result);
+    }
+
+    return code;
+}
+
+/***********************************************************************
+ * 
+ * FUNCTION :
+ *     geotiff probe filename
+ *     geotiff probe -directory dirname ?-pattern pattern? ?-workers n?
+ *
+ * INPUTS:
+ *     filename - the name of a GeoTIFF file to probe
+ *     dirname  - the name of a directory of GeoTIFF files
+ *     pattern  - a glob pattern for the files in the directory; 
+ *                defaults to "*"
+ *     n        - the number of threads to probe with; defaults to 1
+ *
+ * RETURNS:
+ *     For a file, the "geotiff read" dict, less the projection, plus
+ *     the image's width and height.  For a directory, a dict of these
+ *     dicts by normalized file name, for each of its files that is a
+ *     GeoTIFF, in name order.
+ *
+ * DESCRIPTION:
+ *     Reads just what "geotiff read" returns from each file, as cheaply
+ *     as possible, for browsing many candidate maps: the TIFF header
+ *     and the first IFD are read directly, and then only the geo tags'
+ *     values, with no libTiff directory read and no geokey parsing 
+ *     beyond the model type.  A projected file's projection isn't
+ *     checked; "geotiff read" or "geotiff open" will reject one that
+ *     isn't supported.
+ *
+ *     What's found in each file is cached for the life of the process,
+ *     by normalized file name, and reused for as long as the file's 
+ *     modification time and size are unchanged.  Errors are the same
+ *     as for "geotiff read"; with -directory, files that fail are
+ *     simply left out.
+ */
+
+static int
+geotiff_probe(ClientData cd, Tcl_Interp *interp,
+              int objc, Tcl_Obj* CONST objv[])
+{
+    Tcl_Obj*        pattern = NULL;
+    Tcl_Obj*        norm;
+    Tcl_Obj*        files;
+    Tcl_Obj**       elems;
+    Tcl_Obj*        result;
+    Tcl_GlobTypeData types = {TCL_GLOB_TYPE_FILE, 0, NULL, NULL};
+    ProbeBatch      batch;
+    GeoProbe        probe;
+    struct stat     st;
+    int             workers = 1;
+    int             n;
+    int             i;
+
+    /* FIRST, probe a single file. */
+    if (objc == 3)
+    {
+        norm = Tcl_FSGetNormalizedPath(interp, objv[2]);
+
+        if (norm == NULL)
+        {
+            return TCL_ERROR;
+        }
+
+        probeFile(Tcl_GetString(norm), &probe);
+
+        if (probe.status != PROBE_OK)
+        {
+            Tcl_SetResult(interp, (char*)probeErrors[probe.status], 
+                          TCL_STATIC);
+            return TCL_ERROR;
+        }
+
+        Tcl_SetObjResult(interp, newProbeDict(&probe));
+
+        if (probe.values != NULL)
+        {
+            Tcl_Free((char*)probe.values);
+        }
+
+        return TCL_OK;
+    }
+
+    /* NEXT, it's a directory; get the options. */
+    if (objc < 4 || objc % 2 != 0 || !isFlag(objv[2], "-directory"))
+    {
+        Tcl_WrongNumArgs(interp, 2, objv, 
+            "filename | -directory dirname ?-pattern pattern? ?-workers n?");
+        return TCL_ERROR;
+    }
+
+    for (i = 4; i < objc; i += 2)
+    {
+        if (isFlag(objv[i], "-pattern"))
+        {
+            pattern = objv[i + 1];
+        }
+        else if (isFlag(objv[i], "-workers"))
+        {
+            if (Tcl_GetIntFromObj(interp, objv[i + 1], &workers) != TCL_OK)
+            {
+                return TCL_ERROR;
+            }
+
+            if (workers < 1)
+            {
+                Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+                    "invalid -workers, should be at least 1: \"%s\"",
+                    Tcl_GetString(objv[i + 1])));
+                return TCL_ERROR;
+            }
+        }
+        else
+        {
+            Tcl_AppendStringsToObj(Tcl_GetObjResult(interp),
+                                   "unknown option: \"", 
+                                   Tcl_GetString(objv[i]), "\"", NULL);
+            return TCL_ERROR;
+        }
+    }
+
+    norm = Tcl_FSGetNormalizedPath(interp, objv[3]);
+
+    if (norm == NULL)
+    {
+        return TCL_ERROR;
+    }
+
+    if (stat(Tcl_GetString(norm), &st) != 0 || !S_ISDIR(st.st_mode))
+    {
+        Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+            "directory does not exist: \"%s\"", Tcl_GetString(objv[3])));
+        return TCL_ERROR;
+    }
+
+    /* NEXT, list its files, in name order. */
+    files = Tcl_NewObj();
+    Tcl_IncrRefCount(files);
+
+    if (Tcl_FSMatchInDirectory(interp, files, norm, 
+                               pattern ? Tcl_GetString(pattern) : "*",
+                               &types) != TCL_OK ||
+        Tcl_ListObjGetElements(interp, files, &n, &elems) != TCL_OK)
+    {
+        Tcl_DecrRefCount(files);
+        return TCL_ERROR;
+    }
+
+    batch.paths  = (char**)Tcl_Alloc((n + 1) * sizeof(char*));
+    batch.probes = (GeoProbe*)Tcl_Alloc((n + 1) * sizeof(GeoProbe));
+
+    for (i = 0; i < n; i++)
+    {
+        Tcl_Obj* path = Tcl_FSGetNormalizedPath(NULL, elems[i]);
+
+        batch.paths[i] = Tcl_GetString(path ? path : elems[i]);
+    }
+
+    qsort(batch.paths, n, sizeof(char*), compareStrings);
+
+    /* NEXT, probe them, on this thread or spread over the workers. */
+    runWorkers(probeRange, (ClientData)&batch, n, workers, 
+               PROBE_MIN_PER_WORKER);
+
+    /* NEXT, return the GeoTIFFs. */
+    result = Tcl_NewDictObj();
+
+    for (i = 0; i < n; i++)
+    {
+        GeoProbe* p = batch.probes + i;
+
+        if (p->status == PROBE_OK)
+        {
+            Tcl_DictObjPut(interp, result, Tcl_NewStringObj(batch.paths[i], -1),
+                           newProbeDict(p));
+        }
+
+        if (p->values != NULL)
+        {
+            Tcl_Free((char*)p->values);
+        }
+    }
+
+    Tcl_Free((char*)batch.paths);
+    Tcl_Free((char*)batch.probes);
+    Tcl_DecrRefCount(files);
+
+    Tcl_SetObjResult(interp, result);
+
+    return TCL_OK;
+}
+
+/***********************************************************************
+ * 
+ * FUNCTION :
+ *     geotiff open ?-mmap? filename
+ *
+ * INPUTS:
+ *     -mmap    - map the file into memory
+ *     filename - the name of a GeoTIFF file to open
+ *
+ * RETURNS:
+ *     A geotiff handle
+ *
+ * DESCRIPTION:
+ *     Opens a GeoTIFF file for reading, and leaves it open so that
+ *     its pixels can be read a window at a time by the tile, strip
+ *     and region subcommands.  The file's geo information is read
+ *     as by "geotiff read", with the same errors.  
+ *
+ *     Any overviews, i.e., IFDs marked as reduced-resolution versions
+ *     of the image with the same pixel layout, are found as well; 
+ *     they become levels 1 through N, from largest to smallest.  Only
+ *     contiguous pixels of whole bytes are supported.
+ *
+ *     If -mmap is given, the file is mapped read-only, and the pixels
+ *     of uncompressed levels are copied straight out of the mapping
+ *     with no intermediate buffer.  The pages are shared with any other
+ *     process that maps the same file.
+ */
+
+static int
+geotiff_open(ClientData cd, Tcl_Interp *interp,
+             int objc, Tcl_Obj* CONST objv[])
+{
+    GeotiffInfo*   info = (GeotiffInfo*)cd;
+    TIFF*          tiff;
+    Tcl_Obj*       georef;
+    GeoModel       model;
+    uint16         planar;
+    uint32         subfileType;
+    Tcl_HashEntry* entry;
+    int            isNew;
+    int            mmap = 0;
+    char           name[40];
+    int            i;
+    int            j;
+
+    if (objc == 4 && isFlag(objv[2], "-mmap")) {
+        mmap = 1;
+    } else if (objc != 3) {
+        Tcl_WrongNumArgs(interp, 2, objv, "?-mmap? filename");
+        return TCL_ERROR;
+    }
+
+    /* FIRST, open the file and get its geo information. */
+    if (openTiff(interp, objv[objc - 1], &tiff) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
+
+    if (getGeoKeys(interp, tiff, &georef, &model) != TCL_OK)
+    {
+        XTIFFClose(tiff);
+        return TCL_ERROR;
+    }
+
+    /* NEXT, check the pixel layout of the full-resolution image. */
+    GeotiffImage* img = (GeotiffImage*)Tcl_Alloc(sizeof(GeotiffImage));
+    memset(img, 0, sizeof(GeotiffImage));
+    img->tiff   = tiff;
+    img->georef = georef;
+    img->model  = model;
+    img->path   = strcpy(Tcl_Alloc(strlen(Tcl_GetString(objv[objc - 1])) + 1),
+                         Tcl_GetString(objv[objc - 1]));
+    Tcl_IncrRefCount(georef);
+
+    TIFFGetFieldDefaulted(tiff, TIFFTAG_SAMPLESPERPIXEL, &img->samples);
+    TIFFGetFieldDefaulted(tiff, TIFFTAG_BITSPERSAMPLE,   &img->bits);
+    TIFFGetFieldDefaulted(tiff, TIFFTAG_PLANARCONFIG,    &planar);
+    TIFFGetFieldDefaulted(tiff, TIFFTAG_PHOTOMETRIC,     &img->photometric);
+
+    if (planar != PLANARCONFIG_CONTIG || img->bits % 8 != 0)
+    {
+        Tcl_SetResult(interp, 
+                      "unsupported pixel layout, must be contiguous bytes",
+                      TCL_STATIC);
+        closeGeotiff(img);
+        return TCL_ERROR;
+    }
+
+    img->pixelBytes = img->samples * img->bits / 8;
+
+    /* NEXT, find the levels: the first IFD, and the overviews. */
+    int ndirs = TIFFNumberOfDirectories(tiff);
+
+    img->levels = (GeotiffLevel*)Tcl_Alloc(ndirs * sizeof(GeotiffLevel));
+
+    for (i = 0; i < ndirs; i++)
+    {
+        uint16        samples;
+        uint16        bits;
+        GeotiffLevel* level = &img->levels[img->nlevels];
+
+        if (!TIFFSetDirectory(tiff, (tdir_t)i))
+        {
+            break;
+        }
+
+        TIFFGetFieldDefaulted(tiff, TIFFTAG_SUBFILETYPE,     &subfileType);
+        TIFFGetFieldDefaulted(tiff, TIFFTAG_SAMPLESPERPIXEL, &samples);
+        TIFFGetFieldDefaulted(tiff, TIFFTAG_BITSPERSAMPLE,   &bits);
+        TIFFGetFieldDefaulted(tiff, TIFFTAG_PLANARCONFIG,    &planar);
+
+        if (i > 0 && 
+            (!(subfileType & FILETYPE_REDUCEDIMAGE) ||
+             (subfileType & FILETYPE_MASK)          ||
+             samples != img->samples || bits != img->bits ||
+             planar != PLANARCONFIG_CONTIG))
+        {
+            continue;
+        }
+
+        level->dir = (tdir_t)i;
+        TIFFGetField(tiff, TIFFTAG_IMAGEWIDTH,  &level->width);
+        TIFFGetField(tiff, TIFFTAG_IMAGELENGTH, &level->height);
+        level->tiled = TIFFIsTiled(tiff);
+
+        if (level->tiled)
+        {
+            TIFFGetField(tiff, TIFFTAG_TILEWIDTH,  &level->blockWidth);
+            TIFFGetField(tiff, TIFFTAG_TILELENGTH, &level->blockHeight);
+            level->blockSize = TIFFTileSize(tiff);
+        }
+        else
+        {
+            level->blockWidth = level->width;
+            TIFFGetFieldDefaulted(tiff, TIFFTAG_ROWSPERSTRIP, 
+                                  &level->blockHeight);
+
+            if (level->blockHeight > level->height)
+            {
+                level->blockHeight = level->height;
+            }
+
+            level->blockSize = TIFFStripSize(tiff);
+        }
+
+        if (level->blockSize > img->bufSize)
+        {
+            img->bufSize = level->blockSize;
+        }
+
+        /* Uncompressed blocks can be read from the mapping as is,
+         * provided their samples needn't be byte-swapped. */
+        uint16  compression;
+        uint32* offsets;
+        uint32* counts;
+
+        level->nblocks = level->tiled ? TIFFNumberOfTiles(tiff)
+                                      : TIFFNumberOfStrips(tiff);
+        level->offsets = NULL;
+        level->counts  = NULL;
+
+        TIFFGetFieldDefaulted(tiff, TIFFTAG_COMPRESSION, &compression);
+
+        if (mmap && compression == COMPRESSION_NONE &&
+            (bits == 8 || !TIFFIsByteSwapped(tiff)) &&
+            TIFFGetField(tiff, level->tiled ? TIFFTAG_TILEOFFSETS 
+                                            : TIFFTAG_STRIPOFFSETS,
+                         &offsets) &&
+            TIFFGetField(tiff, level->tiled ? TIFFTAG_TILEBYTECOUNTS 
+                                            : TIFFTAG_STRIPBYTECOUNTS,
+                         &counts))
+        {
+            size_t size = level->nblocks * sizeof(uint32);
+
+            level->offsets = (uint32*)Tcl_Alloc(size);
+            level->counts  = (uint32*)Tcl_Alloc(size);
+            memcpy(level->offsets, offsets, size);
+            memcpy(level->counts,  counts,  size);
+        }
+
+        img->nlevels++;
+    }
+
+    /* NEXT, sort the overviews by decreasing size; there are few. */
+    for (i = 2; i < img->nlevels; i++)
+    {
+        GeotiffLevel level = img->levels[i];
+
+        for (j = i; j > 1 && img->levels[j-1].width < level.width; j--)
+        {
+            img->levels[j] = img->levels[j-1];
+        }
+
+        img->levels[j] = level;
+    }
+
+    TIFFSetDirectory(tiff, img->levels[0].dir);
+    img->current = 0;
+
+    if (mmap)
+    {
+        mapGeotiff(img);
+    }
+
+    /* NEXT, register the handle. */
+    sprintf(name, "geotiff%d", ++info->counter);
+    entry = Tcl_CreateHashEntry(&info->images, name, &isNew);
+    Tcl_SetHashValue(entry, img);
+
+    Tcl_SetResult(interp, name, TCL_VOLATILE);
+
+    return TCL_OK;
+}
+
+/***********************************************************************
+ * 
+ * FUNCTION :
+ *     geotiff close handle
+ *
+ * INPUTS:
+ *     handle - a geotiff handle
+ *
+ * RETURNS:
+ *     Nothing.
+ *
+ * DESCRIPTION:
+ *     Closes the file and deletes the handle.
+ */
+
+static int
+geotiff_close(ClientData cd, Tcl_Interp *interp,
+              int objc, Tcl_Obj* CONST objv[])
+{
+    GeotiffInfo*   info = (GeotiffInfo*)cd;
+    GeotiffImage*  img;
+
+    if (objc != 3) {
+        Tcl_WrongNumArgs(interp, 2, objv, "handle");
+        return TCL_ERROR;
+    }
+
+    if (getGeotiff(interp, info, objv[2], &img) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
+
+    Tcl_DeleteHashEntry(Tcl_FindHashEntry(&info->images, 
+                                          Tcl_GetString(objv[2])));
+    closeGeotiff(img);
+
+    return TCL_OK;
+}
+
+/***********************************************************************
+ * 
+ * FUNCTION :
+ *     geotiff info handle
+ *
+ * INPUTS:
+ *     handle - a geotiff handle
+ *
+ * RETURNS:
+ *     A dict describing the image.
+ *
+ * DESCRIPTION:
+ *     Returns the "geotiff read" dict for the file, plus the following
+ *     keys: width and height, the size of the full-resolution image;
+ *     tiled, 1 if it's tiled and 0 if it's in strips; blockwidth and 
+ *     blockheight, the size of a tile or strip; samples, bits, and 
+ *     photometric, which describe its pixels; and levels, a list 
+ *     {width height} of the size of each level, starting with the
+ *     full-resolution image; and mapped, 1 if the full-resolution
+ *     image's pixels are read directly from a file mapping.
+ */
+
+static int
+geotiff_info(ClientData cd, Tcl_Interp *interp,
+             int objc, Tcl_Obj* CONST objv[])
+{
+    GeotiffInfo*   info = (GeotiffInfo*)cd;
+    GeotiffImage*  img;
+    GeotiffLevel*  top;
+    Tcl_Obj*       result;
+    Tcl_Obj*       levels;
+    int            i;
+
+    if (objc != 3) {
+        Tcl_WrongNumArgs(interp, 2, objv, "handle");
+        return TCL_ERROR;
+    }
+
+    if (getGeotiff(interp, info, objv[2], &img) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
+
+    top    = &img->levels[0];
+    result = Tcl_DuplicateObj(img->georef);
+    levels = Tcl_NewObj();
+
+    for (i = 0; i < img->nlevels; i++)
+    {
+        Tcl_Obj* size[2];
+
+        size[0] = Tcl_NewLongObj((long)img->levels[i].width);
+        size[1] = Tcl_NewLongObj((long)img->levels[i].height);
+        Tcl_ListObjAppendElement(interp, levels, Tcl_NewListObj(2, size));
+    }
+
+    Tcl_DictObjPut(interp, result, Tcl_NewStringObj("width", -1),
+                   Tcl_NewLongObj((long)top->width));
+    Tcl_DictObjPut(interp, result, Tcl_NewStringObj("height", -1),
+                   Tcl_NewLongObj((long)top->height));
+    Tcl_DictObjPut(interp, result, Tcl_NewStringObj("tiled", -1),
+                   Tcl_NewIntObj(top->tiled));
+    Tcl_DictObjPut(interp, result, Tcl_NewStringObj("blockwidth", -1),
+                   Tcl_NewLongObj((long)top->blockWidth));
+    Tcl_DictObjPut(interp, result, Tcl_NewStringObj("blockheight", -1),
+                   Tcl_NewLongObj((long)top->blockHeight));
+    Tcl_DictObjPut(interp, result, Tcl_NewStringObj("samples", -1),
+                   Tcl_NewIntObj(img->samples));
+    Tcl_DictObjPut(interp, result, Tcl_NewStringObj("bits", -1),
+                   Tcl_NewIntObj(img->bits));
+    Tcl_DictObjPut(interp, result, Tcl_NewStringObj("photometric", -1),
+                   Tcl_NewIntObj(img->photometric));
+    Tcl_DictObjPut(interp, result, Tcl_NewStringObj("levels", -1), levels);
+    Tcl_DictObjPut(interp, result, Tcl_NewStringObj("mapped", -1),
+                   Tcl_NewIntObj(img->map != NULL && top->offsets != NULL));
+
+    Tcl_SetObjResult(interp, result);
+
+    return TCL_OK;
+}
+
+/***********************************************************************
+ * 
+ * FUNCTION :
+ *     geotiff tile handle col row ?-level n?
+ *
+ * INPUTS:
+ *     handle - a geotiff handle
+ *     col    - the tile column, from 0
+ *     row    - the tile row, from 0
+ *     n      - the level, from 0, the full-resolution image
+ *
+ * RETURNS:
+ *     The tile's pixels, as a byte array.
+ *
+ * DESCRIPTION:
+ *     Decodes one tile of a tiled image directly into the result.
+ *     The result is always a full tile, blockwidth by blockheight
+ *     pixels in row-major order; tiles at the right and bottom edges
+ *     are padded.
+ */
+
+static int
+geotiff_tile(ClientData cd, Tcl_Interp *interp,
+             int objc, Tcl_Obj* CONST objv[])
+{
+    GeotiffInfo*   info = (GeotiffInfo*)cd;
+    GeotiffImage*  img;
+    GeotiffLevel*  level;
+    int            col;
+    int            row;
+
+    if (objc != 5 && objc != 7) {
+        Tcl_WrongNumArgs(interp, 2, objv, "handle col row ?-level n?");
+        return TCL_ERROR;
+    }
+
+    if (getGeotiff(interp, info, objv[2], &img) != TCL_OK ||
+        getLevel(interp, img, objc, objv, 5, &level) != TCL_OK ||
+        Tcl_GetIntFromObj(interp, objv[3], &col) != TCL_OK ||
+        Tcl_GetIntFromObj(interp, objv[4], &row) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
+
+    if (!level->tiled)
+    {
+        Tcl_SetResult(interp, "image is not tiled", TCL_STATIC);
+        return TCL_ERROR;
+    }
+
+    if (col < 0 || (uint32)col*level->blockWidth >= level->width ||
+        row < 0 || (uint32)row*level->blockHeight >= level->height)
+    {
+        Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+            "tile out of range: %d %d", col, row));
+        return TCL_ERROR;
+    }
+
+    /* NEXT, copy it from the mapping, or decode it. */
+    Tcl_Obj*       result = Tcl_NewByteArrayObj(NULL, 0);
+    unsigned char* bytes  = Tcl_SetByteArrayLength(result, level->blockSize);
+    ttile_t        tile   = TIFFComputeTile(img->tiff, 
+                                            col*level->blockWidth,
+                                            row*level->blockHeight, 0, 0);
+    unsigned char* mapped = mappedBlock(img, level, tile, level->blockSize);
+
+    if (mapped != NULL)
+    {
+        memcpy(bytes, mapped, level->blockSize);
+    }
+    else if (TIFFReadEncodedTile(img->tiff, tile, bytes, 
+                                 level->blockSize) < 0)
+    {
+        Tcl_DecrRefCount(result);
+        Tcl_SetResult(interp, "error decoding tile", TCL_STATIC);
+        return TCL_ERROR;
+    }
+
+    Tcl_SetObjResult(interp, result);
+
+    return TCL_OK;
+}
+
+/***********************************************************************
+ * 
+ * FUNCTION :
+ *     geotiff strip handle strip ?-level n?
+ *
+ * INPUTS:
+ *     handle - a geotiff handle
+ *     strip  - the strip number, from 0
+ *     n      - the level, from 0, the full-resolution image
+ *
+ * RETURNS:
+ *     The strip's pixels, as a byte array.
+ *
+ * DESCRIPTION:
+ *     Decodes one strip of a stripped image directly into the result:
+ *     blockheight rows of width pixels, or fewer for the last strip.
+ */
+
+static int
+geotiff_strip(ClientData cd, Tcl_Interp *interp,
+              int objc, Tcl_Obj* CONST objv[])
+{
+    GeotiffInfo*   info = (GeotiffInfo*)cd;
+    GeotiffImage*  img;
+    GeotiffLevel*  level;
+    int            strip;
+
+    if (objc != 4 && objc != 6) {
+        Tcl_WrongNumArgs(interp, 2, objv, "handle strip ?-level n?");
+        return TCL_ERROR;
+    }
+
+    if (getGeotiff(interp, info, objv[2], &img) != TCL_OK ||
+        getLevel(interp, img, objc, objv, 4, &level) != TCL_OK ||
+        Tcl_GetIntFromObj(interp, objv[3], &strip) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
+
+    if (level->tiled)
+    {
+        Tcl_SetResult(interp, "image is tiled", TCL_STATIC);
+        return TCL_ERROR;
+    }
+
+    if (strip < 0 || (uint32)strip*level->blockHeight >= level->height)
+    {
+        Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+            "strip out of range: %d", strip));
+        return TCL_ERROR;
+    }
+
+    /* NEXT, copy it from the mapping, or decode it. */
+    uint32         rows   = level->height - strip*level->blockHeight;
+    tsize_t        size   = (tsize_t)dmin(rows, level->blockHeight) * 
+                            level->width * img->pixelBytes;
+    Tcl_Obj*       result = Tcl_NewByteArrayObj(NULL, 0);
+    unsigned char* bytes  = Tcl_SetByteArrayLength(result, level->blockSize);
+    unsigned char* mapped = mappedBlock(img, level, strip, size);
+
+    if (mapped != NULL)
+    {
+        memcpy(bytes, mapped, size);
+    }
+    else
+    {
+        size = TIFFReadEncodedStrip(img->tiff, (tstrip_t)strip,
+                                    bytes, level->blockSize);
+    }
+
+    if (size < 0)
+    {
+        Tcl_DecrRefCount(result);
+        Tcl_SetResult(interp, "error decoding strip", TCL_STATIC);
+        return TCL_ERROR;
+    }
+
+    Tcl_SetByteArrayLength(result, size);
+    Tcl_SetObjResult(interp, result);
+
+    return TCL_OK;
+}
+
+/***********************************************************************
+ * 
+ * FUNCTION :
+ *     geotiff region handle x y width height ?-level n? ?-workers n?
+ *
+ * INPUTS:
+ *     handle - a geotiff handle
+ *     x, y   - the region's upper left pixel
+ *     width, height - the region's size in pixels
+ *     -level n   - the level, from 0, the full-resolution image
+ *     -workers n - the number of threads to decode with, 1 by default
+ *
+ * RETURNS:
+ *     The region's pixels, as a byte array.
+ *
+ * DESCRIPTION:
+ *     Decodes only the tiles or strips that overlap the region, which
+ *     must lie within the image, and copies the region's part of each
+ *     into the result, width by height pixels in row-major order.
+ *     Blocks in a file mapping are copied from directly.
+ *
+ *     With -workers, the blocks are split among up to n threads, each
+ *     decoding with its own handle on the file; see getDecoders().
+ */
+
+static int
+geotiff_region(ClientData cd, Tcl_Interp *interp,
+               int objc, Tcl_Obj* CONST objv[])
+{
+    GeotiffInfo*   info = (GeotiffInfo*)cd;
+    GeotiffImage*  img;
+    GeotiffLevel*  level;
+    RegionJob      job;
+    int            la      = objc;
+    int            workers = 1;
+    int            i;
+
+    if (objc < 7 || (objc - 7) % 2 != 0) {
+        Tcl_WrongNumArgs(interp, 2, objv, 
+                         "handle x y width height ?-level n? ?-workers n?");
+        return TCL_ERROR;
+    }
+
+    /* FIRST, get the options. */
+    for (i = 7; i < objc; i += 2)
+    {
+        if (isFlag(objv[i], "-level"))
+        {
+            la = i;
+        }
+        else if (isFlag(objv[i], "-workers"))
+        {
+            if (Tcl_GetIntFromObj(interp, objv[i + 1], &workers) != TCL_OK)
+            {
+                return TCL_ERROR;
+            }
+
+            if (workers < 1)
+            {
+                Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+                    "invalid -workers, should be at least 1: \"%s\"",
+                    Tcl_GetString(objv[i + 1])));
+                return TCL_ERROR;
+            }
+        }
+        else
+        {
+            Tcl_AppendStringsToObj(Tcl_GetObjResult(interp),
+                                   "unknown option: \"", 
+                                   Tcl_GetString(objv[i]), "\"", NULL);
+            return TCL_ERROR;
+        }
+    }
+
+    /* NEXT, get the image, level and region. */
+    if (getGeotiff(interp, info, objv[2], &img) != TCL_OK ||
+        getLevel(interp, img, (la < objc) ? la + 2 : la, objv, la, 
+                 &level) != TCL_OK ||
+        Tcl_GetIntFromObj(interp, objv[3], &job.x) != TCL_OK ||
+        Tcl_GetIntFromObj(interp, objv[4], &job.y) != TCL_OK ||
+        Tcl_GetIntFromObj(interp, objv[5], &job.w) != TCL_OK ||
+        Tcl_GetIntFromObj(interp, objv[6], &job.h) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
+
+    if (job.x < 0 || job.y < 0 || job.w < 1 || job.h < 1 ||
+        (uint32)job.x + job.w > level->width || 
+        (uint32)job.y + job.h > level->height)
+    {
+        Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+            "region out of bounds: %d %d %d %d", 
+            job.x, job.y, job.w, job.h));
+        return TCL_ERROR;
+    }
+
+    /* NEXT, get the block buffer. */
+    if (img->buf == NULL)
+    {
+        img->buf = _TIFFmalloc(img->bufSize);
+    }
+
+    /* NEXT, find the blocks that overlap the region. */
+    Tcl_Obj* result = Tcl_NewByteArrayObj(NULL, 0);
+    uint32   bx1;
+    uint32   by1;
+
+    job.img    = img;
+    job.level  = level;
+    job.bytes  = Tcl_SetByteArrayLength(result, 
+                                        (size_t)job.w*job.h*img->pixelBytes);
+    job.failed = 0;
+    job.put    = NULL;
+    job.bx     = job.x - job.x % level->blockWidth;
+    job.by     = job.y - job.y % level->blockHeight;
+    bx1        = job.x + job.w - 1;
+    by1        = job.y + job.h - 1;
+    job.cols   = (bx1 - job.bx) / level->blockWidth + 1;
+    job.nblocks = job.cols * ((by1 - job.by) / level->blockHeight + 1);
+
+    /* NEXT, decode them, on this thread or spread over the workers. */
+    if (workers > job.nblocks)
+    {
+        workers = job.nblocks;
+    }
+
+    if (workers > MAX_WORKERS)
+    {
+        workers = MAX_WORKERS;
+    }
+
+    if (workers > 1)
+    {
+        job.workers = getDecoders(img, level - img->levels, workers);
+        runWorkers(regionRange, (ClientData)&job, job.workers, 
+                   job.workers, 1);
+    }
+    else if (!regionBlocks(&job, img->tiff, img->buf, 0, job.nblocks))
+    {
+        job.failed = 1;
+    }
+
+    if (job.failed)
+    {
+        Tcl_DecrRefCount(result);
+        Tcl_SetResult(interp, "error decoding image", TCL_STATIC);
+        return TCL_ERROR;
+    }
+
+    Tcl_SetObjResult(interp, result);
+
+    return TCL_OK;
+}
+
+/***********************************************************************
+ * 
+ * FUNCTION :
+ *     geotiff tophoto handle photo ?x y width height? ?-level n?
+ *
+ * INPUTS:
+ *     handle - a geotiff handle
+ *     photo  - the name of a Tk photo image
+ *     x, y   - the region's upper left pixel
+ *     width, height - the region's size in pixels
+ *     n      - the level, from 0, the full-resolution image
+ *
+ * RETURNS:
+ *     Nothing.
+ *
+ * DESCRIPTION:
+ *     Decodes the region, the whole image by default, into the photo,
+ *     which is resized to the region.  Each tile or strip goes to the
+ *     photo straight from libTiff's decode buffer, or from the file
+ *     mapping, described by a Tk_PhotoImageBlock in the image's own
+ *     layout; only palette and white-is-zero images are converted,
+ *     a block at a time.  Tk must be loaded.
+ */
+
+static int
+geotiff_tophoto(ClientData cd, Tcl_Interp *interp,
+                int objc, Tcl_Obj* CONST objv[])
+{
+    GeotiffInfo*   info = (GeotiffInfo*)cd;
+    GeotiffImage*  img;
+    GeotiffLevel*  level;
+    RegionJob      job;
+    PhotoJob       pj;
+    int            a;
+    int            code = TCL_OK;
+
+    if (objc == 4 || objc == 6) {
+        a = 4;
+    } else if (objc == 8 || objc == 10) {
+        a = 8;
+    } else {
+        Tcl_WrongNumArgs(interp, 2, objv, 
+                         "handle photo ?x y width height? ?-level n?");
+        return TCL_ERROR;
+    }
+
+    /* FIRST, get the image, level and photo. */
+    if (getGeotiff(interp, info, objv[2], &img) != TCL_OK ||
+        getLevel(interp, img, objc, objv, a, &level) != TCL_OK ||
+        getTkStubs(interp) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
+
+    pj.interp = interp;
+    pj.photo  = Tk_FindPhoto(interp, Tcl_GetString(objv[3]));
+
+    if (pj.photo == NULL)
+    {
+        Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+            "image \"%s\" doesn't exist or is not a photo image",
+            Tcl_GetString(objv[3])));
+        return TCL_ERROR;
+    }
+
+    /* NEXT, get the region. */
+    if (a == 8)
+    {
+        if (Tcl_GetIntFromObj(interp, objv[4], &job.x) != TCL_OK ||
+            Tcl_GetIntFromObj(interp, objv[5], &job.y) != TCL_OK ||
+            Tcl_GetIntFromObj(interp, objv[6], &job.w) != TCL_OK ||
+            Tcl_GetIntFromObj(interp, objv[7], &job.h) != TCL_OK)
+        {
+            return TCL_ERROR;
+        }
+    }
+    else
+    {
+        job.x = 0;
+        job.y = 0;
+        job.w = level->width;
+        job.h = level->height;
+    }
+
+    if (job.x < 0 || job.y < 0 || job.w < 1 || job.h < 1 ||
+        (uint32)job.x + job.w > level->width || 
+        (uint32)job.y + job.h > level->height)
+    {
+        Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+            "region out of bounds: %d %d %d %d", 
+            job.x, job.y, job.w, job.h));
+        return TCL_ERROR;
+    }
+
+    /* NEXT, see how to present the pixels to Tk. */
+    if (photoLayout(interp, img, &pj) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
+
+    if (img->buf == NULL)
+    {
+        img->buf = _TIFFmalloc(img->bufSize);
+    }
+
+    pj.temp = NULL;
+
+    if (pj.convert != PHOTO_ASIS)
+    {
+        pj.temp = (unsigned char*)Tcl_Alloc(
+            (size_t)level->blockWidth * level->blockHeight * 
+            pj.block.pixelSize);
+    }
+
+    /* NEXT, put the blocks that overlap the region. */
+    uint32 bx1 = job.x + job.w - 1;
+    uint32 by1 = job.y + job.h - 1;
+
+    job.img     = img;
+    job.level   = level;
+    job.bytes   = NULL;
+    job.failed  = 0;
+    job.put     = photoBlock;
+    job.putData = (ClientData)&pj;
+    job.bx      = job.x - job.x % level->blockWidth;
+    job.by      = job.y - job.y % level->blockHeight;
+    job.cols    = (bx1 - job.bx) / level->blockWidth + 1;
+    job.nblocks = job.cols * ((by1 - job.by) / level->blockHeight + 1);
+    job.workers = 1;
+
+    if (Tk_PhotoSetSize(interp, pj.photo, job.w, job.h) != TCL_OK)
+    {
+        code = TCL_ERROR;
+    }
+    else if (!regionBlocks(&job, img->tiff, img->buf, 0, job.nblocks))
+    {
+        /* A failed put leaves its own error message. */
+        if (*Tcl_GetStringResult(interp) == '\0')
+        {
+            Tcl_SetResult(interp, "error decoding image", TCL_STATIC);
+        }
+
+        code = TCL_ERROR;
+    }
+
+    if (pj.temp != NULL)
+    {
+        Tcl_Free((char*)pj.temp);
+    }
+
+    return code;
+}
+
+/***********************************************************************
+ * 
+ * FUNCTION :
+ *     geotiff tolatlong ?-exact? handle x y ?x y...?
+ *
+ * INPUTS:
+ *     -exact - convert each point exactly, without the control grid
+ *     handle - a geotiff handle
+ *     x, y   - pixel coordinates in the full-resolution image
+ *
+ * RETURNS:
+ *     A flat list of lat/long pairs, in decimal degrees.
+ *
+ * DESCRIPTION:
+ *     Converts pixel coordinates to lat/long on the image's datum.
+ *     The coordinates needn't be integers, nor within the image.  For
+ *     a projected image, the conversion is interpolated from a control
+ *     grid built on first use; see geotiffConvert().
+ */
+
+static int
+geotiff_tolatlong(ClientData cd, Tcl_Interp *interp,
+                  int objc, Tcl_Obj* CONST objv[])
+{
+    return geotiffConvert((GeotiffInfo*)cd, interp, objc, objv, 0);
+}
+
+/***********************************************************************
+ * 
+ * FUNCTION :
+ *     geotiff topixel ?-exact? handle lat lon ?lat lon...?
+ *
+ * INPUTS:
+ *     -exact   - convert each point exactly, without the control grid
+ *     handle   - a geotiff handle
+ *     lat, lon - a location in decimal degrees, on the image's datum
+ *
+ * RETURNS:
+ *     A flat list of x/y pairs, in pixels in the full-resolution image.
+ *
+ * DESCRIPTION:
+ *     Converts lat/long to pixel coordinates, the inverse of
+ *     geotiff tolatlong.
+ */
+
+static int
+geotiff_topixel(ClientData cd, Tcl_Interp *interp,
+                int objc, Tcl_Obj* CONST objv[])
+{
+    return geotiffConvert((GeotiffInfo*)cd, interp, objc, objv, 1);
+}
+
+/*
+ * raster command and subcommands
+ */
+
+/***********************************************************************
+ * 
+ * FUNCTION :
+ *     marsutil_rasterCmd()
+ *
+ * INPUTS:
+ *     subcommand        The subcommand name
+ *     args              Subcommand arguments
+ *
+ * RETURNS:
+ *     Whatever the subcommand returns.
+ *
+ * DESCRIPTION:
+ *     This is the ensemble command for the raster subcommands.
+ *     It looks up the subcommand name, and then passes execution
+ *     to the subcommand proc.
+ */
+
+static int
+marsutil_rasterCmd(ClientData cd, Tcl_Interp* interp,
+                   int objc, Tcl_Obj* CONST objv[])
+{
+    if (objc < 2)
+    {
+        Tcl_WrongNumArgs(interp, 1, objv, "subcommand ?arg arg ...?");
+        return TCL_ERROR;
+    }
+
+    int index = 0;
+
+    if (Tcl_GetIndexFromObjStruct(interp, objv[1],
+                                  rasterTable, sizeof(SubcommandVector),
+                                  "subcommand",
+                                  TCL_EXACT,
+                                  &index) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
+
+    return(*rasterTable[index].proc)(cd, interp, objc, objv);
+}
+
+/***********************************************************************
+ * 
+ * FUNCTION :
+ *     raster scale ppm up down
+ *
+ * INPUTS:
+ *     ppm      - A binary (P6) PPM image with 8-bit samples
+ *     up, down - The zoom factor, up/down
+ *
+ * RETURNS:
+ *     The scaled image, as a binary PPM.
+ *
+ * DESCRIPTION:
+ *     Scales the image by up/down, as "image copy -zoom up" followed 
+ *     by "-subsample down" would, but in one pass and with filtering:
+ *     reductions average each output pixel's footprint, and
+ *     enlargements interpolate bilinearly.  The result may have at
+ *     most MAX_RASTER_PIXELS pixels.
+ */
+
+static int
+raster_scale(ClientData cd, Tcl_Interp *interp,
+             int objc, Tcl_Obj* CONST objv[])
+{
+    Raster src;
+    Raster dst;
+    int    up;
+    int    down;
+
+    if (objc != 5) {
+        Tcl_WrongNumArgs(interp, 2, objv, "ppm up down");
+        return TCL_ERROR;
+    }
+
+    if (getPpm(interp, objv[2], &src) != TCL_OK ||
+        Tcl_GetIntFromObj(interp, objv[3], &up) != TCL_OK ||
+        Tcl_GetIntFromObj(interp, objv[4], &down) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
+
+    if (up < 1 || down < 1)
+    {
+        Tcl_SetResult(interp, "invalid zoom factor", TCL_STATIC);
+        return TCL_ERROR;
+    }
+
+    if (getScaledSize(interp, &src, up, down, &dst) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
+
+    dst.pixels = (unsigned char*)Tcl_Alloc(3*(size_t)dst.width*dst.height);
+
+    scaleRaster(&src, &dst, up, down, 1);
+
+    Tcl_Obj* result = newPpmObj(interp, &dst);
+    Tcl_Free((char*)dst.pixels);
+
+    if (result == NULL)
+    {
+        return TCL_ERROR;
+    }
+
+    Tcl_SetObjResult(interp, result);
+
+    return TCL_OK;
+}
+
+/***********************************************************************
+ * 
+ * FUNCTION :
+ *     raster pyramid ?-workers n? ?-file name? ?-command cmd? ppm factors
+ *
+ * INPUTS:
+ *     n        - The number of threads to scale each level with,
+ *                1 to MAX_WORKERS; defaults to the number of CPUs
+ *     name     - A file to write the scaled images to
+ *     cmd      - A command prefix
+ *     ppm      - A binary (P6) PPM image with 8-bit samples
+ *     factors  - A list of zoom factors, {up down}
+ *
+ * RETURNS:
+ *     A list of the scaled images, as binary PPMs, one for each
+ *     factor; or nothing, if -command is given.
+ *
+ * DESCRIPTION:
+ *     Scales the image by each factor, as for "raster scale", and
+ *     with the same limit on the size of each level.  If 
+ *     -file is given, the scaled images are written one after another
+ *     to the file as they're done, rather than kept in memory, and
+ *     the result is a list of {offset length} pairs giving each one's
+ *     place in the file.  
+ *
+ *     If -command is given, the scaling is done on a background 
+ *     thread, and the command is called with the result appended
+ *     when the event loop next runs after it's done.  Errors in the
+ *     callback, or in writing the file, are background errors.  
+ *     Without thread support, the scaling is done at once, but the 
+ *     callback still waits for the event loop.  The background
+ *     thread's copy of the ppm is freed as soon as the levels exist.
+ */
+
+static int
+raster_pyramid(ClientData cd, Tcl_Interp *interp,
+               int objc, Tcl_Obj* CONST objv[])
+{
+    Tcl_Obj*  command = NULL;
+    Tcl_Obj*  file    = NULL;
+    int       workers = cpuCount();
+    Raster    base;
+    int       nfactors;
+    Tcl_Obj** factors;
+    int       a;
+    int       i;
+
+    /* FIRST, get the options. */
+    for (a = 2; a < objc - 2; a += 2)
+    {
+        if (isFlag(objv[a], "-workers"))
+        {
+            if (Tcl_GetIntFromObj(interp, objv[a+1], &workers) != TCL_OK)
+            {
+                return TCL_ERROR;
+            }
+
+            if (workers < 1 || workers > MAX_WORKERS)
+            {
+                Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+                    "invalid -workers, should be 1 to %d: \"%s\"",
+                    MAX_WORKERS, Tcl_GetString(objv[a+1])));
+                return TCL_ERROR;
+            }
+        }
+        else if (isFlag(objv[a], "-file"))
+        {
+            file = objv[a+1];
+        }
+        else if (isFlag(objv[a], "-command"))
+        {
+            command = objv[a+1];
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    if (objc - a != 2) {
+        Tcl_WrongNumArgs(interp, 2, objv, 
+            "?-workers n? ?-file name? ?-command cmd? ppm factors");
+        return TCL_ERROR;
+    }
+
+    if (getPpm(interp, objv[a], &base) != TCL_OK ||
+        Tcl_ListObjGetElements(interp, objv[a+1], 
+                               &nfactors, &factors) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
+
+    /* NEXT, set up the pyramid. */
+    Pyramid* p = (Pyramid*)Tcl_Alloc(sizeof(Pyramid));
+    memset(p, 0, sizeof(Pyramid));
+
+    p->workers = workers;
+    p->nlevels = nfactors;
+    p->up      = (int*)Tcl_Alloc(sizeof(int)*(nfactors + 1));
+    p->down    = (int*)Tcl_Alloc(sizeof(int)*(nfactors + 1));
+    p->levels  = (Raster*)Tcl_Alloc(sizeof(Raster)*(nfactors + 1));
+    p->offsets = (long*)Tcl_Alloc(sizeof(long)*(nfactors + 1));
+    p->lengths = (long*)Tcl_Alloc(sizeof(long)*(nfactors + 1));
+    memset(p->levels, 0, sizeof(Raster)*(nfactors + 1));
+
+    if (file != NULL)
+    {
+        int   length;
+        char* name = Tcl_GetStringFromObj(file, &length);
+        
+        p->file = Tcl_Alloc(length + 1);
+        strcpy(p->file, name);
+    }
+
+    for (i = 0; i < nfactors; i++)
+    {
+        if (getZoomFactor(interp, factors[i], 
+                          &p->up[i], &p->down[i]) != TCL_OK ||
+            getScaledSize(interp, &base, p->up[i], p->down[i], 
+                          &p->levels[i]) != TCL_OK)
+        {
+            freePyramid(p);
+            Tcl_Free((char*)p);
+            return TCL_ERROR;
+        }
+    }
+
+    p->base = base;
+
+    /* NEXT, if there's no command, build it now. */
+    if (command == NULL)
+    {
+        Tcl_Obj* result;
+        int      code;
+
+        buildPyramid(p);
+        p->base.pixels = NULL;
+
+        code = getPyramidResult(interp, p, &result);
+
+        freePyramid(p);
+        Tcl_Free((char*)p);
+
+        if (code == TCL_OK)
+        {
+            Tcl_SetObjResult(interp, result);
+        }
+
+        return code;
+    }
+
+    /* NEXT, build it in the background, and queue the callback on this
+     * thread when it's done.  It needs a private copy of the base, 
+     * since the PPM's bytes may change or be freed meanwhile. */
+    size_t size = 3*(size_t)base.width*base.height;
+
+    p->base.pixels = (unsigned char*)Tcl_Alloc(size);
+    memcpy(p->base.pixels, base.pixels, size);
+
+    p->interp  = interp;
+    p->owner   = Tcl_GetCurrentThread();
+    p->command = command;
+    p->header.proc = pyramidEventProc;
+    Tcl_IncrRefCount(command);
+    Tcl_Preserve((ClientData)interp);
+
+#ifdef TCL_THREADS
+    Tcl_ThreadId id;
+
+    if (Tcl_CreateThread(&id, pyramidThread, (ClientData)p,
+                         TCL_THREAD_STACK_DEFAULT, 
+                         TCL_THREAD_NOFLAGS) == TCL_OK)
+    {
+        return TCL_OK;
+    }
+#endif /* TCL_THREADS */
+
+    buildPyramid(p);
+    Tcl_Free((char*)p->base.pixels);
+    p->base.pixels = NULL;
+
+    Tcl_QueueEvent((Tcl_Event*)p, TCL_QUEUE_TAIL);
+
+    return TCL_OK;
+}
+
+/*
+ * curvestore command and subcommands
+ */
+
+/***********************************************************************
+ * 
+ * FUNCTION :
+ *     marsutil_curvestoreCmd()
+ *
+ * INPUTS:
+ *     subcommand        The subcommand name
+ *     args              Subcommand arguments
+ *
+ * RETURNS:
+ *     Whatever the subcommand returns.
+ *
+ * DESCRIPTION:
+ *     This is the ensemble command for the curvestore subcommands.
+ *     It looks up the subcommand name, and then passes execution
+ *     to the subcommand proc.
+ */
+
+static int
+marsutil_curvestoreCmd(ClientData cd, Tcl_Interp* interp,
+                       int objc, Tcl_Obj* CONST objv[])
+{
+    if (objc < 2)
+    {
+        Tcl_WrongNumArgs(interp, 1, objv, "subcommand ?arg arg ...?");
+        return TCL_ERROR;
+    }
+
+    resetScratch(&((CurveInfo*)cd)->scratch);
+
+    int index = 0;
+
+    if (Tcl_GetIndexFromObjStruct(interp, objv[1],
+                                  curvestoreTable, sizeof(SubcommandVector),
+                                  "subcommand",
+                                  TCL_EXACT,
+                                  &index) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
+
+    return(*curvestoreTable[index].proc)(cd, interp, objc, objv);
+}
+
+/***********************************************************************
+ * 
+ * FUNCTION :
+ *     curvestore create
+ *
+ * INPUTS:
+ *     none
+ *
+ * RETURNS:
+ *     A new, empty curvestore handle
+ */
+
+static int
+curvestore_create(ClientData cd, Tcl_Interp *interp,
+                  int objc, Tcl_Obj* CONST objv[])
+{
+    CurveInfo*     info = (CurveInfo*)cd;
+    CurveStore*    store;
+    Tcl_HashEntry* entry;
+    int            isNew;
+    char           name[40];
+
+    if (objc != 2) {
+        Tcl_WrongNumArgs(interp, 2, objv, "");
+        return TCL_ERROR;
+    }
+
+    store = (CurveStore*)Tcl_Alloc(sizeof(CurveStore));
+    memset(store, 0, sizeof(CurveStore));
+
+    sprintf(name, "curvestore%d", ++info->counter);
+    entry = Tcl_CreateHashEntry(&info->stores, name, &isNew);
+    Tcl_SetHashValue(entry, store);
+
+    Tcl_SetResult(interp, name, TCL_VOLATILE);
+
+    return TCL_OK;
+}
+
+/***********************************************************************
+ * 
+ * FUNCTION :
+ *     curvestore delete handle
+ *
+ * INPUTS:
+ *     handle - a curvestore handle
+ *
+ * RETURNS:
+ *     Nothing.
+ *
+ * DESCRIPTION:
+ *     Deletes the store and its curves.
+ */
+
+static int
+curvestore_delete(ClientData cd, Tcl_Interp *interp,
+                  int objc, Tcl_Obj* CONST objv[])
+{
+    CurveInfo*  info = (CurveInfo*)cd;
+    CurveStore* store;
+
+    if (objc != 3) {
+        Tcl_WrongNumArgs(interp, 2, objv, "handle");
+        return TCL_ERROR;
+    }
+
+    if (getCurveStore(interp, info, objv[2], &store) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
+
+    Tcl_DeleteHashEntry(Tcl_FindHashEntry(&info->stores, 
+                                          Tcl_GetString(objv[2])));
+    freeCurveStore(store);
+
+    return TCL_OK;
+}
+
+/***********************************************************************
+ * 
+ * FUNCTION :
+ *     curvestore load handle ctypes curves
+ *
+ * INPUTS:
+ *     handle - a curvestore handle
+ *     ctypes - A flat list {ct_id min max alpha beta gamma ...}
+ *     curves - A flat list 
+ *              {curve_id ct_id a b c delta posfactor negfactor ...},
+ *              in increasing order of curve_id.
+ *
+ * RETURNS:
+ *     Nothing.
+ *
+ * DESCRIPTION:
+ *     Replaces the store's curves with the given curves, which are
+ *     typically the tracked rows of ucurve_curves_t, and their types
+ *     from the ucurve_ctypes view.  The store's arrays are kept from
+ *     one load to the next, so that loading the same curves every
+ *     tick doesn't touch the heap.
+ *
+ *     If the curve IDs are reasonably dense, as they are when the
+ *     database assigns them, a curve is found by indexing an array
+ *     of curve indices by its ID; otherwise, by binary search.
+ */
+
+static int
+curvestore_load(ClientData cd, Tcl_Interp *interp,
+                int objc, Tcl_Obj* CONST objv[])
+{
+    CurveInfo*   info = (CurveInfo*)cd;
+    CurveStore*  store;
+    int          ntypes;
+    Tcl_Obj**    types;
+    int          ncurves;
+    Tcl_Obj**    curves;
+    Tcl_WideInt* typeIds;
+    double*      typeParms;
+    int          i;
+    int          j;
+    int          k;
+
+    if (objc != 5) {
+        Tcl_WrongNumArgs(interp, 2, objv, "handle ctypes curves");
+        return TCL_ERROR;
+    }
+
+    if (getCurveStore(interp, info, objv[2], &store) != TCL_OK ||
+        Tcl_ListObjGetElements(interp, objv[3], &ntypes, &types) != TCL_OK ||
+        Tcl_ListObjGetElements(interp, objv[4], &ncurves, &curves) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
+
+    if (ntypes % 6 != 0)
+    {
+        Tcl_SetResult(interp, 
+            "expected ctypes {ct_id min max alpha beta gamma ...}",
+            TCL_STATIC);
+        return TCL_ERROR;
+    }
+
+    if (ncurves % 8 != 0)
+    {
+        Tcl_SetResult(interp, 
+            "expected curves "
+            "{curve_id ct_id a b c delta posfactor negfactor ...}",
+            TCL_STATIC);
+        return TCL_ERROR;
+    }
+
+    ntypes  /= 6;
+    ncurves /= 8;
+
+    /* FIRST, get the curve types; there are few. */
+    typeIds   = (Tcl_WideInt*)scratchAlloc(&info->scratch, 
+                                           ntypes*sizeof(Tcl_WideInt));
+    typeParms = (double*)scratchAlloc(&info->scratch, 
+                                      5*ntypes*sizeof(double));
+
+    for (i = 0; i < ntypes; i++)
+    {
+        if (Tcl_GetWideIntFromObj(interp, types[6*i], 
+                                  &typeIds[i]) != TCL_OK)
+        {
+            return TCL_ERROR;
+        }
+
+        for (k = 0; k < 5; k++)
+        {
+            if (Tcl_GetDoubleFromObj(interp, types[6*i + k + 1], 
+                                     &typeParms[5*i + k]) != TCL_OK)
+            {
+                return TCL_ERROR;
+            }
+        }
+    }
+
+    /* NEXT, get the curves.  On error the store is left empty. */
+    sizeCurveStore(store, ncurves);
+    store->size   = 0;
+    store->nslots = 0;
+
+    for (i = 0; i < ncurves; i++)
+    {
+        Tcl_Obj**   fields = &curves[8*i];
+        Tcl_WideInt id;
+        Tcl_WideInt ctId;
+
+        if (Tcl_GetWideIntFromObj(interp, fields[0], &id)   != TCL_OK ||
+            Tcl_GetWideIntFromObj(interp, fields[1], &ctId) != TCL_OK ||
+            Tcl_GetDoubleFromObj(interp, fields[2], &store->a[i])  != TCL_OK ||
+            Tcl_GetDoubleFromObj(interp, fields[3], &store->b[i])  != TCL_OK ||
+            Tcl_GetDoubleFromObj(interp, fields[4], &store->c[i])  != TCL_OK ||
+            Tcl_GetDoubleFromObj(interp, fields[5], 
+                                 &store->delta[i]) != TCL_OK ||
+            Tcl_GetDoubleFromObj(interp, fields[6], 
+                                 &store->posfactor[i]) != TCL_OK ||
+            Tcl_GetDoubleFromObj(interp, fields[7], 
+                                 &store->negfactor[i]) != TCL_OK)
+        {
+            return TCL_ERROR;
+        }
+
+        if (i > 0 && id <= store->ids[i-1])
+        {
+            Tcl_SetResult(interp, "curves are not in curve_id order",
+                          TCL_STATIC);
+            return TCL_ERROR;
+        }
+
+        for (j = 0; j < ntypes && typeIds[j] != ctId; j++)
+        {
+            /* Look for the type */
+        }
+
+        if (j == ntypes)
+        {
+            Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+                "unknown ct_id for curve %s: \"%s\"",
+                Tcl_GetString(fields[0]), Tcl_GetString(fields[1])));
+            return TCL_ERROR;
+        }
+
+        store->ids[i]   = id;
+        store->min[i]   = typeParms[5*j];
+        store->max[i]   = typeParms[5*j + 1];
+        store->alpha[i] = typeParms[5*j + 2];
+        store->beta[i]  = typeParms[5*j + 3];
+        store->gamma[i] = typeParms[5*j + 4];
+
+        store->loaded[5*i]     = store->a[i];
+        store->loaded[5*i + 1] = store->b[i];
+        store->loaded[5*i + 2] = store->delta[i];
+        store->loaded[5*i + 3] = store->posfactor[i];
+        store->loaded[5*i + 4] = store->negfactor[i];
+    }
+
+    store->size = ncurves;
+
+    /* NEXT, index the curves by ID, if they're dense enough. */
+    Tcl_WideInt maxId = ncurves > 0 ? store->ids[ncurves - 1] : -1;
+
+    if (ncurves > 0 && store->ids[0] >= 0 && 
+        maxId < 4*(Tcl_WideInt)ncurves + 1024)
+    {
+        if (maxId >= store->maxSlots)
+        {
+            if (store->slots != NULL)
+            {
+                Tcl_Free((char*)store->slots);
+            }
+
+            store->slots    = (int*)Tcl_Alloc((maxId + 1)*sizeof(int));
+            store->maxSlots = (int)maxId + 1;
+        }
+
+        store->nslots = (int)maxId + 1;
+
+        for (i = 0; i < store->nslots; i++)
+        {
+            store->slots[i] = -1;
+        }
+
+        for (i = 0; i < ncurves; i++)
+        {
+            store->slots[store->ids[i]] = i;
+        }
+    }
+
+    return TCL_OK;
+}
+
+/***********************************************************************
+ * 
+ * FUNCTION :
+ *     curvestore apply handle effects ?-start?
+ *
+ * INPUTS:
+ *     handle  - a curvestore handle
+ *     effects - A flat list {curve_id cause_id driver_id pflag mag ...},
+ *               in order of entry.
+ *     -start  - The start flag
+ *
+ * RETURNS:
+ *     A flat list {curve_id driver_id contrib ...} of the total actual
+ *     contribution of each driver to each curve, ordered by curve_id
+ *     and driver_id.
+ *
+ * DESCRIPTION:
+ *     Applies the effects to the loaded curves as "ucurve apply" does,
+ *     given that the adjustments have already been made and that the
+ *     effects are all on tracked curves:
+ *
+ *     Unless -start, computes the new baseline B.t = alpha*A + beta*B +
+ *     gamma*C and its scaling factors, and then applies the persistent
+ *     effects to the baseline.  With -start, it just computes the 
+ *     scaling factors of the current baseline, and the persistent 
+ *     effects are ignored.
+ *
+ *     Then applies the transient effects to the baseline, giving the
+ *     current level A.t.
+ *
+ *     Effects on curves that aren't in the store have no actual
+ *     contribution.  Use "curvestore changes" to get the updated 
+ *     curves.
+ */
+
+static int
+curvestore_apply(ClientData cd, Tcl_Interp *interp,
+                 int objc, Tcl_Obj* CONST objv[])
+{
+    CurveInfo*   info = (CurveInfo*)cd;
+    CurveStore*  store;
+    int          start = 0;
+    int          n;
+    Tcl_Obj**    elems;
+    CurveEffect* effects;
+    int          i;
+    int          j;
+
+    if (objc == 5 && isFlag(objv[4], "-start")) {
+        start = 1;
+    } else if (objc != 4) {
+        Tcl_WrongNumArgs(interp, 2, objv, "handle effects ?-start?");
+        return TCL_ERROR;
+    }
+
+    if (getCurveStore(interp, info, objv[2], &store) != TCL_OK ||
+        Tcl_ListObjGetElements(interp, objv[3], &n, &elems) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
+
+    if (n % 5 != 0)
+    {
+        Tcl_SetResult(interp, 
+            "expected effects {curve_id cause_id driver_id pflag mag ...}",
+            TCL_STATIC);
+        return TCL_ERROR;
+    }
+
+    n /= 5;
+
+    /* FIRST, get the effects. */
+    effects = (CurveEffect*)scratchAlloc(&info->scratch, 
+                                         n*sizeof(CurveEffect));
+
+    for (i = 0; i < n; i++)
+    {
+        CurveEffect* e = &effects[i];
+        Tcl_Obj**    fields = &elems[5*i];
+
+        if (Tcl_GetWideIntFromObj(interp, fields[0], &e->curveId)  != TCL_OK ||
+            Tcl_GetWideIntFromObj(interp, fields[1], &e->causeId)  != TCL_OK ||
+            Tcl_GetWideIntFromObj(interp, fields[2], &e->driverId) != TCL_OK ||
+            Tcl_GetIntFromObj(interp, fields[3], &e->pflag)        != TCL_OK ||
+            Tcl_GetDoubleFromObj(interp, fields[4], &e->mag)       != TCL_OK)
+        {
+            return TCL_ERROR;
+        }
+
+        e->slot   = curveSlot(store, e->curveId);
+        e->order  = i;
+        e->actual = 0.0;
+    }
+
+    /* NEXT, group the effects by pflag, curve, and cause. */
+    qsort(effects, n, sizeof(CurveEffect), compareEffectsByCause);
+
+    /* NEXT, update the baseline. */
+    if (!start)
+    {
+        curveBaseline(store);
+
+        if (curveEffects(store, effects, n, 1))
+        {
+            curveUpdate(store);
+        }
+    }
+    else
+    {
+        memset(store->delta, 0, store->size*sizeof(double));
+        curveUpdate(store);
+    }
+
+    /* NEXT, compute the current levels. */
+    curveEffects(store, effects, n, 0);
+    curveLevels(store);
+
+    /* NEXT, total the actual contributions by curve and driver. */
+    Tcl_Obj* result = Tcl_NewListObj(0, NULL);
+
+    qsort(effects, n, sizeof(CurveEffect), compareEffectsByDriver);
+
+    for (i = 0; i < n; i = j)
+    {
+        double contrib = 0.0;
+
+        for (j = i; j < n && effects[j].curveId  == effects[i].curveId &&
+                             effects[j].driverId == effects[i].driverId; 
+             j++)
+        {
+            contrib += effects[j].actual;
+        }
+
+        Tcl_ListObjAppendElement(interp, result, 
+                                 Tcl_NewWideIntObj(effects[i].curveId));
+        Tcl_ListObjAppendElement(interp, result, 
+                                 Tcl_NewWideIntObj(effects[i].driverId));
+        Tcl_ListObjAppendElement(interp, result, Tcl_NewDoubleObj(contrib));
+    }
+
+    Tcl_SetObjResult(interp, result);
+
+    return TCL_OK;
+}
+
+/***********************************************************************
+ * 
+ * FUNCTION :
+ *     curvestore changes handle
+ *
+ * INPUTS:
+ *     handle - a curvestore handle
+ *
+ * RETURNS:
+ *     A flat list {curve_id a b delta posfactor negfactor ...}
+ *
+ * DESCRIPTION:
+ *     Returns the curves whose a, b, delta, posfactor, or negfactor
+ *     differ from the values last loaded, in curve_id order, so that
+ *     the caller can write back only the curves that have changed.
+ */
+
+static int
+curvestore_changes(ClientData cd, Tcl_Interp *interp,
+                   int objc, Tcl_Obj* CONST objv[])
+{
+    CurveInfo*  info = (CurveInfo*)cd;
+    CurveStore* store;
+    Tcl_Obj*    result;
+    int         i;
+
+    if (objc != 3) {
+        Tcl_WrongNumArgs(interp, 2, objv, "handle");
+        return TCL_ERROR;
+    }
+
+    if (getCurveStore(interp, info, objv[2], &store) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
+
+    result = Tcl_NewListObj(0, NULL);
+
+    for (i = 0; i < store->size; i++)
+    {
+        double* loaded = &store->loaded[5*i];
+
+        if (store->a[i]         == loaded[0] &&
+            store->b[i]         == loaded[1] &&
+            store->delta[i]     == loaded[2] &&
+            store->posfactor[i] == loaded[3] &&
+            store->negfactor[i] == loaded[4])
+        {
+            continue;
+        }
+
+        Tcl_ListObjAppendElement(interp, result, 
+                                 Tcl_NewWideIntObj(store->ids[i]));
+        Tcl_ListObjAppendElement(interp, result, 
+                                 Tcl_NewDoubleObj(store->a[i]));
+        Tcl_ListObjAppendElement(interp, result, 
+                                 Tcl_NewDoubleObj(store->b[i]));
+        Tcl_ListObjAppendElement(interp, result, 
+                                 Tcl_NewDoubleObj(store->delta[i]));
+        Tcl_ListObjAppendElement(interp, result, 
+                                 Tcl_NewDoubleObj(store->posfactor[i]));
+        Tcl_ListObjAppendElement(interp, result, 
+                                 Tcl_NewDoubleObj(store->negfactor[i]));
+    }
+
+    Tcl_SetObjResult(interp, result);
+
+    return TCL_OK;
+}
+
+/***********************************************************************
+ * 
+ * FUNCTION :
+ *     curvestore get handle curve_id
+ *
+ * INPUTS:
+ *     handle   - a curvestore handle
+ *     curve_id - a curve ID
+ *
+ * RETURNS:
+ *     A list {a b c delta posfactor negfactor}
+ *
+ * DESCRIPTION:
+ *     Returns the curve's current values.
+ */
+
+static int
+curvestore_get(ClientData cd, Tcl_Interp *interp,
+               int objc, Tcl_Obj* CONST objv[])
+{
+    CurveInfo*  info = (CurveInfo*)cd;
+    CurveStore* store;
+    Tcl_WideInt id;
+    int         i;
+
+    if (objc != 4) {
+        Tcl_WrongNumArgs(interp, 2, objv, "handle curve_id");
+        return TCL_ERROR;
+    }
+
+    if (getCurveStore(interp, info, objv[2], &store) != TCL_OK ||
+        Tcl_GetWideIntFromObj(interp, objv[3], &id) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
+
+    i = curveSlot(store, id);
+
+    if (i < 0)
+    {
+        Tcl_AppendStringsToObj(Tcl_GetObjResult(interp), 
+                               "unknown curve_id: \"", 
+                               Tcl_GetString(objv[3]), "\"", NULL);
+        return TCL_ERROR;
+    }
+
+    Tcl_Obj* values[6];
+
+    values[0] = Tcl_NewDoubleObj(store->a[i]);
+    values[1] = Tcl_NewDoubleObj(store->b[i]);
+    values[2] = Tcl_NewDoubleObj(store->c[i]);
+    values[3] = Tcl_NewDoubleObj(store->delta[i]);
+    values[4] = Tcl_NewDoubleObj(store->posfactor[i]);
+    values[5] = Tcl_NewDoubleObj(store->negfactor[i]);
+
+    Tcl_SetObjResult(interp, Tcl_NewListObj(6, values));
+
+    return TCL_OK;
+}
+
+/*
+ * gramcontrib command and subcommands
+ */
+
+/***********************************************************************
+ * 
+ * FUNCTION :
+ *     marsutil_gramcontribCmd()
+ *
+ * INPUTS:
+ *     subcommand        The subcommand name
+ *     args              Subcommand arguments
+ *
+ * RETURNS:
+ *     Whatever the subcommand returns.
+ *
+ * DESCRIPTION:
+ *     This is the ensemble command for the gramcontrib subcommands.
+ *     It looks up the subcommand name, and then passes execution
+ *     to the subcommand proc.
+ */
+
+static int
+marsutil_gramcontribCmd(ClientData cd, Tcl_Interp* interp,
+                        int objc, Tcl_Obj* CONST objv[])
+{
+    if (objc < 2)
+    {
+        Tcl_WrongNumArgs(interp, 1, objv, "subcommand ?arg arg ...?");
+        return TCL_ERROR;
+    }
+
+    resetScratch(&((GramInfo*)cd)->scratch);
+
+    int index = 0;
+
+    if (Tcl_GetIndexFromObjStruct(interp, objv[1],
+                                  gramcontribTable, sizeof(SubcommandVector),
+                                  "subcommand",
+                                  TCL_EXACT,
+                                  &index) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
+
+    return(*gramcontribTable[index].proc)(cd, interp, objc, objv);
+}
+
+/***********************************************************************
+ * 
+ * FUNCTION :
+ *     gramcontrib level t effects
+ *
+ * INPUTS:
+ *     t       - The current time, in ticks
+ *     effects - A flat list 
+ *               {id ts te llimit tau nominal athresh dthresh val ...}
+ *               of the level effects that have started, where val
+ *               is the current level of the effect's curve.
+ *
+ * RETURNS:
+ *     A flat list {id nominal ncontrib ...} of the effects whose
+ *     nominal contribution to date has changed, or whose nominal
+ *     contribution for this time step is non-zero.
+ *
+ * DESCRIPTION:
+ *     Computes each level effect's nominal contribution for the time
+ *     step ending at t, as gram(n) does: the effect's level
+ *     approaches llimit exponentially with time constant tau days,
+ *     and reaches it at te.  The contribution is zeroed if the
+ *     curve has already reached the relevant threshold.  The effects
+ *     are returned in the order given.
+ */
+
+static int
+gramcontrib_level(ClientData cd, Tcl_Interp *interp,
+                  int objc, Tcl_Obj* CONST objv[])
+{
+    GramInfo*   info = (GramInfo*)cd;
+    GramEffects fx;
+    Tcl_WideInt t;
+    double*     value;
+    int         bad;
+    int         i;
+
+    if (objc != 4) {
+        Tcl_WrongNumArgs(interp, 2, objv, "t effects");
+        return TCL_ERROR;
+    }
+
+    if (Tcl_GetWideIntFromObj(interp, objv[2], &t) != TCL_OK ||
+        getGramEffects(interp, &info->scratch, objv[3], 1, &fx) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
+
+    /* FIRST, compute each effect's level at time t. */
+    value = (double*)scratchAlloc(&info->scratch, 
+                                  fx.size * sizeof(double));
+
+    bad = gramLevels(&fx, t, value);
+
+    if (bad >= 0)
+    {
+        Tcl_AppendStringsToObj(Tcl_GetObjResult(interp),
+                               "level effect ", Tcl_GetString(fx.ids[bad]),
+                               " has a time constant of 0.0", NULL);
+        return TCL_ERROR;
+    }
+
+    /* NEXT, the contribution is the increment over the nominal
+     * contribution to date. */
+    for (i = 0; i < fx.size; i++)
+    {
+        fx.ncontrib[i] = value[i] - fx.loaded[i];
+        fx.nominal[i]  = fx.loaded[i] + fx.ncontrib[i];
+    }
+
+    /* NEXT, apply the thresholds, and return the changes. */
+    gramThresholds(&fx);
+
+    Tcl_SetObjResult(interp, gramChanges(&fx));
+
+    return TCL_OK;
+}
+
+/***********************************************************************
+ * 
+ * FUNCTION :
+ *     gramcontrib slope t tlast tickSize unitDays maxEndTime effects
+ *
+ * INPUTS:
+ *     t           - The current time, in ticks
+ *     tlast       - The time of the previous time step, in ticks
+ *     tickSize    - The length of a tick, in the clock's units
+ *     unitDays    - The length of one of the clock's units, in days
+ *     maxEndTime  - The end time of a slope effect with no future
+ *                   links
+ *     effects     - A flat list 
+ *                   {id ts te slope future nominal athresh dthresh val ...}
+ *                   of the slope effects that have started, where val
+ *                   is the current level of the effect's curve.
+ *
+ * RETURNS:
+ *     A list of two flat lists, {links changes}.  The links are
+ *     {id ts te slope future ...} for the effects that moved on to
+ *     a later link of their chain during the time step; the changes
+ *     are {id nominal ncontrib ...}, as for "gramcontrib level".
+ *
+ * DESCRIPTION:
+ *     Computes each slope effect's nominal contribution for the time
+ *     step from tlast to t, as gram(n) does: each link of the
+ *     effect's chain that was active during the step contributes its
+ *     slope times the length of its part of the step in days.  The 
+ *     contribution is zeroed if the curve has already reached the
+ *     relevant threshold.
+ *
+ *     Lengths in days are computed as simclock(n)'s toDays method
+ *     computes them, ticks*tickSize*unitDays, so that the results
+ *     are the same as gram(n)'s to the last bit.
+ */
+
+static int
+gramcontrib_slope(ClientData cd, Tcl_Interp *interp,
+                  int objc, Tcl_Obj* CONST objv[])
+{
+    GramInfo*   info = (GramInfo*)cd;
+    GramEffects fx;
+    Tcl_WideInt t;
+    Tcl_WideInt tlast;
+    Tcl_WideInt tickSize;
+    double      unitDays;
+    Tcl_WideInt maxEndTime;
+    Tcl_Obj*    links;
+    Tcl_Obj*    result[2];
+
+    if (objc != 8) {
+        Tcl_WrongNumArgs(interp, 2, objv, 
+                         "t tlast tickSize unitDays maxEndTime effects");
+        return TCL_ERROR;
+    }
+
+    if (Tcl_GetWideIntFromObj(interp, objv[2], &t)           != TCL_OK ||
+        Tcl_GetWideIntFromObj(interp, objv[3], &tlast)       != TCL_OK ||
+        Tcl_GetWideIntFromObj(interp, objv[4], &tickSize)    != TCL_OK ||
+        Tcl_GetDoubleFromObj(interp, objv[5], &unitDays)     != TCL_OK ||
+        Tcl_GetWideIntFromObj(interp, objv[6], &maxEndTime)  != TCL_OK ||
+        getGramEffects(interp, &info->scratch, objv[7], 0, &fx) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
+
+    /* FIRST, compute the contributions, following the chains. */
+    links = Tcl_NewListObj(0, NULL);
+
+    if (gramSlopes(interp, &fx, t, tlast, tickSize, unitDays, maxEndTime, 
+                   links) != TCL_OK)
+    {
+        Tcl_DecrRefCount(links);
+        return TCL_ERROR;
+    }
+
+    /* NEXT, apply the thresholds, and return the links and changes. */
+    gramThresholds(&fx);
+
+    result[0] = links;
+    result[1] = gramChanges(&fx);
+
+    Tcl_SetObjResult(interp, Tcl_NewListObj(2, result));
+
+    return TCL_OK;
+}
+
+/*
+ * Math and Geometry Functions
+ */
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	spheredist
+ *
+ * INPUTS:
+ *	lat1		A latitude in decimal degrees
+ *      lon1            A longitude in decimal degrees
+ *	lat2		A latitude in decimal degrees
+ *      lon2            A longitude in decimal degrees
+ *
+ * RETURNS:
+ *	The distance between loc 1 and loc 2 in kilometers.
+ *
+ * DESCRIPTION:
+ *	Computes the distance between the two points and returns
+ *      an answer in kilometers.  The algorithm is equivalent to
+ *      that used in CBS.
+ */
+
+static double
+spheredist(double lat1, double lon1, double lat2, double lon2)
+{
+    /* Earth's diameter in kilometers, per CBS */
+    double diameter = 12742.0;
+
+    /* NEXT, convert points to radians */
+    lat1 *= radians;
+    lon1 *= radians;
+    lat2 *= radians;
+    lon2 *= radians;
+
+    /* NEXT, compute the distance. */
+    double sinHalfDlat = sin((lat2 - lat1)/2.0);
+    double sinHalfDlon = sin((lon2 - lon1)/2.0);
+
+    double dist = 
+        diameter * 
+        asin(sqrt(sinHalfDlat*sinHalfDlat +
+                  cos(lat1)*cos(lat2)*sinHalfDlon*sinHalfDlon));
+
+    return dist;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	spheredistRow
+ *
+ * INPUTS:
+ *	lat1		A latitude in radians
+ *      lon1            A longitude in radians
+ *      cosLat1         cos(lat1)
+ *      n               The number of locations
+ *	lat		n latitudes in radians
+ *	lon		n longitudes in radians
+ *	cosLat		The n cosines of lat
+ *
+ * OUTPUTS:
+ *	dist		The n distances in kilometers from lat1,lon1 to
+ *                      each lat[i],lon[i].
+ *
+ * DESCRIPTION:
+ *	The array form of spheredist(), for computing many distances
+ *      at once.  The loop is written over contiguous arrays with no
+ *      branches, so that the compiler can vectorize it where the math
+ *      library allows.  The cosines are computed once per location
+ *      by the caller rather than once per pair.  The arithmetic is
+ *      the same as spheredist()'s, so the results are identical.
+ */
+
+static void
+spheredistRow(double lat1, double lon1, double cosLat1, int n,
+              const double* restrict lat, 
+              const double* restrict lon,
+              const double* restrict cosLat,
+              double* restrict dist)
+{
+    /* Earth's diameter in kilometers, per CBS */
+    const double diameter = 12742.0;
+    int i;
+
+    for (i = 0; i < n; i++)
+    {
+        double sinHalfDlat = sin((lat[i] - lat1)/2.0);
+        double sinHalfDlon = sin((lon[i] - lon1)/2.0);
+
+        dist[i] = 
+            diameter * 
+            asin(sqrt(sinHalfDlat*sinHalfDlat +
+                      cosLat1*cosLat[i]*sinHalfDlon*sinHalfDlon));
+    }
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	bbox()
+ *
+ * INPUTS:
+ *	points		A list of Points
+ *
+ * OUTPUTS
+ *      bbox	A bounding box
+ *
+ * RETURNS:
+ *	nothing
+ *
+ * DESCRIPTION:
+ *	Computes the bounding box of the Points
+ */
+
+static void 
+bbox(Points* points, Bbox* bbox)
+{
+    int i;
+
+    /* FIRST, get the first point as the start point. */
+    bbox->xmin = points->pts[0].x;
+    bbox->xmax = bbox->xmin;
+
+    bbox->ymin = points->pts[0].y;
+    bbox->ymax = bbox->ymin;
+
+    for (i = 1; i < points->size; i++)
+    {
+        double x = points->pts[i].x;
+        double y = points->pts[i].y;
+
+        if (x < bbox->xmin)
+        {
+            bbox->xmin = x;
+        } 
+        else if (x > bbox->xmax)
+        {
+            bbox->xmax = x;
+        }
+
+        if (y < bbox->ymin)
+        {
+            bbox->ymin = y;
+        } 
+        else if (y > bbox->ymax)
+        {
+            bbox->ymax = y;
+        }
+    }
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	ccw
+ *
+ * INPUTS:
+ *	a	An {x y} point
+ *	b	An (x y) point
+ *	c	An {x y} point
+ *
+ * Checks whether a path from point a to point b to point c turns 
+ * counterclockwise or not.
+ *
+ *                   c
+ *                   |
+ * Returns:   1    a-b    or   a-b-c
+ *
+ *
+ *           -1    a-b    or   c-a-b
+ *                   | 
+ *                   c
+ *
+ *            0    a-c-b
+ *                 
+ * From Sedgewick, Algorithms in C, page 350, via the CBS Simscript
+ * code.  Explicitly handles the case where a == b, which Sedgewick's
+ * code doesn't.
+ */
+
+static int
+ccw(Point* a, Point* b, Point* c)
+{
+    /* FIRST, compute the deltas from a-b and a-c */
+    double dx1 = b->x - a->x;
+    double dy1 = b->y - a->y;
+    double dx2 = c->x - a->x;
+    double dy2 = c->y - a->y;
+
+    /* NEXT, see if point c is on the left of a-b */
+    if (dx1*dy2 > dy1*dx2) {
+        return 1;
+    }
+    
+    /* NEXT, see if point c is on the right of a-b */
+    if (dx1*dy2 < dy1*dx2) {
+        return -1;
+    }
+
+    /* NEXT, the points are collinear.
+     * c-a-b */
+    if ((dx1 * dx2 < 0) || (dy1 * dy2 < 0)) {
+        return -1;
+    }
+
+    /* NEXT, Explicitly handle the case where a == b */
+    if (dx1 == 0 && dy1 == 0) {
+        /* a == b */
+
+        if (dx2 < 0) {
+            /* c->x < a->x */
+            return -1;
+        } else if (dx2 > 0) {
+            /* c->x > a->x */
+            return 1;
+        } else {
+            return 0;
+        }
+    }
+        
+    if ((dx1*dx1 + dy1*dy1) < (dx2*dx2 + dy2*dy2)) {
+        return 1;
+    }
+
+    return 0;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	intersect()
+ *
+ * INPUTS:
+ *	p1	A point
+ *      p2	A point
+ *      q1	A point
+ *      q2	A point
+ *
+ * RETURNS:
+ *	1 if the line segments intersect, and 0 otherwise.	
+ *
+ * DESCRIPTION:
+ *	
+ *	Given two line segments p1-p2 and q1-q2, returns 1 if the line
+ *	segments intersect and 0 otherwise.  The segments are still said
+ *	to intersect if the point of intersection is the end point of one
+ *	or both segments.  Either segment may be degenerate, i.e.,
+ *	p1 == p2 and/or q1 == q2.
+ *
+ *	From Sedgewick, Algorithms in C, 1990, Addison-Wesley, page 351.
+ */
+
+static int 
+intersect(Point* p1, Point* p2, Point* q1, Point* q2)
+{
+    if (ccw(p1, p2, q1) * ccw(p1, p2, q2) <= 0 &&
+        ccw(q1, q2, p1) * ccw(q1, q2, p2) <= 0) {
+        return 1;
+    } else {
+        return 0;
+    }
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	ptinpoly()
+ *
+ * INPUTS:
+ *	poly		A polygon defines as a list of Points
+ *	p		A point
+ *	bbox		The polygon's bounding box
+ *
+ * RETURNS:
+ *	1 if the point is inside the polygon or on its border, and 0
+ *	otherwise.
+ *
+ * DESCRIPTION:
+ * This function determines whether a given point q is inside or outside
+ * of a given polygon; if a point is on an edge or vertex it is defined to
+ * be on the inside.  The function determines this by:
+ *
+ * (1) Comparing q against the bounding box of the polygon; if it's outside
+ *     the bounding box, it's outside the polygon.
+ *
+ * (2) Checking q against each edge of the polygon, using [intersect].
+ *     If it's explicitly on the border, it's "inside".
+ *
+ * (3) Checking whether q is inside the polygon by counting the number
+ *     intersections made between q and a point outside the polygon.
+ *     This part of the algorithm was found in an on-line paper by
+ *     Paul Bourke called "Determining If A Point Lies On The Interior
+ *     Of A Polygon", at 
+ *
+ *     http://astronomy.swin.edu.au/~pbourke/geometry/insidepoly
+ */
+
+static int
+ptinpoly(Points* poly, Point* p, Bbox* box)
+{
+    int    i;
+    int    counter;
+    Point* p1;
+
+    /* FIRST, if p is outside the bounding box, it's outside the
+     * polygon. */
+    if (p->x < box->xmin || p->x > box->xmax ||
+        p->y < box->ymin || p->y > box->ymax) {
+        return 0;
+    }
+
+    /* NEXT, count the intersections */
+    counter = 0;
+    p1 = &poly->pts[0];
+
+    for (i = 1; i <= poly->size; i++)
+    {
+        Point* p2 = &poly->pts[i % poly->size];
+
+        /* FIRST, if the point is on this edge then it's "inside" */
+        if (intersect(p1, p2, p, p)) {
+            return 1;
+        }
+
+        /* NEXT, check for an intersection */
+        if (p->y > dmin(p1->y, p2->y))
+        {
+            if (p->y <= dmax(p1->y, p2->y))
+            {
+                if (p->x <= dmax(p1->x, p2->x))
+                {
+                    if (p1->y != p2->y) 
+                    {
+                        double xInters = 
+                            (p->y - p1->y)*(p2->x - p1->x)/(p2->y - p1->y) 
+                            + p1->x;
+
+                        if (p1->x == p2->x || p->x <= xInters) {
+                            ++counter;
+                        }
+                    }
+                }
+            }
+        }
+        
+        p1 = p2;
+    }
+
+    if (counter % 2 == 0) {
+        return 0;
+    } else {
+        return 1;
+    }
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	ptinpolygon()
+ *
+ * INPUTS:
+ *	poly		A compiled polygon
+ *	p		A point
+ *
+ * RETURNS:
+ *	1 if the point is inside the polygon or on its border, and 0
+ *	otherwise.
+ *
+ * DESCRIPTION:
+ *	Equivalent to ptinpoly(), but uses the polygon's precomputed
+ *      bounding box and edge data.  The crossings are counted by
+ *      crossings(), which uses the same arithmetic as ptinpoly(), so
+ *      the two always agree.
+ *
+ *      A point can only be on an edge if it is collinear with the
+ *      edge; crossings() flags such points, and only then are the
+ *      edges checked with intersect().
+ */
+
+static int
+ptinpolygon(Polygon* poly, Point* p)
+{
+    int i;
+    int counter;
+    int collinear;
+
+    /* FIRST, if p is outside the bounding box, it's outside the
+     * polygon. */
+    if (p->x < poly->box.xmin || p->x > poly->box.xmax ||
+        p->y < poly->box.ymin || p->y > poly->box.ymax) {
+        return 0;
+    }
+
+    /* NEXT, count the intersections */
+    counter = crossings(poly, p->x, p->y, &collinear);
+
+    /* NEXT, if the point is on an edge then it's "inside" */
+    if (collinear)
+    {
+        for (i = 0; i < poly->size; i++)
+        {
+            if (intersect(&poly->pts[i], &poly->pts[i + 1], p, p)) {
+                return 1;
+            }
+        }
+    }
+
+    return counter % 2;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	crossings()
+ *
+ * INPUTS:
+ *	poly		A compiled polygon
+ *	px, py		A point
+ *
+ * OUTPUTS:
+ *	collinear	Set to 1 if the point is collinear with any edge,
+ *                      and 0 otherwise.
+ *
+ * RETURNS:
+ *	The number of edges crossed by a ray from the point, as
+ *      counted by ptinpoly().
+ *
+ * DESCRIPTION:
+ *	This is the inner loop of ptinpolygon().  It is written without
+ *      branches over the struct-of-arrays edge data, so that the 
+ *      compiler can vectorize it.  Every edge is tested with the same
+ *      comparisons and arithmetic as in ptinpoly(); the division is
+ *      done for every edge, with a dummy divisor for those edges that
+ *      ptinpoly() would skip.
+ *
+ *      The collinearity test is the cross product, the first test in
+ *      ccw(); a point can only be on an edge if it's collinear with
+ *      it.
+ */
+
+static int
+crossings(Polygon* poly, double px, double py, int* collinear)
+{
+    const double* restrict x1   = poly->edges.x1;
+    const double* restrict y1   = poly->edges.y1;
+    const double* restrict ymin = poly->edges.ymin;
+    const double* restrict ymax = poly->edges.ymax;
+    const double* restrict xmax = poly->edges.xmax;
+    const double* restrict dx   = poly->edges.dx;
+    const double* restrict dy   = poly->edges.dy;
+    int    n       = poly->size;
+    int    counter = 0;
+    int    onLine  = 0;
+    int    i;
+
+    for (i = 0; i < n; i++)
+    {
+        double ex  = px - x1[i];
+        double ey  = py - y1[i];
+        int    hit = (py > ymin[i]) & (py <= ymax[i]) & 
+                     (px <= xmax[i]) & (dy[i] != 0.0);
+        double div = (dy[i] != 0.0) ? dy[i] : 1.0;
+        double xInters = ey*dx[i]/div + x1[i];
+
+        counter += hit & ((dx[i] == 0.0) | (px <= xInters));
+        onLine  |= (dx[i]*ey == dy[i]*ex);
+    }
+
+    *collinear = onLine;
+
+    return counter;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	buildGeoIndex()
+ *
+ * INPUTS:
+ *	gi		A GeoIndex
+ *
+ * RETURNS:
+ *	nothing
+ *
+ * DESCRIPTION:
+ *	Compacts out any removed entries, and rebuilds the grid.  The
+ *      grid has roughly one cell per polygon, shaped to the aspect
+ *      ratio of the index's extent.  Each entry is listed in every 
+ *      cell its bounding box overlaps; entries are added in stacking
+ *      order, so each cell's list is in stacking order as well.
+ */
+
+#define GEOINDEX_MAX_CELLS 1024
+
+static void
+buildGeoIndex(GeoIndex* gi)
+{
+    int    i;
+    int    j;
+    int    ncells;
+    double w;
+    double h;
+
+    /* FIRST, compact the entries, if need be. */
+    if (gi->removed > 0)
+    {
+        j = 0;
+
+        for (i = 0; i < gi->size; i++)
+        {
+            if (gi->entries[i].id != NULL)
+            {
+                gi->entries[j++] = gi->entries[i];
+            }
+        }
+
+        gi->size    = j;
+        gi->removed = 0;
+
+        for (i = 0; i < gi->size; i++)
+        {
+            Tcl_HashEntry* entry = 
+                Tcl_FindHashEntry(&gi->ids, 
+                                  Tcl_GetString(gi->entries[i].id));
+            Tcl_SetHashValue(entry, (ClientData)(long)i);
+        }
+    }
+
+    gi->dirty = 0;
+
+    if (gi->size == 0)
+    {
+        gi->nx = gi->ny = 0;
+        return;
+    }
+
+    /* NEXT, compute the extent. */
+    gi->extent = gi->entries[0].poly->box;
+
+    for (i = 1; i < gi->size; i++)
+    {
+        Bbox* box = &gi->entries[i].poly->box;
+
+        gi->extent.xmin = dmin(gi->extent.xmin, box->xmin);
+        gi->extent.ymin = dmin(gi->extent.ymin, box->ymin);
+        gi->extent.xmax = dmax(gi->extent.xmax, box->xmax);
+        gi->extent.ymax = dmax(gi->extent.ymax, box->ymax);
+    }
+
+    /* NEXT, size the grid. */
+    w = gi->extent.xmax - gi->extent.xmin;
+    h = gi->extent.ymax - gi->extent.ymin;
+
+    if (w > 0.0 && h > 0.0)
+    {
+        gi->nx = (int)ceil(sqrt(gi->size * w / h));
+    }
+    else 
+    {
+        gi->nx = (w > 0.0) ? gi->size : 1;
+    }
+
+    gi->nx = (gi->nx < 1) ? 1 : gi->nx;
+    gi->nx = (gi->nx > GEOINDEX_MAX_CELLS) ? GEOINDEX_MAX_CELLS : gi->nx;
+    gi->ny = (h > 0.0) ? (gi->size + gi->nx - 1)/gi->nx : 1;
+    gi->ny = (gi->ny > GEOINDEX_MAX_CELLS) ? GEOINDEX_MAX_CELLS : gi->ny;
+
+    gi->cellWidth  = (w > 0.0) ? w/gi->nx : 1.0;
+    gi->cellHeight = (h > 0.0) ? h/gi->ny : 1.0;
+
+    ncells = gi->nx * gi->ny;
+
+    /* NEXT, count the entries in each cell, and compute each cell's
+     * start offset.  cellStart[c+1] counts cell c at first. */
+    gi->cellStart = (int*)Tcl_Realloc((char*)gi->cellStart, 
+                                      (ncells + 1) * sizeof(int));
+    memset(gi->cellStart, 0, (ncells + 1) * sizeof(int));
+
+    for (i = 0; i < gi->size; i++)
+    {
+        Bbox* box = &gi->entries[i].poly->box;
+        int   cx0, cy0, cx1, cy1, cx, cy;
+
+        geoIndexCell(gi, box->xmin, box->ymin, &cx0, &cy0);
+        geoIndexCell(gi, box->xmax, box->ymax, &cx1, &cy1);
+
+        for (cy = cy0; cy <= cy1; cy++)
+        {
+            for (cx = cx0; cx <= cx1; cx++)
+            {
+                gi->cellStart[cy*gi->nx + cx + 1]++;
+            }
+        }
+    }
+
+    for (i = 0; i < ncells; i++)
+    {
+        gi->cellStart[i + 1] += gi->cellStart[i];
+    }
+
+    /* NEXT, fill in the cells, using a copy of the start offsets as
+     * the fill pointers. */
+    int* fill = (int*)Tcl_Alloc(ncells * sizeof(int));
+    memcpy(fill, gi->cellStart, ncells * sizeof(int));
+
+    gi->cellItems = (int*)Tcl_Realloc((char*)gi->cellItems, 
+                                      (gi->cellStart[ncells] + 1) * 
+                                      sizeof(int));
+
+    for (i = 0; i < gi->size; i++)
+    {
+        Bbox* box = &gi->entries[i].poly->box;
+        int   cx0, cy0, cx1, cy1, cx, cy;
+
+        geoIndexCell(gi, box->xmin, box->ymin, &cx0, &cy0);
+        geoIndexCell(gi, box->xmax, box->ymax, &cx1, &cy1);
+
+        for (cy = cy0; cy <= cy1; cy++)
+        {
+            for (cx = cx0; cx <= cx1; cx++)
+            {
+                gi->cellItems[fill[cy*gi->nx + cx]++] = i;
+            }
+        }
+    }
+
+    Tcl_Free((char*)fill);
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	geoIndexCell()
+ *
+ * INPUTS:
+ *	gi		A GeoIndex with a current grid
+ *	x, y		A point within the index's extent
+ *
+ * OUTPUTS:
+ *	cx, cy		The column and row of the grid cell containing x, y
+ *
+ * RETURNS:
+ *	nothing
+ */
+
+static void
+geoIndexCell(GeoIndex* gi, double x, double y, int* cx, int* cy)
+{
+    *cx = (int)((x - gi->extent.xmin) / gi->cellWidth);
+    *cy = (int)((y - gi->extent.ymin) / gi->cellHeight);
+
+    *cx = (*cx < 0) ? 0 : ((*cx >= gi->nx) ? gi->nx - 1 : *cx);
+    *cy = (*cy < 0) ? 0 : ((*cy >= gi->ny) ? gi->ny - 1 : *cy);
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	findGeoIndex()
+ *
+ * INPUTS:
+ *	gi		A GeoIndex
+ *	p		A point
+ *
+ * RETURNS:
+ *	The uppermost entry whose polygon contains the point, or NULL.
+ *
+ * DESCRIPTION:
+ *	Rebuilds the grid if need be, and then checks the polygons 
+ *      listed in the point's cell from the top down.
+ */
+
+static GeoIndexEntry*
+findGeoIndex(GeoIndex* gi, Point* p)
+{
+    int i;
+    int cx;
+    int cy;
+    int cell;
+
+    if (gi->dirty)
+    {
+        buildGeoIndex(gi);
+    }
+
+    if (gi->size == 0 ||
+        p->x < gi->extent.xmin || p->x > gi->extent.xmax ||
+        p->y < gi->extent.ymin || p->y > gi->extent.ymax)
+    {
+        return NULL;
+    }
+
+    geoIndexCell(gi, p->x, p->y, &cx, &cy);
+    cell = cy*gi->nx + cx;
+
+    for (i = gi->cellStart[cell + 1] - 1; i >= gi->cellStart[cell]; i--)
+    {
+        GeoIndexEntry* e = &gi->entries[gi->cellItems[i]];
+
+        if (ptinpolygon(e->poly, p))
+        {
+            return e;
+        }
+    }
+
+    return NULL;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	edgeContact()
+ *
+ * INPUTS:
+ *	p1, p2		An edge
+ *	q1, q2		Another edge
+ *	tol		Tolerance for collinearity
+ *	latlong		1 if the points are lat/long pairs in degrees
+ *
+ * OUTPUTS:
+ *	border		The length of the edges' shared part, or 0.0
+ *
+ * RETURNS:
+ *	1 if the edges touch, cross, or overlap, and 0 otherwise.
+ *
+ * DESCRIPTION:
+ *	If both ends of q1-q2 lie within tol of the line through p1-p2,
+ *      the edges are collinear, and share the part of p1-p2 that 
+ *      q1-q2 projects onto, if any.  Otherwise, they're in contact
+ *      only if they intersect().  The shared length is planar, or
+ *      with latlong, the spheredist() in kilometers.
+ */
+
+static int
+edgeContact(Point* p1, Point* p2, Point* q1, Point* q2, double tol,
+            int latlong, double* border)
+{
+    double dx  = p2->x - p1->x;
+    double dy  = p2->y - p1->y;
+    double len = hypot(dx, dy);
+
+    *border = 0.0;
+
+    if (len > 0.0)
+    {
+        /* FIRST, get the cross products, proportional to the
+         * distances of q1 and q2 from the line. */
+        double c1 = dx*(q1->y - p1->y) - dy*(q1->x - p1->x);
+        double c2 = dx*(q2->y - p1->y) - dy*(q2->x - p1->x);
+
+        if (fabs(c1) <= tol*len && fabs(c2) <= tol*len)
+        {
+            /* NEXT, they're collinear; project q onto p. */
+            double t1 = (dx*(q1->x - p1->x) + dy*(q1->y - p1->y))/(len*len);
+            double t2 = (dx*(q2->x - p1->x) + dy*(q2->y - p1->y))/(len*len);
+            double lo = dmax(0.0, dmin(t1, t2));
+            double hi = dmin(1.0, dmax(t1, t2));
+
+            if (hi > lo)
+            {
+                if (latlong)
+                {
+                    *border = spheredist(p1->x + lo*dx, p1->y + lo*dy,
+                                         p1->x + hi*dx, p1->y + hi*dy);
+                }
+                else
+                {
+                    *border = (hi - lo)*len;
+                }
+
+                return 1;
+            }
+
+            if (hi == lo)
+            {
+                return 1;
+            }
+        }
+    }
+
+    return intersect(p1, p2, q1, q2);
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	centroid()
+ *
+ * INPUTS:
+ *	poly		A Polygon
+ *
+ * OUTPUTS:
+ *	c		The polygon's centroid
+ *
+ * RETURNS:
+ *	nothing
+ *
+ * DESCRIPTION:
+ *	Computes the centroid of the polygon's area, or for a polygon
+ *      with no area, the average of its vertices.
+ */
+
+static void
+centroid(Polygon* poly, Point* c)
+{
+    Point* pts   = poly->pts;
+    double area2 = 0.0;
+    double cx    = 0.0;
+    double cy    = 0.0;
+    int    i;
+
+    for (i = 0; i < poly->size; i++)
+    {
+        double cross = pts[i].x*pts[i+1].y - pts[i+1].x*pts[i].y;
+
+        area2 += cross;
+        cx    += (pts[i].x + pts[i+1].x)*cross;
+        cy    += (pts[i].y + pts[i+1].y)*cross;
+    }
+
+    if (area2 != 0.0)
+    {
+        c->x = cx/(3.0*area2);
+        c->y = cy/(3.0*area2);
+        return;
+    }
+
+    cx = 0.0;
+    cy = 0.0;
+
+    for (i = 0; i < poly->size; i++)
+    {
+        cx += pts[i].x;
+        cy += pts[i].y;
+    }
+
+    c->x = cx/poly->size;
+    c->y = cy/poly->size;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	compareAdjEdges(), compareAdjPairs()
+ *
+ * DESCRIPTION:
+ *	qsort() comparisons for polygon adjacency: edges by minimum X,
+ *      and pairs by i and then j.
+ */
+
+static int
+compareAdjEdges(const void* a, const void* b)
+{
+    double xa = ((const AdjEdge*)a)->xmin;
+    double xb = ((const AdjEdge*)b)->xmin;
+
+    return (xa < xb) ? -1 : (xa > xb) ? 1 : 0;
+}
+
+static int
+compareAdjPairs(const void* a, const void* b)
+{
+    const AdjPair* pa = (const AdjPair*)a;
+    const AdjPair* pb = (const AdjPair*)b;
+
+    if (pa->i != pb->i)
+    {
+        return pa->i - pb->i;
+    }
+
+    return pa->j - pb->j;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	dmin()
+ *
+ * INPUTS:
+ *	a	a value
+ *	b	a value
+ *
+ * RETURNS:
+ *	The minimum of the two values.
+ */
+
+static double
+dmin(double a, double b)
+{
+    if (a < b)
+    {
+        return a;
+    }
+    else
+    {
+        return b;
+    }
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	dmax()
+ *
+ * INPUTS:
+ *	a	a value
+ *	b	a value
+ *
+ * RETURNS:
+ *	The maximum of the two values.
+ */
+
+static double
+dmax(double a, double b)
+{
+    if (a > b)
+    {
+        return a;
+    }
+    else
+    {
+        return b;
+    }
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	ll_area()
+ *
+ * INPUTS:
+ *	poly		A list of (lat,lon) pairs
+ *
+ * RETURNS:
+ *	The area of the polygon in square kilometers
+ *
+ * DESCRIPTION:
+ *	Computes the area of the polygon, taking curvature of the
+ *      Earth into account.  See latlong.tcl for a discussion of the
+ *      algorithm and its limitations.
+ */
+
+static double
+ll_area(Points* poly)
+{
+    int    i;
+    double sum;
+
+    /* FIRST, compute the sum, converting the lat/lon points to 
+     * radians as we go; the points may be shared, and so are left
+     * as they are. */
+    sum = 0.0;
+
+    for (i = 0; i < poly->size; i++)
+    {
+        int j = (i - 2);
+
+        if (j < 0)
+        {
+            j += poly->size;
+        }
+
+        int k = (i - 1);
+
+        if (k < 0)
+        {
+            k += poly->size;
+        }
+
+        double ilon = poly->pts[i].y * radians;
+        double jlon = poly->pts[j].y * radians;
+        double klat = poly->pts[k].x * radians;
+
+        sum += (ilon - jlon)*sin(klat);
+    }
+
+    double area = -(earthRadius*earthRadius/2.0)*sum;
+
+    return area;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	ll_earea()
+ *
+ * INPUTS:
+ *	geo		The GeodesicData for the spheroid
+ *	poly		A polygon in lat/long decimal degrees, at least
+ *                      three points.
+ *
+ * OUTPUTS:
+ *	none
+ *
+ * RETURNS:
+ *	The area of the polygon in square kilometers on the spheroid.
+ *
+ * DESCRIPTION:
+ *	Maps each vertex to its authalic latitude, which takes the 
+ *      ellipsoid to the sphere of the same area, and sums the 
+ *      spherical excess of each edge's trapezoid with the equator.
+ *      On the authalic sphere the edges are great circles; for
+ *      polygons of less than continental size the difference from
+ *      the ellipsoid's geodesics is negligible.  As for ll_area(),
+ *      the polygon should be counter-clockwise, else the result is 
+ *      negated, and may not contain a pole.
+ */
+
+static double
+ll_earea(GeodesicData* geo, Points* poly)
+{
+    int    i;
+    double sum = 0.0;
+
+    /* FIRST, get the first vertex' authalic latitude; the tangent of
+     * half of it is all the excess formula needs. */
+    double t1   = tan(asin(authalicQ(geo, poly->pts[0].x * radians) /
+                           geo->qp)/2.0);
+    double lon1 = poly->pts[0].y * radians;
+
+    /* NEXT, sum the signed excess of each edge. */
+    for (i = 1; i <= poly->size; i++)
+    {
+        int    k    = (i < poly->size) ? i : 0;
+        double t2   = tan(asin(authalicQ(geo, poly->pts[k].x * radians) /
+                               geo->qp)/2.0);
+        double lon2 = poly->pts[k].y * radians;
+        double dlon = lon2 - lon1;
+
+        if (dlon > pi)
+        {
+            dlon -= 2.0*pi;
+        }
+        else if (dlon < -pi)
+        {
+            dlon += 2.0*pi;
+        }
+
+        sum += 2.0*atan2(tan(dlon/2.0)*(t1 + t2), 1.0 + t1*t2);
+
+        t1   = t2;
+        lon1 = lon2;
+    }
+
+    return -geo->authalicR2*sum;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	ll_perimeter()
+ *
+ * INPUTS:
+ *	geo		The GeodesicData for the spheroid
+ *	poly		A polygon in lat/long decimal degrees
+ *
+ * OUTPUTS:
+ *	none
+ *
+ * RETURNS:
+ *	The length in kilometers of the polygon's boundary, closing it.
+ *
+ * DESCRIPTION:
+ *	Sums the geodesic lengths of the polygon's edges.
+ */
+
+static double
+ll_perimeter(GeodesicData* geo, Points* poly)
+{
+    int    i;
+    double sum = 0.0;
+
+    for (i = 0; i < poly->size; i++)
+    {
+        int k = (i + 1 < poly->size) ? i + 1 : 0;
+
+        sum += geodist(geo, 
+                       poly->pts[i].x * radians, poly->pts[i].y * radians,
+                       poly->pts[k].x * radians, poly->pts[k].y * radians);
+    }
+
+    return sum;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	geodist()
+ *
+ * INPUTS:
+ *	geo		The GeodesicData for the spheroid
+ *	lat1, lon1	The first point, in radians
+ *	lat2, lon2	The second point, in radians
+ *
+ * OUTPUTS:
+ *	none
+ *
+ * RETURNS:
+ *	The geodesic distance between the points, in kilometers.
+ *
+ * DESCRIPTION:
+ *	Vincenty's inverse formula.  It fails to converge only for 
+ *      nearly antipodal points, which no polygon edge should join;
+ *      in that case the spherical distance on a sphere of the 
+ *      ellipsoid's mean radius is returned.
+ */
+
+static double
+geodist(GeodesicData* geo, double lat1, double lon1, 
+        double lat2, double lon2)
+{
+    double L      = lon2 - lon1;
+    double U1     = atan((1.0 - geo->f)*tan(lat1));
+    double U2     = atan((1.0 - geo->f)*tan(lat2));
+    double sinU1  = sin(U1), cosU1 = cos(U1);
+    double sinU2  = sin(U2), cosU2 = cos(U2);
+    double lambda = L;
+    double sinSigma, cosSigma, sigma, cos2Alpha, cos2SigmaM;
+    int    iter;
+
+    for (iter = 0; iter < VINCENTY_MAX_ITER; iter++)
+    {
+        double sinLambda = sin(lambda);
+        double cosLambda = cos(lambda);
+        double x         = cosU2*sinLambda;
+        double y         = cosU1*sinU2 - sinU1*cosU2*cosLambda;
+
+        sinSigma = sqrt(x*x + y*y);
+
+        if (sinSigma == 0.0)
+        {
+            /* Coincident points */
+            return 0.0;
+        }
+
+        cosSigma   = sinU1*sinU2 + cosU1*cosU2*cosLambda;
+        sigma      = atan2(sinSigma, cosSigma);
+
+        double sinAlpha = cosU1*cosU2*sinLambda/sinSigma;
+
+        cos2Alpha  = 1.0 - sinAlpha*sinAlpha;
+        cos2SigmaM = (cos2Alpha != 0.0) ?
+            cosSigma - 2.0*sinU1*sinU2/cos2Alpha : 0.0; /* Equatorial */
+
+        double C = geo->f/16.0*cos2Alpha*(4.0 + geo->f*(4.0 - 3.0*cos2Alpha));
+        double lambdaPrev = lambda;
+
+        lambda = L + (1.0 - C)*geo->f*sinAlpha*
+            (sigma + C*sinSigma*
+             (cos2SigmaM + C*cosSigma*(-1.0 + 2.0*cos2SigmaM*cos2SigmaM)));
+
+        if (fabs(lambda - lambdaPrev) < 1e-12)
+        {
+            double u2 = cos2Alpha*(geo->a*geo->a - geo->b*geo->b)/
+                (geo->b*geo->b);
+            double A  = 1.0 + u2/16384.0*
+                (4096.0 + u2*(-768.0 + u2*(320.0 - 175.0*u2)));
+            double B  = u2/1024.0*(256.0 + u2*(-128.0 + u2*(74.0 - 47.0*u2)));
+            double dSigma = B*sinSigma*
+                (cos2SigmaM + B/4.0*
+                 (cosSigma*(-1.0 + 2.0*cos2SigmaM*cos2SigmaM) -
+                  B/6.0*cos2SigmaM*(-3.0 + 4.0*sinSigma*sinSigma)*
+                  (-3.0 + 4.0*cos2SigmaM*cos2SigmaM)));
+
+            return geo->b*A*(sigma - dSigma);
+        }
+    }
+
+    /* NEXT, it didn't converge. */
+    double sinHalfDlat = sin((lat2 - lat1)/2.0);
+    double sinHalfDlon = sin((lon2 - lon1)/2.0);
+
+    return (2.0*geo->a + geo->b)/3.0 * 2.0 *
+        asin(sqrt(sinHalfDlat*sinHalfDlat +
+                  cos(lat1)*cos(lat2)*sinHalfDlon*sinHalfDlon));
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	authalicQ()
+ *
+ * INPUTS:
+ *	geo		The GeodesicData for the spheroid
+ *	lat		A geodetic latitude in radians
+ *
+ * OUTPUTS:
+ *	none
+ *
+ * RETURNS:
+ *	The "q" function of the latitude, proportional to the area 
+ *      of the ellipsoid between the equator and the latitude.
+ *
+ * DESCRIPTION:
+ *	The authalic latitude is asin(q(lat)/q(pi/2)).  See Snyder, 
+ *      "Map Projections: A Working Manual", eq. 3-12.
+ */
+
+static double
+authalicQ(GeodesicData* geo, double lat)
+{
+    double e      = geo->e;
+    double sinLat = sin(lat);
+
+    if (e == 0.0)
+    {
+        return 2.0*sinLat;
+    }
+
+    return (1.0 - geo->e2)*
+        (sinLat/(1.0 - geo->e2*sinLat*sinLat) -
+         log((1.0 - e*sinLat)/(1.0 + e*sinLat))/(2.0*e));
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	setGeodesicData()
+ *
+ * INPUTS:
+ *	a		The semi-major axis in meters
+ *	invf		The inverse flattening
+ *
+ * OUTPUTS:
+ *	geo		The GeodesicData for the spheroid
+ *
+ * RETURNS:
+ *	nothing
+ *
+ * DESCRIPTION:
+ *	Computes the parameters used by ll_earea() and geodist().
+ */
+
+static void
+setGeodesicData(GeodesicData* geo, double a, double invf)
+{
+    geo->a  = a/1000.0;
+    geo->f  = 1.0/invf;
+    geo->b  = geo->a*(1.0 - geo->f);
+    geo->e2 = geo->f*(2.0 - geo->f);
+    geo->e  = sqrt(geo->e2);
+    geo->qp = authalicQ(geo, pi/2.0);
+
+    geo->authalicR2 = geo->a*geo->a*geo->qp/2.0;
+}
+
+/*
+ * Private Helper Functions
+ */
+
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	newLatlongInfo()
+ *
+ * INPUTS:
+ *	nothing
+ *
+ * OUTPUTS:
+ *	none
+ *
+ * RETURNS:
+ *	A pointer to a zeroed LatlongInfo struct
+ *
+ * DESCRIPTION:
+ *	Allocates a new LatlongInfo struct, and zeroes it.
+ */
+
+static LatlongInfo*
+newLatlongInfo(void)
+{
+    LatlongInfo* info = (LatlongInfo*)Tcl_Alloc(sizeof(LatlongInfo));
+    memset(info, 0, sizeof(LatlongInfo));
+    info->spheroid = 0;
+    Init_MGRS_Context(&info->mgrs);
+
+    setEllipsoidData(info);
+
+    return info;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	newGeotiffInfo()
+ *
+ * INPUTS:
+ *	nothing
+ *
+ * OUTPUTS:
+ *	none
+ *
+ * RETURNS:
+ *	A pointer to an initialized GeotiffInfo struct
+ *
+ * DESCRIPTION:
+ *	Allocates a new GeotiffInfo struct, with an empty registry.
+ */
+
+static GeotiffInfo*
+newGeotiffInfo(void)
+{
+    GeotiffInfo* info = (GeotiffInfo*)Tcl_Alloc(sizeof(GeotiffInfo));
+    memset(info, 0, sizeof(GeotiffInfo));
+    Tcl_InitHashTable(&info->images, TCL_STRING_KEYS);
+
+    return info;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	newPolygonInfo()
+ *
+ * INPUTS:
+ *	nothing
+ *
+ * OUTPUTS:
+ *	none
+ *
+ * RETURNS:
+ *	A pointer to an initialized PolygonInfo struct
+ *
+ * DESCRIPTION:
+ *	Allocates a new PolygonInfo struct, with an empty registry.
+ */
+
+static PolygonInfo*
+newPolygonInfo(void)
+{
+    PolygonInfo* info = (PolygonInfo*)Tcl_Alloc(sizeof(PolygonInfo));
+    memset(info, 0, sizeof(PolygonInfo));
+    Tcl_InitHashTable(&info->polygons, TCL_STRING_KEYS);
+    Tcl_InitHashTable(&info->indices, TCL_STRING_KEYS);
+
+    return info;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	deletePolygonInfo()
+ *
+ * INPUTS:
+ *	cd		The PolygonInfo*
+ *	interp		The interpreter being deleted
+ *
+ * OUTPUTS:
+ *	none
+ *
+ * RETURNS:
+ *	nothing
+ *
+ * DESCRIPTION:
+ *	Deletes all remaining geoindex and polygon handles, and frees the 
+ *      PolygonInfo.  Called as the interp's assoc data is deleted.
+ */
+
+static void
+deletePolygonInfo(ClientData cd, Tcl_Interp* interp)
+{
+    PolygonInfo*   info = (PolygonInfo*)cd;
+    Tcl_HashEntry* entry;
+    Tcl_HashSearch search;
+
+    for (entry = Tcl_FirstHashEntry(&info->indices, &search);
+         entry != NULL;
+         entry = Tcl_NextHashEntry(&search))
+    {
+        deleteGeoIndex((GeoIndex*)Tcl_GetHashValue(entry));
+    }
+
+    Tcl_DeleteHashTable(&info->indices);
+
+    for (entry = Tcl_FirstHashEntry(&info->polygons, &search);
+         entry != NULL;
+         entry = Tcl_NextHashEntry(&search))
+    {
+        Polygon* poly = (Polygon*)Tcl_GetHashValue(entry);
+        poly->deleted = 1;
+        releasePolygon(poly);
+    }
+
+    Tcl_DeleteHashTable(&info->polygons);
+    freeScratch(&info->scratch);
+
+    Tcl_Free((void*)info);
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	newPolygon()
+ *
+ * INPUTS:
+ *	coords		The polygon's coordinate list
+ *      points		The parsed coordinates
+ *
+ * OUTPUTS:
+ *	none
+ *
+ * RETURNS:
+ *	A pointer to a new Polygon, with a reference count of 1.
+ *
+ * DESCRIPTION:
+ *	Compiles the polygon: copies the points, closing the polygon,
+ *      and computes the bounding box and the edge data.
+ */
+
+static Polygon*
+newPolygon(Tcl_Obj* coords, Points* points)
+{
+    Polygon* poly = (Polygon*)Tcl_Alloc(sizeof(Polygon));
+    int      n    = points->size;
+    int      i;
+
+    memset(poly, 0, sizeof(Polygon));
+    poly->refCount = 1;
+    poly->coords   = coords;
+    Tcl_IncrRefCount(coords);
+
+    /* FIRST, copy the points, repeating the first point at the end. */
+    poly->size = n;
+    poly->pts  = (Point*)Tcl_Alloc((n + 1) * sizeof(Point));
+    memcpy(poly->pts, points->pts, n * sizeof(Point));
+    poly->pts[n] = poly->pts[0];
+
+    bbox(points, &poly->box);
+
+    /* NEXT, compute the edges.  The arrays share one block. */
+    Edges* e = &poly->edges;
+
+    e->x1   = (double*)Tcl_Alloc(7 * n * sizeof(double));
+    e->y1   = e->x1   + n;
+    e->ymin = e->y1   + n;
+    e->ymax = e->ymin + n;
+    e->xmax = e->ymax + n;
+    e->dx   = e->xmax + n;
+    e->dy   = e->dx   + n;
+
+    for (i = 0; i < n; i++)
+    {
+        Point* p1 = &poly->pts[i];
+        Point* p2 = &poly->pts[i + 1];
+
+        e->x1[i]   = p1->x;
+        e->y1[i]   = p1->y;
+        e->ymin[i] = dmin(p1->y, p2->y);
+        e->ymax[i] = dmax(p1->y, p2->y);
+        e->xmax[i] = dmax(p1->x, p2->x);
+        e->dx[i]   = p2->x - p1->x;
+        e->dy[i]   = p2->y - p1->y;
+    }
+
+    return poly;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	releasePolygon()
+ *
+ * INPUTS:
+ *	poly		A Polygon
+ *
+ * OUTPUTS:
+ *	none
+ *
+ * RETURNS:
+ *	nothing
+ *
+ * DESCRIPTION:
+ *	Releases a reference to the polygon, freeing it when no 
+ *      references remain.
+ */
+
+static void
+releasePolygon(Polygon* poly)
+{
+    if (--poly->refCount > 0)
+    {
+        return;
+    }
+
+    Tcl_DecrRefCount(poly->coords);
+    Tcl_Free((void*)poly->pts);
+    Tcl_Free((void*)poly->edges.x1);
+    Tcl_Free((void*)poly);
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	newGeoIndex()
+ *
+ * INPUTS:
+ *	nothing
+ *
+ * OUTPUTS:
+ *	none
+ *
+ * RETURNS:
+ *	A pointer to a new, empty GeoIndex
+ */
+
+static GeoIndex*
+newGeoIndex(void)
+{
+    GeoIndex* gi = (GeoIndex*)Tcl_Alloc(sizeof(GeoIndex));
+    memset(gi, 0, sizeof(GeoIndex));
+    Tcl_InitHashTable(&gi->ids, TCL_STRING_KEYS);
+
+    return gi;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	deleteGeoIndex()
+ *
+ * INPUTS:
+ *	gi		A GeoIndex
+ *
+ * OUTPUTS:
+ *	none
+ *
+ * RETURNS:
+ *	nothing
+ *
+ * DESCRIPTION:
+ *	Releases the index's polygons and frees the index.
+ */
+
+static void
+deleteGeoIndex(GeoIndex* gi)
+{
+    int i;
+
+    for (i = 0; i < gi->size; i++)
+    {
+        if (gi->entries[i].id != NULL)
+        {
+            Tcl_DecrRefCount(gi->entries[i].id);
+            releasePolygon(gi->entries[i].poly);
+        }
+    }
+
+    Tcl_DeleteHashTable(&gi->ids);
+
+    if (gi->entries != NULL)
+    {
+        Tcl_Free((char*)gi->entries);
+    }
+
+    if (gi->cellStart != NULL)
+    {
+        Tcl_Free((char*)gi->cellStart);
+    }
+
+    if (gi->cellItems != NULL)
+    {
+        Tcl_Free((char*)gi->cellItems);
+    }
+
+    Tcl_Free((char*)gi);
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	freePolygonIntRep(), dupPolygonIntRep(), setPolygonFromAny()
+ *
+ * DESCRIPTION:
+ *	The polygonObjType procs.  The internal rep holds a reference
+ *      to the Polygon, so a cached Polygon* is never left dangling;
+ *      if the handle has been deleted, getPolygon() notices and looks
+ *      the name up again.  Handles are only converted by getPolygon(),
+ *      so setPolygonFromAny() simply fails.
+ */
+
+static void
+freePolygonIntRep(Tcl_Obj* objPtr)
+{
+    releasePolygon((Polygon*)objPtr->internalRep.twoPtrValue.ptr1);
+    objPtr->typePtr = NULL;
+}
+
+static void
+dupPolygonIntRep(Tcl_Obj* srcPtr, Tcl_Obj* dupPtr)
+{
+    Polygon* poly = (Polygon*)srcPtr->internalRep.twoPtrValue.ptr1;
+
+    poly->refCount++;
+    dupPtr->internalRep.twoPtrValue.ptr1 = poly;
+    dupPtr->internalRep.twoPtrValue.ptr2 = 
+        srcPtr->internalRep.twoPtrValue.ptr2;
+    dupPtr->typePtr = &polygonObjType;
+}
+
+static int
+setPolygonFromAny(Tcl_Interp* interp, Tcl_Obj* objPtr)
+{
+    if (interp != NULL)
+    {
+        Tcl_SetResult(interp, "can't convert value to a polygon handle",
+                      TCL_STATIC);
+    }
+
+    return TCL_ERROR;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	openTiff()
+ *
+ * INPUTS:
+ *	interp		The Tcl interpreter
+ *	fileObj		The file name
+ *
+ * OUTPUTS:
+ *	tiff		The open TIFF
+ *
+ * RETURNS:
+ *	TCL_OK on success and TCL_ERROR on failure, setting the error
+ *      string in the latter case.
+ *
+ * DESCRIPTION:
+ *	Opens a TIFF file for reading, with libTiff's error messages 
+ *      suppressed.  The "m" mode flag keeps libTiff from mapping the
+ *      file; only "geotiff open -mmap" maps files, explicitly.
+ */
+
+static int
+openTiff(Tcl_Interp* interp, Tcl_Obj* fileObj, TIFF** tiff)
+{
+    FILE* f;
+    char* fname = Tcl_GetStringFromObj(fileObj, NULL);
+
+    /* See if the file exists */
+    if ((f = fopen(fname, "r")) == NULL)
+    {
+        Tcl_SetResult(interp, "file does not exist", TCL_STATIC);
+        return TCL_ERROR;
+    }
+
+    fclose(f);
 
     /* Disable TIFF libraries internal error handling, */
     /* this prevents messages from going to stderr     */
     TIFFSetErrorHandler(NULL); 
 
-    info->tiff = XTIFFOpen(fname, "r");
+    *tiff = XTIFFOpen(fname, "rm");
+
+    /* File is not a TIFF */
+    if (*tiff == NULL)
+    {
+        Tcl_SetResult(interp, "file is not a TIFF", TCL_STATIC);
+        return TCL_ERROR;
+    }
+
+    return TCL_OK;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	getGeoKeys()
+ *
+ * INPUTS:
+ *	interp		The Tcl interpreter
+ *	tiff		An open TIFF
+ *
+ * OUTPUTS:
+ *	result		The "geotiff read" dict
+ *	model		If not NULL, the GeoModel
+ *
+ * RETURNS:
+ *	TCL_OK on success and TCL_ERROR on failure, setting the error
+ *      string in the latter case.
+ *
+ * DESCRIPTION:
+ *	Reads the GeoTIFF's geokeys, tiepoints and pixel scale into a 
+ *      new dict.  The GEOGRAPHIC model type is supported, and the 
+ *      PROJECTED model type with a Transverse Mercator projection; see
+ *      getProjection().
+ */
+
+static int
+getGeoKeys(Tcl_Interp* interp, TIFF* tiff, Tcl_Obj** result, 
+           GeoModel* model)
+{
+    double*   d_list = NULL;
+    uint16    d_list_count;
+    ttag_t    field;
+    geocode_t code;
+    geokey_t  key;
+    GTIF*     gtif;
+    GeoModel  m;
+    Tcl_Obj*  projection = NULL;
+    double    unit = 1.0;
+    double    tie[4] = {0.0, 0.0, 0.0, 0.0}; /* Tiepoint i,j and X,Y */
+    int       haveTie = 0;
+    int       i;
+
+    gtif = GTIFNew(tiff);
+
+    /* File does not contain any geokeys */
+    if (!gtif)
+    {
+        Tcl_SetResult(interp, "file does not contain geokeys", TCL_STATIC);
+        return TCL_ERROR;
+    }
+
+    /* Model Type */
+    key = (geokey_t)GT_MODEL_TYPE;
+
+    if (!GTIFKeyGet(gtif, key, &code, 0, 1))
+    {
+        Tcl_SetResult(interp, "file is not a GeoTIFF", TCL_STATIC);
+        GTIFFree(gtif);
+        return TCL_ERROR;
+    }
+
+    memset(&m, 0, sizeof(GeoModel));
+
+    switch (code) 
+    {
+        /* Unsupported Model Types */
+        case MODEL_TYPE_GEOCENTRIC:
+            Tcl_SetResult(interp, 
+                 "unsupported model type, must be geographic or projected",
+                 TCL_STATIC);
+            GTIFFree(gtif);
+            return TCL_ERROR;
+
+        case MODEL_TYPE_PROJECTED:
+            if (getProjection(interp, gtif, &m, &unit, &projection) 
+                != TCL_OK)
+            {
+                GTIFFree(gtif);
+                return TCL_ERROR;
+            }
+            break;
+
+        case MODEL_TYPE_GEOGRAPHIC:
+            break;
+
+        default:
+            Tcl_SetResult(interp, "unrecognized model type", TCL_STATIC);
+            GTIFFree(gtif);
+            return TCL_ERROR;
+    }
+
+    GTIFFree(gtif);
+
+    /* Result returned as a dictionary */
+    *result = Tcl_NewDictObj();
+
+    /* Model type */
+    if (projection != NULL)
+    {
+        Tcl_DictObjPut(interp, *result, Tcl_NewStringObj("modeltype", 9),
+                       Tcl_NewStringObj("PROJECTED", 9));
+        Tcl_DictObjPut(interp, *result, Tcl_NewStringObj("projection", 10),
+                       projection);
+    }
+    else
+    {
+        Tcl_DictObjPut(interp, *result, Tcl_NewStringObj("modeltype", 9),
+                       Tcl_NewStringObj("GEOGRAPHIC", 10));
+    }
+
+    /* Tiepoints */
+    field = (ttag_t)MODEL_TIEPOINT_TAG;
+
+    if (!TIFFGetField(tiff, field, &d_list_count, &d_list))
+    {
+        Tcl_DecrRefCount(*result);
+        Tcl_SetResult(interp, "no tiepoints found in image", TCL_STATIC);
+        return TCL_ERROR;
+    }
+
+    Tcl_Obj* tplist = Tcl_NewObj();
+
+    for (i=0; i<d_list_count; i++)
+    {
+        Tcl_ListObjAppendElement(interp, tplist, Tcl_NewDoubleObj(d_list[i]));
+    }
+
+    Tcl_DictObjPut(interp, *result, Tcl_NewStringObj("tiepoints", 9), tplist);
+
+    if (d_list_count >= 6)
+    {
+        tie[0]  = d_list[0];
+        tie[1]  = d_list[1];
+        tie[2]  = d_list[3];
+        tie[3]  = d_list[4];
+        haveTie = 1;
+    }
+
+    /* Pixel scaling */
+    field = (ttag_t)MODEL_PIXEL_SCALE_TAG;
+
+    if (!TIFFGetField(tiff, field, &d_list_count, &d_list))
+    {
+        Tcl_DecrRefCount(*result);
+        Tcl_SetResult(interp, "no pixel scaling found in image", TCL_STATIC);
+        return TCL_ERROR;
+    }
+
+    Tcl_Obj* pslist = Tcl_NewObj();
+
+    for (i=0; i<d_list_count; i++)
+    {
+        Tcl_ListObjAppendElement(interp, pslist, Tcl_NewDoubleObj(d_list[i]));
+    }
+
+    Tcl_DictObjPut(interp, *result, Tcl_NewStringObj("pscale", 6), pslist);
+
+    /* The GeoModel: the model coordinates of pixel 0,0, and the model
+     * units per pixel.  They are in meters for a projected image, and
+     * model y increases up the image. */
+    if (model != NULL)
+    {
+        if (haveTie && d_list_count >= 2 && 
+            d_list[0] != 0.0 && d_list[1] != 0.0)
+        {
+            m.sx = d_list[0]*unit;
+            m.sy = -d_list[1]*unit;
+            m.x0 = tie[2]*unit - tie[0]*m.sx;
+            m.y0 = tie[3]*unit - tie[1]*m.sy;
+        }
+
+        *model = m;
+    }
+
+    return TCL_OK;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	probeFile()
+ *
+ * INPUTS:
+ *	path		The normalized name of a file
+ *
+ * OUTPUTS:
+ *	probe		What was found in it; its values, if any, are
+ *                      the caller's to free.
+ *
+ * RETURNS:
+ *	nothing
+ *
+ * DESCRIPTION:
+ *	Probes a file for geotiff probe, using the cached probe if the
+ *      file's modification time and size haven't changed, and caching
+ *      the new one otherwise.  It's thread-safe, and touches no Tcl
+ *      objects.
+ */
+
+static void
+probeFile(const char* path, GeoProbe* probe)
+{
+    struct stat    st;
+    Tcl_HashEntry* entry;
+    ProbeEntry*    cached;
+    FILE*          f;
+    int            isNew;
+
+    memset(probe, 0, sizeof(GeoProbe));
+
+    /* FIRST, there's nothing to probe or cache if it isn't there. */
+    if (stat(path, &st) != 0)
+    {
+        probe->status = PROBE_NO_FILE;
+        return;
+    }
+
+    /* NEXT, use the cached probe if it's still good. */
+    Tcl_MutexLock(&probeMutex);
+
+    if (!probeCacheReady)
+    {
+        Tcl_InitHashTable(&probeCache, TCL_STRING_KEYS);
+        probeCacheReady = 1;
+    }
+
+    entry = Tcl_FindHashEntry(&probeCache, path);
+
+    if (entry != NULL)
+    {
+        cached = (ProbeEntry*)Tcl_GetHashValue(entry);
+
+        if (cached->mtime == (Tcl_WideInt)st.st_mtime &&
+            cached->size  == (Tcl_WideInt)st.st_size)
+        {
+            copyGeoProbe(&cached->probe, probe);
+            Tcl_MutexUnlock(&probeMutex);
+            return;
+        }
+    }
+
+    Tcl_MutexUnlock(&probeMutex);
+
+    /* NEXT, probe the file. */
+    if ((f = fopen(path, "rb")) == NULL)
+    {
+        probe->status = PROBE_NO_FILE;
+        return;
+    }
+
+    probe->status = readGeoProbe(f, probe);
+    fclose(f);
+
+    /* NEXT, cache what was found. */
+    Tcl_MutexLock(&probeMutex);
+
+    entry = Tcl_CreateHashEntry(&probeCache, path, &isNew);
+
+    if (isNew)
+    {
+        cached = (ProbeEntry*)Tcl_Alloc(sizeof(ProbeEntry));
+        Tcl_SetHashValue(entry, (ClientData)cached);
+    }
+    else 
+    {
+        cached = (ProbeEntry*)Tcl_GetHashValue(entry);
+
+        if (cached->probe.values != NULL)
+        {
+            Tcl_Free((char*)cached->probe.values);
+        }
+    }
+
+    cached->mtime = (Tcl_WideInt)st.st_mtime;
+    cached->size  = (Tcl_WideInt)st.st_size;
+    copyGeoProbe(probe, &cached->probe);
+
+    Tcl_MutexUnlock(&probeMutex);
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	readGeoProbe()
+ *
+ * INPUTS:
+ *	f		A file open for reading, at its start
+ *
+ * OUTPUTS:
+ *	probe		The modelType, width, height and values, if found
+ *
+ * RETURNS:
+ *	PROBE_OK, or a PROBE_ error code.
+ *
+ * DESCRIPTION:
+ *	Reads the file's TIFF header and the entries of its first IFD,
+ *      and then only the values of the geo tags: the model
+ *      type from the GeoKeyDirectory, the tiepoints, and the pixel
+ *      scale.  The checks are made in the same order as by geotiff
+ *      read, so a bad file gets the same error.
+ */
+
+static int
+readGeoProbe(FILE* f, GeoProbe* probe)
+{
+    unsigned char  header[8];
+    unsigned char* entries;
+    unsigned char* keys;
+    unsigned char* tie   = NULL;
+    unsigned char* scale = NULL;
+    unsigned char* keyEntry   = NULL;
+    unsigned char* tieEntry   = NULL;
+    unsigned char* scaleEntry = NULL;
+    Tcl_WideInt    ifd;
+    int            be;         /* 1 if big-endian */
+    int            nentries;
+    int            nkeys;
+    int            nshorts;
+    int            i;
+
+    /* FIRST, read the header, for the byte order and the offset of
+     * the first IFD.  Like libTiff, only classic TIFF is supported, 
+     * not BigTIFF. */
+    if (fread(header, 1, 8, f) != 8)
+    {
+        return PROBE_NOT_TIFF;
+    }
+
+    if (header[0] == 'I' && header[1] == 'I')
+    {
+        be = 0;
+    }
+    else if (header[0] == 'M' && header[1] == 'M')
+    {
+        be = 1;
+    }
+    else
+    {
+        return PROBE_NOT_TIFF;
+    }
+
+    if (probeGet(header + 2, 2, be) != TIFF_VERSION)
+    {
+        return PROBE_NOT_TIFF;
+    }
+
+    ifd = probeGet(header + 4, 4, be);
+
+    /* NEXT, read the IFD's entries in one go, and pick out the geo 
+     * tags and the image size. */
+    if (ifd == 0 || ifd > LONG_MAX ||
+        fseek(f, (long)ifd, SEEK_SET) != 0 ||
+        fread(header, 1, 2, f) != 2)
+    {
+        return PROBE_NOT_TIFF;
+    }
+
+    nentries = (int)probeGet(header, 2, be);
+
+    if (nentries < 1 || nentries > PROBE_MAX_ENTRIES)
+    {
+        return PROBE_NOT_TIFF;
+    }
+
+    entries = (unsigned char*)Tcl_Alloc(nentries * 12);
+
+    if (fread(entries, 12, nentries, f) != (size_t)nentries)
+    {
+        Tcl_Free((char*)entries);
+        return PROBE_NOT_TIFF;
+    }
+
+    for (i = 0; i < nentries; i++)
+    {
+        unsigned char* e     = entries + i*12;
+        int            type  = (int)probeGet(e + 2, 2, be);
+        int            size  = (type == TIFF_SHORT) ? 2 : 4;
+
+        switch (probeGet(e, 2, be))
+        {
+            case TIFFTAG_IMAGEWIDTH:
+                probe->width = probeGet(e + 8, size, be);
+                break;
+
+            case TIFFTAG_IMAGELENGTH:
+                probe->height = probeGet(e + 8, size, be);
+                break;
+
+            case GEO_KEY_DIRECTORY_TAG:
+                keyEntry = (type == TIFF_SHORT) ? e : NULL;
+                break;
+
+            case MODEL_TIEPOINT_TAG:
+                tieEntry = (type == TIFF_DOUBLE) ? e : NULL;
+                break;
+
+            case MODEL_PIXEL_SCALE_TAG:
+                scaleEntry = (type == TIFF_DOUBLE) ? e : NULL;
+                break;
+        }
+    }
+
+    /* NEXT, get the model type from the GeoKeyDirectory: a header of
+     * version, revision, minor revision and number of keys, and then
+     * each key's ID, location, count and value. */
+    keys = keyEntry ? probeValues(f, keyEntry, be, 2, &nshorts) : NULL;
+
+    if (keys == NULL || nshorts < 4)
+    {
+        probe->status = PROBE_NOT_GEOTIFF;
+    }
+    else if (probeGet(keys, 2, be) > GvCurrentVersion)
+    {
+        probe->status = PROBE_NO_GEOKEYS;
+    }
+    else
+    {
+        probe->status = PROBE_NOT_GEOTIFF;
+        nkeys         = (int)probeGet(keys + 6, 2, be);
+
+        for (i = 0; i < nkeys && 4*(i + 2) <= nshorts; i++)
+        {
+            unsigned char* key = keys + 8*(i + 1);
+
+            if (probeGet(key, 2, be) == GT_MODEL_TYPE &&
+                probeGet(key + 2, 2, be) == 0)
+            {
+                probe->modelType = (int)probeGet(key + 6, 2, be);
+                probe->status    = PROBE_OK;
+                break;
+            }
+        }
+    }
+
+    if (probe->status == PROBE_OK)
+    {
+        switch (probe->modelType)
+        {
+            case MODEL_TYPE_GEOCENTRIC:
+                probe->status = PROBE_GEOCENTRIC;
+                break;
+
+            case MODEL_TYPE_PROJECTED:
+            case MODEL_TYPE_GEOGRAPHIC:
+                break;
+
+            default:
+                probe->status = PROBE_BAD_MODEL;
+                break;
+        }
+    }
+
+    /* NEXT, get the tiepoints and pixel scale, as doubles. */
+    if (probe->status == PROBE_OK)
+    {
+        tie = tieEntry ? 
+            probeValues(f, tieEntry, be, 8, &probe->ntie) : NULL;
+
+        if (tie == NULL)
+        {
+            probe->status = PROBE_NO_TIEPOINTS;
+        }
+    }
+
+    if (probe->status == PROBE_OK)
+    {
+        scale = scaleEntry ?
+            probeValues(f, scaleEntry, be, 8, &probe->nscale) : NULL;
+
+        if (scale == NULL)
+        {
+            probe->status = PROBE_NO_PSCALE;
+        }
+    }
+
+    if (probe->status == PROBE_OK)
+    {
+        probe->values = (double*)Tcl_Alloc(
+            (probe->ntie + probe->nscale) * sizeof(double));
+
+        for (i = 0; i < probe->ntie + probe->nscale; i++)
+        {
+            Tcl_WideInt bits = (i < probe->ntie)
+                ? probeGet(tie + 8*i, 8, be)
+                : probeGet(scale + 8*(i - probe->ntie), 8, be);
+
+            memcpy(probe->values + i, &bits, sizeof(double));
+        }
+    }
+
+    Tcl_Free((char*)entries);
+
+    if (keys != NULL)
+    {
+        Tcl_Free((char*)keys);
+    }
+
+    if (tie != NULL)
+    {
+        Tcl_Free((char*)tie);
+    }
+
+    if (scale != NULL)
+    {
+        Tcl_Free((char*)scale);
+    }
+
+    return probe->status;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	probeValues()
+ *
+ * INPUTS:
+ *	f		The file
+ *	e		An IFD entry
+ *	be		1 if the file is big-endian
+ *	size		The size of each value, in bytes
+ *
+ * OUTPUTS:
+ *	count		The number of values
+ *
+ * RETURNS:
+ *	The entry's values, unswapped, in a buffer the caller must free;
+ *      or NULL if they can't be read.
+ *
+ * DESCRIPTION:
+ *	Reads an IFD entry's values, which are in the entry itself if
+ *      they fit and at the offset it gives otherwise.
+ */
+
+static unsigned char*
+probeValues(FILE* f, unsigned char* e, int be, int size, int* count)
+{
+    Tcl_WideInt    n = probeGet(e + 4, 4, be);
+    Tcl_WideInt    offset;
+    unsigned char* values;
+
+    if (n < 1 || n > PROBE_MAX_VALUES)
+    {
+        return NULL;
+    }
+
+    values = (unsigned char*)Tcl_Alloc((int)n * size);
+
+    if (n * size <= 4)
+    {
+        memcpy(values, e + 8, (size_t)(n * size));
+    }
+    else
+    {
+        offset = probeGet(e + 8, 4, be);
+
+        if (offset <= 0 || offset > LONG_MAX ||
+            fseek(f, (long)offset, SEEK_SET) != 0 ||
+            fread(values, size, (size_t)n, f) != (size_t)n)
+        {
+            Tcl_Free((char*)values);
+            return NULL;
+        }
+    }
+
+    *count = (int)n;
+
+    return values;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	probeGet()
+ *
+ * INPUTS:
+ *	p		Some bytes of a TIFF file
+ *	n		The number of bytes, at most 8
+ *	be		1 if the file is big-endian
+ *
+ * RETURNS:
+ *	The unsigned integer they hold.
+ *
+ * DESCRIPTION:
+ *	Decodes an integer in the file's byte order, whatever the host's.
+ */
+
+static Tcl_WideInt
+probeGet(const unsigned char* p, int n, int be)
+{
+    Tcl_WideUInt v = 0;
+    int          i;
+
+    for (i = 0; i < n; i++)
+    {
+        v = (v << 8) | p[be ? i : n - 1 - i];
+    }
+
+    return (Tcl_WideInt)v;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	copyGeoProbe()
+ *
+ * INPUTS:
+ *	src		A GeoProbe
+ *
+ * OUTPUTS:
+ *	dst		A copy of it, with its own values
+ *
+ * RETURNS:
+ *	nothing
+ */
+
+static void
+copyGeoProbe(GeoProbe* src, GeoProbe* dst)
+{
+    *dst = *src;
+
+    if (src->values != NULL)
+    {
+        size_t size = (src->ntie + src->nscale) * sizeof(double);
+
+        dst->values = (double*)memcpy(Tcl_Alloc(size), src->values, size);
+    }
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	newProbeDict()
+ *
+ * INPUTS:
+ *	probe		A successful GeoProbe
+ *
+ * RETURNS:
+ *	The geotiff probe dict.
+ */
+
+static Tcl_Obj*
+newProbeDict(GeoProbe* probe)
+{
+    Tcl_Obj* result = Tcl_NewDictObj();
+    Tcl_Obj* tplist = Tcl_NewObj();
+    Tcl_Obj* pslist = Tcl_NewObj();
+    int      i;
+
+    for (i = 0; i < probe->ntie; i++)
+    {
+        Tcl_ListObjAppendElement(NULL, tplist, 
+                                 Tcl_NewDoubleObj(probe->values[i]));
+    }
+
+    for (i = probe->ntie; i < probe->ntie + probe->nscale; i++)
+    {
+        Tcl_ListObjAppendElement(NULL, pslist, 
+                                 Tcl_NewDoubleObj(probe->values[i]));
+    }
+
+    Tcl_DictObjPut(NULL, result, Tcl_NewStringObj("modeltype", 9),
+                   (probe->modelType == MODEL_TYPE_PROJECTED)
+                   ? Tcl_NewStringObj("PROJECTED", 9)
+                   : Tcl_NewStringObj("GEOGRAPHIC", 10));
+    Tcl_DictObjPut(NULL, result, Tcl_NewStringObj("width", 5),
+                   Tcl_NewWideIntObj(probe->width));
+    Tcl_DictObjPut(NULL, result, Tcl_NewStringObj("height", 6),
+                   Tcl_NewWideIntObj(probe->height));
+    Tcl_DictObjPut(NULL, result, Tcl_NewStringObj("tiepoints", 9), tplist);
+    Tcl_DictObjPut(NULL, result, Tcl_NewStringObj("pscale", 6), pslist);
+
+    return result;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	probeRange()
+ *
+ * INPUTS:
+ *	cd		A ProbeBatch*
+ *	first		The index of the first file to probe
+ *	last		The index after the last file
+ *
+ * RETURNS:
+ *	nothing
+ *
+ * DESCRIPTION:
+ *	A WorkProc that probes the batch's files from first to last.
+ */
+
+static void
+probeRange(ClientData cd, int first, int last)
+{
+    ProbeBatch* batch = (ProbeBatch*)cd;
+    int         i;
+
+    for (i = first; i < last; i++)
+    {
+        probeFile(batch->paths[i], batch->probes + i);
+    }
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	compareStrings()
+ *
+ * INPUTS:
+ *	a, b		Pointers to char*
+ *
+ * RETURNS:
+ *	<0, 0, or >0, as for strcmp.
+ *
+ * DESCRIPTION:
+ *	qsort() comparison function for an array of strings.
+ */
+
+static int
+compareStrings(const void* a, const void* b)
+{
+    return strcmp(*(const char**)a, *(const char**)b);
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	getGeotiff()
+ *
+ * INPUTS:
+ *	interp		The Tcl interpreter
+ *      info		The GeotiffInfo
+ *      handle		A geotiff handle
+ *
+ * OUTPUTS:
+ *	img		The GeotiffImage
+ *
+ * RETURNS:
+ *	TCL_OK on success and TCL_ERROR on failure, setting the error
+ *      string in the latter case.
+ *
+ * DESCRIPTION:
+ *	Looks up a geotiff handle.
+ */
+
+static int
+getGeotiff(Tcl_Interp* interp, GeotiffInfo* info, Tcl_Obj* handle,
+           GeotiffImage** img)
+{
+    Tcl_HashEntry* entry;
+
+    entry = Tcl_FindHashEntry(&info->images, Tcl_GetString(handle));
+
+    if (entry == NULL)
+    {
+        Tcl_AppendStringsToObj(Tcl_GetObjResult(interp), 
+                               "unknown geotiff: \"", 
+                               Tcl_GetString(handle), "\"", NULL);
+        return TCL_ERROR;
+    }
+
+    *img = (GeotiffImage*)Tcl_GetHashValue(entry);
+
+    return TCL_OK;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	getLevel()
+ *
+ * INPUTS:
+ *	interp		The Tcl interpreter
+ *      img		A GeotiffImage
+ *      objc, objv	The subcommand's arguments
+ *      a		The index of the optional "-level n"
+ *
+ * OUTPUTS:
+ *	level		The requested GeotiffLevel, 0 by default
+ *
+ * RETURNS:
+ *	TCL_OK on success and TCL_ERROR on failure, setting the error
+ *      string in the latter case.
+ *
+ * DESCRIPTION:
+ *	Gets the level to read, and makes its IFD the current one.
+ */
+
+static int
+getLevel(Tcl_Interp* interp, GeotiffImage* img, int objc, 
+         Tcl_Obj* CONST objv[], int a, GeotiffLevel** level)
+{
+    int n = 0;
+
+    if (objc > a)
+    {
+        if (!isFlag(objv[a], "-level"))
+        {
+            Tcl_AppendStringsToObj(Tcl_GetObjResult(interp),
+                                   "unknown option: \"", 
+                                   Tcl_GetString(objv[a]), "\"", NULL);
+            return TCL_ERROR;
+        }
+
+        if (Tcl_GetIntFromObj(interp, objv[a + 1], &n) != TCL_OK)
+        {
+            return TCL_ERROR;
+        }
+
+        if (n < 0 || n >= img->nlevels)
+        {
+            Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+                "invalid level, should be 0 to %d: \"%d\"", 
+                img->nlevels - 1, n));
+            return TCL_ERROR;
+        }
+    }
+
+    if (n != img->current)
+    {
+        if (!TIFFSetDirectory(img->tiff, img->levels[n].dir))
+        {
+            Tcl_SetResult(interp, "error reading level", TCL_STATIC);
+            return TCL_ERROR;
+        }
+
+        img->current = n;
+    }
+
+    *level = &img->levels[n];
+
+    return TCL_OK;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	mapGeotiff()
+ *
+ * INPUTS:
+ *	img		A GeotiffImage
+ *
+ * OUTPUTS:
+ *	none
+ *
+ * RETURNS:
+ *	nothing
+ *
+ * DESCRIPTION:
+ *	Maps the image's file read-only using libTiff's own map procedure,
+ *      so that mappedBlock() can find its blocks.  If the file can't be
+ *      mapped, the image is simply read by decoding as usual.
+ */
+
+static void
+mapGeotiff(GeotiffImage* img)
+{
+    TIFFMapFileProc mapProc = TIFFGetMapFileProc(img->tiff);
+
+    if (!mapProc(TIFFClientdata(img->tiff), &img->map, &img->mapSize))
+    {
+        img->map     = NULL;
+        img->mapSize = 0;
+    }
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	mappedBlock()
+ *
+ * INPUTS:
+ *	img		A GeotiffImage
+ *      level		One of its levels
+ *      n		A tile or strip number
+ *      size		The number of bytes the block should hold
+ *
+ * OUTPUTS:
+ *	none
+ *
+ * RETURNS:
+ *	A pointer to the block's pixels in the file mapping, or NULL if
+ *      the block must be decoded.
+ *
+ * DESCRIPTION:
+ *	Finds an uncompressed block in the file mapping.  The block must
+ *      lie entirely within the mapping.
+ */
+
+static unsigned char*
+mappedBlock(GeotiffImage* img, GeotiffLevel* level, uint32 n, tsize_t size)
+{
+    if (img->map == NULL || level->offsets == NULL || n >= level->nblocks ||
+        level->counts[n] < (uint32)size || (toff_t)size > img->mapSize ||
+        level->offsets[n] > img->mapSize - (toff_t)size)
+    {
+        return NULL;
+    }
+
+    return (unsigned char*)img->map + level->offsets[n];
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	closeGeotiff()
+ *
+ * INPUTS:
+ *	img		A GeotiffImage
+ *
+ * OUTPUTS:
+ *	none
+ *
+ * RETURNS:
+ *	nothing
+ *
+ * DESCRIPTION:
+ *	Unmaps and closes the image's file and frees the GeotiffImage.
+ */
+
+static void
+closeGeotiff(GeotiffImage* img)
+{
+    int i;
+
+    if (img->map != NULL)
+    {
+        TIFFGetUnmapFileProc(img->tiff)(TIFFClientdata(img->tiff),
+                                        img->map, img->mapSize);
+    }
+
+    XTIFFClose(img->tiff);
+    Tcl_DecrRefCount(img->georef);
+    freeGeoGrid(img->toLatLong);
+    freeGeoGrid(img->toPixel);
+
+    for (i = 0; i < img->nlevels; i++)
+    {
+        if (img->levels[i].offsets != NULL)
+        {
+            Tcl_Free((char*)img->levels[i].offsets);
+            Tcl_Free((char*)img->levels[i].counts);
+        }
+    }
+
+    if (img->levels != NULL)
+    {
+        Tcl_Free((char*)img->levels);
+    }
+
+    if (img->buf != NULL)
+    {
+        _TIFFfree(img->buf);
+    }
+
+    for (i = 1; i <= img->ndecoders; i++)
+    {
+        XTIFFClose(img->decoders[i]);
+
+        if (img->decoderBufs[i] != NULL)
+        {
+            _TIFFfree(img->decoderBufs[i]);
+        }
+    }
+
+    Tcl_Free(img->path);
+    Tcl_Free((char*)img);
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	getDecoders()
+ *
+ * INPUTS:
+ *	img		A GeotiffImage
+ *      n		The level to read
+ *      workers		The number of decoders wanted
+ *
+ * OUTPUTS:
+ *	none
+ *
+ * RETURNS:
+ *	The number of decoders ready, from 1 to workers.
+ *
+ * DESCRIPTION:
+ *	Gets the image's extra decoders ready to read level n in
+ *      parallel: opens more handles on the file as needed, makes n
+ *      their current level, and gives each a block buffer.  The image's
+ *      own handle is decoder 0.  The handles are kept until the image
+ *      is closed.  If a handle can't be opened or positioned, fewer
+ *      decoders are used.
+ */
+
+static int
+getDecoders(GeotiffImage* img, int n, int workers)
+{
+    int w;
+
+    for (w = 1; w < workers; w++)
+    {
+        /* FIRST, open another handle if need be. */
+        if (w > img->ndecoders)
+        {
+            TIFF* tiff = XTIFFOpen(img->path, "rm");
+
+            if (tiff == NULL)
+            {
+                break;
+            }
+
+            img->decoders[w]      = tiff;
+            img->decoderLevels[w] = 0;
+            img->decoderBufs[w]   = NULL;
+            img->ndecoders        = w;
+        }
+
+        /* NEXT, make the level current, and get a buffer. */
+        if (img->decoderLevels[w] != n)
+        {
+            if (!TIFFSetDirectory(img->decoders[w], img->levels[n].dir))
+            {
+                break;
+            }
+
+            img->decoderLevels[w] = n;
+        }
+
+        if (img->decoderBufs[w] == NULL)
+        {
+            img->decoderBufs[w] = _TIFFmalloc(img->bufSize);
+
+            if (img->decoderBufs[w] == NULL)
+            {
+                break;
+            }
+        }
+    }
+
+    return w;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	regionBlocks()
+ *
+ * INPUTS:
+ *	job		A RegionJob
+ *      tiff		The handle to decode with, at the job's level
+ *      block		A buffer of the image's bufSize bytes
+ *      first		The first block to read
+ *      last		The block after the last
+ *
+ * OUTPUTS:
+ *	The blocks' parts of job->bytes
+ *
+ * RETURNS:
+ *	1 on success, and 0 if a block couldn't be decoded.
+ *
+ * DESCRIPTION:
+ *	Decodes the region's blocks from first to last-1 in turn, and
+ *      copies each one's overlap with the region into the region's
+ *      pixels, or passes it to job->put.  Blocks in a file mapping 
+ *      are copied from directly.  Without a put, touches nothing but
+ *      the handle, the buffer, and the blocks' parts of the region, 
+ *      so may run on a worker thread.
+ */
+
+static int
+regionBlocks(RegionJob* job, TIFF* tiff, tdata_t block, int first, int last)
+{
+    GeotiffImage* img   = job->img;
+    GeotiffLevel* level = job->level;
+    int           pb    = img->pixelBytes;
+    int           k;
+
+    for (k = first; k < last; k++)
+    {
+        uint32         bx = job->bx + (k % job->cols) * level->blockWidth;
+        uint32         by = job->by + (k / job->cols) * level->blockHeight;
+        uint32         n;
+        tsize_t        size;
+        unsigned char* src;
+
+        if (level->tiled)
+        {
+            n    = TIFFComputeTile(tiff, bx, by, 0, 0);
+            size = level->blockSize;
+        }
+        else
+        {
+            n    = TIFFComputeStrip(tiff, by, 0);
+            size = (tsize_t)dmin(level->height - by, level->blockHeight)
+                   * level->width * pb;
+        }
+
+        src = mappedBlock(img, level, n, size);
+
+        if (src == NULL)
+        {
+            src = (unsigned char*)block;
+
+            if (level->tiled)
+            {
+                size = TIFFReadEncodedTile(tiff, n, block, img->bufSize);
+            }
+            else
+            {
+                size = TIFFReadEncodedStrip(tiff, n, block, img->bufSize);
+            }
+        }
+
+        if (size < 0)
+        {
+            return 0;
+        }
+
+        /* Copy the overlap, a row at a time, or hand it on. */
+        uint32 x0 = dmax(bx, job->x);
+        uint32 x1 = dmin(bx + level->blockWidth, job->x + job->w);
+        uint32 y0 = dmax(by, job->y);
+        uint32 y1 = dmin(by + level->blockHeight, job->y + job->h);
+        uint32 r;
+
+        if (job->put != NULL)
+        {
+            if (!job->put(job, 
+                          src + ((size_t)(y0 - by)*level->blockWidth + 
+                                 (x0 - bx))*pb,
+                          level->blockWidth*pb, x0 - job->x, y0 - job->y,
+                          x1 - x0, y1 - y0))
+            {
+                return 0;
+            }
+
+            continue;
+        }
+
+        for (r = y0; r < y1; r++)
+        {
+            memcpy(job->bytes + ((size_t)(r - job->y)*job->w + 
+                                 (x0 - job->x))*pb,
+                   src + ((size_t)(r - by)*level->blockWidth + 
+                          (x0 - bx))*pb,
+                   (size_t)(x1 - x0)*pb);
+        }
+    }
+
+    return 1;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	regionRange()
+ *
+ * INPUTS:
+ *	cd		A RegionJob*
+ *	first		The first decoder
+ *	last		The decoder after the last
+ *
+ * RETURNS:
+ *	nothing
+ *
+ * DESCRIPTION:
+ *	A WorkProc over the job's decoders rather than its blocks, since
+ *      each worker needs a decoder of its own: decoder w reads the w'th
+ *      of the job's contiguous shares of blocks.  Sets job->failed if
+ *      a block can't be decoded.
+ */
+
+static void
+regionRange(ClientData cd, int first, int last)
+{
+    RegionJob*    job = (RegionJob*)cd;
+    GeotiffImage* img = job->img;
+    int           w;
+
+    for (w = first; w < last; w++)
+    {
+        int from = (int)((long)job->nblocks*w/job->workers);
+        int to   = (int)((long)job->nblocks*(w + 1)/job->workers);
+
+        if (!regionBlocks(job, 
+                          w == 0 ? img->tiff : img->decoders[w],
+                          w == 0 ? img->buf  : img->decoderBufs[w],
+                          from, to))
+        {
+            job->failed = 1;
+        }
+    }
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	getTkStubs()
+ *
+ * INPUTS:
+ *	interp		The Tcl interpreter
+ *
+ * OUTPUTS:
+ *	none
+ *
+ * RETURNS:
+ *	TCL_OK on success and TCL_ERROR on failure, setting the error
+ *      string in the latter case.
+ *
+ * DESCRIPTION:
+ *	Finds Tk's stubs table, as Tk_InitStubs() would, if Tk is loaded
+ *      in the interpreter.  Marsbin doesn't otherwise need Tk, so
+ *      doesn't link with its stubs library or load it.
+ */
+
+static int
+getTkStubs(Tcl_Interp* interp)
+{
+    ClientData stubs;
+
+    if (tkStubsPtr != NULL)
+    {
+        return TCL_OK;
+    }
+
+    if (Tcl_PkgPresentEx(interp, "Tk", "8.5", 0, &stubs) == NULL)
+    {
+        return TCL_ERROR;
+    }
+
+    if (stubs == NULL)
+    {
+        Tcl_SetResult(interp, "Tk has no stubs table", TCL_STATIC);
+        return TCL_ERROR;
+    }
+
+    tkStubsPtr = (const TkStubs*)stubs;
+
+    return TCL_OK;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	photoLayout()
+ *
+ * INPUTS:
+ *	interp		The Tcl interpreter
+ *      img		A GeotiffImage, at the level to be read
+ *
+ * OUTPUTS:
+ *	pj		The block layout and conversion
+ *
+ * RETURNS:
+ *	TCL_OK on success and TCL_ERROR on failure, setting the error
+ *      string in the latter case.
+ *
+ * DESCRIPTION:
+ *	Describes the image's pixels to Tk.  Grayscale and RGB, with or 
+ *      without alpha, are given as they are, with each sample's offset
+ *      in the pixel; for 16-bit samples that's the offset of the high
+ *      byte.  8-bit palette images are converted to RGB, and
+ *      white-is-zero ones are inverted.
+ */
+
+static int
+photoLayout(Tcl_Interp* interp, GeotiffImage* img, PhotoJob* pj)
+{
+    static const uint16 one = 1;
+    int                 hi  = (img->bits == 16 && 
+                               *(const unsigned char*)&one == 1) ? 1 : 0;
+    int                 sb  = img->bits/8;
+    uint16              nextra = 0;
+    uint16*             extra;
+    int                 alpha;
+    int                 i;
+
+    /* FIRST, see if there's unassociated alpha after the colors. */
+    TIFFGetFieldDefaulted(img->tiff, TIFFTAG_EXTRASAMPLES, &nextra, &extra);
+    alpha = (nextra > 0 && extra[0] == EXTRASAMPLE_UNASSALPHA);
+
+    pj->convert         = PHOTO_ASIS;
+    pj->block.pixelSize = img->pixelBytes;
+    pj->block.offset[3] = img->pixelBytes;    /* Opaque */
+
+    switch (img->photometric)
+    {
+    case PHOTOMETRIC_MINISWHITE:
+    case PHOTOMETRIC_MINISBLACK:
+        if (img->photometric == PHOTOMETRIC_MINISWHITE)
+        {
+            if (img->bits != 8)
+            {
+                break;
+            }
+
+            pj->convert = PHOTO_INVERT;
+        }
+
+        pj->block.offset[0] = hi;
+        pj->block.offset[1] = hi;
+        pj->block.offset[2] = hi;
+
+        if (alpha && img->samples >= 2)
+        {
+            pj->block.offset[3] = sb + hi;
+        }
+
+        return TCL_OK;
+
+    case PHOTOMETRIC_RGB:
+        if (img->samples < 3)
+        {
+            break;
+        }
+
+        pj->block.offset[0] = hi;
+        pj->block.offset[1] = sb + hi;
+        pj->block.offset[2] = 2*sb + hi;
+
+        if (alpha && img->samples >= 4)
+        {
+            pj->block.offset[3] = 3*sb + hi;
+        }
+
+        return TCL_OK;
+
+    case PHOTOMETRIC_PALETTE:
+    {
+        uint16* red;
+        uint16* green;
+        uint16* blue;
+        int     shift = 0;
+
+        if (img->bits != 8 || img->samples != 1 ||
+            !TIFFGetField(img->tiff, TIFFTAG_COLORMAP, &red, &green, &blue))
+        {
+            break;
+        }
+
+        /* Some writers store 8-bit colormaps; libTiff checks the same
+         * way. */
+        for (i = 0; i < 256; i++)
+        {
+            if (red[i] > 255 || green[i] > 255 || blue[i] > 255)
+            {
+                shift = 8;
+                break;
+            }
+        }
+
+        for (i = 0; i < 256; i++)
+        {
+            pj->cmap[3*i]     = (unsigned char)(red[i]   >> shift);
+            pj->cmap[3*i + 1] = (unsigned char)(green[i] >> shift);
+            pj->cmap[3*i + 2] = (unsigned char)(blue[i]  >> shift);
+        }
+
+        pj->convert         = PHOTO_PALETTE;
+        pj->block.pixelSize = 3;
+        pj->block.offset[0] = 0;
+        pj->block.offset[1] = 1;
+        pj->block.offset[2] = 2;
+        pj->block.offset[3] = 3;
+
+        return TCL_OK;
+    }
+    }
+
+    Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+        "unsupported pixel layout for a photo: photometric %d, "
+        "%d samples of %d bits", img->photometric, img->samples, 
+        img->bits));
+
+    return TCL_ERROR;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	photoBlock()
+ *
+ * INPUTS:
+ *	job		A RegionJob whose putData is a PhotoJob
+ *      src		The first pixel to put
+ *      pitch		The bytes between rows of src
+ *      x, y		Where in the region the pixels go
+ *      w, h		How many to put
+ *
+ * RETURNS:
+ *	1 on success, and 0 on failure, setting the error string.
+ *
+ * DESCRIPTION:
+ *	A RegionProc that puts part of a block into the photo; see
+ *      geotiff_tophoto().
+ */
+
+static int
+photoBlock(RegionJob* job, unsigned char* src, int pitch, 
+           int x, int y, int w, int h)
+{
+    PhotoJob*          pj    = (PhotoJob*)job->putData;
+    Tk_PhotoImageBlock block = pj->block;
+    int                pb    = job->img->pixelBytes;
+    int                r;
+    int                c;
+
+    block.pixelPtr = src;
+    block.width    = w;
+    block.height   = h;
+    block.pitch    = pitch;
+
+    /* FIRST, convert, if need be. */
+    if (pj->convert == PHOTO_PALETTE)
+    {
+        unsigned char* dst = pj->temp;
+
+        for (r = 0; r < h; r++)
+        {
+            unsigned char* p = src + (size_t)r*pitch;
+
+            for (c = 0; c < w; c++, dst += 3)
+            {
+                const unsigned char* rgb = pj->cmap + 3*p[c];
+
+                dst[0] = rgb[0];
+                dst[1] = rgb[1];
+                dst[2] = rgb[2];
+            }
+        }
+
+        block.pixelPtr = pj->temp;
+        block.pitch    = 3*w;
+    }
+    else if (pj->convert == PHOTO_INVERT)
+    {
+        unsigned char* dst = pj->temp;
+
+        for (r = 0; r < h; r++)
+        {
+            memcpy(dst, src + (size_t)r*pitch, (size_t)w*pb);
+
+            for (c = 0; c < w*pb; c += pb)
+            {
+                dst[c] = 255 - dst[c];
+            }
+
+            dst += w*pb;
+        }
+
+        block.pixelPtr = pj->temp;
+        block.pitch    = w*pb;
+    }
+
+    /* NEXT, put it. */
+    return Tk_PhotoPutBlock(pj->interp, pj->photo, &block, x, y, w, h, 
+                            TK_PHOTO_COMPOSITE_SET) == TCL_OK;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	getProjection()
+ *
+ * INPUTS:
+ *	interp		The Tcl interpreter
+ *	gtif		The image's geokeys
+ *
+ * OUTPUTS:
+ *	model		The projection fields of the GeoModel
+ *	unit		Meters per model unit
+ *	result		The "projection" dict for "geotiff read"
+ *
+ * RETURNS:
+ *	TCL_OK on success and TCL_ERROR on failure, setting the error
+ *      string in the latter case.
+ *
+ * DESCRIPTION:
+ *	Gets the projection of a PROJECTED image, which must be
+ *      Transverse Mercator; UTM zones are Transverse Mercator with the
+ *      zone's parameters.  libGTiff normalizes the geokeys, looking up
+ *      EPSG codes as need be, so that the parameters are in meters and
+ *      decimal degrees.
+ */
+
+static int
+getProjection(Tcl_Interp* interp, GTIF* gtif, GeoModel* model,
+              double* unit, Tcl_Obj** result)
+{
+    GTIFDefn defn;
+    double   f;
+    double   lat0;
+    double   lon0;
+    double   k;
+    double   fe;
+    double   fn;
+
+    /* FIRST, normalize the definition. */
+    if (!GTIFGetDefn(gtif, &defn) || 
+        defn.CTProjection != CT_TransverseMercator)
+    {
+        Tcl_SetResult(interp, 
+                      "unsupported projection, must be Transverse Mercator",
+                      TCL_STATIC);
+        return TCL_ERROR;
+    }
+
+    if (defn.SemiMajor <= 0.0 || defn.SemiMinor <= 0.0 || 
+        defn.UOMLengthInMeters <= 0.0)
+    {
+        Tcl_SetResult(interp, "unknown ellipsoid or linear units",
+                      TCL_STATIC);
+        return TCL_ERROR;
+    }
+
+    /* NEXT, set up the projection.  These are where GTIFGetDefn puts
+     * the Transverse Mercator parameters. */
+    f    = 1.0 - defn.SemiMinor/defn.SemiMajor;
+    lat0 = defn.ProjParm[0];
+    lon0 = defn.ProjParm[1];
+    k    = defn.ProjParm[4];
+    fe   = defn.ProjParm[5];
+    fn   = defn.ProjParm[6];
+
+    Init_Transverse_Mercator_Context(&model->tm);
+
+    if (Set_Transverse_Mercator_Parameters_r(&model->tm, defn.SemiMajor, f,
+                                             lat0*radians, lon0*radians,
+                                             fe, fn, k) != TRANMERC_NO_ERROR)
+    {
+        Tcl_SetResult(interp, "invalid Transverse Mercator parameters",
+                      TCL_STATIC);
+        return TCL_ERROR;
+    }
+
+    model->projected = 1;
+    model->lon0      = lon0;
+    *unit            = defn.UOMLengthInMeters;
+
+    /* NEXT, describe it. */
+    *result = Tcl_NewDictObj();
+
+    Tcl_DictObjPut(interp, *result, Tcl_NewStringObj("method", -1),
+                   Tcl_NewStringObj("TransverseMercator", -1));
+    Tcl_DictObjPut(interp, *result, Tcl_NewStringObj("zone", -1),
+                   Tcl_NewIntObj(defn.MapSys == MapSys_UTM_North ||
+                                 defn.MapSys == MapSys_UTM_South 
+                                 ? defn.Zone : 0));
+    Tcl_DictObjPut(interp, *result, Tcl_NewStringObj("hemisphere", -1),
+                   Tcl_NewStringObj(defn.MapSys == MapSys_UTM_North ? "N" :
+                                    defn.MapSys == MapSys_UTM_South ? "S" :
+                                    "", -1));
+    Tcl_DictObjPut(interp, *result, Tcl_NewStringObj("a", -1),
+                   Tcl_NewDoubleObj(defn.SemiMajor));
+    Tcl_DictObjPut(interp, *result, Tcl_NewStringObj("f", -1),
+                   Tcl_NewDoubleObj(f));
+    Tcl_DictObjPut(interp, *result, Tcl_NewStringObj("lat0", -1),
+                   Tcl_NewDoubleObj(lat0));
+    Tcl_DictObjPut(interp, *result, Tcl_NewStringObj("lon0", -1),
+                   Tcl_NewDoubleObj(lon0));
+    Tcl_DictObjPut(interp, *result, Tcl_NewStringObj("k", -1),
+                   Tcl_NewDoubleObj(k));
+    Tcl_DictObjPut(interp, *result, Tcl_NewStringObj("fe", -1),
+                   Tcl_NewDoubleObj(fe));
+    Tcl_DictObjPut(interp, *result, Tcl_NewStringObj("fn", -1),
+                   Tcl_NewDoubleObj(fn));
+    Tcl_DictObjPut(interp, *result, Tcl_NewStringObj("unit", -1),
+                   Tcl_NewDoubleObj(defn.UOMLengthInMeters));
+
+    return TCL_OK;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	pixelToLatLong()
+ *
+ * INPUTS:
+ *	model		A GeoModel
+ *	x, y		Pixel coordinates
+ *
+ * OUTPUTS:
+ *	lat, lon	The location in decimal degrees; for a projected
+ *                      image the longitude is within 180 degrees of the
+ *                      central meridian, rather than normalized.
+ *
+ * RETURNS:
+ *	1 on success, and 0 if the projection can't convert the point.
+ *
+ * DESCRIPTION:
+ *	Converts pixel coordinates to lat/long exactly.
+ */
+
+static int
+pixelToLatLong(GeoModel* model, double x, double y, double* lat, double* lon)
+{
+    double mx = model->x0 + x*model->sx;
+    double my = model->y0 + y*model->sy;
+
+    if (!model->projected)
+    {
+        *lat = my;
+        *lon = mx;
+        return 1;
+    }
+
+    if (Convert_Transverse_Mercator_To_Geodetic_r(&model->tm, mx, my, 
+                                                  lat, lon) 
+        & ~TRANMERC_LON_WARNING)
+    {
+        return 0;
+    }
+
+    *lat /= radians;
+    *lon  = *lon/radians - model->lon0;
+    *lon  = model->lon0 + *lon - 360.0*floor((*lon + 180.0)/360.0);
+
+    return 1;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	latLongToPixel()
+ *
+ * INPUTS:
+ *	model		A GeoModel
+ *	lat, lon	A location in decimal degrees
+ *
+ * OUTPUTS:
+ *	x, y		Pixel coordinates
+ *
+ * RETURNS:
+ *	1 on success, and 0 if the projection can't convert the point.
+ *
+ * DESCRIPTION:
+ *	Converts lat/long to pixel coordinates exactly.
+ */
+
+static int
+latLongToPixel(GeoModel* model, double lat, double lon, double* x, double* y)
+{
+    double mx = lon;
+    double my = lat;
+
+    if (model->projected)
+    {
+        lon -= 360.0*floor((lon + 180.0)/360.0);
+
+        if (Convert_Geodetic_To_Transverse_Mercator_r(&model->tm, 
+                                                      lat*radians, 
+                                                      lon*radians,
+                                                      &mx, &my)
+            & ~TRANMERC_LON_WARNING)
+        {
+            return 0;
+        }
+    }
+
+    *x = (mx - model->x0)/model->sx;
+    *y = (my - model->y0)/model->sy;
+
+    return 1;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	gridPoint()
+ *
+ * INPUTS:
+ *	grid		A GeoGrid
+ *	u, v		The inputs
+ *
+ * OUTPUTS:
+ *	out		The two outputs
+ *
+ * RETURNS:
+ *	1 on success, and 0 if the point is off the grid or in a cell
+ *      with a NaN node.
+ *
+ * DESCRIPTION:
+ *	Interpolates a conversion from the control grid.
+ */
+
+static int
+gridPoint(GeoGrid* grid, double u, double v, double* out)
+{
+    double  fx = (u - grid->x0)/grid->dx;
+    double  fy = (v - grid->y0)/grid->dy;
+    double* n00;
+    double* n01;
+    int     i;
+    int     j;
+
+    /* FIRST, find the cell; the test is false for NaN as well. */
+    if (!(fx >= 0.0 && fx <= grid->cols - 1 && 
+          fy >= 0.0 && fy <= grid->rows - 1))
+    {
+        return 0;
+    }
+
+    i = (int)fx < grid->cols - 1 ? (int)fx : grid->cols - 2;
+    j = (int)fy < grid->rows - 1 ? (int)fy : grid->rows - 2;
+    fx -= i;
+    fy -= j;
+
+    /* NEXT, interpolate between its corners. */
+    n00 = grid->nodes + 2*((size_t)j*grid->cols + i);
+    n01 = n00 + 2*grid->cols;
+
+    out[0] = (1.0 - fy)*((1.0 - fx)*n00[0] + fx*n00[2]) +
+                    fy *((1.0 - fx)*n01[0] + fx*n01[2]);
+    out[1] = (1.0 - fy)*((1.0 - fx)*n00[1] + fx*n00[3]) +
+                    fy *((1.0 - fx)*n01[1] + fx*n01[3]);
+
+    return !isnan(out[0]) && !isnan(out[1]);
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	newGeoGrid()
+ *
+ * INPUTS:
+ *	model		A projected GeoModel
+ *	toPixel		1 for lon,lat to pixels, 0 for pixels to lat,lon
+ *	x0, y0, x1, y1	The area to cover, in input units
+ *
+ * RETURNS:
+ *	The new GeoGrid, or NULL if no grid of up to GRID_MAX_NODES
+ *      nodes is accurate enough.
+ *
+ * DESCRIPTION:
+ *	Builds a control grid over the area, starting with 4 by 4 cells
+ *      and halving them until the interpolation error at the center of
+ *      every cell is at most GRID_TOLERANCE pixels.  Latitude and 
+ *      longitude errors are scaled to pixels by the local pixel size.
+ */
+
+static GeoGrid*
+newGeoGrid(GeoModel* model, int toPixel, 
+           double x0, double y0, double x1, double y1)
+{
+    GeoGrid* grid = (GeoGrid*)Tcl_Alloc(sizeof(GeoGrid));
+    int      cells;
+    int      i;
+    int      j;
+
+    grid->x0 = x0;
+    grid->y0 = y0;
+
+    for (cells = 4; (cells + 1)*(cells + 1) <= GRID_MAX_NODES; cells *= 2)
+    {
+        double err = 0.0;
+
+        /* FIRST, convert at the nodes. */
+        grid->cols  = cells + 1;
+        grid->rows  = cells + 1;
+        grid->dx    = (x1 - x0)/cells;
+        grid->dy    = (y1 - y0)/cells;
+        grid->nodes = (double*)Tcl_Alloc(2*sizeof(double)*
+                                         grid->cols*grid->rows);
+
+        for (j = 0; j < grid->rows; j++)
+        {
+            for (i = 0; i < grid->cols; i++)
+            {
+                double  u = x0 + i*grid->dx;
+                double  v = y0 + j*grid->dy;
+                double* n = grid->nodes + 2*(j*grid->cols + i);
+                int     ok = toPixel 
+                    ? latLongToPixel(model, v, u, &n[0], &n[1])
+                    : pixelToLatLong(model, u, v, &n[0], &n[1]);
+
+                if (!ok)
+                {
+                    n[0] = n[1] = NAN;
+                }
+            }
+        }
+
+        /* NEXT, measure the error at the center of each cell. */
+        for (j = 0; j < cells && err <= GRID_TOLERANCE; j++)
+        {
+            for (i = 0; i < cells; i++)
+            {
+                double u = x0 + (i + 0.5)*grid->dx;
+                double v = y0 + (j + 0.5)*grid->dy;
+                double est[2];
+                double a;
+                double b;
+
+                if (!gridPoint(grid, u, v, est) ||
+                    !(toPixel ? latLongToPixel(model, v, u, &a, &b)
+                              : pixelToLatLong(model, u, v, &a, &b)))
+                {
+                    continue;
+                }
+
+                if (toPixel)
+                {
+                    err = dmax(err, dmax(fabs(est[0] - a), 
+                                         fabs(est[1] - b)));
+                }
+                else
+                {
+                    err = dmax(err, METERS_PER_DEGREE*dmax(
+                        fabs(est[0] - a)/fabs(model->sy),
+                        fabs(est[1] - b)*cos(a*radians)/fabs(model->sx)));
+                }
+            }
+        }
+
+        if (err <= GRID_TOLERANCE)
+        {
+            return grid;
+        }
+
+        Tcl_Free((char*)grid->nodes);
+    }
+
+    Tcl_Free((char*)grid);
+
+    return NULL;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	freeGeoGrid()
+ *
+ * INPUTS:
+ *	grid		A GeoGrid, or NULL
+ *
+ * RETURNS:
+ *	nothing
+ *
+ * DESCRIPTION:
+ *	Frees the grid.
+ */
+
+static void
+freeGeoGrid(GeoGrid* grid)
+{
+    if (grid != NULL)
+    {
+        Tcl_Free((char*)grid->nodes);
+        Tcl_Free((char*)grid);
+    }
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	buildGeoGrids()
+ *
+ * INPUTS:
+ *	img		A projected GeotiffImage
+ *
+ * RETURNS:
+ *	nothing
+ *
+ * DESCRIPTION:
+ *	Builds the image's control grids: pixels to lat/long over the
+ *      image, and lat/long to pixels over the image's bounding box in
+ *      lat/long, found by converting points along its edges.
+ */
+
+static void
+buildGeoGrids(GeotiffImage* img)
+{
+    GeoModel* model = &img->model;
+    double    w     = img->levels[0].width;
+    double    h     = img->levels[0].height;
+    Bbox      box;
+    int       found = 0;
+    int       i;
+
+    img->toLatLong = newGeoGrid(model, 0, 0.0, 0.0, w, h);
+
+    for (i = 0; i <= 4*GRID_EDGE_POINTS; i++)
+    {
+        double t    = (double)(i % GRID_EDGE_POINTS)/GRID_EDGE_POINTS;
+        int    edge = i / GRID_EDGE_POINTS;
+        double x    = edge == 0 ? t*w : edge == 1 ? w : 
+                      edge == 2 ? (1.0 - t)*w : 0.0;
+        double y    = edge == 0 ? 0.0 : edge == 1 ? t*h :
+                      edge == 2 ? h : (1.0 - t)*h;
+        double lat;
+        double lon;
+
+        if (!pixelToLatLong(model, x, y, &lat, &lon))
+        {
+            continue;
+        }
+
+        if (!found)
+        {
+            box.xmin = box.xmax = lon;
+            box.ymin = box.ymax = lat;
+            found = 1;
+        }
+
+        box.xmin = dmin(box.xmin, lon);
+        box.xmax = dmax(box.xmax, lon);
+        box.ymin = dmin(box.ymin, lat);
+        box.ymax = dmax(box.ymax, lat);
+    }
+
+    if (found && box.xmin < box.xmax && box.ymin < box.ymax)
+    {
+        img->toPixel = newGeoGrid(model, 1, box.xmin, box.ymin, 
+                                  box.xmax, box.ymax);
+    }
+
+    img->gridsBuilt = 1;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	geotiffConvert()
+ *
+ * INPUTS:
+ *	info		The GeotiffInfo
+ *	interp		The Tcl interpreter
+ *	objc, objv	The geotiff tolatlong or topixel arguments
+ *	toPixel		1 for topixel, 0 for tolatlong
+ *
+ * RETURNS:
+ *	TCL_OK on success and TCL_ERROR on failure, setting the error
+ *      string in the latter case.
+ *
+ * DESCRIPTION:
+ *	Implements geotiff tolatlong and topixel.  A geographic image's
+ *      conversions are affine, and so are done exactly.  A projected
+ *      image's are interpolated from its control grids, which are
+ *      built the first time either is used and are accurate to
+ *      GRID_TOLERANCE pixels; points the grids don't cover, and all
+ *      points with -exact, are projected exactly.
+ */
+
+static int
+geotiffConvert(GeotiffInfo* info, Tcl_Interp* interp, 
+               int objc, Tcl_Obj* CONST objv[], int toPixel)
+{
+    GeotiffImage* img;
+    GeoModel*     model;
+    GeoGrid*      grid = NULL;
+    Tcl_Obj*      result;
+    int           exact = 0;
+    int           a = 2;
+    int           i;
+
+    if (objc > 2 && isFlag(objv[2], "-exact")) {
+        exact = 1;
+        a = 3;
+    }
+
+    if (objc < a + 3 || (objc - a - 1) % 2 != 0) {
+        Tcl_WrongNumArgs(interp, 2, objv, toPixel 
+                         ? "?-exact? handle lat lon ?lat lon...?"
+                         : "?-exact? handle x y ?x y...?");
+        return TCL_ERROR;
+    }
+
+    /* FIRST, get the image and its control grid. */
+    if (getGeotiff(interp, info, objv[a], &img) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
+
+    model = &img->model;
+
+    if (model->sx == 0.0 || model->sy == 0.0)
+    {
+        Tcl_SetResult(interp, "image has no tiepoint and pixel scale",
+                      TCL_STATIC);
+        return TCL_ERROR;
+    }
+
+    if (model->projected && !exact)
+    {
+        if (!img->gridsBuilt)
+        {
+            buildGeoGrids(img);
+        }
+
+        grid = toPixel ? img->toPixel : img->toLatLong;
+    }
+
+    /* NEXT, convert the points. */
+    result = Tcl_NewListObj(0, NULL);
+
+    for (i = a + 1; i < objc; i += 2)
+    {
+        double in[2];
+        double out[2];
+        int    ok;
+
+        if (Tcl_GetDoubleFromObj(interp, objv[i],     &in[0]) != TCL_OK ||
+            Tcl_GetDoubleFromObj(interp, objv[i + 1], &in[1]) != TCL_OK)
+        {
+            Tcl_DecrRefCount(result);
+            return TCL_ERROR;
+        }
+
+        if (toPixel)
+        {
+            /* The grid's inputs are lon,lat, unwrapped about the 
+             * central meridian. */
+            double lon = in[1] - model->lon0;
+
+            lon = model->lon0 + lon - 360.0*floor((lon + 180.0)/360.0);
+
+            ok = (grid != NULL && gridPoint(grid, lon, in[0], out)) ||
+                latLongToPixel(model, in[0], in[1], &out[0], &out[1]);
+        }
+        else
+        {
+            ok = (grid != NULL && gridPoint(grid, in[0], in[1], out)) ||
+                pixelToLatLong(model, in[0], in[1], &out[0], &out[1]);
+
+            if (model->projected)
+            {
+                out[1] -= 360.0*floor((out[1] + 180.0)/360.0);
+            }
+        }
+
+        if (!ok)
+        {
+            Tcl_DecrRefCount(result);
+            Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+                "%s outside the projection: \"%s %s\"",
+                toPixel ? "location" : "pixel",
+                Tcl_GetString(objv[i]), Tcl_GetString(objv[i + 1])));
+            return TCL_ERROR;
+        }
+
+        Tcl_ListObjAppendElement(interp, result, Tcl_NewDoubleObj(out[0]));
+        Tcl_ListObjAppendElement(interp, result, Tcl_NewDoubleObj(out[1]));
+    }
+
+    Tcl_SetObjResult(interp, result);
+
+    return TCL_OK;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	setEllipsoidData
+ *
+ * INPUTS:
+ *	info           Reference to LatLongInfo
+ *
+ * OUTPUTS:
+ *	info->ellipsoid, info->geodesic, info->mgrs, info->mgrsStatus
+ *
+ * RETURNS:
+ *	nothing
+ *
+ * DESCRIPTION:
+ *	Compute essetial datum values from the current reference spheriod.
+ *      This data is used for conversion to/from GCC values.
+ *
+ *      Also prepares the MGRS context for the spheroid, so that the
+ *      MGRS conversions needn't recompute the projection series on
+ *      each call.
+ */
+
+static void setEllipsoidData(LatlongInfo* info) 
+{
+    Ellipsoid* e = &ellipsoidTable[info->spheroid];
+
+    geoGetEllipsoid(&info->ellipsoid.a, &info->ellipsoid.b, 
+                    &info->ellipsoid.e2, &info->ellipsoid.ee2, 
+                    &info->ellipsoid.flat, e->geo_stars_datum);
+
+    setGeodesicData(&info->geodesic, e->semi_major_axis, e->inv_flattening);
+
+    info->mgrsStatus = Set_MGRS_Parameters_r(&info->mgrs,
+                                             e->semi_major_axis,
+                                             1.0 / e->inv_flattening,
+                                             e->code);
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	deleteLatlongInfo()
+ *
+ * INPUTS:
+ *	none
+ *
+ * OUTPUTS:
+ *	none
+ *
+ * RETURNS:
+ *	A pointer to a LatlongInfo struct allocated with newLatlongInfo().
+ *
+ * DESCRIPTION:
+ *	Frees the LatlongInfo* data.
+ */
+
+static void
+deleteLatlongInfo(LatlongInfo* p)
+{
+    freeScratch(&p->scratch);
+
+    Tcl_Free((void*)p);
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	deleteGeotiffInfo()
+ *
+ * INPUTS:
+ *	A pointer to a GeotiffInfo struct
+ *
+ * OUTPUTS:
+ *	none
+ *
+ * RETURNS:
+ *  nothing
+ *
+ * DESCRIPTION:
+ *	Closes any open geotiff handles, and frees the GeotiffInfo* data.
+ */
+
+static void
+deleteGeotiffInfo(GeotiffInfo* g)
+{
+    Tcl_HashEntry* entry;
+    Tcl_HashSearch search;
+
+    for (entry = Tcl_FirstHashEntry(&g->images, &search);
+         entry != NULL;
+         entry = Tcl_NextHashEntry(&search))
+    {
+        closeGeotiff((GeotiffImage*)Tcl_GetHashValue(entry));
+    }
+
+    Tcl_DeleteHashTable(&g->images);
+    Tcl_Free((void*)g);
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	scratchAlloc()
+ *
+ * INPUTS:
+ *	scratch		The Scratch arena
+ *	nbytes		The number of bytes wanted
+ *
+ * OUTPUTS:
+ *	none
+ *
+ * RETURNS:
+ *	A SCRATCH_ALIGN-aligned buffer of at least nbytes bytes, valid
+ *      until the next resetScratch().
+ *
+ * DESCRIPTION:
+ *	Hands out the next piece of the arena's block.  If the block is
+ *      full, the buffer is allocated separately and freed on reset, 
+ *      and the block is grown on reset to hold everything handed out 
+ *      since the last one.
+ */
+
+static void*
+scratchAlloc(Scratch* scratch, size_t nbytes)
+{
+    char* raw;
+
+    nbytes = (nbytes + SCRATCH_ALIGN - 1) & ~(size_t)(SCRATCH_ALIGN - 1);
+    scratch->wanted += nbytes;
+
+    /* FIRST, use the block if there's room. */
+    if (scratch->used + nbytes <= scratch->size)
+    {
+        void* buf = scratch->base + scratch->used;
+        scratch->used += nbytes;
+
+        return buf;
+    }
+
+    /* NEXT, allocate an overflow buffer. */
+    if (scratch->nextra == scratch->maxExtra)
+    {
+        scratch->maxExtra = 2*scratch->maxExtra + 4;
+        scratch->extra = (char**)Tcl_Realloc((char*)scratch->extra,
+                                      scratch->maxExtra * sizeof(char*));
+    }
+
+    raw = Tcl_Alloc(nbytes + SCRATCH_ALIGN);
+    scratch->extra[scratch->nextra++] = raw;
+
+    return (void*)(((size_t)raw + SCRATCH_ALIGN - 1) & 
+                   ~(size_t)(SCRATCH_ALIGN - 1));
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	resetScratch()
+ *
+ * INPUTS:
+ *	scratch		The Scratch arena
+ *
+ * OUTPUTS:
+ *	none
+ *
+ * RETURNS:
+ *	nothing
+ *
+ * DESCRIPTION:
+ *	Releases everything handed out by scratchAlloc() since the
+ *      last reset.  If the block overflowed, it's replaced
+ *      with one big enough to hold it all.
+ */
+
+static void
+resetScratch(Scratch* scratch)
+{
+    int i;
+
+    for (i = 0; i < scratch->nextra; i++)
+    {
+        Tcl_Free(scratch->extra[i]);
+    }
+
+    scratch->nextra = 0;
+
+    if (scratch->wanted > scratch->size)
+    {
+        if (scratch->raw != NULL)
+        {
+            Tcl_Free(scratch->raw);
+        }
+
+        scratch->raw  = Tcl_Alloc(scratch->wanted + SCRATCH_ALIGN);
+        scratch->base = (char*)(((size_t)scratch->raw + SCRATCH_ALIGN - 1) &
+                                ~(size_t)(SCRATCH_ALIGN - 1));
+        scratch->size = scratch->wanted;
+    }
+
+    scratch->used   = 0;
+    scratch->wanted = 0;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	freeScratch()
+ *
+ * INPUTS:
+ *	scratch		The Scratch arena
+ *
+ * OUTPUTS:
+ *	none
+ *
+ * RETURNS:
+ *	nothing
+ *
+ * DESCRIPTION:
+ *	Frees all of the arena's memory; the Scratch struct itself
+ *      belongs to the caller.
+ */
+
+static void
+freeScratch(Scratch* scratch)
+{
+    resetScratch(scratch);
+
+    if (scratch->raw != NULL)
+    {
+        Tcl_Free(scratch->raw);
+    }
+
+    if (scratch->extra != NULL)
+    {
+        Tcl_Free((char*)scratch->extra);
+    }
+
+    memset(scratch, 0, sizeof(Scratch));
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	getBbox()
+ *
+ * INPUTS:
+ *	interp		The Tcl interpreter
+ *      coords		The coordinates: xmin ymin xmax ymax
+ *
+ * OUTPUTS:
+ *	box		A pointer to the Bbox struct.
+ *
+ * RETURNS:
+ *	TCL_OK on success and TCL_ERROR on failure, setting the error
+ *      string in the latter case.
+ *
+ * DESCRIPTION:
+ *	Converts a flat list of coordinates into a bounding box.
+ */
+
+static int
+getBbox(Tcl_Interp* interp, Tcl_Obj* coords, Bbox* box)
+{
+    int listc;
+    Tcl_Obj** listv;
+    
+    if (Tcl_ListObjGetElements(interp, coords, &listc, &listv) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
+
+    if (listc != 4)
+    {
+        Tcl_Obj* result = Tcl_GetObjResult(interp);
+
+        Tcl_AppendStringsToObj(
+            result, 
+            "invalid bounding box, expected 4 coordinates, got: \"", NULL);
+        Tcl_AppendObjToObj(result, Tcl_NewIntObj(listc));
+        Tcl_AppendStringsToObj(
+            result, 
+            "\"", NULL);
+        
+        return TCL_ERROR;
+    }
+
+    if (Tcl_GetDoubleFromObj(interp, listv[0], &box->xmin) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
+
+    if (Tcl_GetDoubleFromObj(interp, listv[1], &box->ymin) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
+
+    if (Tcl_GetDoubleFromObj(interp, listv[2], &box->xmax) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
+
+    if (Tcl_GetDoubleFromObj(interp, listv[3], &box->ymax) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
+
+    return TCL_OK;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	getPoint()
+ *
+ * INPUTS:
+ *	interp		The Tcl interpreter
+ *      coords		The coordinates: a 2-element Tcl list
+ *
+ * OUTPUTS:
+ *	point		A pointer to the Point struct.
+ *
+ * RETURNS:
+ *	TCL_OK on success and TCL_ERROR on failure, setting the error
+ *      string in the latter case.
+ *
+ * DESCRIPTION:
+ *	Converts a coordinate pair into a Point.
+ */
+
+static int
+getPoint(Tcl_Interp* interp, Tcl_Obj* coords, Point* point)
+{
+    int listc;
+    Tcl_Obj** listv;
+    
+    if (Tcl_ListObjGetElements(interp, coords, &listc, &listv) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
+
+    if (listc != 2)
+    {
+        Tcl_SetResult(interp, "not a coordinate pair",
+                      TCL_STATIC);
+        return TCL_ERROR;
+    }
+
+    if (Tcl_GetDoubleFromObj(interp, listv[0], &point->x) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
+
+    if (Tcl_GetDoubleFromObj(interp, listv[1], &point->y) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
+
+    return TCL_OK;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	getPoints()
+ *
+ * INPUTS:
+ *	interp		The Tcl interpreter
+ *      scratch		The command's Scratch arena
+ *      coords		The coordinates: an N-element Tcl list
+ *      minSize         Minimum number of points
+ *
+ * OUTPUTS:
+ *	points		A pointer to the Points.
+ *
+ * RETURNS:
+ *	TCL_OK on success and TCL_ERROR on failure, setting the error
+ *      string in the latter case.
+ *
+ * DESCRIPTION:
+ *	Converts a flat list of coordinates into a set of Points, 
+ *      allocated in the scratch arena and so valid until its next 
+ *      reset.
+ *
+ *      coords keeps its list rep, so it can be used with list commands
+ *      and geometry commands alternately without being reparsed; and
+ *      its elements keep their double reps, so parsing a list that's 
+ *      used repeatedly is just a copy.
+ */
+
+static int
+getPoints(Tcl_Interp* interp, Scratch* scratch, Tcl_Obj* coords, 
+          int minSize, Points** points)
+{
+    int       listc;
+    Tcl_Obj** listv;
+    Points*   pp;
+    int       i;
+    
+    if (Tcl_ListObjGetElements(interp, coords, &listc, &listv) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
+
+    if (listc % 2 != 0)
+    {
+        Tcl_Obj* result = Tcl_GetObjResult(interp);
+
+        Tcl_AppendStringsToObj(result, 
+                               "expected even number of coordinates, got ", 
+                               NULL);
+        Tcl_AppendObjToObj(result, Tcl_NewIntObj(listc));
+        Tcl_AppendStringsToObj(result, ": \"", NULL);
+        Tcl_AppendObjToObj(result, coords);
+        Tcl_AppendStringsToObj(result, "\"", NULL);
+
+        return TCL_ERROR;
+    }
+
+    if (listc < 2*minSize)
+    {
+        Tcl_Obj* result = Tcl_GetObjResult(interp);
+
+        Tcl_AppendStringsToObj(result, "expected at least ", NULL);
+        Tcl_AppendObjToObj(result, Tcl_NewIntObj(minSize));
+        Tcl_AppendStringsToObj(result, " point(s), got ", NULL);
+        Tcl_AppendObjToObj(result, Tcl_NewIntObj(listc/2));
+        Tcl_AppendStringsToObj(result, ": \"", NULL);
+        Tcl_AppendObjToObj(result, coords);
+        Tcl_AppendStringsToObj(result, "\"", NULL);
+
+        return TCL_ERROR;
+    }
+
+    /* NEXT, parse the coordinates into the arena. */
+    pp          = (Points*)scratchAlloc(scratch, sizeof(Points));
+    pp->size    = listc/2;
+    pp->maxSize = listc/2;
+    pp->pts     = (Point*)scratchAlloc(scratch, pp->size * sizeof(Point));
+
+    for (i = 0; i < pp->size; i++) {
+        if (Tcl_GetDoubleFromObj(interp, listv[2*i], 
+                                 &pp->pts[i].x) != TCL_OK ||
+            Tcl_GetDoubleFromObj(interp, listv[2*i + 1], 
+                                 &pp->pts[i].y) != TCL_OK)
+        {
+            return TCL_ERROR;
+        }
+    }
+
+    *points = pp;
+
+    return TCL_OK;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	getPolygon()
+ *
+ * INPUTS:
+ *	interp		The Tcl interpreter, or NULL
+ *      info		The interp's PolygonInfo
+ *      handle		A polygon handle
+ *
+ * OUTPUTS:
+ *	poly		The compiled Polygon
+ *
+ * RETURNS:
+ *	TCL_OK on success and TCL_ERROR on failure, setting the error
+ *      string in the latter case if interp is not NULL.
+ *
+ * DESCRIPTION:
+ *	Looks up a polygon handle, caching the result in the handle's
+ *      internal rep.
+ */
+
+static int
+getPolygon(Tcl_Interp* interp, PolygonInfo* info, Tcl_Obj* handle,
+           Polygon** poly)
+{
+    Tcl_HashEntry* entry;
+    Polygon*       p;
+
+    /* FIRST, use the cached Polygon if it's still valid. */
+    if (handle->typePtr == &polygonObjType &&
+        handle->internalRep.twoPtrValue.ptr2 == (void*)info)
+    {
+        p = (Polygon*)handle->internalRep.twoPtrValue.ptr1;
+
+        if (!p->deleted)
+        {
+            *poly = p;
+            return TCL_OK;
+        }
+    }
+
+    /* NEXT, look it up. */
+    entry = Tcl_FindHashEntry(&info->polygons, Tcl_GetString(handle));
+
+    if (entry == NULL)
+    {
+        if (interp != NULL)
+        {
+            Tcl_Obj* result = Tcl_GetObjResult(interp);
+
+            Tcl_AppendStringsToObj(result, "unknown polygon: \"", 
+                                   Tcl_GetString(handle), "\"", NULL);
+        }
+
+        return TCL_ERROR;
+    }
+
+    p = (Polygon*)Tcl_GetHashValue(entry);
+
+    /* NEXT, cache it.  The string rep was generated above, so it's
+     * safe to discard the old internal rep. */
+    if (handle->typePtr != NULL && handle->typePtr->freeIntRepProc != NULL)
+    {
+        handle->typePtr->freeIntRepProc(handle);
+    }
+
+    p->refCount++;
+    handle->internalRep.twoPtrValue.ptr1 = p;
+    handle->internalRep.twoPtrValue.ptr2 = info;
+    handle->typePtr = &polygonObjType;
+
+    *poly = p;
+
+    return TCL_OK;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	getGeoIndex()
+ *
+ * INPUTS:
+ *	interp		The Tcl interpreter
+ *      info		The interp's PolygonInfo
+ *      handle		A geoindex handle
+ *
+ * OUTPUTS:
+ *	gi		The GeoIndex
+ *
+ * RETURNS:
+ *	TCL_OK on success and TCL_ERROR on failure, setting the error
+ *      string in the latter case.
+ */
+
+static int
+getGeoIndex(Tcl_Interp* interp, PolygonInfo* info, Tcl_Obj* handle,
+            GeoIndex** gi)
+{
+    Tcl_HashEntry* entry = 
+        Tcl_FindHashEntry(&info->indices, Tcl_GetString(handle));
+
+    if (entry == NULL)
+    {
+        Tcl_AppendStringsToObj(Tcl_GetObjResult(interp), 
+                               "unknown geoindex: \"", 
+                               Tcl_GetString(handle), "\"", NULL);
+        return TCL_ERROR;
+    }
+
+    *gi = (GeoIndex*)Tcl_GetHashValue(entry);
+
+    return TCL_OK;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	getLatLong()
+ *
+ * INPUTS:
+ *	interp		The Tcl interpreter
+ *      loc		The location: a 2-element Tcl list
+ *
+ * OUTPUTS:
+ *	lat		The latitude
+ *      lon		The longitude
+ *
+ * RETURNS:
+ *	TCL_OK on success and TCL_ERROR on failure, setting the error
+ *      string in the latter case.
+ *
+ * DESCRIPTION:
+ *	Converts a lat/long pair into doubles--or, really, any 
+ *      double-valued coordinate pair.
+ */
+
+static int
+getLatLong(Tcl_Interp* interp, Tcl_Obj* loc, double* lat, double* lon)
+{
+    int locc;
+    Tcl_Obj** locv;
+    
+    if (Tcl_ListObjGetElements(interp, loc, &locc, &locv) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
+
+    if (locc != 2)
+    {
+        Tcl_Obj* result = Tcl_GetObjResult(interp);
+
+        Tcl_AppendStringsToObj(
+            result, 
+            "expected lat/long pair, got: \"", NULL);
+        Tcl_AppendObjToObj(result, loc);
+        Tcl_AppendStringsToObj(
+            result, 
+            "\"", NULL);
+
+        return TCL_ERROR;
+    }
+
+    if (Tcl_GetDoubleFromObj(interp, locv[0], lat) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
+
+    if (Tcl_GetDoubleFromObj(interp, locv[1], lon) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
+
+    return TCL_OK;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	getGcc()
+ *
+ * INPUTS:
+ *	interp		The Tcl interpreter
+ *      loc		The location: a 3-element Tcl list
+ *
+ * OUTPUTS:
+ *	x         Geo-celestiocentric x-axis value
+ *      y         Geo-celestiocentric y-axis value
+ *      z	  Geo-celestiocentric z-axis value
+ *
+ * RETURNS:
+ *	TCL_OK on success and TCL_ERROR on failure, setting the error
+ *      string in the latter case.
+ *
+ * DESCRIPTION:
+ *	Converts a GCC triple into doubles--or, really, any 
+ *      doubled-valued coordinate tripple.
+ */
+
+static int
+getGcc(Tcl_Interp* interp, Tcl_Obj* loc, double* x, double* y, double* z)
+{
+    int locc;
+    Tcl_Obj** locv;
+    
+    if (Tcl_ListObjGetElements(interp, loc, &locc, &locv) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
+
+    if (locc != 3)
+    {
+        Tcl_Obj* result = Tcl_GetObjResult(interp);
+
+        Tcl_AppendStringsToObj(
+            result, 
+            "expected X Y Z triple, got: \"", NULL);
+        Tcl_AppendObjToObj(result, loc);
+        Tcl_AppendStringsToObj(
+            result, 
+            "\"", NULL);
+
+        return TCL_ERROR;
+    }
+
+    if (Tcl_GetDoubleFromObj(interp, locv[0], x) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
+
+    if (Tcl_GetDoubleFromObj(interp, locv[1], y) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
+
+    if (Tcl_GetDoubleFromObj(interp, locv[2], z) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
+
+    return TCL_OK;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	getLocArrays()
+ *
+ * INPUTS:
+ *	interp		The Tcl interpreter
+ *	info		The LatlongInfo
+ *	locs		A flat list of lat/long coordinates in decimal
+ *                      degrees, lat1 lon1 lat2 lon2 ...
+ *
+ * OUTPUTS:
+ *	n		The number of locations
+ *
+ * RETURNS:
+ *	A block of 3*n doubles from info's Scratch arena: the
+ *      n latitudes in radians, the n longitudes in radians, and the
+ *      n cosines of the latitudes.  On error, an error message is
+ *      left in the interpreter result and NULL is returned.
+ *
+ * DESCRIPTION:
+ *	Puts a list of locations into the struct-of-arrays form used
+ *      by spheredistRow().  The list is parsed by getPoints(), so 
+ *      the error messages are the same.
+ */
+
+static double*
+getLocArrays(Tcl_Interp* interp, LatlongInfo* info, Tcl_Obj* locs, int* n)
+{
+    Points* points;
+    int     i;
+
+    if (getPoints(interp, &info->scratch, locs, 0, &points) != TCL_OK)
+    {
+        return NULL;
+    }
+
+    *n = points->size;
+
+    double* lat    = (double*)scratchAlloc(&info->scratch, 
+                                           3*points->size * sizeof(double));
+    double* lon    = lat + points->size;
+    double* cosLat = lon + points->size;
+
+    for (i = 0; i < points->size; i++)
+    {
+        lat[i]    = points->pts[i].x * radians;
+        lon[i]    = points->pts[i].y * radians;
+        cosLat[i] = cos(lat[i]);
+    }
+
+    return lat;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	setDoublesResult()
+ *
+ * INPUTS:
+ *	interp		The Tcl interpreter
+ *	scratch		A Scratch arena for the temporary objv
+ *	values		An array of doubles
+ *	n		The number of values
+ *	asBytes		1 for a byte array, 0 for a list
+ *
+ * RETURNS:
+ *	nothing
+ *
+ * DESCRIPTION:
+ *	Sets the interpreter result to the values, either as a list
+ *      of doubles, or as a byte array of native doubles that can be
+ *      unpacked with "binary scan $bytes d* values" and that involves
+ *      no per-value Tcl objects.
+ */
+
+static void
+setDoublesResult(Tcl_Interp* interp, Scratch* scratch, double* values, 
+                 int n, int asBytes)
+{
+    int i;
+
+    if (asBytes)
+    {
+        Tcl_SetObjResult(interp, 
+            Tcl_NewByteArrayObj((unsigned char*)values, n*sizeof(double)));
+        return;
+    }
+
+    Tcl_Obj** objv = (Tcl_Obj**)scratchAlloc(scratch, n * sizeof(Tcl_Obj*));
+
+    for (i = 0; i < n; i++)
+    {
+        objv[i] = Tcl_NewDoubleObj(values[i]);
+    }
+
+    Tcl_SetObjResult(interp, Tcl_NewListObj(n, objv));
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	isFlag()
+ *
+ * INPUTS:
+ *	objPtr		An argument
+ *	flag		A flag name, e.g., "-bytes"
+ *
+ * RETURNS:
+ *	1 if the argument is the flag, and 0 otherwise.
+ *
+ * DESCRIPTION:
+ *	Checks for an optional flag.  An argument that's a list of
+ *      other than one element can't be a flag, so this doesn't 
+ *      generate the string rep of a long list of locations just
+ *      to compare it.
+ */
+
+static int
+isFlag(Tcl_Obj* objPtr, char* flag)
+{
+    int len;
+
+    return Tcl_ListObjLength(NULL, objPtr, &len) == TCL_OK && len == 1 &&
+        strcmp(Tcl_GetString(objPtr), flag) == 0;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	measurePolygon()
+ *
+ * INPUTS:
+ *	interp		The Tcl interpreter
+ *	info		The LatlongInfo
+ *	polyObj		A lat/long coordinate list or a polygon(n) handle
+ *	measure		MEASURE_AREA, MEASURE_EAREA, or MEASURE_PERIMETER
+ *
+ * OUTPUTS:
+ *	value		The polygon's area in km^2 or perimeter in km
+ *
+ * RETURNS:
+ *	TCL_OK on success and TCL_ERROR on failure, setting the error
+ *      string in the latter case.
+ *
+ * DESCRIPTION:
+ *	Measures a lat/long polygon, which must have at least three
+ *      valid points.  A polygon handle's measures are cached in the
+ *      Polygon; the ellipsoidal measures are recomputed if the 
+ *      spheroid has changed.  As for ptinpoly, a coordinate list 
+ *      always has at least two elements, so a one-element value is a 
+ *      handle, and it's an error if it's unknown.
+ */
+
+static int
+measurePolygon(Tcl_Interp* interp, LatlongInfo* info, Tcl_Obj* polyObj,
+               int measure, double* value)
+{
+    PolygonInfo* pinfo;
+    Polygon*     poly = NULL;
+    Points       view;
+    Points*      points;
+    double*      cached = NULL;
+    int          len;
+    int          i;
+
+    /* FIRST, see if it's a polygon handle, as for ptinpoly. */
+    if (polyObj->typePtr == &polygonObjType ||
+        (Tcl_ListObjLength(NULL, polyObj, &len) == TCL_OK && len == 1))
+    {
+        pinfo = (PolygonInfo*)Tcl_GetAssocData(interp, "marsutil_polygon", 
+                                               NULL);
+
+        if (getPolygon(interp, pinfo, polyObj, &poly) != TCL_OK)
+        {
+            return TCL_ERROR;
+        }
+    }
+
+    /* NEXT, if it is, use the cached value if we have it. */
+    if (poly != NULL)
+    {
+        switch (measure)
+        {
+        case MEASURE_AREA:      cached = &poly->area;      break;
+        case MEASURE_EAREA:     cached = &poly->earea;     break;
+        case MEASURE_PERIMETER: cached = &poly->perimeter; break;
+        }
+
+        if (measure != MEASURE_AREA && poly->spheroid != info->spheroid)
+        {
+            poly->measured &= MEASURE_AREA;
+            poly->spheroid  = info->spheroid;
+        }
+
+        if (poly->measured & measure)
+        {
+            *value = *cached;
+            return TCL_OK;
+        }
+
+        view.maxSize = poly->size;
+        view.size    = poly->size;
+        view.pts     = poly->pts;
+        points       = &view;
+    }
+    else if (getPoints(interp, &info->scratch, polyObj, 3, &points) 
+             != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
+
+    /* NEXT, ensure that all pairs are valid */
+    for (i = 0; i < points->size; i++) {
+        if (validateLatLong(interp, 
+                            points->pts[i].x,
+                            points->pts[i].y) != TCL_OK)
+        {
+            return TCL_ERROR;
+        }
+    }
+
+    /* NEXT, measure it. */
+    switch (measure)
+    {
+    case MEASURE_AREA:  
+        *value = ll_area(points);
+        break;
+
+    case MEASURE_EAREA:
+        *value = ll_earea(&info->geodesic, points);
+        break;
+
+    default:
+        *value = ll_perimeter(&info->geodesic, points);
+        break;
+    }
+
+    if (poly != NULL)
+    {
+        *cached         = *value;
+        poly->measured |= measure;
+    }
+
+    return TCL_OK;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	validateLatLong()
+ *
+ * INPUTS:
+ *	interp		The Tcl interpreter
+ *	lat		The latitude
+ *      lon		The longitude
+ *
+ * RETURNS:
+ *	TCL_OK on success and TCL_ERROR on failure, setting the error
+ *      string in the latter case.
+ *
+ * DESCRIPTION:
+ *	Validates the lat and lon values.
+ */
+
+static int
+validateLatLong(Tcl_Interp* interp, double lat, double lon)
+{
+    if (lat < LAT_MIN || lat > LAT_MAX)
+    {
+        Tcl_Obj* result = Tcl_GetObjResult(interp);
+
+        Tcl_AppendStringsToObj(result, 
+            "invalid latitude, should be ", NULL);
+        Tcl_AppendObjToObj(result, Tcl_NewDoubleObj(LAT_MIN));
+        Tcl_AppendStringsToObj(result, 
+            " to ", NULL);
+        Tcl_AppendObjToObj(result, Tcl_NewDoubleObj(LAT_MAX));
+        Tcl_AppendStringsToObj(result, 
+            " degrees: \"", NULL);
+        Tcl_AppendObjToObj(result, Tcl_NewDoubleObj(lat));
+        Tcl_AppendStringsToObj(result, 
+            "\"", NULL);
+
+        return TCL_ERROR;
+    }
+
+    if (lon < LON_MIN || lon > LON_MAX)
+    {
+        Tcl_Obj* result = Tcl_GetObjResult(interp);
+
+        Tcl_AppendStringsToObj(result, 
+            "invalid longitude, should be ", NULL);
+        Tcl_AppendObjToObj(result, Tcl_NewDoubleObj(LON_MIN));
+        Tcl_AppendStringsToObj(result, 
+            " to ", NULL);
+        Tcl_AppendObjToObj(result, Tcl_NewDoubleObj(LON_MAX));
+        Tcl_AppendStringsToObj(result, 
+            " degrees: \"", NULL);
+        Tcl_AppendObjToObj(result, Tcl_NewDoubleObj(lon));
+        Tcl_AppendStringsToObj(result, 
+            "\"", NULL);
 
-    /* File is not a TIFF */
-    if (info->tiff == NULL)
-    {
-        Tcl_SetResult(interp, "file is not a TIFF", TCL_STATIC);
         return TCL_ERROR;
     }
 
-    info->gtif = GTIFNew(info->tiff);
+    return TCL_OK;
+}
 
-    /* File does not contain any geokeys */
-    if (!info->gtif)
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	getPpm()
+ *
+ * INPUTS:
+ *	interp		The Tcl interpreter
+ *	obj		A binary (P6) PPM
+ *
+ * OUTPUTS:
+ *	raster		The image; its pixels point into obj's bytes.
+ *
+ * RETURNS:
+ *	TCL_OK on success and TCL_ERROR on failure, setting the error
+ *      string in the latter case.
+ *
+ * DESCRIPTION:
+ *	Parses a PPM header, allowing comments, as Tk's "image data 
+ *      -format ppm" writes it.  Only 8-bit samples are supported.
+ */
+
+static int
+getPpm(Tcl_Interp* interp, Tcl_Obj* obj, Raster* raster)
+{
+    int            length;
+    unsigned char* bytes = Tcl_GetByteArrayFromObj(obj, &length);
+    unsigned char* end   = bytes + length;
+    unsigned char* p     = bytes + 2;
+    long           fields[3];
+    int            i;
+
+    if (length < 2 || bytes[0] != 'P' || bytes[1] != '6')
     {
-        Tcl_SetResult(interp, "file does not contain geokeys", TCL_STATIC);
-        XTIFFClose(info->tiff);
-        info->tiff = NULL ;
+        Tcl_SetResult(interp, "not a binary PPM image", TCL_STATIC);
         return TCL_ERROR;
     }
 
-    /* Extract data */
+    /* FIRST, get the width, height, and maximum sample value. */
+    for (i = 0; i < 3; i++)
+    {
+        while (p < end && (isspace(*p) || *p == '#'))
+        {
+            if (*p == '#')
+            {
+                while (p < end && *p != '\n')
+                {
+                    p++;
+                }
+            }
+            else
+            {
+                p++;
+            }
+        }
+
+        fields[i] = 0;
 
-    /* Model Type */
-    key = (geokey_t)GT_MODEL_TYPE;
+        if (p == end || !isdigit(*p))
+        {
+            Tcl_SetResult(interp, "invalid PPM header", TCL_STATIC);
+            return TCL_ERROR;
+        }
+
+        while (p < end && isdigit(*p) && fields[i] < 1000000)
+        {
+            fields[i] = fields[i]*10 + (*p++ - '0');
+        }
+    }
 
-    if (!GTIFKeyGet(info->gtif, key, &code, 0, 1))
+    /* NEXT, a single whitespace character precedes the pixels. */
+    if (p == end || !isspace(*p) || fields[2] != 255 ||
+        fields[0] < 1 || fields[1] < 1 || fields[0] >= 1000000 ||
+        fields[1] >= 1000000)
     {
-        Tcl_SetResult(interp, "file is not a GeoTIFF", TCL_STATIC);
-        closeGeotiff(info);
+        Tcl_SetResult(interp, "invalid PPM header", TCL_STATIC);
         return TCL_ERROR;
     }
-        
-    switch (code) 
-    {
-        /* Unsupported Model Types */
-        case MODEL_TYPE_GEOCENTRIC:
-        case MODEL_TYPE_PROJECTED:
-            Tcl_SetResult(interp, 
-                          "usupported model type, must be geographic", 
-                          TCL_STATIC);
 
-            closeGeotiff(info);
+    p++;
 
-            return TCL_ERROR;
+    if ((end - p)/3/fields[0] < fields[1])
+    {
+        Tcl_SetResult(interp, "PPM image is truncated", TCL_STATIC);
+        return TCL_ERROR;
+    }
 
-         /* Look for right tags */
-         case MODEL_TYPE_GEOGRAPHIC:
-            /* Result returned as a dictionary */
-            result = Tcl_NewDictObj();
+    raster->width  = (int)fields[0];
+    raster->height = (int)fields[1];
+    raster->pixels = p;
 
-            /* Model type */
-            Tcl_Obj* modelkey = Tcl_NewStringObj("modeltype", 9);
-            Tcl_Obj* modelval = Tcl_NewStringObj("GEOGRAPHIC", 10);
-            Tcl_DictObjPut(interp, result, modelkey, modelval);
+    return TCL_OK;
+}
 
-            /* Tiepoints */
-            field = (ttag_t)MODEL_TIEPOINT_TAG;
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	newPpmObj()
+ *
+ * INPUTS:
+ *	interp		The Tcl interpreter
+ *	raster		An image
+ *
+ * RETURNS:
+ *	A new byte array containing the image as a binary PPM, or NULL,
+ *      setting the error string, if it's too large for a byte array.
+ */
 
-            if (TIFFGetField(info->tiff, field, &d_list_count, &d_list))
-            {
-                Tcl_Obj* tpkey  = Tcl_NewStringObj("tiepoints", 9);
-                Tcl_Obj* tplist = Tcl_NewObj();
-                
-                int i;
+static Tcl_Obj*
+newPpmObj(Tcl_Interp* interp, Raster* raster)
+{
+    char           header[40];
+    int            hlen;
+    size_t         size = 3*(size_t)raster->width*raster->height;
+    Tcl_Obj*       obj;
+    unsigned char* bytes;
 
-                for (i=0; i<d_list_count; i++)
-                {
-                    Tcl_ListObjAppendElement(interp, tplist,
-                                             Tcl_NewDoubleObj(d_list[i]));
-                }
+    hlen  = sprintf(header, "P6\n%d %d\n255\n", 
+                    raster->width, raster->height);
 
-                Tcl_DictObjPut(interp, result, tpkey, tplist);
+    if (size > (size_t)(INT_MAX - hlen))
+    {
+        Tcl_SetResult(interp, "image too large for a PPM", TCL_STATIC);
+        return NULL;
+    }
 
-            } 
-            else
-            {
-                Tcl_SetResult(interp, 
-                              "no tiepoints found in image", 
-                              TCL_STATIC);
+    obj   = Tcl_NewByteArrayObj(NULL, 0);
+    bytes = Tcl_SetByteArrayLength(obj, hlen + (int)size);
 
-                closeGeotiff(info);
+    memcpy(bytes, header, hlen);
+    memcpy(bytes + hlen, raster->pixels, size);
 
-                return TCL_ERROR;
-            }
+    return obj;
+}
 
-            /* Pixel scaling */
-            field = (ttag_t)MODEL_PIXEL_SCALE_TAG;
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	getZoomFactor()
+ *
+ * INPUTS:
+ *	interp		The Tcl interpreter
+ *	obj		A zoom factor, {up down}
+ *
+ * OUTPUTS:
+ *	up, down	The factor's terms, both positive
+ *
+ * RETURNS:
+ *	TCL_OK on success and TCL_ERROR on failure, setting the error
+ *      string in the latter case.
+ */
 
-            if (TIFFGetField(info->tiff, field, &d_list_count, &d_list))
-            {
-                Tcl_Obj* pskey  = Tcl_NewStringObj("pscale", 6);
-                Tcl_Obj* pslist = Tcl_NewObj();
-                
-                int i;
+static int
+getZoomFactor(Tcl_Interp* interp, Tcl_Obj* obj, int* up, int* down)
+{
+    int       n;
+    Tcl_Obj** terms;
 
-                for (i=0; i<d_list_count; i++)
-                {
-                    Tcl_ListObjAppendElement(interp, pslist,
-                                             Tcl_NewDoubleObj(d_list[i]));
-                }
+    if (Tcl_ListObjGetElements(interp, obj, &n, &terms) != TCL_OK)
+    {
+        return TCL_ERROR;
+    }
 
-                Tcl_DictObjPut(interp, result, pskey, pslist);
-                break;
+    if (n != 2 ||
+        Tcl_GetIntFromObj(NULL, terms[0], up) != TCL_OK ||
+        Tcl_GetIntFromObj(NULL, terms[1], down) != TCL_OK ||
+        *up < 1 || *down < 1)
+    {
+        Tcl_AppendStringsToObj(Tcl_GetObjResult(interp),
+                               "invalid zoom factor: \"",
+                               Tcl_GetString(obj), "\"", NULL);
+        return TCL_ERROR;
+    }
 
-            }
-            else
-            {
-                Tcl_SetResult(interp, 
-                              "no pixel scaling found in image", 
-                              TCL_STATIC);
+    return TCL_OK;
+}
 
-                closeGeotiff(info);
-                
-                return TCL_ERROR;
-            }
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	getScaledSize()
+ *
+ * INPUTS:
+ *	interp		The Tcl interpreter
+ *	src		The image to scale
+ *	up, down	The zoom factor, both positive
+ *
+ * OUTPUTS:
+ *	dst		The scaled image's width and height; its pixels
+ *                      are left alone.
+ *
+ * RETURNS:
+ *	TCL_OK on success and TCL_ERROR on failure, setting the error
+ *      string in the latter case.
+ *
+ * DESCRIPTION:
+ *	Computes the size of src scaled by up/down, at least 1x1, and
+ *      makes sure it has at most MAX_RASTER_PIXELS pixels, so that
+ *      its size in bytes fits in an int.
+ */
 
-         default:
-            Tcl_SetResult(interp, "unrecognized model type", TCL_STATIC);
-            closeGeotiff(info);
+static int
+getScaledSize(Tcl_Interp* interp, Raster* src, int up, int down, 
+              Raster* dst)
+{
+    Tcl_WideInt width  = (Tcl_WideInt)src->width*up/down;
+    Tcl_WideInt height = (Tcl_WideInt)src->height*up/down;
 
-            return TCL_ERROR;
-    }
+    width  = (width  < 1) ? 1 : width;
+    height = (height < 1) ? 1 : height;
 
+    if (width > MAX_RASTER_PIXELS || height > MAX_RASTER_PIXELS ||
+        width*height > MAX_RASTER_PIXELS)
+    {
+        Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+            "scaled image too large: %lld x %lld, at most %d pixels",
+            (long long)width, (long long)height, MAX_RASTER_PIXELS));
+        return TCL_ERROR;
+    }
 
-    /* Done */
-    closeGeotiff(info);
-    Tcl_SetObjResult(interp, result);
+    dst->width  = (int)width;
+    dst->height = (int)height;
 
     return TCL_OK;
 }
 
-/*
- * Math and Geometry Functions
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	scaleRaster()
+ *
+ * INPUTS:
+ *	src		The image to scale
+ *	dst		The scaled image; its size is set, and its pixels
+ *                      allocated.
+ *	up, down	The zoom factor
+ *	workers		The number of threads to use
+ *
+ * RETURNS:
+ *	nothing
+ *
+ * DESCRIPTION:
+ *	Fills in dst's pixels by scaling src, which must not be an
+ *      object's bytes if this is called off the interp's thread.
  */
 
+static void
+scaleRaster(Raster* src, Raster* dst, int up, int down, int workers)
+{
+    ScaleJob job;
+
+    job.src = src;
+    job.dst = dst;
+    buildFilter(&job.xf, src->width,  dst->width,  up, down);
+    buildFilter(&job.yf, src->height, dst->height, up, down);
+
+    runWorkers(scaleRange, (ClientData)&job, dst->height, workers,
+               ROWS_PER_WORKER);
+
+    freeFilter(&job.xf);
+    freeFilter(&job.yf);
+}
+
 /***********************************************************************
  *
  * FUNCTION:
- *	spheredist
+ *	buildFilter()
  *
  * INPUTS:
- *	lat1		A latitude in decimal degrees
- *      lon1            A longitude in decimal degrees
- *	lat2		A latitude in decimal degrees
- *      lon2            A longitude in decimal degrees
+ *	f		The Filter to fill in
+ *	n		The number of input pixels
+ *	m		The number of output pixels
+ *	up, down	The zoom factor
  *
  * RETURNS:
- *	The distance between loc 1 and loc 2 in kilometers.
+ *	nothing
  *
  * DESCRIPTION:
- *	Computes the distance between the two points and returns
- *      an answer in kilometers.  The algorithm is equivalent to
- *      that used in CBS.
+ *	When reducing, each output pixel is the area-weighted average of
+ *      the input pixels its footprint covers, a box filter.  Otherwise,
+ *      it is interpolated linearly between the two input pixels nearest
+ *      its center.
  */
 
-static double
-spheredist(double lat1, double lon1, double lat2, double lon2)
+static void
+buildFilter(Filter* f, int n, int m, int up, int down)
 {
-    /* Earth's diameter in kilometers, per CBS */
-    double diameter = 12742.0;
+    double scale = (double)down/up;  /* Input pixels per output pixel */
+    int    maxTaps = (up < down) ? (int)ceil(scale) + 1 : 2;
+    int    next = 0;
+    int    i;
 
-    /* NEXT, convert points to radians */
-    lat1 *= radians;
-    lon1 *= radians;
-    lat2 *= radians;
-    lon2 *= radians;
+    f->first   = (int*)Tcl_Alloc(sizeof(int)*m);
+    f->count   = (int*)Tcl_Alloc(sizeof(int)*m);
+    f->start   = (int*)Tcl_Alloc(sizeof(int)*m);
+    f->weights = (float*)Tcl_Alloc(sizeof(float)*m*maxTaps);
 
-    /* NEXT, compute the distance. */
-    double sinHalfDlat = sin((lat2 - lat1)/2.0);
-    double sinHalfDlon = sin((lon2 - lon1)/2.0);
+    for (i = 0; i < m; i++)
+    {
+        f->start[i] = next;
 
-    double dist = 
-        diameter * 
-        asin(sqrt(sinHalfDlat*sinHalfDlat +
-                  cos(lat1)*cos(lat2)*sinHalfDlon*sinHalfDlon));
+        if (up < down)
+        {
+            double lo = i*scale;
+            double hi = dmin((i + 1)*scale, n);
+            int    j  = (int)lo;
 
-    return dist;
+            f->first[i] = j;
+            f->count[i] = 0;
+
+            for (; j < hi && f->count[i] < maxTaps; j++)
+            {
+                double w = (dmin(j + 1, hi) - dmax(j, lo))/(hi - lo);
+
+                f->weights[next++] = (float)w;
+                f->count[i]++;
+            }
+        }
+        else
+        {
+            double c = (i + 0.5)*scale - 0.5;
+            int    j = (int)floor(c);
+            double t = c - j;
+
+            if (j < 0)
+            {
+                j = 0;
+                t = 0.0;
+            }
+
+            if (j >= n - 1)
+            {
+                j = n - 1;
+                t = 0.0;
+            }
+
+            f->first[i] = j;
+            f->count[i] = (t > 0.0) ? 2 : 1;
+            f->weights[next++] = (float)(1.0 - t);
+
+            if (t > 0.0)
+            {
+                f->weights[next++] = (float)t;
+            }
+        }
+    }
 }
 
 /***********************************************************************
  *
  * FUNCTION:
- *	bbox()
+ *	freeFilter()
  *
  * INPUTS:
- *	points		A list of Points
- *
- * OUTPUTS
- *      bbox	A bounding box
+ *	f		A Filter
  *
  * RETURNS:
  *	nothing
  *
  * DESCRIPTION:
- *	Computes the bounding box of the Points
+ *	Frees the filter's arrays.
  */
 
-static void 
-bbox(Points* points, Bbox* bbox)
+static void
+freeFilter(Filter* f)
 {
-    int i;
-
-    /* FIRST, get the first point as the start point. */
-    bbox->xmin = points->pts[0].x;
-    bbox->xmax = bbox->xmin;
+    Tcl_Free((char*)f->first);
+    Tcl_Free((char*)f->count);
+    Tcl_Free((char*)f->start);
+    Tcl_Free((char*)f->weights);
+}
 
-    bbox->ymin = points->pts[0].y;
-    bbox->ymax = bbox->ymin;
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	scaleRange()
+ *
+ * INPUTS:
+ *	cd		A ScaleJob*
+ *	first		The first output row to compute
+ *	last		The row after the last
+ *
+ * RETURNS:
+ *	nothing
+ *
+ * DESCRIPTION:
+ *	A WorkProc that computes a range of the job's output rows.  Each
+ *      row is the weighted sum of the input rows its y filter names,
+ *      each filtered along x in turn.
+ */
 
-    for (i = 1; i < points->size; i++)
+static void
+scaleRange(ClientData cd, int first, int last)
+{
+    ScaleJob*      job = (ScaleJob*)cd;
+    int            dw  = job->dst->width;
+    float*         acc = (float*)Tcl_Alloc(sizeof(float)*3*dw);
+    int            y;
+    int            x;
+    int            k;
+    int            t;
+
+    for (y = first; y < last; y++)
     {
-        double x = points->pts[i].x;
-        double y = points->pts[i].y;
+        memset(acc, 0, sizeof(float)*3*dw);
 
-        if (x < bbox->xmin)
-        {
-            bbox->xmin = x;
-        } 
-        else if (x > bbox->xmax)
+        for (k = 0; k < job->yf.count[y]; k++)
         {
-            bbox->xmax = x;
+            float          wy  = job->yf.weights[job->yf.start[y] + k];
+            unsigned char* row = job->src->pixels + 
+                3*(size_t)job->src->width*(job->yf.first[y] + k);
+
+            for (x = 0; x < dw; x++)
+            {
+                unsigned char* in = row + 3*job->xf.first[x];
+                float*         w  = job->xf.weights + job->xf.start[x];
+                float          r  = 0.0f;
+                float          g  = 0.0f;
+                float          b  = 0.0f;
+
+                for (t = 0; t < job->xf.count[x]; t++, in += 3)
+                {
+                    r += w[t]*in[0];
+                    g += w[t]*in[1];
+                    b += w[t]*in[2];
+                }
+
+                acc[3*x]     += wy*r;
+                acc[3*x + 1] += wy*g;
+                acc[3*x + 2] += wy*b;
+            }
         }
 
-        if (y < bbox->ymin)
-        {
-            bbox->ymin = y;
-        } 
-        else if (y > bbox->ymax)
+        unsigned char* out = job->dst->pixels + 3*(size_t)dw*y;
+
+        for (x = 0; x < 3*dw; x++)
         {
-            bbox->ymax = y;
+            float v = acc[x] + 0.5f;
+
+            out[x] = (v >= 255.0f) ? 255 : (unsigned char)v;
         }
     }
+
+    Tcl_Free((char*)acc);
 }
 
 /***********************************************************************
  *
  * FUNCTION:
- *	ccw
+ *	buildPyramid()
  *
  * INPUTS:
- *	a	An {x y} point
- *	b	An (x y) point
- *	c	An {x y} point
+ *	p		A Pyramid
  *
- * Checks whether a path from point a to point b to point c turns 
- * counterclockwise or not.
- *
- *                   c
- *                   |
- * Returns:   1    a-b    or   a-b-c
- *
- *
- *           -1    a-b    or   c-a-b
- *                   | 
- *                   c
+ * RETURNS:
+ *	nothing
  *
- *            0    a-c-b
- *                 
- * From Sedgewick, Algorithms in C, page 350, via the CBS Simscript
- * code.  Explicitly handles the case where a == b, which Sedgewick's
- * code doesn't.
+ * DESCRIPTION:
+ *	Scales the pyramid's base to each of its levels, whose sizes
+ *      were set by getScaledSize(), writing each
+ *      to the pyramid's file, if any, and then freeing it.  It touches 
+ *      no Tcl objects, and so can run on any thread.
  */
 
-static int
-ccw(Point* a, Point* b, Point* c)
+static void
+buildPyramid(Pyramid* p)
 {
-    /* FIRST, compute the deltas from a-b and a-c */
-    double dx1 = b->x - a->x;
-    double dy1 = b->y - a->y;
-    double dx2 = c->x - a->x;
-    double dy2 = c->y - a->y;
+    FILE* f = NULL;
+    int   i;
 
-    /* NEXT, see if point c is on the left of a-b */
-    if (dx1*dy2 > dy1*dx2) {
-        return 1;
-    }
-    
-    /* NEXT, see if point c is on the right of a-b */
-    if (dx1*dy2 < dy1*dx2) {
-        return -1;
+    if (p->file != NULL && (f = fopen(p->file, "wb")) == NULL)
+    {
+        p->failed = 1;
+        return;
     }
 
-    /* NEXT, the points are collinear.
-     * c-a-b */
-    if ((dx1 * dx2 < 0) || (dy1 * dy2 < 0)) {
-        return -1;
-    }
+    for (i = 0; i < p->nlevels && !p->failed; i++)
+    {
+        Raster* level = &p->levels[i];
 
-    /* NEXT, Explicitly handle the case where a == b */
-    if (dx1 == 0 && dy1 == 0) {
-        /* a == b */
+        level->pixels = (unsigned char*)Tcl_Alloc(
+            3*(size_t)level->width*level->height);
 
-        if (dx2 < 0) {
-            /* c->x < a->x */
-            return -1;
-        } else if (dx2 > 0) {
-            /* c->x > a->x */
-            return 1;
-        } else {
-            return 0;
+        scaleRaster(&p->base, level, p->up[i], p->down[i], p->workers);
+
+        if (f != NULL)
+        {
+            p->failed = !writeLevel(f, level, &p->offsets[i], &p->lengths[i]);
+            Tcl_Free((char*)level->pixels);
+            level->pixels = NULL;
         }
     }
-        
-    if ((dx1*dx1 + dy1*dy1) < (dx2*dx2 + dy2*dy2)) {
-        return 1;
-    }
 
-    return 0;
+    if (f != NULL && fclose(f) != 0)
+    {
+        p->failed = 1;
+    }
 }
 
 /***********************************************************************
  *
  * FUNCTION:
- *	intersect()
+ *	writeLevel()
  *
  * INPUTS:
- *	p1	A point
- *      p2	A point
- *      q1	A point
- *      q2	A point
+ *	f		A file open for writing
+ *	level		A pyramid level
+ *
+ * OUTPUTS:
+ *	offset		Where the level starts in the file
+ *	length		The level's length in bytes
  *
  * RETURNS:
- *	1 if the line segments intersect, and 0 otherwise.	
+ *	1 on success and 0 on failure.
  *
  * DESCRIPTION:
- *	
- *	Given two line segments p1-p2 and q1-q2, returns 1 if the line
- *	segments intersect and 0 otherwise.  The segments are still said
- *	to intersect if the point of intersection is the end point of one
- *	or both segments.  Either segment may be degenerate, i.e.,
- *	p1 == p2 and/or q1 == q2.
- *
- *	From Sedgewick, Algorithms in C, 1990, Addison-Wesley, page 351.
+ *	Appends the level to the file as a binary PPM.
  */
 
-static int 
-intersect(Point* p1, Point* p2, Point* q1, Point* q2)
+static int
+writeLevel(FILE* f, Raster* level, long* offset, long* length)
 {
-    if (ccw(p1, p2, q1) * ccw(p1, p2, q2) <= 0 &&
-        ccw(q1, q2, p1) * ccw(q1, q2, p2) <= 0) {
-        return 1;
-    } else {
+    size_t size = 3*(size_t)level->width*level->height;
+    int    hlen;
+
+    *offset = ftell(f);
+    hlen = fprintf(f, "P6\n%d %d\n255\n", level->width, level->height);
+
+    if (hlen < 0 || fwrite(level->pixels, 1, size, f) != size)
+    {
         return 0;
     }
+
+    *length = hlen + (long)size;
+
+    return 1;
 }
 
 /***********************************************************************
  *
  * FUNCTION:
- *	ptinpoly()
+ *	getPyramidResult()
  *
  * INPUTS:
- *	poly		A polygon defines as a list of Points
- *	p		A point
- *	bbox		The polygon's bounding box
+ *	interp		The Tcl interpreter
+ *	p		A finished Pyramid
+ *
+ * OUTPUTS:
+ *	result		The "raster pyramid" result
  *
  * RETURNS:
- *	1 if the point is inside the polygon or on its border, and 0
- *	otherwise.
+ *	TCL_OK on success and TCL_ERROR on failure, setting the error
+ *      string in the latter case.
  *
  * DESCRIPTION:
- * This function determines whether a given point q is inside or outside
- * of a given polygon; if a point is on an edge or vertex it is defined to
- * be on the inside.  The function determines this by:
- *
- * (1) Comparing q against the bounding box of the polygon; if it's outside
- *     the bounding box, it's outside the polygon.
- *
- * (2) Checking q against each edge of the polygon, using [intersect].
- *     If it's explicitly on the border, it's "inside".
- *
- * (3) Checking whether q is inside the polygon by counting the number
- *     intersections made between q and a point outside the polygon.
- *     This part of the algorithm was found in an on-line paper by
- *     Paul Bourke called "Determining If A Point Lies On The Interior
- *     Of A Polygon", at 
- *
- *     http://astronomy.swin.edu.au/~pbourke/geometry/insidepoly
+ *	Returns the list of levels as PPMs, or of their offsets and 
+ *      lengths if they were written to a file.
  */
 
 static int
-ptinpoly(Points* poly, Point* p, Bbox* box)
+getPyramidResult(Tcl_Interp* interp, Pyramid* p, Tcl_Obj** result)
 {
-    int    i;
-    int    counter;
-    Point* p1;
+    int i;
 
-    /* FIRST, if p is outside the bounding box, it's outside the
-     * polygon. */
-    if (p->x < box->xmin || p->x > box->xmax ||
-        p->y < box->ymin || p->y > box->ymax) {
-        return 0;
+    if (p->failed)
+    {
+        Tcl_AppendStringsToObj(Tcl_GetObjResult(interp),
+                               "error writing \"", p->file, "\"", NULL);
+        return TCL_ERROR;
     }
 
-    /* NEXT, count the intersections */
-    counter = 0;
-    p1 = &poly->pts[0];
+    *result = Tcl_NewObj();
 
-    for (i = 1; i <= poly->size; i++)
+    for (i = 0; i < p->nlevels; i++)
     {
-        Point* p2 = &poly->pts[i % poly->size];
+        Tcl_Obj* level;
 
-        /* FIRST, if the point is on this edge then it's "inside" */
-        if (intersect(p1, p2, p, p)) {
-            return 1;
-        }
+        if (p->file != NULL)
+        {
+            Tcl_Obj* place[2];
 
-        /* NEXT, check for an intersection */
-        if (p->y > dmin(p1->y, p2->y))
+            place[0] = Tcl_NewLongObj(p->offsets[i]);
+            place[1] = Tcl_NewLongObj(p->lengths[i]);
+            level    = Tcl_NewListObj(2, place);
+        }
+        else
         {
-            if (p->y <= dmax(p1->y, p2->y))
-            {
-                if (p->x <= dmax(p1->x, p2->x))
-                {
-                    if (p1->y != p2->y) 
-                    {
-                        double xInters = 
-                            (p->y - p1->y)*(p2->x - p1->x)/(p2->y - p1->y) 
-                            + p1->x;
+            level = newPpmObj(interp, &p->levels[i]);
 
-                        if (p1->x == p2->x || p->x <= xInters) {
-                            ++counter;
-                        }
-                    }
-                }
+            if (level == NULL)
+            {
+                Tcl_DecrRefCount(*result);
+                return TCL_ERROR;
             }
         }
-        
-        p1 = p2;
-    }
 
-    if (counter % 2 == 0) {
-        return 0;
-    } else {
-        return 1;
+        Tcl_ListObjAppendElement(NULL, *result, level);
     }
+
+    return TCL_OK;
 }
 
 /***********************************************************************
  *
  * FUNCTION:
- *	dmin()
+ *	pyramidThread()
  *
  * INPUTS:
- *	a	a value
- *	b	a value
+ *	cd		A Pyramid* with a callback
  *
  * RETURNS:
- *	The minimum of the two values.
+ *	nothing
+ *
+ * DESCRIPTION:
+ *	The body of a "raster pyramid -command" thread: builds the 
+ *      pyramid, frees its copy of the base, which is no longer 
+ *      needed, and queues it back to the interp's thread.
  */
 
-static double
-dmin(double a, double b)
+static Tcl_ThreadCreateType
+pyramidThread(ClientData cd)
 {
-    if (a < b)
-    {
-        return a;
-    }
-    else
-    {
-        return b;
-    }
+    Pyramid*     p = (Pyramid*)cd;
+    Tcl_ThreadId owner = p->owner;
+
+    buildPyramid(p);
+    Tcl_Free((char*)p->base.pixels);
+    p->base.pixels = NULL;
+
+    Tcl_ThreadQueueEvent(owner, (Tcl_Event*)p, TCL_QUEUE_TAIL);
+    Tcl_ThreadAlert(owner);
+
+    TCL_THREAD_CREATE_RETURN;
 }
 
 /***********************************************************************
  *
  * FUNCTION:
- *	dmax()
+ *	pyramidEventProc()
  *
  * INPUTS:
- *	a	a value
- *	b	a value
+ *	event		A finished Pyramid
+ *	flags		The event flags
  *
  * RETURNS:
- *	The maximum of the two values.
+ *	1, as the event is always handled.
+ *
+ * DESCRIPTION:
+ *	Calls the pyramid's callback with the list of levels, unless the
+ *      interp has since been deleted, and frees the pyramid's data.  
+ *      A failure to write the pyramid's file is a background error.
+ *      Tcl frees the event itself.
  */
 
-static double
-dmax(double a, double b)
+static int
+pyramidEventProc(Tcl_Event* event, int flags)
 {
-    if (a > b)
-    {
-        return a;
-    }
-    else
+    Pyramid*    p      = (Pyramid*)event;
+    Tcl_Interp* interp = p->interp;
+    Tcl_Obj*    levels;
+
+    if (!Tcl_InterpDeleted(interp))
     {
-        return b;
+        Tcl_Obj* cmd = Tcl_DuplicateObj(p->command);
+
+        Tcl_IncrRefCount(cmd);
+
+        if (getPyramidResult(interp, p, &levels) != TCL_OK ||
+            Tcl_ListObjAppendElement(interp, cmd, levels) != TCL_OK ||
+            Tcl_EvalObjEx(interp, cmd, TCL_EVAL_GLOBAL) != TCL_OK)
+        {
+            Tcl_BackgroundError(interp);
+        }
+
+        Tcl_DecrRefCount(cmd);
     }
+
+    Tcl_DecrRefCount(p->command);
+    Tcl_Release((ClientData)interp);
+    freePyramid(p);
+
+    return 1;
 }
 
 /***********************************************************************
  *
  * FUNCTION:
- *	ll_area()
+ *	freePyramid()
  *
  * INPUTS:
- *	poly		A list of (lat,lon) pairs
+ *	p		A Pyramid
  *
  * RETURNS:
- *	The area of the polygon in square kilometers
+ *	nothing
  *
  * DESCRIPTION:
- *	Computes the area of the polygon, taking curvature of the
- *      Earth into account.  See latlong.tcl for a discussion of the
- *      algorithm and its limitations.
+ *	Frees the pyramid's rasters and arrays, but not the pyramid 
+ *      itself, which Tcl frees if it's been queued as an event.
  */
 
-static double
-ll_area(Points* poly)
+static void
+freePyramid(Pyramid* p)
 {
-    int    i;
-    double sum;
-
-    /* FIRST, convert the lat/lon points to radians */
-    for (i = 0; i < poly->size; i++)
-    {
-        poly->pts[i].x *= radians;
-        poly->pts[i].y *= radians;
-    }
-
-    /* NEXT, compute the sum. */
-    sum = 0.0;
-
-    for (i = 0; i < poly->size; i++)
-    {
-        int j = (i - 2);
-
-        if (j < 0)
-        {
-            j += poly->size;
-        }
-
-        int k = (i - 1);
+    int i;
 
-        if (k < 0)
+    for (i = 0; i < p->nlevels; i++)
+    {
+        if (p->levels[i].pixels != NULL)
         {
-            k += poly->size;
+            Tcl_Free((char*)p->levels[i].pixels);
         }
+    }
 
-        double ilon = poly->pts[i].y;
-        double jlon = poly->pts[j].y;
-        double klat = poly->pts[k].x;
-
-        sum += (ilon - jlon)*sin(klat);
+    if (p->base.pixels != NULL)
+    {
+        Tcl_Free((char*)p->base.pixels);
     }
 
-    double area = -(earthRadius*earthRadius/2.0)*sum;
+    if (p->file != NULL)
+    {
+        Tcl_Free(p->file);
+    }
 
-    return area;
+    Tcl_Free((char*)p->up);
+    Tcl_Free((char*)p->down);
+    Tcl_Free((char*)p->levels);
+    Tcl_Free((char*)p->offsets);
+    Tcl_Free((char*)p->lengths);
 }
 
-/*
- * Private Helper Functions
- */
-
-
 /***********************************************************************
  *
  * FUNCTION:
- *	newLatlongInfo()
+ *	newCurveInfo()
  *
  * INPUTS:
  *	nothing
@@ -2278,21 +12198,18 @@ ll_area(Points* poly)
  *	none
  *
  * RETURNS:
- *	A pointer to a zeroed LatlongInfo struct
+ *	A pointer to an initialized CurveInfo struct
  *
  * DESCRIPTION:
- *	Allocates a new LatlongInfo struct, and zeroes it.
+ *	Allocates a new CurveInfo struct, with an empty registry.
  */
 
-static LatlongInfo*
-newLatlongInfo(void)
+static CurveInfo*
+newCurveInfo(void)
 {
-    LatlongInfo* info = (LatlongInfo*)Tcl_Alloc(sizeof(LatlongInfo));
-    memset(info, 0, sizeof(LatlongInfo));
-    info->pointsBuffer = newPoints();
-    info->spheroid = 0;
-
-    setEllipsoidData(info);
+    CurveInfo* info = (CurveInfo*)Tcl_Alloc(sizeof(CurveInfo));
+    memset(info, 0, sizeof(CurveInfo));
+    Tcl_InitHashTable(&info->stores, TCL_STRING_KEYS);
 
     return info;
 }
@@ -2300,534 +12217,895 @@ newLatlongInfo(void)
 /***********************************************************************
  *
  * FUNCTION:
- *	newGeotiffInfo()
+ *	deleteCurveInfo()
  *
  * INPUTS:
- *	nothing
+ *	A pointer to a CurveInfo struct
  *
  * OUTPUTS:
  *	none
  *
  * RETURNS:
- *	A pointer to a zeroed GeotiffInfo struct
+ *  nothing
  *
  * DESCRIPTION:
- *	Allocates a new GeotiffInfo struct, and zeroes it.
+ *	Deletes any remaining curvestore handles, and frees the 
+ *      CurveInfo* data.
  */
 
-static GeotiffInfo*
-newGeotiffInfo(void)
+static void
+deleteCurveInfo(CurveInfo* info)
 {
-    GeotiffInfo* info = (GeotiffInfo*)Tcl_Alloc(sizeof(GeotiffInfo));
-    memset(info, 0, sizeof(GeotiffInfo));
-    info->tiff = NULL;
+    Tcl_HashEntry* entry;
+    Tcl_HashSearch search;
 
-    return info;
+    for (entry = Tcl_FirstHashEntry(&info->stores, &search);
+         entry != NULL;
+         entry = Tcl_NextHashEntry(&search))
+    {
+        freeCurveStore((CurveStore*)Tcl_GetHashValue(entry));
+    }
+
+    Tcl_DeleteHashTable(&info->stores);
+    freeScratch(&info->scratch);
+
+    Tcl_Free((void*)info);
 }
 
 /***********************************************************************
  *
  * FUNCTION:
- *	closeGeotiff()
+ *	getCurveStore()
  *
  * INPUTS:
- *	Pointer to a GeotiffInfo struct
+ *	interp		The Tcl interpreter
+ *      info		The CurveInfo
+ *      handle		A curvestore handle
  *
  * OUTPUTS:
- *	none
+ *	store		The CurveStore
  *
  * RETURNS:
- *  nothing
+ *	TCL_OK on success and TCL_ERROR on failure, setting the error
+ *      string in the latter case.
  *
  * DESCRIPTION:
- *	Closes a Geotiff associated with a Geotiff info and cleans up
- *  pointers.
- *
+ *	Looks up a curvestore handle.
  */
 
-static void
-closeGeotiff(GeotiffInfo* info)
+static int
+getCurveStore(Tcl_Interp* interp, CurveInfo* info, Tcl_Obj* handle,
+              CurveStore** store)
 {
-    XTIFFClose(info->tiff);
-    info->tiff = NULL;
-    info->gtif = NULL;
-    return;
+    Tcl_HashEntry* entry;
+
+    entry = Tcl_FindHashEntry(&info->stores, Tcl_GetString(handle));
+
+    if (entry == NULL)
+    {
+        Tcl_AppendStringsToObj(Tcl_GetObjResult(interp), 
+                               "unknown curvestore: \"", 
+                               Tcl_GetString(handle), "\"", NULL);
+        return TCL_ERROR;
+    }
+
+    *store = (CurveStore*)Tcl_GetHashValue(entry);
+
+    return TCL_OK;
 }
 
 /***********************************************************************
  *
  * FUNCTION:
- *	setEllipsoidData
+ *	freeCurveStore()
  *
  * INPUTS:
- *	info           Reference to LatLongInfo
+ *	store		A CurveStore
  *
  * OUTPUTS:
- *	ellipsoidData   
+ *	none
  *
  * RETURNS:
  *	nothing
  *
  * DESCRIPTION:
- *	Compute essetial datum values from the current reference spheriod.
- *      This data is used for conversion to/from GCC values.
+ *	Frees the store and its arrays.
  */
 
-static void setEllipsoidData(LatlongInfo* info) 
+static void
+freeCurveStore(CurveStore* store)
 {
-    geoGetEllipsoid(&ellipsoidData.a, &ellipsoidData.b, &ellipsoidData.e2,
-                    &ellipsoidData.ee2, &ellipsoidData.flat, 
-                    ellipsoidTable[info->spheroid].geo_stars_datum);
+    if (store->maxSize > 0)
+    {
+        Tcl_Free((char*)store->ids);
+        Tcl_Free((char*)store->a);
+    }
+
+    if (store->slots != NULL)
+    {
+        Tcl_Free((char*)store->slots);
+    }
+
+    Tcl_Free((char*)store);
 }
 
 /***********************************************************************
  *
  * FUNCTION:
- *	deleteLatlongInfo()
+ *	sizeCurveStore()
  *
  * INPUTS:
- *	none
+ *	store		A CurveStore
+ *	size		The number of curves it must hold
  *
  * OUTPUTS:
  *	none
  *
  * RETURNS:
- *	A pointer to a LatlongInfo struct allocated with newLatlongInfo().
+ *	nothing
  *
  * DESCRIPTION:
- *	Frees the LatlongInfo* data.
+ *	Grows the store's arrays, if need be, to hold at least size
+ *      curves.  The double arrays share one block; their contents
+ *      are not kept.
  */
 
 static void
-deleteLatlongInfo(LatlongInfo* p)
+sizeCurveStore(CurveStore* store, int size)
 {
-    deletePoints(p->pointsBuffer);
+    if (size <= store->maxSize)
+    {
+        return;
+    }
 
-    Tcl_Free((void*)p);
+    if (store->maxSize > 0)
+    {
+        Tcl_Free((char*)store->ids);
+        Tcl_Free((char*)store->a);
+    }
+
+    store->maxSize = size;
+    store->ids     = (Tcl_WideInt*)Tcl_Alloc(size*sizeof(Tcl_WideInt));
+    store->a       = (double*)Tcl_Alloc(16*(size_t)size*sizeof(double));
+
+    store->b         = store->a + size;
+    store->c         = store->b + size;
+    store->delta     = store->c + size;
+    store->posfactor = store->delta + size;
+    store->negfactor = store->posfactor + size;
+    store->min       = store->negfactor + size;
+    store->max       = store->min + size;
+    store->alpha     = store->max + size;
+    store->beta      = store->alpha + size;
+    store->gamma     = store->beta + size;
+    store->loaded    = store->gamma + size;
 }
 
 /***********************************************************************
  *
  * FUNCTION:
- *	deleteGeotiffInfo()
+ *	curveSlot()
  *
  * INPUTS:
- *	A pointer to a GeotiffInfo struct
+ *	store		A CurveStore
+ *	id		A curve_id
  *
  * OUTPUTS:
  *	none
  *
  * RETURNS:
- *  nothing
+ *	The index of the curve in the store's arrays, or -1 if it
+ *      isn't there.
  *
  * DESCRIPTION:
- *	Frees the GeotiffInfo* data.
+ *	Looks the curve up in the slots, if any, and otherwise does a
+ *      binary search of the IDs.
  */
 
-static void
-deleteGeotiffInfo(GeotiffInfo* g)
+static int
+curveSlot(CurveStore* store, Tcl_WideInt id)
 {
-    Tcl_Free((void*)g);
+    if (store->nslots > 0)
+    {
+        return (id >= 0 && id < store->nslots) ? store->slots[id] : -1;
+    }
+
+    int lo = 0;
+    int hi = store->size - 1;
+
+    while (lo <= hi)
+    {
+        int mid = lo + (hi - lo)/2;
+
+        if (store->ids[mid] < id)
+        {
+            lo = mid + 1;
+        }
+        else if (store->ids[mid] > id)
+        {
+            hi = mid - 1;
+        }
+        else
+        {
+            return mid;
+        }
+    }
+
+    return -1;
 }
 
 /***********************************************************************
  *
  * FUNCTION:
- *	newPoints()
+ *	curveBaseline()
  *
  * INPUTS:
- *	none
+ *	store		A CurveStore
  *
  * OUTPUTS:
  *	none
  *
  * RETURNS:
- *	A pointer to an initialized Points struct
+ *	nothing
  *
  * DESCRIPTION:
- *	Allocates and zeros a new Points struct.
+ *	Computes each curve's new baseline, B.t = alpha*A.t-1 + 
+ *      beta*B.t-1 + gamma*C.t, and its scaling factors.
  */
 
-static Points*
-newPoints()
+static void
+curveBaseline(CurveStore* store)
 {
-    Points* p = (Points*)Tcl_Alloc(sizeof(Points));
-    memset(p, 0, sizeof(Points));
+    double* restrict a     = store->a;
+    double* restrict b     = store->b;
+    double* restrict c     = store->c;
+    double* restrict alpha = store->alpha;
+    double* restrict beta  = store->beta;
+    double* restrict gamma = store->gamma;
+    int              i;
+
+    for (i = 0; i < store->size; i++)
+    {
+        b[i] = alpha[i]*a[i] + beta[i]*b[i] + gamma[i]*c[i];
+    }
 
-    return p;
+    for (i = 0; i < store->size; i++)
+    {
+        store->posfactor[i] = (store->max[i] - b[i])/100.0;
+        store->negfactor[i] = (b[i] - store->min[i])/100.0;
+    }
 }
 
 /***********************************************************************
  *
  * FUNCTION:
- *	deletePoints()
+ *	curveUpdate()
  *
  * INPUTS:
- *	none
+ *	store		A CurveStore
  *
  * OUTPUTS:
  *	none
  *
  * RETURNS:
- *	A pointer to a Points struct allocated with newPoints().
+ *	nothing
  *
  * DESCRIPTION:
- *	Frees the Points* data.
+ *	Adds each curve's delta to its baseline, clamping it to the 
+ *      curve's bounds, and recomputes its scaling factors.
  */
 
 static void
-deletePoints(Points* p)
+curveUpdate(CurveStore* store)
 {
-    if (p->pts != NULL)
+    double* restrict b     = store->b;
+    double* restrict delta = store->delta;
+    double* restrict min   = store->min;
+    double* restrict max   = store->max;
+    int              i;
+
+    for (i = 0; i < store->size; i++)
     {
-        Tcl_Free((void*)p->pts);
+        double bnew = b[i] + delta[i];
+
+        b[i] = bnew > max[i] ? max[i] : (bnew < min[i] ? min[i] : bnew);
     }
 
-    Tcl_Free((void*)p);
+    for (i = 0; i < store->size; i++)
+    {
+        store->posfactor[i] = (max[i] - b[i])/100.0;
+        store->negfactor[i] = (b[i] - min[i])/100.0;
+    }
 }
 
-
 /***********************************************************************
  *
  * FUNCTION:
- *	getBbox()
+ *	curveEffects()
  *
  * INPUTS:
- *	interp		The Tcl interpreter
- *      coords		The coordinates: xmin ymin xmax ymax
+ *	store		A CurveStore
+ *	effects		The effects, sorted by compareEffectsByCause()
+ *	n		The number of effects
+ *	pflag		1 for the persistent effects, 0 for the transient
  *
  * OUTPUTS:
- *	box		A pointer to the Bbox struct.
+ *	effects		The actual magnitude of each effect applied
  *
  * RETURNS:
- *	TCL_OK on success and TCL_ERROR on failure, setting the error
- *      string in the latter case.
+ *	1 if any effects were applied, and 0 otherwise.
  *
  * DESCRIPTION:
- *	Converts a flat list of coordinates into a bounding box.
+ *	Computes each curve's delta from the given kind of effects.
+ *      The effects of each cause on a curve don't accumulate: the 
+ *      cause's net contribution is its largest positive magnitude 
+ *      plus its largest negative magnitude, scaled by the curve's
+ *      positive or negative scaling factor.  Each effect of the cause
+ *      is credited with a share of that in proportion to its 
+ *      magnitude.
  */
 
 static int
-getBbox(Tcl_Interp* interp, Tcl_Obj* coords, Bbox* box)
+curveEffects(CurveStore* store, CurveEffect* effects, int n, int pflag)
 {
-    int listc;
-    Tcl_Obj** listv;
-    
-    if (Tcl_ListObjGetElements(interp, coords, &listc, &listv) != TCL_OK)
-    {
-        return TCL_ERROR;
-    }
+    int applied = 0;
+    int i;
+    int j;
+    int k;
 
-    if (listc != 4)
+    memset(store->delta, 0, store->size*sizeof(double));
+
+    for (i = 0; i < n; i = j)
     {
-        Tcl_Obj* result = Tcl_GetObjResult(interp);
+        CurveEffect* e      = &effects[i];
+        double       maxpos = 0.0;
+        double       sumpos = 0.0;
+        double       minneg = 0.0;
+        double       sumneg = 0.0;
+
+        /* FIRST, find the effects of this cause on this curve. */
+        for (j = i; j < n && effects[j].pflag   == e->pflag &&
+                             effects[j].curveId == e->curveId &&
+                             effects[j].causeId == e->causeId;
+             j++)
+        {
+            double mag = effects[j].mag;
 
-        Tcl_AppendStringsToObj(
-            result, 
-            "invalid bounding box, expected 4 coordinates, got: \"", NULL);
-        Tcl_AppendObjToObj(result, Tcl_NewIntObj(listc));
-        Tcl_AppendStringsToObj(
-            result, 
-            "\"", NULL);
-        
-        return TCL_ERROR;
+            if (mag > 0.0)
+            {
+                maxpos  = mag > maxpos ? mag : maxpos;
+                sumpos += mag;
+            }
+            else if (mag < 0.0)
+            {
+                minneg  = mag < minneg ? mag : minneg;
+                sumneg += mag;
+            }
+        }
+
+        if (e->pflag != pflag || e->slot < 0)
+        {
+            continue;
+        }
+
+        /* NEXT, apply the net contribution. */
+        double net   = maxpos + minneg;
+        double scale = net >= 0.0 ? store->posfactor[e->slot] 
+                                  : store->negfactor[e->slot];
+
+        store->delta[e->slot] += scale*net;
+        applied = 1;
+
+        /* NEXT, give each effect its share. */
+        double posfrac = maxpos > 0.0 ? scale*maxpos/sumpos : 0.0;
+        double negfrac = minneg < 0.0 ? scale*minneg/sumneg : 0.0;
+
+        for (k = i; k < j; k++)
+        {
+            double mag = effects[k].mag;
+
+            if (mag != 0.0)
+            {
+                effects[k].actual = (mag >= 0.0 ? posfrac : negfrac)*mag;
+            }
+        }
     }
 
-    if (Tcl_GetDoubleFromObj(interp, listv[0], &box->xmin) != TCL_OK)
+    return applied;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	curveLevels()
+ *
+ * INPUTS:
+ *	store		A CurveStore
+ *
+ * OUTPUTS:
+ *	none
+ *
+ * RETURNS:
+ *	nothing
+ *
+ * DESCRIPTION:
+ *	Computes each curve's current level from its baseline and 
+ *      delta, clamped to the curve's bounds.
+ */
+
+static void
+curveLevels(CurveStore* store)
+{
+    double* restrict a     = store->a;
+    double* restrict b     = store->b;
+    double* restrict delta = store->delta;
+    double* restrict min   = store->min;
+    double* restrict max   = store->max;
+    int              i;
+
+    for (i = 0; i < store->size; i++)
     {
-        return TCL_ERROR;
+        double anew = b[i] + delta[i];
+
+        a[i] = anew > max[i] ? max[i] : (anew < min[i] ? min[i] : anew);
     }
+}
 
-    if (Tcl_GetDoubleFromObj(interp, listv[1], &box->ymin) != TCL_OK)
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	compareEffectsByCause()
+ *
+ * INPUTS:
+ *	p1, p2		Pointers to two CurveEffects
+ *
+ * OUTPUTS:
+ *	none
+ *
+ * RETURNS:
+ *	-1, 0, or 1
+ *
+ * DESCRIPTION:
+ *	qsort() comparison function for CurveEffects: orders them by
+ *      pflag, curve_id, cause_id, and order of entry.
+ */
+
+static int
+compareEffectsByCause(const void* p1, const void* p2)
+{
+    const CurveEffect* e1 = (const CurveEffect*)p1;
+    const CurveEffect* e2 = (const CurveEffect*)p2;
+
+    if (e1->pflag != e2->pflag)
     {
-        return TCL_ERROR;
+        return e1->pflag < e2->pflag ? -1 : 1;
     }
 
-    if (Tcl_GetDoubleFromObj(interp, listv[2], &box->xmax) != TCL_OK)
+    if (e1->curveId != e2->curveId)
     {
-        return TCL_ERROR;
+        return e1->curveId < e2->curveId ? -1 : 1;
     }
 
-    if (Tcl_GetDoubleFromObj(interp, listv[3], &box->ymax) != TCL_OK)
+    if (e1->causeId != e2->causeId)
     {
-        return TCL_ERROR;
+        return e1->causeId < e2->causeId ? -1 : 1;
     }
 
-    return TCL_OK;
+    return (e1->order > e2->order) - (e1->order < e2->order);
 }
 
 /***********************************************************************
  *
  * FUNCTION:
- *	getPoint()
+ *	compareEffectsByDriver()
  *
  * INPUTS:
- *	interp		The Tcl interpreter
- *      coords		The coordinates: a 2-element Tcl list
+ *	p1, p2		Pointers to two CurveEffects
  *
  * OUTPUTS:
- *	point		A pointer to the Point struct.
+ *	none
  *
  * RETURNS:
- *	TCL_OK on success and TCL_ERROR on failure, setting the error
- *      string in the latter case.
+ *	-1, 0, or 1
  *
  * DESCRIPTION:
- *	Converts a coordinate pair into a Point.
+ *	qsort() comparison function for CurveEffects: orders them by
+ *      curve_id, driver_id, and order of entry.
  */
 
 static int
-getPoint(Tcl_Interp* interp, Tcl_Obj* coords, Point* point)
+compareEffectsByDriver(const void* p1, const void* p2)
 {
-    int listc;
-    Tcl_Obj** listv;
-    
-    if (Tcl_ListObjGetElements(interp, coords, &listc, &listv) != TCL_OK)
-    {
-        return TCL_ERROR;
-    }
+    const CurveEffect* e1 = (const CurveEffect*)p1;
+    const CurveEffect* e2 = (const CurveEffect*)p2;
 
-    if (listc != 2)
+    if (e1->curveId != e2->curveId)
     {
-        Tcl_SetResult(interp, "not a coordinate pair",
-                      TCL_STATIC);
-        return TCL_ERROR;
+        return e1->curveId < e2->curveId ? -1 : 1;
     }
 
-    if (Tcl_GetDoubleFromObj(interp, listv[0], &point->x) != TCL_OK)
+    if (e1->driverId != e2->driverId)
     {
-        return TCL_ERROR;
+        return e1->driverId < e2->driverId ? -1 : 1;
     }
 
-    if (Tcl_GetDoubleFromObj(interp, listv[1], &point->y) != TCL_OK)
-    {
-        return TCL_ERROR;
-    }
+    return (e1->order > e2->order) - (e1->order < e2->order);
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	newGramInfo()
+ *
+ * INPUTS:
+ *	nothing
+ *
+ * OUTPUTS:
+ *	none
+ *
+ * RETURNS:
+ *	A pointer to an initialized GramInfo struct
+ *
+ * DESCRIPTION:
+ *	Allocates a new GramInfo struct.
+ */
+
+static GramInfo*
+newGramInfo(void)
+{
+    GramInfo* info = (GramInfo*)Tcl_Alloc(sizeof(GramInfo));
+    memset(info, 0, sizeof(GramInfo));
+
+    return info;
+}
+
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	deleteGramInfo()
+ *
+ * INPUTS:
+ *	A pointer to a GramInfo struct
+ *
+ * OUTPUTS:
+ *	none
+ *
+ * RETURNS:
+ *  nothing
+ *
+ * DESCRIPTION:
+ *	Frees the GramInfo* data.
+ */
 
-    return TCL_OK;
+static void
+deleteGramInfo(GramInfo* info)
+{
+    freeScratch(&info->scratch);
+
+    Tcl_Free((void*)info);
 }
 
 /***********************************************************************
  *
  * FUNCTION:
- *	getPoints()
+ *	getGramEffects()
  *
  * INPUTS:
  *	interp		The Tcl interpreter
- *      coords		The coordinates: an N-element Tcl list
- *      minSize         Minimum number of points
+ *      scratch		The scratch arena for the arrays
+ *      effects		A flat list of effects, 9 fields per effect:
+ *                      {id ts te llimit tau nominal athresh dthresh val}
+ *                      for level effects, and
+ *                      {id ts te slope future nominal athresh dthresh val}
+ *                      for slope effects.
+ *      level		1 for level effects, 0 for slope effects
  *
  * OUTPUTS:
- *	points		A pointer to the Points struct.
+ *	fx		The effects, in scratch arrays
  *
  * RETURNS:
  *	TCL_OK on success and TCL_ERROR on failure, setting the error
  *      string in the latter case.
  *
  * DESCRIPTION:
- *	Converts a flat list of coordinates into a set of Points.
- *
- *      getPoints allocates enough space in points to hold the current 
- *      Note that it assumes that the points buffer is being reused.
- *      Initially, the points buffer should be all zeros.
+ *	Unpacks the effects into a GramEffects.  The nominal array is
+ *      initialized from the loaded values, and ncontrib to 0.0.  The
+ *      arrays that don't apply to the kind of effect are NULL.
  */
 
 static int
-getPoints(Tcl_Interp* interp, Tcl_Obj* coords, int minSize, Points* points)
+getGramEffects(Tcl_Interp* interp, Scratch* scratch, Tcl_Obj* effects,
+               int level, GramEffects* fx)
 {
-    int       listc;
-    Tcl_Obj** listv;
+    int       objc;
+    Tcl_Obj** objv;
+    int       n;
     int       i;
-    
-    if (Tcl_ListObjGetElements(interp, coords, &listc, &listv) != TCL_OK)
-    {
-        return TCL_ERROR;
-    }
 
-    if (listc % 2 != 0)
+    if (Tcl_ListObjGetElements(interp, effects, &objc, &objv) != TCL_OK)
     {
-        Tcl_Obj* result = Tcl_GetObjResult(interp);
-
-        Tcl_AppendStringsToObj(result, 
-                               "expected even number of coordinates, got ", 
-                               NULL);
-        Tcl_AppendObjToObj(result, Tcl_NewIntObj(listc));
-        Tcl_AppendStringsToObj(result, ": \"", NULL);
-        Tcl_AppendObjToObj(result, coords);
-        Tcl_AppendStringsToObj(result, "\"", NULL);
-
         return TCL_ERROR;
     }
 
-    if (listc < 2*minSize)
+    if (objc % 9 != 0)
     {
-        Tcl_Obj* result = Tcl_GetObjResult(interp);
-
-        Tcl_AppendStringsToObj(result, "expected at least ", NULL);
-        Tcl_AppendObjToObj(result, Tcl_NewIntObj(minSize));
-        Tcl_AppendStringsToObj(result, " point(s), got ", NULL);
-        Tcl_AppendObjToObj(result, Tcl_NewIntObj(listc/2));
-        Tcl_AppendStringsToObj(result, ": \"", NULL);
-        Tcl_AppendObjToObj(result, coords);
-        Tcl_AppendStringsToObj(result, "\"", NULL);
-
-        
+        Tcl_SetResult(interp, level
+            ? "expected effects "
+              "{id ts te llimit tau nominal athresh dthresh val ...}"
+            : "expected effects "
+              "{id ts te slope future nominal athresh dthresh val ...}",
+            TCL_STATIC);
         return TCL_ERROR;
     }
 
-    points->size = listc/2;
-
-    if (points->maxSize == 0)
+    n = objc / 9;
+
+    memset(fx, 0, sizeof(GramEffects));
+    fx->size     = n;
+    fx->ids      = (Tcl_Obj**)scratchAlloc(scratch, n*sizeof(Tcl_Obj*));
+    fx->ts       = (Tcl_WideInt*)scratchAlloc(scratch, 
+                                              n*sizeof(Tcl_WideInt));
+    fx->te       = (Tcl_WideInt*)scratchAlloc(scratch, 
+                                              n*sizeof(Tcl_WideInt));
+    fx->loaded   = (double*)scratchAlloc(scratch, n*sizeof(double));
+    fx->nominal  = (double*)scratchAlloc(scratch, n*sizeof(double));
+    fx->ncontrib = (double*)scratchAlloc(scratch, n*sizeof(double));
+    fx->athresh  = (double*)scratchAlloc(scratch, n*sizeof(double));
+    fx->dthresh  = (double*)scratchAlloc(scratch, n*sizeof(double));
+    fx->val      = (double*)scratchAlloc(scratch, n*sizeof(double));
+
+    if (level)
     {
-        points->maxSize = points->size;
-        points->pts = (Point*)Tcl_Alloc(points->size * sizeof(Point));
+        fx->llimit = (double*)scratchAlloc(scratch, n*sizeof(double));
+        fx->tau    = (double*)scratchAlloc(scratch, n*sizeof(double));
     }
-    else if (points->size > points->maxSize)
+    else
     {
-        points->maxSize = points->size;
-        points->pts = (Point*)Tcl_Realloc((char*)points->pts, 
-                                          points->size * sizeof(Point));
+        fx->slope  = (double*)scratchAlloc(scratch, n*sizeof(double));
+        fx->future = (Tcl_Obj**)scratchAlloc(scratch, n*sizeof(Tcl_Obj*));
     }
 
-    for (i = 0; i < points->size; i++) {
-        if (Tcl_GetDoubleFromObj(interp, listv[2*i], 
-                                 &points->pts[i].x) != TCL_OK)
+    for (i = 0; i < n; i++)
+    {
+        Tcl_Obj** fields = &objv[9*i];
+
+        fx->ids[i] = fields[0];
+
+        if (Tcl_GetWideIntFromObj(interp, fields[1], &fx->ts[i]) != TCL_OK ||
+            Tcl_GetWideIntFromObj(interp, fields[2], &fx->te[i]) != TCL_OK ||
+            Tcl_GetDoubleFromObj(interp, fields[5], 
+                                 &fx->loaded[i]) != TCL_OK ||
+            Tcl_GetDoubleFromObj(interp, fields[6], 
+                                 &fx->athresh[i]) != TCL_OK ||
+            Tcl_GetDoubleFromObj(interp, fields[7], 
+                                 &fx->dthresh[i]) != TCL_OK ||
+            Tcl_GetDoubleFromObj(interp, fields[8], &fx->val[i]) != TCL_OK)
         {
             return TCL_ERROR;
         }
 
-        if (Tcl_GetDoubleFromObj(interp, listv[2*i + 1], 
-                                 &points->pts[i].y) != TCL_OK)
+        if (level)
         {
-            return TCL_ERROR;
+            if (Tcl_GetDoubleFromObj(interp, fields[3], 
+                                     &fx->llimit[i]) != TCL_OK ||
+                Tcl_GetDoubleFromObj(interp, fields[4], 
+                                     &fx->tau[i]) != TCL_OK)
+            {
+                return TCL_ERROR;
+            }
+        }
+        else
+        {
+            if (Tcl_GetDoubleFromObj(interp, fields[3], 
+                                     &fx->slope[i]) != TCL_OK)
+            {
+                return TCL_ERROR;
+            }
+
+            fx->future[i] = fields[4];
         }
+
+        fx->nominal[i]  = fx->loaded[i];
+        fx->ncontrib[i] = 0.0;
     }
+
     return TCL_OK;
 }
 
 /***********************************************************************
  *
  * FUNCTION:
- *	getLatLong()
+ *	gramLevels()
  *
  * INPUTS:
- *	interp		The Tcl interpreter
- *      loc		The location: a 2-element Tcl list
+ *	fx		Level effects
+ *      t		The current time, in ticks
  *
  * OUTPUTS:
- *	lat		The latitude
- *      lon		The longitude
+ *	value		Each effect's level at time t
  *
  * RETURNS:
- *	TCL_OK on success and TCL_ERROR on failure, setting the error
- *      string in the latter case.
+ *	-1 on success, or the index of an effect whose level couldn't 
+ *      be computed because its tau is 0.0.
  *
  * DESCRIPTION:
- *	Converts a lat/long pair into doubles--or, really, any 
- *      double-valued coordinate pair.
+ *	Computes the level of each effect at time t: 0.0 before ts,
+ *      llimit from te on, and in between
+ *
+ *          llimit * (1 - exp(-(t - ts)/tau))
+ *
+ *      where t - ts is in days.  The exponents are computed first,
+ *      and then exp() is taken of all of them in a single loop, which
+ *      the compiler can vectorize where the math library allows.
  */
 
 static int
-getLatLong(Tcl_Interp* interp, Tcl_Obj* loc, double* lat, double* lon)
+gramLevels(GramEffects* fx, Tcl_WideInt t, double* value)
 {
-    int locc;
-    Tcl_Obj** locv;
-    
-    if (Tcl_ListObjGetElements(interp, loc, &locc, &locv) != TCL_OK)
-    {
-        return TCL_ERROR;
-    }
+    int i;
 
-    if (locc != 2)
+    /* FIRST, compute the exponents; they're 0.0 for effects that
+     * aren't part way. */
+    for (i = 0; i < fx->size; i++)
     {
-        Tcl_Obj* result = Tcl_GetObjResult(interp);
-
-        Tcl_AppendStringsToObj(
-            result, 
-            "expected lat/long pair, got: \"", NULL);
-        Tcl_AppendObjToObj(result, loc);
-        Tcl_AppendStringsToObj(
-            result, 
-            "\"", NULL);
+        if (t >= fx->te[i] || t <= fx->ts[i])
+        {
+            value[i] = 0.0;
+        }
+        else if (fx->tau[i] == 0.0)
+        {
+            return i;
+        }
+        else
+        {
+            double deltaDays = (double)(t - fx->ts[i])/1440.0;
 
-        return TCL_ERROR;
+            value[i] = -deltaDays/fx->tau[i];
+        }
     }
 
-    if (Tcl_GetDoubleFromObj(interp, locv[0], lat) != TCL_OK)
+    /* NEXT, the exponential kernel. */
+    for (i = 0; i < fx->size; i++)
     {
-        return TCL_ERROR;
+        value[i] = exp(value[i]);
     }
 
-    if (Tcl_GetDoubleFromObj(interp, locv[1], lon) != TCL_OK)
+    /* NEXT, the levels. */
+    for (i = 0; i < fx->size; i++)
     {
-        return TCL_ERROR;
+        if (t >= fx->te[i])
+        {
+            value[i] = fx->llimit[i];
+        }
+        else if (t <= fx->ts[i])
+        {
+            value[i] = 0.0;
+        }
+        else
+        {
+            value[i] = fx->llimit[i] * (1.0 - value[i]);
+        }
     }
 
-    return TCL_OK;
+    return -1;
 }
 
 /***********************************************************************
  *
  * FUNCTION:
- *	getGcc()
+ *	gramSlopes()
  *
  * INPUTS:
  *	interp		The Tcl interpreter
- *      loc		The location: a 3-element Tcl list
+ *	fx		Slope effects
+ *      t		The current time, in ticks
+ *      tlast		The time of the previous step, in ticks
+ *      tickSize	The length of a tick in the clock's units
+ *      unitDays	The length of one of the clock's units in days
+ *      maxEndTime	The end time of an effect with no future links
  *
  * OUTPUTS:
- *	x         Geo-celestiocentric x-axis value
- *      y         Geo-celestiocentric y-axis value
- *      z	  Geo-celestiocentric z-axis value
+ *	links		A list to which {id ts te slope future} is 
+ *                      appended for each effect that moves on to a 
+ *                      later link of its chain.
  *
  * RETURNS:
  *	TCL_OK on success and TCL_ERROR on failure, setting the error
  *      string in the latter case.
  *
  * DESCRIPTION:
- *	Converts a GCC triple into doubles--or, really, any 
- *      doubled-valued coordinate tripple.
+ *	Computes each effect's nominal contribution for the step from
+ *      tlast to t, adding it to the effect's nominal contribution to
+ *      date.  An effect whose current link ended before t moves on to
+ *      its next link, {ts slope}, which is the head of its future 
+ *      list; the link ends at the start of the link after it.
  */
 
 static int
-getGcc(Tcl_Interp* interp, Tcl_Obj* loc, double* x, double* y, double* z)
+gramSlopes(Tcl_Interp* interp, GramEffects* fx, 
+           Tcl_WideInt t, Tcl_WideInt tlast, Tcl_WideInt tickSize,
+           double unitDays, Tcl_WideInt maxEndTime, Tcl_Obj* links)
 {
-    int locc;
-    Tcl_Obj** locv;
-    
-    if (Tcl_ListObjGetElements(interp, loc, &locc, &locv) != TCL_OK)
-    {
-        return TCL_ERROR;
-    }
+    int i;
 
-    if (locc != 3)
+    for (i = 0; i < fx->size; i++)
     {
-        Tcl_Obj* result = Tcl_GetObjResult(interp);
+        Tcl_WideInt ts    = fx->ts[i];
+        Tcl_WideInt te    = fx->te[i];
+        double      slope = fx->slope[i];
+        Tcl_Obj*    tsObj = NULL;
+        Tcl_Obj*    teObj = NULL;
+        Tcl_Obj*    slopeObj = NULL;
+        int         nfuture = 0;
+        Tcl_Obj**   future = NULL;
+
+        if (te < t && 
+            Tcl_ListObjGetElements(interp, fx->future[i], 
+                                   &nfuture, &future) != TCL_OK)
+        {
+            return TCL_ERROR;
+        }
 
-        Tcl_AppendStringsToObj(
-            result, 
-            "expected X Y Z triple, got: \"", NULL);
-        Tcl_AppendObjToObj(result, loc);
-        Tcl_AppendStringsToObj(
-            result, 
-            "\"", NULL);
+        while (1)
+        {
+            /* FIRST, get the part of the step during which this link
+             * applies, and its contribution.  The multiplications are
+             * done in simclock(n)'s order. */
+            Tcl_WideInt start = ts > tlast ? ts : tlast;
+            Tcl_WideInt end   = te < t ? te : t;
+            double      days  = (double)((end - start)*tickSize)*unitDays;
+            double      nvalue = slope * days;
+
+            fx->nominal[i]  = fx->nominal[i] + nvalue;
+            fx->ncontrib[i] = fx->ncontrib[i] + nvalue;
+
+            /* NEXT, if the link ended during the step, get the next 
+             * one. */
+            if (te >= t)
+            {
+                break;
+            }
 
-        return TCL_ERROR;
-    }
+            if (nfuture < 2)
+            {
+                Tcl_AppendStringsToObj(Tcl_GetObjResult(interp),
+                    "slope effect ", Tcl_GetString(fx->ids[i]),
+                    " has no more links", NULL);
+                return TCL_ERROR;
+            }
 
-    if (Tcl_GetDoubleFromObj(interp, locv[0], x) != TCL_OK)
-    {
-        return TCL_ERROR;
-    }
+            tsObj    = future[0];
+            slopeObj = future[1];
+            future  += 2;
+            nfuture -= 2;
 
-    if (Tcl_GetDoubleFromObj(interp, locv[1], y) != TCL_OK)
-    {
-        return TCL_ERROR;
-    }
+            if (nfuture == 0)
+            {
+                teObj = Tcl_NewWideIntObj(maxEndTime);
+            }
+            else
+            {
+                teObj = future[0];
+            }
 
-    if (Tcl_GetDoubleFromObj(interp, locv[2], z) != TCL_OK)
-    {
-        return TCL_ERROR;
+            if (Tcl_GetWideIntFromObj(interp, tsObj, &ts) != TCL_OK ||
+                Tcl_GetWideIntFromObj(interp, teObj, &te) != TCL_OK ||
+                Tcl_GetDoubleFromObj(interp, slopeObj, &slope) != TCL_OK)
+            {
+                return TCL_ERROR;
+            }
+        }
+
+        /* NEXT, save the new link, if any. */
+        if (tsObj != NULL)
+        {
+            Tcl_ListObjAppendElement(interp, links, fx->ids[i]);
+            Tcl_ListObjAppendElement(interp, links, tsObj);
+            Tcl_ListObjAppendElement(interp, links, teObj);
+            Tcl_ListObjAppendElement(interp, links, slopeObj);
+            Tcl_ListObjAppendElement(interp, links, 
+                                     Tcl_NewListObj(nfuture, future));
+        }
     }
 
     return TCL_OK;
@@ -2836,66 +13114,78 @@ getGcc(Tcl_Interp* interp, Tcl_Obj* loc, double* x, double* y, double* z)
 /***********************************************************************
  *
  * FUNCTION:
- *	validateLatLong()
+ *	gramThresholds()
  *
  * INPUTS:
- *	interp		The Tcl interpreter
- *	lat		The latitude
- *      lon		The longitude
+ *	fx		Effects whose ncontribs have been computed
+ *
+ * OUTPUTS:
+ *	none
  *
  * RETURNS:
- *	TCL_OK on success and TCL_ERROR on failure, setting the error
- *      string in the latter case.
+ *	nothing
  *
  * DESCRIPTION:
- *	Validates the lat and lon values.
+ *	Zeroes the positive contributions to curves at or above their
+ *      effects' ascending thresholds, and the negative contributions
+ *      to curves at or below their descending thresholds.
  */
 
-static int
-validateLatLong(Tcl_Interp* interp, double lat, double lon)
+static void
+gramThresholds(GramEffects* fx)
 {
-    if (lat < LAT_MIN || lat > LAT_MAX)
-    {
-        Tcl_Obj* result = Tcl_GetObjResult(interp);
-
-        Tcl_AppendStringsToObj(result, 
-            "invalid latitude, should be ", NULL);
-        Tcl_AppendObjToObj(result, Tcl_NewDoubleObj(LAT_MIN));
-        Tcl_AppendStringsToObj(result, 
-            " to ", NULL);
-        Tcl_AppendObjToObj(result, Tcl_NewDoubleObj(LAT_MAX));
-        Tcl_AppendStringsToObj(result, 
-            " degrees: \"", NULL);
-        Tcl_AppendObjToObj(result, Tcl_NewDoubleObj(lat));
-        Tcl_AppendStringsToObj(result, 
-            "\"", NULL);
-
-        return TCL_ERROR;
-    }
+    int i;
 
-    if (lon < LON_MIN || lon > LON_MAX)
+    for (i = 0; i < fx->size; i++)
     {
-        Tcl_Obj* result = Tcl_GetObjResult(interp);
-
-        Tcl_AppendStringsToObj(result, 
-            "invalid longitude, should be ", NULL);
-        Tcl_AppendObjToObj(result, Tcl_NewDoubleObj(LON_MIN));
-        Tcl_AppendStringsToObj(result, 
-            " to ", NULL);
-        Tcl_AppendObjToObj(result, Tcl_NewDoubleObj(LON_MAX));
-        Tcl_AppendStringsToObj(result, 
-            " degrees: \"", NULL);
-        Tcl_AppendObjToObj(result, Tcl_NewDoubleObj(lon));
-        Tcl_AppendStringsToObj(result, 
-            "\"", NULL);
-
-        return TCL_ERROR;
+        if (fx->ncontrib[i] > 0.0 && fx->val[i] >= fx->athresh[i])
+        {
+            fx->ncontrib[i] = 0.0;
+        }
+        else if (fx->ncontrib[i] < 0.0 && fx->val[i] <= fx->dthresh[i])
+        {
+            fx->ncontrib[i] = 0.0;
+        }
     }
-
-    return TCL_OK;
 }
 
+/***********************************************************************
+ *
+ * FUNCTION:
+ *	gramChanges()
+ *
+ * INPUTS:
+ *	fx		Effects whose contributions have been computed
+ *
+ * OUTPUTS:
+ *	none
+ *
+ * RETURNS:
+ *	A new list {id nominal ncontrib ...}
+ *
+ * DESCRIPTION:
+ *	Lists the effects whose nominal contribution to date differs
+ *      from the loaded value, or whose ncontrib is non-zero.  The
+ *      others need only have their ncontribs zeroed.
+ */
 
+static Tcl_Obj*
+gramChanges(GramEffects* fx)
+{
+    Tcl_Obj* result = Tcl_NewListObj(0, NULL);
+    int      i;
 
+    for (i = 0; i < fx->size; i++)
+    {
+        if (fx->nominal[i] != fx->loaded[i] || fx->ncontrib[i] != 0.0)
+        {
+            Tcl_ListObjAppendElement(NULL, result, fx->ids[i]);
+            Tcl_ListObjAppendElement(NULL, result, 
+                                     Tcl_NewDoubleObj(fx->nominal[i]));
+            Tcl_ListObjAppendElement(NULL, result, 
+                                     Tcl_NewDoubleObj(fx->ncontrib[i]));
+        }
+    }
 
-
+    return result;
+}
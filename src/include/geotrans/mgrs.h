@@ -93,6 +93,30 @@
   #define MGRS_HEMISPHERE_ERROR        0x0200
 
 
+/***************************************************************************/
+/*
+ *                              TYPES
+ */
+
+  #include "utm.h"
+  #include "ups.h"
+
+/*
+ * The state of an MGRS conversion: the ellipsoid, and the UTM and UPS
+ * contexts prepared for it.  See tranmerc.h for the use of contexts.
+ */
+
+  typedef struct MGRS_Context
+  {
+    double      a;                   /* Semi-major axis of ellipsoid in meters */
+    double      f;                   /* Flattening of ellipsoid                */
+    double      recpf;               /* Reciprocal of flattening               */
+    char        Ellipsoid_Code[3];   /* 2-letter code for ellipsoid            */
+    UTM_Context utm;                 /* UTM, with no zone override             */
+    UPS_Context ups;                 /* UPS                                    */
+  } MGRS_Context;
+
+
 /***************************************************************************/
 /*
  *                              FUNCTION PROTOTYPES
@@ -243,6 +267,62 @@ extern "C" {
  *    Northing      : Northing/Y in meters             (output)
  */
 
+/*
+ * Convert_UPS_To_MGRS and Convert_MGRS_To_UPS do not depend on the
+ * ellipsoid parameters, and so have no context variants.
+ */
+
+
+  void Init_MGRS_Context(MGRS_Context *ctx);
+/*
+ * The function Init_MGRS_Context initializes a context to the default
+ * (WGS 84) ellipsoid parameters.  A context must be initialized before
+ * it is used.
+ *
+ *    ctx              : The context                              (output)
+ */
+
+
+  long Set_MGRS_Parameters_r(MGRS_Context *ctx,
+                             double a,
+                             double f,
+                             char   *Ellipsoid_Code);
+
+  void Get_MGRS_Parameters_r(const MGRS_Context *ctx,
+                             double *a,
+                             double *f,
+                             char   *Ellipsoid_Code);
+
+  long Convert_Geodetic_To_MGRS_r (const MGRS_Context *ctx,
+                                   double Latitude,
+                                   double Longitude,
+                                   long   Precision,
+                                   char *MGRS);
+
+  long Convert_MGRS_To_Geodetic_r (const MGRS_Context *ctx,
+                                   char *MGRS,
+                                   double *Latitude,
+                                   double *Longitude);
+
+  long Convert_UTM_To_MGRS_r (const MGRS_Context *ctx,
+                              long Zone,
+                              char Hemisphere,
+                              double Easting,
+                              double Northing,
+                              long Precision,
+                              char *MGRS);
+
+  long Convert_MGRS_To_UTM_r (const MGRS_Context *ctx,
+                              char   *MGRS,
+                              long   *Zone,
+                              char   *Hemisphere,
+                              double *Easting,
+                              double *Northing); 
+/*
+ * These are the same as the functions above, but use the given context
+ * rather than the default context.  The conversions do not modify the
+ * context, so a context may be shared by several threads once it is set.
+ */
 
 
   #ifdef __cplusplus
@@ -105,6 +105,37 @@
   #define POLAR_INV_F_ERROR             0x0080
   #define POLAR_RADIUS_ERROR            0x0100
 
+/**********************************************************************/
+/*
+ *                              TYPES
+ */
+
+/*
+ * The state of a Polar Stereographic projection: the ellipsoid and
+ * projection parameters, and the values precomputed from them.  See
+ * tranmerc.h for the use of contexts.
+ */
+
+  typedef struct Polar_Stereographic_Context
+  {
+    double a;                    /* Semi-major axis of ellipsoid in meters */
+    double f;                    /* Flattening of ellipsoid                */
+    double es;                   /* Eccentricity of ellipsoid              */
+    double es_OVER_2;            /* es / 2.0                               */
+    double Southern_Hemisphere;  /* Flag variable                          */
+    double mc;
+    double tc;
+    double e4;
+    double a_mc;                 /* a * mc                                 */
+    double two_a;                /* 2.0 * a                                */
+    double Origin_Lat;           /* Latitude of origin in radians          */
+    double Origin_Long;          /* Longitude of origin in radians         */
+    double False_Easting;        /* False easting in meters                */
+    double False_Northing;       /* False northing in meters               */
+    double Delta_Easting;        /* Maximum variance for easting and       */
+    double Delta_Northing;       /* northing values                        */
+  } Polar_Stereographic_Context;
+
 /**********************************************************************/
 /*
  *                        FUNCTION PROTOTYPES
@@ -192,6 +223,48 @@ extern "C" {
  *  Latitude         : Latitude, in radians                     (output)
  *  Longitude        : Longitude, in radians                    (output)
  *
+ */
+
+  void Init_Polar_Stereographic_Context (Polar_Stereographic_Context *ctx);
+/*
+ *  The function Init_Polar_Stereographic_Context initializes a context to
+ *  the default (WGS 84) ellipsoid and projection parameters.  A context
+ *  must be initialized before it is used.
+ *
+ *  ctx              : The context                                     (output)
+ */
+
+
+  long Set_Polar_Stereographic_Parameters_r (Polar_Stereographic_Context *ctx,
+                                             double a,
+                                             double f,
+                                             double Latitude_of_True_Scale,
+                                             double Longitude_Down_from_Pole,
+                                             double False_Easting,
+                                             double False_Northing);
+
+  void Get_Polar_Stereographic_Parameters_r (const Polar_Stereographic_Context *ctx,
+                                             double *a,
+                                             double *f,
+                                             double *Latitude_of_True_Scale,
+                                             double *Longitude_Down_from_Pole,
+                                             double *False_Easting,
+                                             double *False_Northing);
+
+  long Convert_Geodetic_To_Polar_Stereographic_r (const Polar_Stereographic_Context *ctx,
+                                                  double Latitude,
+                                                  double Longitude,
+                                                  double *Easting,
+                                                  double *Northing);
+
+  long Convert_Polar_Stereographic_To_Geodetic_r (const Polar_Stereographic_Context *ctx,
+                                                  double Easting,
+                                                  double Northing,
+                                                  double *Latitude,
+                                                  double *Longitude);
+/*
+ *  These are the same as the functions above, but use the given context
+ *  rather than the default context.
  */
 
   #ifdef __cplusplus
@@ -101,6 +101,43 @@
   #define TRANMERC_LON_WARNING        0x0200
 
 
+/***************************************************************************/
+/*
+ *                              TYPES
+ */
+
+/*
+ * The state of a Transverse Mercator projection: the ellipsoid and 
+ * projection parameters, and the values precomputed from them.  The
+ * functions ending in _r take a context explicitly, and so can be used
+ * from several threads at once, each with its own context, or with a
+ * shared context that is no longer being set.  The other functions use
+ * a single default context.
+ */
+
+  typedef struct Transverse_Mercator_Context
+  {
+    double a;               /* Semi-major axis of ellipsoid in meters     */
+    double f;               /* Flattening of ellipsoid                    */
+    double es;              /* Eccentricity squared                       */
+    double ebs;             /* Second eccentricity squared                */
+    double Origin_Lat;      /* Latitude of origin in radians              */
+    double Origin_Long;     /* Longitude of origin in radians             */
+    double False_Northing;  /* False northing in meters                   */
+    double False_Easting;   /* False easting in meters                    */
+    double Scale_Factor;    /* Scale factor                               */
+    double ap;              /* Isometric to geodetic latitude parameters  */
+    double bp;
+    double cp;
+    double dp;
+    double ep;
+    double Delta_Easting;   /* Maximum variance for easting and northing  */
+    double Delta_Northing;
+    int    Series_Valid;    /* Nonzero if ap..ep and the maximum variances */
+                            /* have been computed for a and f.            */
+  } Transverse_Mercator_Context;
+
+
 /***************************************************************************/
 /*
  *                              FUNCTION PROTOTYPES
@@ -202,6 +239,52 @@ extern "C" {
  */
 
 
+  void Init_Transverse_Mercator_Context(Transverse_Mercator_Context *ctx);
+/*
+ * The function Init_Transverse_Mercator_Context initializes a context
+ * to the default (WGS 84) ellipsoid and projection parameters.  A context
+ * must be initialized before it is used.
+ *
+ *    ctx               : The context                                (output)
+ */
+
+
+  long Set_Transverse_Mercator_Parameters_r(Transverse_Mercator_Context *ctx,
+                                            double a,      
+                                            double f,
+                                            double Origin_Latitude,
+                                            double Central_Meridian,
+                                            double False_Easting,
+                                            double False_Northing,
+                                            double Scale_Factor);
+
+  void Get_Transverse_Mercator_Parameters_r(const Transverse_Mercator_Context *ctx,
+                                            double *a,
+                                            double *f,
+                                            double *Origin_Latitude,
+                                            double *Central_Meridian,
+                                            double *False_Easting,
+                                            double *False_Northing,
+                                            double *Scale_Factor);
+
+  long Convert_Geodetic_To_Transverse_Mercator_r (const Transverse_Mercator_Context *ctx,
+                                                  double Latitude,
+                                                  double Longitude,
+                                                  double *Easting,
+                                                  double *Northing);
+
+  long Convert_Transverse_Mercator_To_Geodetic_r (const Transverse_Mercator_Context *ctx,
+                                                  double Easting,
+                                                  double Northing,
+                                                  double *Latitude,
+                                                  double *Longitude);
+/*
+ * These are the same as the functions above, but use the given context
+ * rather than the default context.  Setting the parameters recomputes
+ * the series coefficients only if the ellipsoid has changed.
+ */
+
+
   #ifdef __cplusplus
 }
   #endif
@@ -95,6 +95,29 @@
   #define UPS_INV_F_ERROR             0x0040
 
 
+/**********************************************************************/
+/*
+ *                        TYPES
+ */
+
+  #include "polarst.h"
+
+/*
+ * The state of a UPS conversion: the ellipsoid, and the Polar 
+ * Stereographic contexts for each hemisphere (index 0 is north, 1 is
+ * south), set up for the ellipsoid.  See tranmerc.h for the use of
+ * contexts.
+ */
+
+  typedef struct UPS_Context
+  {
+    double a;                                /* Semi-major axis in meters */
+    double f;                                /* Flattening of ellipsoid   */
+    Polar_Stereographic_Context Forward[2];  /* Geodetic to UPS           */
+    Polar_Stereographic_Context Inverse[2];  /* UPS to Geodetic           */
+  } UPS_Context;
+
+
 /**********************************************************************/
 /*
  *                        FUNCTION PROTOTYPES
@@ -166,6 +189,43 @@ extern "C" {
  *    Northing      : Northing/Y in meters                      (input)
  *    Latitude      : Latitude in radians                       (output)
  *    Longitude     : Longitude in radians                      (output)
+ */
+
+  void Init_UPS_Context( UPS_Context *ctx );
+/*
+ * The function Init_UPS_Context initializes a context to the default
+ * (WGS 84) ellipsoid parameters.  A context must be initialized before 
+ * it is used.
+ *
+ *   ctx   : The context                            (output)
+ */
+
+
+  long Set_UPS_Parameters_r( UPS_Context *ctx,
+                             double a,
+                             double f);
+
+  void Get_UPS_Parameters_r( const UPS_Context *ctx,
+                             double *a,
+                             double *f);
+
+  long Convert_Geodetic_To_UPS_r ( const UPS_Context *ctx,
+                                   double Latitude,
+                                   double Longitude,
+                                   char   *Hemisphere,
+                                   double *Easting,
+                                   double *Northing);
+
+  long Convert_UPS_To_Geodetic_r(const UPS_Context *ctx,
+                                 char   Hemisphere,
+                                 double Easting,
+                                 double Northing,
+                                 double *Latitude,
+                                 double *Longitude);
+/*
+ *  These are the same as the functions above, but use the given context
+ *  rather than the default context.  The conversions do not modify the
+ *  context.
  */
 
   #ifdef __cplusplus
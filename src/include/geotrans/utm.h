@@ -89,6 +89,28 @@
   #define UTM_INV_F_ERROR         0x0100
 
 
+/***************************************************************************/
+/*
+ *                              TYPES
+ */
+
+  #include "tranmerc.h"
+
+/*
+ * The state of a UTM conversion: the ellipsoid and zone override, and
+ * the Transverse Mercator context with the series coefficients for the
+ * ellipsoid.  See tranmerc.h for the use of contexts.
+ */
+
+  typedef struct UTM_Context
+  {
+    double a;                        /* Semi-major axis of ellipsoid in meters */
+    double f;                        /* Flattening of ellipsoid                */
+    long   Override;                 /* Zone override flag                     */
+    Transverse_Mercator_Context tm;  /* Precomputed for a and f                */
+  } UTM_Context;
+
+
 /***************************************************************************/
 /*
  *                              FUNCTION PROTOTYPES
@@ -169,6 +191,47 @@ extern "C" {
  *    Northing          : Northing (Y) in meters                 (input)
  *    Latitude          : Latitude in radians                    (output)
  *    Longitude         : Longitude in radians                   (output)
+ */
+
+  void Init_UTM_Context(UTM_Context *ctx);
+/*
+ * The function Init_UTM_Context initializes a context to the default
+ * (WGS 84) ellipsoid parameters, with no zone override.  A context must
+ * be initialized before it is used.
+ *
+ *    ctx               : The context                                   (output)
+ */
+
+
+  long Set_UTM_Parameters_r(UTM_Context *ctx,
+                            double a,      
+                            double f,
+                            long   override);
+
+  void Get_UTM_Parameters_r(const UTM_Context *ctx,
+                            double *a,
+                            double *f,
+                            long   *override);
+
+  long Convert_Geodetic_To_UTM_r (const UTM_Context *ctx,
+                                  double Latitude,
+                                  double Longitude,
+                                  long   *Zone,
+                                  char   *Hemisphere,
+                                  double *Easting,
+                                  double *Northing); 
+
+  long Convert_UTM_To_Geodetic_r(const UTM_Context *ctx,
+                                 long   Zone,
+                                 char   Hemisphere,
+                                 double Easting,
+                                 double Northing,
+                                 double *Latitude,
+                                 double *Longitude);
+/*
+ * These are the same as the functions above, but use the given context
+ * rather than the default context.  The conversions do not modify the
+ * context.
  */
 
   #ifdef __cplusplus
@@ -26,6 +26,18 @@
 #include "cpl_serv.h"
 #include "geo_tiffp.h"
 
+#include <sys/stat.h>
+
+#ifndef WIN32
+#  include <fcntl.h>
+#  include <unistd.h>
+#  include <sys/mman.h>
+#  define CSV_GETPID()  ((long) getpid())
+#else
+#  include <process.h>
+#  define CSV_GETPID()  ((long) _getpid())
+#endif
+
 /* ==================================================================== */
 /*      The CSVTable is a persistant set of info about an open CSV      */
 /*      table.  While it doesn't currently maintain a record index,     */
@@ -50,10 +62,149 @@ typedef struct ctb {
     char        **papszLines;
     int         *panLineIndex;
     char        *pszRawData;
+
+    /* Binary index on the first field, see CSVLoadIndex() */
+    int         bIndexTried;
+    char        *pabyCSVData;
+    size_t      nCSVDataSize;
+    int         bCSVDataMapped;
+    char        *pabyIndexData;
+    size_t      nIndexDataSize;
+    int         bIndexDataMapped;
+    const struct csvidxrec *pasIndex;
+    int         nIndexCount;
 } CSVTable;
 
+/* ==================================================================== */
+/*      A CSV index is a table's integer first field, and the offset    */
+/*      of its record in the file, for each record; sorted on the       */
+/*      key, and on the offset for equal keys, so that a binary         */
+/*      search finds the same record a scan from the top would.         */
+/*                                                                      */
+/*      By default each process builds the index in memory the first    */
+/*      time it needs it; nothing is written beside the tables, which   */
+/*      are usually installed read-only.  If GEOTIFF_CSV_INDEX names a  */
+/*      directory, the index is written there once as                   */
+/*      ``<table>.idx'', and after that the index and the table are     */
+/*      mapped read-only (read, on WIN32), so no process rebuilds it.   */
+/*      The header records the size and time of the table it was        */
+/*      built from; a stale or foreign index is rebuilt.                */
+/* ==================================================================== */
+#define CSV_INDEX_MAGIC         "CSVIDX1"
+#define CSV_INDEX_BYTE_ORDER    0x01020304
+
+typedef struct {
+    char         szMagic[8];
+    unsigned int nByteOrder;
+    unsigned int nRecordCount;
+    unsigned int nCSVSize;
+    unsigned int nCSVTime;
+} CSVIndexHeader;
+
+typedef struct csvidxrec {
+    int          nKey;
+    unsigned int nOffset;
+} CSVIndexRecord;
+
 static CSVTable *psCSVTableList = NULL;
 
+/************************************************************************/
+/*                            CSVMapFile()                              */
+/*                                                                      */
+/*      Map a whole file read-only, or where that can't be done,        */
+/*      read it into memory.  Returns NULL for a missing or empty       */
+/*      file.                                                           */
+/************************************************************************/
+
+static char *CSVMapFile( const char *pszFilename, size_t *pnSize,
+                         int *pbMapped )
+
+{
+    char        *pabyData;
+    FILE        *fp;
+    long        nFileLen;
+
+    *pnSize = 0;
+    *pbMapped = FALSE;
+
+#ifndef WIN32
+    {
+        struct stat sStat;
+        int         fd = open( pszFilename, O_RDONLY );
+
+        if( fd < 0 )
+            return NULL;
+
+        pabyData = NULL;
+        if( fstat( fd, &sStat ) == 0 && sStat.st_size > 0 )
+        {
+            pabyData = (char *) mmap( NULL, (size_t) sStat.st_size,
+                                      PROT_READ, MAP_SHARED, fd, 0 );
+            if( pabyData == (char *) MAP_FAILED )
+                pabyData = NULL;
+            else
+            {
+                *pnSize = (size_t) sStat.st_size;
+                *pbMapped = TRUE;
+            }
+        }
+
+        close( fd );
+
+        if( pabyData != NULL )
+            return pabyData;
+    }
+#endif
+
+    fp = VSIFOpen( pszFilename, "rb" );
+    if( fp == NULL )
+        return NULL;
+
+    VSIFSeek( fp, 0, SEEK_END );
+    nFileLen = VSIFTell( fp );
+    VSIRewind( fp );
+
+    if( nFileLen <= 0 )
+    {
+        VSIFClose( fp );
+        return NULL;
+    }
+
+    pabyData = (char *) CPLMalloc( nFileLen );
+    if( (long) VSIFRead( pabyData, 1, nFileLen, fp ) != nFileLen )
+    {
+        CPLFree( pabyData );
+        pabyData = NULL;
+    }
+    else
+        *pnSize = (size_t) nFileLen;
+
+    VSIFClose( fp );
+
+    return pabyData;
+}
+
+/************************************************************************/
+/*                           CSVUnmapFile()                             */
+/************************************************************************/
+
+static void CSVUnmapFile( char *pabyData, size_t nSize, int bMapped )
+
+{
+    if( pabyData == NULL )
+        return;
+
+#ifndef WIN32
+    if( bMapped )
+    {
+        munmap( pabyData, nSize );
+        return;
+    }
+#endif
+
+    CPLFree( pabyData );
+}
+
 /************************************************************************/
 /*                             CSVAccess()                              */
 /*                                                                      */
@@ -174,6 +325,11 @@ void CSVDeaccess( const char * pszFilename )
     CPLFree( psTable->pszRawData );
     CPLFree( psTable->papszLines );
 
+    CSVUnmapFile( psTable->pabyCSVData, psTable->nCSVDataSize,
+                  psTable->bCSVDataMapped );
+    CSVUnmapFile( psTable->pabyIndexData, psTable->nIndexDataSize,
+                  psTable->bIndexDataMapped );
+
     CPLFree( psTable );
 
     CPLReadLine( NULL );
@@ -635,6 +791,370 @@ CSVScanLinesIngested( CSVTable *psTable, int iKeyField, const char * pszValue,
     return( papszFields );
 }
 
+/************************************************************************/
+/*                          CSVIndexLineEnd()                           */
+/*                                                                      */
+/*      Return the offset of the end of the line starting at           */
+/*      nOffset in a mapped table, by the rules of CSVFindNextLine().   */
+/************************************************************************/
+
+static size_t CSVIndexLineEnd( const char *pabyData, size_t nSize,
+                               size_t nOffset )
+
+{
+    size_t      i;
+    int         nQuoteCount = 0;
+
+    for( i = nOffset; i < nSize && pabyData[i] != '\0'; i++ )
+    {
+        if( pabyData[i] == '\"'
+            && (i == nOffset || pabyData[i-1] != '\\') )
+            nQuoteCount++;
+
+        if( (pabyData[i] == 10 || pabyData[i] == 13)
+            && (nQuoteCount % 2) == 0 )
+            break;
+    }
+
+    return i;
+}
+
+/************************************************************************/
+/*                            CSVIndexKey()                             */
+/*                                                                      */
+/*      Return the integer value of the first field of a line, as       */
+/*      atoi() of the field CSVSplitLine() would return.                */
+/************************************************************************/
+
+static int CSVIndexKey( const char *pszLine, size_t nLength )
+
+{
+    char        szField[32];
+    size_t      i;
+    int         nField = 0, bInString = FALSE;
+
+    for( i = 0; i < nLength && nField < (int) sizeof(szField) - 1; i++ )
+    {
+        if( !bInString && pszLine[i] == ',' )
+            break;
+
+        if( pszLine[i] == '"' )
+        {
+            if( !bInString || i+1 >= nLength || pszLine[i+1] != '"' )
+            {
+                bInString = !bInString;
+                continue;
+            }
+            i++;
+        }
+
+        szField[nField++] = pszLine[i];
+    }
+
+    szField[nField] = '\0';
+
+    return atoi( szField );
+}
+
+/************************************************************************/
+/*                       CSVCompareIndexRecords()                       */
+/************************************************************************/
+
+static int CSVCompareIndexRecords( const void *pA, const void *pB )
+
+{
+    const CSVIndexRecord *psA = (const CSVIndexRecord *) pA;
+    const CSVIndexRecord *psB = (const CSVIndexRecord *) pB;
+
+    if( psA->nKey != psB->nKey )
+        return psA->nKey < psB->nKey ? -1 : 1;
+
+    if( psA->nOffset != psB->nOffset )
+        return psA->nOffset < psB->nOffset ? -1 : 1;
+
+    return 0;
+}
+
+/************************************************************************/
+/*                           CSVBuildIndex()                            */
+/*                                                                      */
+/*      Build the index of a mapped table, header and all, in a         */
+/*      newly allocated buffer.                                         */
+/************************************************************************/
+
+static char *CSVBuildIndex( const char *pabyData, size_t nSize,
+                            const struct stat *psStat, size_t *pnIndexSize )
+
+{
+    CSVIndexHeader      *psHeader;
+    CSVIndexRecord      *pasRecords;
+    char                *pabyIndex;
+    size_t              i, nOffset, nMaxCount = 1;
+    unsigned int        nCount = 0;
+
+/* -------------------------------------------------------------------- */
+/*      Allocate for the most records the table could hold.             */
+/* -------------------------------------------------------------------- */
+    for( i = 0; i < nSize; i++ )
+    {
+        if( pabyData[i] == 10 || pabyData[i] == 13 )
+            nMaxCount++;
+    }
+
+    pabyIndex = (char *)
+        CPLMalloc( sizeof(CSVIndexHeader) + nMaxCount*sizeof(CSVIndexRecord) );
+    psHeader = (CSVIndexHeader *) pabyIndex;
+    pasRecords = (CSVIndexRecord *) (pabyIndex + sizeof(CSVIndexHeader));
+
+/* -------------------------------------------------------------------- */
+/*      Record the key and offset of each line after the header.        */
+/* -------------------------------------------------------------------- */
+    nOffset = CSVIndexLineEnd( pabyData, nSize, 0 );
+
+    while( TRUE )
+    {
+        size_t  nEnd;
+
+        while( nOffset < nSize
+               && (pabyData[nOffset] == 10 || pabyData[nOffset] == 13) )
+            nOffset++;
+
+        if( nOffset >= nSize || pabyData[nOffset] == '\0' )
+            break;
+
+        nEnd = CSVIndexLineEnd( pabyData, nSize, nOffset );
+
+        pasRecords[nCount].nKey =
+            CSVIndexKey( pabyData + nOffset, nEnd - nOffset );
+        pasRecords[nCount].nOffset = (unsigned int) nOffset;
+        nCount++;
+
+        nOffset = nEnd;
+    }
+
+    qsort( pasRecords, nCount, sizeof(CSVIndexRecord),
+           CSVCompareIndexRecords );
+
+    memset( psHeader, 0, sizeof(CSVIndexHeader) );
+    strcpy( psHeader->szMagic, CSV_INDEX_MAGIC );
+    psHeader->nByteOrder = CSV_INDEX_BYTE_ORDER;
+    psHeader->nRecordCount = nCount;
+    psHeader->nCSVSize = (unsigned int) psStat->st_size;
+    psHeader->nCSVTime = (unsigned int) psStat->st_mtime;
+
+    *pnIndexSize = sizeof(CSVIndexHeader) + nCount*sizeof(CSVIndexRecord);
+
+    return pabyIndex;
+}
+
+/************************************************************************/
+/*                          CSVIndexFilename()                          */
+/*                                                                      */
+/*      Put the path of the index of a table in pszPath, a buffer of    */
+/*      nPathSize bytes.  Returns FALSE if no index directory is        */
+/*      configured, or the path doesn't fit.                            */
+/************************************************************************/
+
+static int CSVIndexFilename( const char *pszFilename,
+                             char *pszPath, size_t nPathSize )
+
+{
+    const char  *pszDir = getenv( "GEOTIFF_CSV_INDEX" );
+    const char  *pszBasename = pszFilename;
+    const char  *psz;
+
+    if( pszDir == NULL || *pszDir == '\0' )
+        return FALSE;
+
+    for( psz = pszFilename; *psz != '\0'; psz++ )
+    {
+        if( *psz == '/' || *psz == '\\' )
+            pszBasename = psz + 1;
+    }
+
+    if( strlen(pszDir) + strlen(pszBasename) + 6 > nPathSize )
+        return FALSE;
+
+    sprintf( pszPath, "%s/%s.idx", pszDir, pszBasename );
+    return TRUE;
+}
+
+/************************************************************************/
+/*                           CSVLoadIndex()                             */
+/*                                                                      */
+/*      Map a table and its index.  If an index directory is            */
+/*      configured, the index is read from it, and written there        */
+/*      first if it is missing or stale; otherwise, or if it can't be   */
+/*      written, the index is built in memory for this process.         */
+/*      Returns TRUE if the table can be searched with CSVScanIndex().  */
+/************************************************************************/
+
+static int CSVLoadIndex( CSVTable *psTable )
+
+{
+    struct stat         sStat;
+    char                szIndexFile[1024];
+    int                 bIndexFile;
+    CSVIndexHeader      *psHeader;
+
+    if( psTable->bIndexTried )
+        return psTable->pasIndex != NULL;
+
+    psTable->bIndexTried = TRUE;
+
+/* -------------------------------------------------------------------- */
+/*      Map the table itself.                                           */
+/* -------------------------------------------------------------------- */
+    if( stat( psTable->pszFilename, &sStat ) != 0
+        || (double) sStat.st_size >= 4294967295.0 )
+        return FALSE;
+
+    psTable->pabyCSVData = CSVMapFile( psTable->pszFilename,
+                                       &psTable->nCSVDataSize,
+                                       &psTable->bCSVDataMapped );
+    if( psTable->pabyCSVData == NULL
+        || psTable->nCSVDataSize != (size_t) sStat.st_size )
+        return FALSE;
+
+/* -------------------------------------------------------------------- */
+/*      Is there an index for this version of the table?                */
+/* -------------------------------------------------------------------- */
+    bIndexFile = CSVIndexFilename( psTable->pszFilename,
+                                   szIndexFile, sizeof(szIndexFile) );
+
+    if( bIndexFile )
+    {
+        psTable->pabyIndexData = CSVMapFile( szIndexFile,
+                                             &psTable->nIndexDataSize,
+                                             &psTable->bIndexDataMapped );
+        psHeader = (CSVIndexHeader *) psTable->pabyIndexData;
+
+        if( psHeader != NULL
+            && psTable->nIndexDataSize >= sizeof(CSVIndexHeader)
+            && strcmp( psHeader->szMagic, CSV_INDEX_MAGIC ) == 0
+            && psHeader->nByteOrder == CSV_INDEX_BYTE_ORDER
+            && psHeader->nCSVSize == (unsigned int) sStat.st_size
+            && psHeader->nCSVTime == (unsigned int) sStat.st_mtime
+            && psTable->nIndexDataSize == sizeof(CSVIndexHeader)
+                + psHeader->nRecordCount*sizeof(CSVIndexRecord) )
+        {
+            psTable->pasIndex = (CSVIndexRecord *)
+                (psTable->pabyIndexData + sizeof(CSVIndexHeader));
+            psTable->nIndexCount = (int) psHeader->nRecordCount;
+
+            return TRUE;
+        }
+
+        CSVUnmapFile( psTable->pabyIndexData, psTable->nIndexDataSize,
+                      psTable->bIndexDataMapped );
+        psTable->pabyIndexData = NULL;
+    }
+
+/* -------------------------------------------------------------------- */
+/*      No, so build one, and save it for the next process if there's   */
+/*      somewhere to put it.  It is written under a temporary name      */
+/*      and renamed into place, so that no reader ever sees part of     */
+/*      an index.                                                       */
+/* -------------------------------------------------------------------- */
+    psTable->pabyIndexData = CSVBuildIndex( psTable->pabyCSVData,
+                                            psTable->nCSVDataSize, &sStat,
+                                            &psTable->nIndexDataSize );
+    psTable->bIndexDataMapped = FALSE;
+    psHeader = (CSVIndexHeader *) psTable->pabyIndexData;
+
+    psTable->pasIndex = (CSVIndexRecord *)
+        (psTable->pabyIndexData + sizeof(CSVIndexHeader));
+    psTable->nIndexCount = (int) psHeader->nRecordCount;
+
+    if( bIndexFile )
+    {
+        char    *pszTempFile;
+        FILE    *fp;
+        int     bWritten = FALSE;
+
+        pszTempFile = (char *) CPLMalloc( strlen(szIndexFile) + 32 );
+        sprintf( pszTempFile, "%s.%ld", szIndexFile, CSV_GETPID() );
+
+        fp = VSIFOpen( pszTempFile, "wb" );
+        if( fp != NULL )
+        {
+            bWritten = fwrite( psTable->pabyIndexData, 1,
+                               psTable->nIndexDataSize, fp )
+                == psTable->nIndexDataSize;
+            bWritten = (VSIFClose( fp ) == 0) && bWritten;
+        }
+
+        if( bWritten && rename( pszTempFile, szIndexFile ) != 0 )
+        {
+#ifdef WIN32
+            /* rename() won't replace a stale index on WIN32. */
+            remove( szIndexFile );
+            bWritten = (rename( pszTempFile, szIndexFile ) == 0);
+#else
+            bWritten = FALSE;
+#endif
+        }
+
+        if( !bWritten )
+            remove( pszTempFile );
+
+        CPLFree( pszTempFile );
+    }
+
+    return TRUE;
+}
+
+/************************************************************************/
+/*                            CSVScanIndex()                            */
+/*                                                                      */
+/*      Find the first record whose first field is nKeyValue with a     */
+/*      binary search of the index, and return it split into fields.    */
+/************************************************************************/
+
+static char **CSVScanIndex( CSVTable *psTable, int nKeyValue )
+
+{
+    int         iTop, iBottom, iMiddle;
+    size_t      nOffset, nEnd;
+    char        *pszLine, **papszFields;
+
+/* -------------------------------------------------------------------- */
+/*      Find the first record with the key.                             */
+/* -------------------------------------------------------------------- */
+    iBottom = 0;
+    iTop = psTable->nIndexCount;
+
+    while( iBottom < iTop )
+    {
+        iMiddle = iBottom + (iTop - iBottom) / 2;
+        if( psTable->pasIndex[iMiddle].nKey < nKeyValue )
+            iBottom = iMiddle + 1;
+        else
+            iTop = iMiddle;
+    }
+
+    if( iBottom == psTable->nIndexCount
+        || psTable->pasIndex[iBottom].nKey != nKeyValue )
+        return NULL;
+
+/* -------------------------------------------------------------------- */
+/*      Copy out the line, and split it.                                */
+/* -------------------------------------------------------------------- */
+    nOffset = psTable->pasIndex[iBottom].nOffset;
+    nEnd = CSVIndexLineEnd( psTable->pabyCSVData, psTable->nCSVDataSize,
+                            nOffset );
+
+    pszLine = (char *) CPLMalloc( nEnd - nOffset + 1 );
+    memcpy( pszLine, psTable->pabyCSVData + nOffset, nEnd - nOffset );
+    pszLine[nEnd - nOffset] = '\0';
+
+    papszFields = CSVSplitLine( pszLine );
+
+    CPLFree( pszLine );
+
+    return papszFields;
+}
+
 /************************************************************************/
 /*                            CSVScanFile()                             */
 /*                                                                      */
@@ -659,8 +1179,6 @@ char **CSVScanFile( const char * pszFilename, int iKeyField,
     psTable = gtCSVAccess( pszFilename );
     if( psTable == NULL )
         return NULL;
-    
-    CSVIngest( pszFilename );
 
 /* -------------------------------------------------------------------- */
 /*      Does the current record match the criteria?  If so, just        */
@@ -673,6 +1191,22 @@ char **CSVScanFile( const char * pszFilename, int iKeyField,
         return psTable->papszRecFields;
     }
 
+/* -------------------------------------------------------------------- */
+/*      Code lookups, which are nearly all of them, go through the      */
+/*      binary index.                                                   */
+/* -------------------------------------------------------------------- */
+    if( iKeyField == 0 && eCriteria == CC_Integer
+        && CSVLoadIndex( psTable ) )
+    {
+        CSLDestroy( psTable->papszRecFields );
+        psTable->papszRecFields =
+            CSVScanIndex( psTable, atoi(pszValue) );
+
+        return( psTable->papszRecFields );
+    }
+
+    CSVIngest( pszFilename );
+
 /* -------------------------------------------------------------------- */
 /*      Scan the file from the beginning, replacing the ``current       */
 /*      record'' in our structure with the one that is found.           */
@@ -1957,6 +1957,15 @@ SetCSVFilenameHook() function to
 override the search method based on application knowledge of where they are
 found.<p>
 
+Lookups by EPSG code go through a binary index of each table.  By
+default the index is built in memory, once per process, and nothing is
+written beside the tables.  If the GEOTIFF_CSV_INDEX environment variable
+names a directory, the index is written there as <tt>pcs.csv.idx</tt> and
+so on the first time the table is used; later processes map the index and
+the table read-only, so they are shared by every process reading GeoTIFF
+files.  An index is rebuilt whenever its table changes, and is simply
+built in memory if it can't be written.<p>
+
 The normalization methodology operates by fetching tags from the GeoTIFF
 file, and then setting all other tags implied by them in the structure.  The
 implied relationships are worked out by reading definitions from the 
@@ -0,0 +1,157 @@
+/*! \file geoBench.c
+    \brief  Micro-benchmark for the batch coordinate conversions done by
+    latlong togcc/fromgcc -list in libMarsutil: geoLlh2EfgOpt() and
+    geoEfg2LlhOpt() over an array of points, single-threaded and
+    split across a number of threads as the -list commands do.
+
+    Build with "make bench"; run as
+
+        geoBench ?npoints? ?nthreads?
+
+    npoints defaults to 1000000 and nthreads to 4.  The output is the
+    rate in points/sec for each conversion and thread count.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include "geoStars.h"
+
+#define MAX_THREADS 16
+
+typedef struct BenchRange {
+    EllipsoidData *eld;
+    int            first;
+    int            last;
+    double        *ll;     /* lat/lon pairs in radians */
+    double        *efg;    /* E/F/G triples in meters */
+} BenchRange;
+
+static double now(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+
+    return tv.tv_sec + tv.tv_usec/1.0e6;
+}
+
+static void *toEfg(void *arg)
+{
+    BenchRange *r = (BenchRange *)arg;
+    int i;
+
+    for (i = r->first; i < r->last; i++)
+    {
+        geoLlh2EfgOpt(r->ll[2*i], r->ll[2*i+1], 0.0, r->eld,
+                      &r->efg[3*i+GEO_E], &r->efg[3*i+GEO_F],
+                      &r->efg[3*i+GEO_G]);
+    }
+
+    return NULL;
+}
+
+static void *fromEfg(void *arg)
+{
+    BenchRange *r = (BenchRange *)arg;
+    double hgt;
+    int i;
+
+    for (i = r->first; i < r->last; i++)
+    {
+        geoEfg2LlhOpt(r->eld, &r->efg[3*i], &r->ll[2*i], &r->ll[2*i+1],
+                      &hgt);
+    }
+
+    return NULL;
+}
+
+/* Runs proc over n points split across nthreads threads, the first
+ * range on this thread; returns the elapsed seconds. */
+
+static double run(void *(*proc)(void *), EllipsoidData *eld, int n,
+                  int nthreads, double *ll, double *efg)
+{
+    BenchRange ranges[MAX_THREADS];
+    pthread_t  ids[MAX_THREADS];
+    double     start;
+    int        t;
+
+    for (t = 0; t < nthreads; t++)
+    {
+        ranges[t].eld   = eld;
+        ranges[t].first = (int)((long)n*t/nthreads);
+        ranges[t].last  = (int)((long)n*(t+1)/nthreads);
+        ranges[t].ll    = ll;
+        ranges[t].efg   = efg;
+    }
+
+    start = now();
+
+    for (t = 1; t < nthreads; t++)
+    {
+        pthread_create(&ids[t], NULL, proc, &ranges[t]);
+    }
+
+    proc(&ranges[0]);
+
+    for (t = 1; t < nthreads; t++)
+    {
+        pthread_join(ids[t], NULL);
+    }
+
+    return now() - start;
+}
+
+int main(int argc, char *argv[])
+{
+    EllipsoidData eld;
+    double *ll, *efg;
+    int n        = (argc > 1) ? atoi(argv[1]) : 1000000;
+    int nthreads = (argc > 2) ? atoi(argv[2]) : 4;
+    int threads[2];
+    int i, k;
+
+    if (n < 1 || nthreads < 1 || nthreads > MAX_THREADS)
+    {
+        fprintf(stderr, "usage: geoBench ?npoints? ?nthreads 1-%d?\n",
+                MAX_THREADS);
+        return 1;
+    }
+
+    geoGetEllipsoid(&eld.a, &eld.b, &eld.e2, &eld.ee2, &eld.flat,
+                    GEO_DATUM_DEFAULT);
+
+    ll  = (double *)malloc(2 * n * sizeof(double));
+    efg = (double *)malloc(3 * n * sizeof(double));
+
+    srand(1);
+
+    for (i = 0; i < n; i++)
+    {
+        ll[2*i]   = (rand()/(double)RAND_MAX*180.0 - 90.0) * DEG_TO_RAD;
+        ll[2*i+1] = (rand()/(double)RAND_MAX*360.0 - 180.0) * DEG_TO_RAD;
+    }
+
+    threads[0] = 1;
+    threads[1] = nthreads;
+
+    printf("%d points\n", n);
+
+    for (k = 0; k < (nthreads > 1 ? 2 : 1); k++)
+    {
+        double t1 = run(toEfg,   &eld, n, threads[k], ll, efg);
+        double t2 = run(fromEfg, &eld, n, threads[k], ll, efg);
+
+        printf("%2d thread(s): togcc %12.0f points/sec  "
+               "fromgcc %12.0f points/sec\n",
+               threads[k], n/t1, n/t2);
+    }
+
+    free(ll);
+    free(efg);
+
+    return 0;
+}
@@ -148,11 +148,20 @@
 #define MAX_EAST_NORTH 4000000
 
 
-/* Ellipsoid parameters, default to WGS 84 */
-double MGRS_a = 6378137.0;    /* Semi-major axis of ellipsoid in meters */
-double MGRS_f = 1 / 298.257223563; /* Flattening of ellipsoid           */
-double MGRS_recpf = 298.257223563;
-char   MGRS_Ellipsoid_Code[3] = {'W','E',0};
+/* The context used by the functions that don't take one; it is
+ * initialized to WGS 84 on first use. */
+static MGRS_Context MGRS_Default;
+static int          MGRS_Initialized = 0;
+
+static MGRS_Context *Default_MGRS_Context(void)
+{
+  if (!MGRS_Initialized)
+  {
+    Init_MGRS_Context(&MGRS_Default);
+    MGRS_Initialized = 1;
+  }
+  return &MGRS_Default;
+}
 
 
 /* 
@@ -515,7 +524,8 @@ long Break_MGRS_String (char* MGRS,
 } /* Break_MGRS_String */
 
 
-void Get_Grid_Values (long zone, 
+void Get_Grid_Values (const MGRS_Context *ctx,
+                      long zone, 
                       long* ltr2_low_value, 
                       long* ltr2_high_value, 
                       double *false_northing)
@@ -526,6 +536,7 @@ void Get_Grid_Values (long zone,
  * value of A for the second letter of the grid square, based on 
  * the grid pattern and set number of the utm zone.
  *
+ *    ctx             : The context             (input)
  *    zone            : Zone number             (input)
  *    ltr2_low_value  : 2nd letter low number   (output)
  *    ltr2_high_value : 2nd letter high number  (output)
@@ -540,8 +551,8 @@ void Get_Grid_Values (long zone,
   if (!set_number)
     set_number = 6;
 
-  if (!strcmp(MGRS_Ellipsoid_Code,CLARKE_1866) || !strcmp(MGRS_Ellipsoid_Code, CLARKE_1880) || 
-      !strcmp(MGRS_Ellipsoid_Code,BESSEL_1841) || !strcmp(MGRS_Ellipsoid_Code,BESSEL_1841_NAMIBIA))
+  if (!strcmp(ctx->Ellipsoid_Code,CLARKE_1866) || !strcmp(ctx->Ellipsoid_Code, CLARKE_1880) || 
+      !strcmp(ctx->Ellipsoid_Code,BESSEL_1841) || !strcmp(ctx->Ellipsoid_Code,BESSEL_1841_NAMIBIA))
     aa_pattern = FALSE;
   else
     aa_pattern = TRUE;
@@ -580,7 +591,8 @@ void Get_Grid_Values (long zone,
 } /* END OF Get_Grid_Values */
 
 
-long UTM_To_MGRS (long Zone,
+long UTM_To_MGRS (const MGRS_Context *ctx,
+                  long Zone,
                   double Latitude,
                   double Easting,
                   double Northing,
@@ -590,6 +602,7 @@ long UTM_To_MGRS (long Zone,
  * The function UTM_To_MGRS calculates an MGRS coordinate string
  * based on the zone, latitude, easting and northing.
  *
+ *    ctx       : The context             (input)
  *    Zone      : Zone number             (input)
  *    Latitude  : Latitude in radians     (input)
  *    Easting   : Easting                 (input)
@@ -612,7 +625,7 @@ long UTM_To_MGRS (long Zone,
 	Easting = Round_MGRS (Easting/divisor) * divisor;
 	Northing = Round_MGRS (Northing/divisor) * divisor;
 
-  Get_Grid_Values(Zone, &ltr2_low_value, &ltr2_high_value, &false_northing);
+  Get_Grid_Values(ctx, Zone, &ltr2_low_value, &ltr2_high_value, &false_northing);
 
   error_code = Get_Latitude_Letter(Latitude, &letters[0]);
    
@@ -652,14 +665,33 @@ long UTM_To_MGRS (long Zone,
 } /* END UTM_To_MGRS */
 
 
-long Set_MGRS_Parameters (double a,
-                          double f,
-                          char   *Ellipsoid_Code)
+void Init_MGRS_Context (MGRS_Context *ctx)
 /*
- * The function SET_MGRS_PARAMETERS receives the ellipsoid parameters and sets
- * the corresponding state variables. If any errors occur, the error code(s)
- * are returned by the function, otherwise MGRS_NO_ERROR is returned.
+ * The function Init_MGRS_Context initializes a context to the default
+ * (WGS 84) ellipsoid parameters.
+ *
+ *   ctx              : The context                             (output)
+ */
+{ /* Init_MGRS_Context */
+  char code[3] = {'W','E',0};
+
+  Set_MGRS_Parameters_r (ctx, 6378137.0, 1 / 298.257223563, code);
+} /* Init_MGRS_Context */
+
+
+long Set_MGRS_Parameters_r (MGRS_Context *ctx,
+                            double a,
+                            double f,
+                            char   *Ellipsoid_Code)
+/*
+ * The function Set_MGRS_Parameters_r receives the ellipsoid parameters and
+ * sets the corresponding variables in the context, including the UTM and
+ * UPS contexts for the ellipsoid.  This is where the projection series
+ * coefficients are computed; conversions reuse them.  If any errors occur,
+ * the error code(s) are returned by the function, otherwise MGRS_NO_ERROR
+ * is returned.
  *
+ *   ctx              : The context                             (input/output)
  *   a                : Semi-major axis of ellipsoid in meters  (input)
  *   f                : Flattening of ellipsoid					        (input)
  *   Ellipsoid_Code   : 2-letter code for ellipsoid             (input)
@@ -679,44 +711,51 @@ long Set_MGRS_Parameters (double a,
   }
   if (!Error_Code)
   { /* no errors */
-    MGRS_a = a;
-    MGRS_f = f;
-    MGRS_recpf = inv_f;
-    strcpy (MGRS_Ellipsoid_Code, Ellipsoid_Code);
+    ctx->a = a;
+    ctx->f = f;
+    ctx->recpf = inv_f;
+    strncpy (ctx->Ellipsoid_Code, Ellipsoid_Code, 2);
+    ctx->Ellipsoid_Code[2] = 0;
+    Set_UTM_Parameters_r (&ctx->utm, a, f, 0);
+    Set_UPS_Parameters_r (&ctx->ups, a, f);
   }
   return (Error_Code);
-}  /* Set_MGRS_Parameters  */
+}  /* Set_MGRS_Parameters_r  */
 
 
-void Get_MGRS_Parameters (double *a,
-                          double *f,
-                          char* Ellipsoid_Code)
+void Get_MGRS_Parameters_r (const MGRS_Context *ctx,
+                            double *a,
+                            double *f,
+                            char* Ellipsoid_Code)
 /*
- * The function Get_MGRS_Parameters returns the current ellipsoid
+ * The function Get_MGRS_Parameters_r returns the context's ellipsoid
  * parameters.
  *
+ *  ctx              : The context                             (input)
  *  a                : Semi-major axis of ellipsoid, in meters (output)
  *  f                : Flattening of ellipsoid					       (output)
  *  Ellipsoid_Code   : 2-letter code for ellipsoid             (output)
  */
 { /* Get_MGRS_Parameters */
-  *a = MGRS_a;
-  *f = MGRS_f;
-  strcpy (Ellipsoid_Code, MGRS_Ellipsoid_Code);
+  *a = ctx->a;
+  *f = ctx->f;
+  strcpy (Ellipsoid_Code, ctx->Ellipsoid_Code);
   return;
-} /* Get_MGRS_Parameters */
+} /* Get_MGRS_Parameters_r */
 
 
-long Convert_Geodetic_To_MGRS (double Latitude,
-                               double Longitude,
-                               long Precision,
-                               char* MGRS)
+long Convert_Geodetic_To_MGRS_r (const MGRS_Context *ctx,
+                                 double Latitude,
+                                 double Longitude,
+                                 long Precision,
+                                 char* MGRS)
 /*
- * The function Convert_Geodetic_To_MGRS converts Geodetic (latitude and
+ * The function Convert_Geodetic_To_MGRS_r converts Geodetic (latitude and
  * longitude) coordinates to an MGRS coordinate string, according to the 
- * current ellipsoid parameters.  If any errors occur, the error code(s) 
+ * context's ellipsoid parameters.  If any errors occur, the error code(s) 
  * are returned by the function, otherwise MGRS_NO_ERROR is returned.
  *
+ *    ctx        : The context                      (input)
  *    Latitude   : Latitude in radians              (input)
  *    Longitude  : Longitude in radians             (input)
  *    Precision  : Precision level of MGRS string   (input)
@@ -744,31 +783,31 @@ long Convert_Geodetic_To_MGRS (double Latitude,
   {
     if ((Latitude < MIN_UTM_LAT) || (Latitude > MAX_UTM_LAT))
     {
-      Set_UPS_Parameters (MGRS_a, MGRS_f);
-      error_code |= Convert_Geodetic_To_UPS (Latitude, Longitude, &hemisphere, &easting, &northing);
+      error_code |= Convert_Geodetic_To_UPS_r (&ctx->ups, Latitude, Longitude, &hemisphere, &easting, &northing);
       error_code |= Convert_UPS_To_MGRS (hemisphere, easting, northing, Precision, MGRS);
     }
     else
     {
-      Set_UTM_Parameters (MGRS_a, MGRS_f, 0);
-      error_code |= Convert_Geodetic_To_UTM (Latitude, Longitude, &zone, &hemisphere, &easting, &northing);
-      error_code |= UTM_To_MGRS (zone, Latitude, easting, northing, Precision, MGRS);
+      error_code |= Convert_Geodetic_To_UTM_r (&ctx->utm, Latitude, Longitude, &zone, &hemisphere, &easting, &northing);
+      error_code |= UTM_To_MGRS (ctx, zone, Latitude, easting, northing, Precision, MGRS);
     }
   }
   return (error_code);
-} /* Convert_Geodetic_To_MGRS */
+} /* Convert_Geodetic_To_MGRS_r */
 
 
-long Convert_MGRS_To_Geodetic (char* MGRS, 
-                               double *Latitude, 
-                               double *Longitude)
+long Convert_MGRS_To_Geodetic_r (const MGRS_Context *ctx,
+                                 char* MGRS, 
+                                 double *Latitude, 
+                                 double *Longitude)
 /*
- * The function Convert_MGRS_To_Geodetic converts an MGRS coordinate string
+ * The function Convert_MGRS_To_Geodetic_r converts an MGRS coordinate string
  * to Geodetic (latitude and longitude) coordinates 
- * according to the current ellipsoid parameters.  If any errors occur, 
+ * according to the context's ellipsoid parameters.  If any errors occur, 
  * the error code(s) are returned by the function, otherwise UTM_NO_ERROR 
  * is returned.
  *
+ *    ctx        : The context                      (input)
  *    MGRS       : MGRS coordinate string           (input)
  *    Latitude   : Latitude in radians              (output)
  *    Longitude  : Longitude in radians             (output)
@@ -787,33 +826,33 @@ long Convert_MGRS_To_Geodetic (char* MGRS,
   {
     if (zone_exists)
     {
-      error_code |= Convert_MGRS_To_UTM (MGRS, &zone, &hemisphere, &easting, &northing);
-      Set_UTM_Parameters (MGRS_a, MGRS_f, 0);
-      error_code |= Convert_UTM_To_Geodetic (zone, hemisphere, easting, northing, Latitude, Longitude);
+      error_code |= Convert_MGRS_To_UTM_r (ctx, MGRS, &zone, &hemisphere, &easting, &northing);
+      error_code |= Convert_UTM_To_Geodetic_r (&ctx->utm, zone, hemisphere, easting, northing, Latitude, Longitude);
     }
     else
     {
       error_code |= Convert_MGRS_To_UPS (MGRS, &hemisphere, &easting, &northing);
-      Set_UPS_Parameters (MGRS_a, MGRS_f);
-      error_code |= Convert_UPS_To_Geodetic (hemisphere, easting, northing, Latitude, Longitude);
+      error_code |= Convert_UPS_To_Geodetic_r (&ctx->ups, hemisphere, easting, northing, Latitude, Longitude);
     }
   }
   return (error_code);
-} /* END OF Convert_MGRS_To_Geodetic */
+} /* END OF Convert_MGRS_To_Geodetic_r */
 
 
-long Convert_UTM_To_MGRS (long Zone,
-                          char Hemisphere,
-                          double Easting,
-                          double Northing,
-                          long Precision,
-                          char* MGRS)
+long Convert_UTM_To_MGRS_r (const MGRS_Context *ctx,
+                            long Zone,
+                            char Hemisphere,
+                            double Easting,
+                            double Northing,
+                            long Precision,
+                            char* MGRS)
 /*
- * The function Convert_UTM_To_MGRS converts UTM (zone, easting, and
+ * The function Convert_UTM_To_MGRS_r converts UTM (zone, easting, and
  * northing) coordinates to an MGRS coordinate string, according to the 
- * current ellipsoid parameters.  If any errors occur, the error code(s) 
+ * context's ellipsoid parameters.  If any errors occur, the error code(s) 
  * are returned by the function, otherwise MGRS_NO_ERROR is returned.
  *
+ *    ctx        : The context                      (input)
  *    Zone       : UTM zone                         (input)
  *    Hemisphere : North or South hemisphere        (input)
  *    Easting    : Easting (X) in meters            (input)
@@ -824,6 +863,7 @@ long Convert_UTM_To_MGRS (long Zone,
 { /* Convert_UTM_To_MGRS */
   double latitude;           /* Latitude of UTM point */
   double longitude;          /* Longitude of UTM point */
+  UTM_Context utm32;         /* UTM with zone override 32 */
   long temp_error = MGRS_NO_ERROR;
   long error_code = MGRS_NO_ERROR;
 
@@ -839,35 +879,37 @@ long Convert_UTM_To_MGRS (long Zone,
     error_code |= MGRS_PRECISION_ERROR;
   if (!error_code)
   {
-    Set_UTM_Parameters (MGRS_a, MGRS_f, 0);
-    temp_error = Convert_UTM_To_Geodetic (Zone, Hemisphere, Easting, Northing, &latitude, &longitude);
+    temp_error = Convert_UTM_To_Geodetic_r (&ctx->utm, Zone, Hemisphere, Easting, Northing, &latitude, &longitude);
 
 	  /* Special check for rounding to (truncated) eastern edge of zone 31V */
 	  if ((Zone == 31) && (latitude >= 56.0 * DEG_TO_RAD) && (latitude < 64.0 * DEG_TO_RAD) && 
         (longitude >= 3.0 * DEG_TO_RAD))
 	  { /* Reconvert to UTM zone 32 */
-      Set_UTM_Parameters (MGRS_a, MGRS_f, 32);
-      temp_error = Convert_Geodetic_To_UTM (latitude, longitude, &Zone, &Hemisphere, &Easting, &Northing);
+      utm32 = ctx->utm;
+      Set_UTM_Parameters_r (&utm32, ctx->a, ctx->f, 32);
+      temp_error = Convert_Geodetic_To_UTM_r (&utm32, latitude, longitude, &Zone, &Hemisphere, &Easting, &Northing);
 	  }
 
-	  error_code = UTM_To_MGRS (Zone, latitude, Easting, Northing, Precision, MGRS);
+	  error_code = UTM_To_MGRS (ctx, Zone, latitude, Easting, Northing, Precision, MGRS);
   }
   return (error_code);
-} /* Convert_UTM_To_MGRS */
+} /* Convert_UTM_To_MGRS_r */
 
 
-long Convert_MGRS_To_UTM (char   *MGRS,
-                          long   *Zone,
-                          char   *Hemisphere,
-                          double *Easting,
-                          double *Northing)
+long Convert_MGRS_To_UTM_r (const MGRS_Context *ctx,
+                            char   *MGRS,
+                            long   *Zone,
+                            char   *Hemisphere,
+                            double *Easting,
+                            double *Northing)
 /*
- * The function Convert_MGRS_To_UTM converts an MGRS coordinate string
+ * The function Convert_MGRS_To_UTM_r converts an MGRS coordinate string
  * to UTM projection (zone, hemisphere, easting and northing) coordinates 
- * according to the current ellipsoid parameters.  If any errors occur, 
+ * according to the context's ellipsoid parameters.  If any errors occur, 
  * the error code(s) are returned by the function, otherwise UTM_NO_ERROR 
  * is returned.
  *
+ *    ctx        : The context                      (input)
  *    MGRS       : MGRS coordinate string           (input)
  *    Zone       : UTM zone                         (output)
  *    Hemisphere : North or South hemisphere        (output)
@@ -889,6 +931,7 @@ long Convert_MGRS_To_UTM (char   *MGRS,
   double latitude = 0.0;
   double longitude = 0.0;
   double divisor = 1.0;
+  UTM_Context utm;            /* UTM with the zone as override */
   long error_code = MGRS_NO_ERROR;
 
   error_code = Break_MGRS_String (MGRS, Zone, letters, Easting, Northing, &in_precision);
@@ -907,7 +950,7 @@ long Convert_MGRS_To_UTM (char   *MGRS,
         else
           *Hemisphere = 'N';
 
-        Get_Grid_Values(*Zone, &ltr2_low_value, &ltr2_high_value, &false_northing);
+        Get_Grid_Values(ctx, *Zone, &ltr2_low_value, &ltr2_high_value, &false_northing);
 
         /* Check that the second letter of the MGRS string is within
          * the range of valid second letter values 
@@ -950,10 +993,11 @@ long Convert_MGRS_To_UTM (char   *MGRS,
             *Northing = grid_northing + *Northing;
 
             /* check that point is within Zone Letter bounds */
-            error_code = Set_UTM_Parameters(MGRS_a,MGRS_f,*Zone);
+            utm = ctx->utm;
+            error_code = Set_UTM_Parameters_r(&utm,ctx->a,ctx->f,*Zone);
             if (!error_code)
             {
-              error_code = Convert_UTM_To_Geodetic(*Zone,*Hemisphere,*Easting,*Northing,&latitude,&longitude);
+              error_code = Convert_UTM_To_Geodetic_r(&utm,*Zone,*Hemisphere,*Easting,*Northing,&latitude,&longitude);
               if (!error_code)
               {
                 divisor = pow (10.0, in_precision);
@@ -971,7 +1015,7 @@ long Convert_MGRS_To_UTM (char   *MGRS,
     }
   }
   return (error_code);
-} /* Convert_MGRS_To_UTM */
+} /* Convert_MGRS_To_UTM_r */
 
 
 long Convert_UPS_To_MGRS (char   Hemisphere,
@@ -1188,4 +1232,67 @@ long Convert_MGRS_To_UPS ( char   *MGRS,
 } /* Convert_MGRS_To_UPS */
 
 
+/***************************************************************************/
+/*
+ *                   FUNCTIONS USING THE DEFAULT CONTEXT
+ *
+ *    These are the original, non-reentrant entry points; each calls the
+ *    corresponding _r function with a single, file-static context.
+ */
+
+long Set_MGRS_Parameters (double a,
+                          double f,
+                          char   *Ellipsoid_Code)
+{
+  return Set_MGRS_Parameters_r (Default_MGRS_Context(), a, f, Ellipsoid_Code);
+}
+
+
+void Get_MGRS_Parameters (double *a,
+                          double *f,
+                          char* Ellipsoid_Code)
+{
+  Get_MGRS_Parameters_r (Default_MGRS_Context(), a, f, Ellipsoid_Code);
+}
+
+
+long Convert_Geodetic_To_MGRS (double Latitude,
+                               double Longitude,
+                               long Precision,
+                               char* MGRS)
+{
+  return Convert_Geodetic_To_MGRS_r (Default_MGRS_Context(), 
+                                     Latitude, Longitude, Precision, MGRS);
+}
+
+
+long Convert_MGRS_To_Geodetic (char* MGRS, 
+                               double *Latitude, 
+                               double *Longitude)
+{
+  return Convert_MGRS_To_Geodetic_r (Default_MGRS_Context(), 
+                                     MGRS, Latitude, Longitude);
+}
+
+
+long Convert_UTM_To_MGRS (long Zone,
+                          char Hemisphere,
+                          double Easting,
+                          double Northing,
+                          long Precision,
+                          char* MGRS)
+{
+  return Convert_UTM_To_MGRS_r (Default_MGRS_Context(), Zone, Hemisphere,
+                                Easting, Northing, Precision, MGRS);
+}
 
+
+long Convert_MGRS_To_UTM (char   *MGRS,
+                          long   *Zone,
+                          char   *Hemisphere,
+                          double *Easting,
+                          double *Northing)
+{
+  return Convert_MGRS_To_UTM_r (Default_MGRS_Context(), MGRS, Zone, 
+                                Hemisphere, Easting, Northing);
+}
@@ -110,7 +110,7 @@
 #define PI           3.14159265358979323e0       /* PI     */
 #define PI_OVER_2    (PI / 2.0)           
 #define TWO_PI       (2.0 * PI)
-#define POLAR_POW(EsSin)     pow((1.0 - EsSin) / (1.0 + EsSin), es_OVER_2)
+#define POLAR_POW(EsSin)     pow((1.0 - EsSin) / (1.0 + EsSin), ctx->es_OVER_2)
 
 /************************************************************************/
 /*                           GLOBAL DECLARATIONS
@@ -119,31 +119,32 @@
 
 const double PI_Over_4 = (PI / 4.0);
 
-/* Ellipsoid Parameters, default to WGS 84  */
-static double Polar_a = 6378137.0;                    /* Semi-major axis of ellipsoid in meters  */
-static double Polar_f = 1 / 298.257223563;            /* Flattening of ellipsoid  */
-static double es = 0.08181919084262188000;            /* Eccentricity of ellipsoid    */
-static double es_OVER_2 = .040909595421311;           /* es / 2.0 */
-static double Southern_Hemisphere = 0;                /* Flag variable */
-static double mc = 1.0;                    
-static double tc = 1.0;
-static double e4 = 1.0033565552493;
-static double Polar_a_mc = 6378137.0;                 /* Polar_a * mc */
-static double two_Polar_a = 12756274.0;               /* 2.0 * Polar_a */
-
-/* Polar Stereographic projection Parameters */
-static double Polar_Origin_Lat = ((PI * 90) / 180);   /* Latitude of origin in radians */
-static double Polar_Origin_Long = 0.0;                /* Longitude of origin in radians */
-static double Polar_False_Easting = 0.0;              /* False easting in meters */
-static double Polar_False_Northing = 0.0;             /* False northing in meters */
-
-/* Maximum variance for easting and northing values for WGS 84. */
-static double Polar_Delta_Easting = 12713601.0;
-static double Polar_Delta_Northing = 12713601.0;
-
-/* These state variables are for optimization purposes. The only function
- * that should modify them is Set_Polar_Stereographic_Parameters.         
- */
+/* Ellipsoid and projection parameters default to WGS 84, as does the
+ * maximum variance for easting and northing values. */
+#define POLAR_DEFAULTS                                                    \
+{                                                                         \
+  6378137.0,              /* a: Semi-major axis of ellipsoid in meters */ \
+  1 / 298.257223563,      /* f: Flattening of ellipsoid                */ \
+  0.08181919084262188000, /* es: Eccentricity of ellipsoid             */ \
+  .040909595421311,       /* es_OVER_2: es / 2.0                       */ \
+  0,                      /* Southern_Hemisphere: Flag variable        */ \
+  1.0,                    /* mc                                        */ \
+  1.0,                    /* tc                                        */ \
+  1.0033565552493,        /* e4                                        */ \
+  6378137.0,              /* a_mc: a * mc                              */ \
+  12756274.0,             /* two_a: 2.0 * a                            */ \
+  ((PI * 90) / 180),      /* Origin_Lat: Latitude of origin in radians */ \
+  0.0,                    /* Origin_Long                               */ \
+  0.0,                    /* False_Easting                             */ \
+  0.0,                    /* False_Northing                            */ \
+  12713601.0,             /* Delta_Easting                             */ \
+  12713601.0              /* Delta_Northing                            */ \
+}
+
+static const Polar_Stereographic_Context Polar_Defaults = POLAR_DEFAULTS;
+
+/* The context used by the functions that don't take one. */
+static Polar_Stereographic_Context Polar = POLAR_DEFAULTS;
 
 
 /************************************************************************/
@@ -152,20 +153,37 @@ static double Polar_Delta_Northing = 12713601.0;
  */
 
 
-long Set_Polar_Stereographic_Parameters (double a,
-                                         double f,
-                                         double Latitude_of_True_Scale,
-                                         double Longitude_Down_from_Pole,
-                                         double False_Easting,
-                                         double False_Northing)
+void Init_Polar_Stereographic_Context (Polar_Stereographic_Context *ctx)
+
+{  /* BEGIN Init_Polar_Stereographic_Context */
+/*
+ *  The function Init_Polar_Stereographic_Context initializes a context to
+ *  the default (WGS 84) ellipsoid and projection parameters.
+ *
+ *  ctx              : The context                                     (output)
+ */
+
+  *ctx = Polar_Defaults;
+} /* END OF Init_Polar_Stereographic_Context */
 
-{  /* BEGIN Set_Polar_Stereographic_Parameters   */
+
+long Set_Polar_Stereographic_Parameters_r (Polar_Stereographic_Context *ctx,
+                                           double a,
+                                           double f,
+                                           double Latitude_of_True_Scale,
+                                           double Longitude_Down_from_Pole,
+                                           double False_Easting,
+                                           double False_Northing)
+
+{  /* BEGIN Set_Polar_Stereographic_Parameters_r   */
 /*  
- *  The function Set_Polar_Stereographic_Parameters receives the ellipsoid
+ *  The function Set_Polar_Stereographic_Parameters_r receives the ellipsoid
  *  parameters and Polar Stereograpic projection parameters as inputs, and
- *  sets the corresponding state variables.  If any errors occur, error
- *  code(s) are returned by the function, otherwise POLAR_NO_ERROR is returned.
+ *  sets the corresponding variables in the context.  If any errors occur, 
+ *  error code(s) are returned by the function, otherwise POLAR_NO_ERROR is 
+ *  returned.
  *
+ *  ctx              : The context                                     (input/output)
  *  a                : Semi-major axis of ellipsoid, in meters         (input)
  *  f                : Flattening of ellipsoid					               (input)
  *  Latitude_of_True_Scale  : Latitude of true scale, in radians       (input)
@@ -204,72 +222,74 @@ long Set_Polar_Stereographic_Parameters (double a,
   if (!Error_Code)
   { /* no errors */
 
-    Polar_a = a;
-    two_Polar_a = 2.0 * Polar_a;
-    Polar_f = f;
+    ctx->a = a;
+    ctx->two_a = 2.0 * ctx->a;
+    ctx->f = f;
 
     if (Longitude_Down_from_Pole > PI)
       Longitude_Down_from_Pole -= TWO_PI;
     if (Latitude_of_True_Scale < 0)
     {
-      Southern_Hemisphere = 1;
-      Polar_Origin_Lat = -Latitude_of_True_Scale;
-      Polar_Origin_Long = -Longitude_Down_from_Pole;
+      ctx->Southern_Hemisphere = 1;
+      ctx->Origin_Lat = -Latitude_of_True_Scale;
+      ctx->Origin_Long = -Longitude_Down_from_Pole;
     }
     else
     {
-      Southern_Hemisphere = 0;
-      Polar_Origin_Lat = Latitude_of_True_Scale;
-      Polar_Origin_Long = Longitude_Down_from_Pole;
+      ctx->Southern_Hemisphere = 0;
+      ctx->Origin_Lat = Latitude_of_True_Scale;
+      ctx->Origin_Long = Longitude_Down_from_Pole;
     }
-    Polar_False_Easting = False_Easting;
-    Polar_False_Northing = False_Northing;
+    ctx->False_Easting = False_Easting;
+    ctx->False_Northing = False_Northing;
 
-    es2 = 2 * Polar_f - Polar_f * Polar_f;
-    es = sqrt(es2);
-    es_OVER_2 = es / 2.0;
+    es2 = 2 * ctx->f - ctx->f * ctx->f;
+    ctx->es = sqrt(es2);
+    ctx->es_OVER_2 = ctx->es / 2.0;
 
-    if (fabs(fabs(Polar_Origin_Lat) - PI_OVER_2) > 1.0e-10)
+    if (fabs(fabs(ctx->Origin_Lat) - PI_OVER_2) > 1.0e-10)
     {
-      slat = sin(Polar_Origin_Lat);
-      essin = es * slat;
+      slat = sin(ctx->Origin_Lat);
+      essin = ctx->es * slat;
       pow_es = POLAR_POW(essin);
-      clat = cos(Polar_Origin_Lat);
-      mc = clat / sqrt(1.0 - essin * essin);
-      Polar_a_mc = Polar_a * mc;
-      tc = tan(PI_Over_4 - Polar_Origin_Lat / 2.0) / pow_es;
+      clat = cos(ctx->Origin_Lat);
+      ctx->mc = clat / sqrt(1.0 - essin * essin);
+      ctx->a_mc = ctx->a * ctx->mc;
+      ctx->tc = tan(PI_Over_4 - ctx->Origin_Lat / 2.0) / pow_es;
     }
     else
     {
-      one_PLUS_es = 1.0 + es;
-      one_MINUS_es = 1.0 - es;
-      e4 = sqrt(pow(one_PLUS_es, one_PLUS_es) * pow(one_MINUS_es, one_MINUS_es));
+      one_PLUS_es = 1.0 + ctx->es;
+      one_MINUS_es = 1.0 - ctx->es;
+      ctx->e4 = sqrt(pow(one_PLUS_es, one_PLUS_es) * pow(one_MINUS_es, one_MINUS_es));
     }
   }
   /* Calculate Radius */
-  Convert_Geodetic_To_Polar_Stereographic(0, Polar_Origin_Long, 
-                                          &temp, &Polar_Delta_Northing);
-  Polar_Delta_Northing = fabs(Polar_Delta_Northing) + epsilon;
-  Polar_Delta_Easting = Polar_Delta_Northing;
+  Convert_Geodetic_To_Polar_Stereographic_r(ctx, 0, ctx->Origin_Long, 
+                                            &temp, &ctx->Delta_Northing);
+  ctx->Delta_Northing = fabs(ctx->Delta_Northing) + epsilon;
+  ctx->Delta_Easting = ctx->Delta_Northing;
 
 
   return (Error_Code);
-} /* END OF Set_Polar_Stereographic_Parameters */
+} /* END OF Set_Polar_Stereographic_Parameters_r */
 
 
 
-void Get_Polar_Stereographic_Parameters (double *a,
-                                         double *f,
-                                         double *Latitude_of_True_Scale,
-                                         double *Longitude_Down_from_Pole,
-                                         double *False_Easting,
-                                         double *False_Northing)
+void Get_Polar_Stereographic_Parameters_r (const Polar_Stereographic_Context *ctx,
+                                           double *a,
+                                           double *f,
+                                           double *Latitude_of_True_Scale,
+                                           double *Longitude_Down_from_Pole,
+                                           double *False_Easting,
+                                           double *False_Northing)
 
-{ /* BEGIN Get_Polar_Stereographic_Parameters  */
+{ /* BEGIN Get_Polar_Stereographic_Parameters_r  */
 /*
- * The function Get_Polar_Stereographic_Parameters returns the current
+ * The function Get_Polar_Stereographic_Parameters_r returns the context's
  * ellipsoid parameters and Polar projection parameters.
  *
+ *  ctx              : The context                                     (input)
  *  a                : Semi-major axis of ellipsoid, in meters         (output)
  *  f                : Flattening of ellipsoid					               (output)
  *  Latitude_of_True_Scale  : Latitude of true scale, in radians       (output)
@@ -278,30 +298,32 @@ void Get_Polar_Stereographic_Parameters (double *a,
  *  False_Northing   : Northing (Y) at center of projection, in meters (output)
  */
 
-  *a = Polar_a;
-  *f = Polar_f;
-  *Latitude_of_True_Scale = Polar_Origin_Lat;
-  *Longitude_Down_from_Pole = Polar_Origin_Long;
-  *False_Easting = Polar_False_Easting;
-  *False_Northing = Polar_False_Northing;
+  *a = ctx->a;
+  *f = ctx->f;
+  *Latitude_of_True_Scale = ctx->Origin_Lat;
+  *Longitude_Down_from_Pole = ctx->Origin_Long;
+  *False_Easting = ctx->False_Easting;
+  *False_Northing = ctx->False_Northing;
   return;
-} /* END OF Get_Polar_Stereographic_Parameters */
+} /* END OF Get_Polar_Stereographic_Parameters_r */
 
 
-long Convert_Geodetic_To_Polar_Stereographic (double Latitude,
-                                              double Longitude,
-                                              double *Easting,
-                                              double *Northing)
+long Convert_Geodetic_To_Polar_Stereographic_r (const Polar_Stereographic_Context *ctx,
+                                                double Latitude,
+                                                double Longitude,
+                                                double *Easting,
+                                                double *Northing)
 
-{  /* BEGIN Convert_Geodetic_To_Polar_Stereographic */
+{  /* BEGIN Convert_Geodetic_To_Polar_Stereographic_r */
 
 /*
- * The function Convert_Geodetic_To_Polar_Stereographic converts geodetic
+ * The function Convert_Geodetic_To_Polar_Stereographic_r converts geodetic
  * coordinates (latitude and longitude) to Polar Stereographic coordinates
- * (easting and northing), according to the current ellipsoid
+ * (easting and northing), according to the context's ellipsoid
  * and Polar Stereographic projection parameters. If any errors occur, error
  * code(s) are returned by the function, otherwise POLAR_NO_ERROR is returned.
  *
+ *    ctx        :  The context                               (input)
  *    Latitude   :  Latitude, in radians                      (input)
  *    Longitude  :  Longitude, in radians                     (input)
  *    Easting    :  Easting (X), in meters                    (output)
@@ -320,11 +342,11 @@ long Convert_Geodetic_To_Polar_Stereographic (double Latitude,
   {   /* Latitude out of range */
     Error_Code |= POLAR_LAT_ERROR;
   }
-  if ((Latitude < 0) && (Southern_Hemisphere == 0))
+  if ((Latitude < 0) && (ctx->Southern_Hemisphere == 0))
   {   /* Latitude and Origin Latitude in different hemispheres */
     Error_Code |= POLAR_LAT_ERROR;
   }
-  if ((Latitude > 0) && (Southern_Hemisphere == 1))
+  if ((Latitude > 0) && (ctx->Southern_Hemisphere == 1))
   {   /* Latitude and Origin Latitude in different hemispheres */
     Error_Code |= POLAR_LAT_ERROR;
   }
@@ -344,12 +366,12 @@ long Convert_Geodetic_To_Polar_Stereographic (double Latitude,
     }
     else
     {
-      if (Southern_Hemisphere != 0)
+      if (ctx->Southern_Hemisphere != 0)
       {
         Longitude *= -1.0;
         Latitude *= -1.0;
       }
-      dlam = Longitude - Polar_Origin_Long;
+      dlam = Longitude - ctx->Origin_Long;
       if (dlam > PI)
       {
         dlam -= TWO_PI;
@@ -359,45 +381,47 @@ long Convert_Geodetic_To_Polar_Stereographic (double Latitude,
         dlam += TWO_PI;
       }
       slat = sin(Latitude);
-      essin = es * slat;
+      essin = ctx->es * slat;
       pow_es = POLAR_POW(essin);
       t = tan(PI_Over_4 - Latitude / 2.0) / pow_es;
 
-      if (fabs(fabs(Polar_Origin_Lat) - PI_OVER_2) > 1.0e-10)
-        rho = Polar_a_mc * t / tc;
+      if (fabs(fabs(ctx->Origin_Lat) - PI_OVER_2) > 1.0e-10)
+        rho = ctx->a_mc * t / ctx->tc;
       else
-        rho = two_Polar_a * t / e4;
+        rho = ctx->two_a * t / ctx->e4;
 
-      *Easting = rho * sin(dlam) + Polar_False_Easting;
+      *Easting = rho * sin(dlam) + ctx->False_Easting;
 
-      if (Southern_Hemisphere != 0)
+      if (ctx->Southern_Hemisphere != 0)
       {
         *Easting *= -1.0;
-        *Northing = rho * cos(dlam) + Polar_False_Northing;
+        *Northing = rho * cos(dlam) + ctx->False_Northing;
       }
       else
-        *Northing = -rho * cos(dlam) + Polar_False_Northing;
+        *Northing = -rho * cos(dlam) + ctx->False_Northing;
 
     }
   }
   return (Error_Code);
-} /* END OF Convert_Geodetic_To_Polar_Stereographic */
+} /* END OF Convert_Geodetic_To_Polar_Stereographic_r */
 
 
-long Convert_Polar_Stereographic_To_Geodetic (double Easting,
-                                              double Northing,
-                                              double *Latitude,
-                                              double *Longitude)
+long Convert_Polar_Stereographic_To_Geodetic_r (const Polar_Stereographic_Context *ctx,
+                                                double Easting,
+                                                double Northing,
+                                                double *Latitude,
+                                                double *Longitude)
 
-{ /*  BEGIN Convert_Polar_Stereographic_To_Geodetic  */
+{ /*  BEGIN Convert_Polar_Stereographic_To_Geodetic_r  */
 /*
- *  The function Convert_Polar_Stereographic_To_Geodetic converts Polar
+ *  The function Convert_Polar_Stereographic_To_Geodetic_r converts Polar
  *  Stereographic coordinates (easting and northing) to geodetic
- *  coordinates (latitude and longitude) according to the current ellipsoid
+ *  coordinates (latitude and longitude) according to the context's ellipsoid
  *  and Polar Stereographic projection Parameters. If any errors occur, the
  *  code(s) are returned by the function, otherwise POLAR_NO_ERROR
  *  is returned.
  *
+ *  ctx              : The context                              (input)
  *  Easting          : Easting (X), in meters                   (input)
  *  Northing         : Northing (Y), in meters                  (input)
  *  Latitude         : Latitude, in radians                     (output)
@@ -415,13 +439,13 @@ long Convert_Polar_Stereographic_To_Geodetic (double Easting,
   double temp;
   long Error_Code = POLAR_NO_ERROR;
 
-  if ((Easting > (Polar_False_Easting + Polar_Delta_Easting)) ||
-      (Easting < (Polar_False_Easting - Polar_Delta_Easting)))
+  if ((Easting > (ctx->False_Easting + ctx->Delta_Easting)) ||
+      (Easting < (ctx->False_Easting - ctx->Delta_Easting)))
   { /* Easting out of range */
     Error_Code |= POLAR_EASTING_ERROR;
   }
-  if ((Northing > (Polar_False_Northing + Polar_Delta_Northing)) ||
-      (Northing < (Polar_False_Northing - Polar_Delta_Northing)))
+  if ((Northing > (ctx->False_Northing + ctx->Delta_Northing)) ||
+      (Northing < (ctx->False_Northing - ctx->Delta_Northing)))
   { /* Northing out of range */
     Error_Code |= POLAR_NORTHING_ERROR;
   }
@@ -429,10 +453,10 @@ long Convert_Polar_Stereographic_To_Geodetic (double Easting,
   {
     temp = sqrt(Easting * Easting + Northing * Northing);     
 
-    if ((temp > (Polar_False_Easting + Polar_Delta_Easting)) || 
-        (temp > (Polar_False_Northing + Polar_Delta_Northing)) ||
-        (temp < (Polar_False_Easting - Polar_Delta_Easting)) || 
-        (temp < (Polar_False_Northing - Polar_Delta_Northing)))
+    if ((temp > (ctx->False_Easting + ctx->Delta_Easting)) || 
+        (temp > (ctx->False_Northing + ctx->Delta_Northing)) ||
+        (temp < (ctx->False_Easting - ctx->Delta_Easting)) || 
+        (temp < (ctx->False_Northing - ctx->Delta_Northing)))
     { /* Point is outside of projection area */
       Error_Code |= POLAR_RADIUS_ERROR;
     }
@@ -441,38 +465,38 @@ long Convert_Polar_Stereographic_To_Geodetic (double Easting,
   if (!Error_Code)
   { /* no errors */
 
-    dy = Northing - Polar_False_Northing;
-    dx = Easting - Polar_False_Easting;
+    dy = Northing - ctx->False_Northing;
+    dx = Easting - ctx->False_Easting;
     if ((dy == 0.0) && (dx == 0.0))
     {
       *Latitude = PI_OVER_2;
-      *Longitude = Polar_Origin_Long;
+      *Longitude = ctx->Origin_Long;
 
     }
     else
     {
-      if (Southern_Hemisphere != 0)
+      if (ctx->Southern_Hemisphere != 0)
       {
         dy *= -1.0;
         dx *= -1.0;
       }
 
       rho = sqrt(dx * dx + dy * dy);
-      if (fabs(fabs(Polar_Origin_Lat) - PI_OVER_2) > 1.0e-10)
-        t = rho * tc / (Polar_a_mc);
+      if (fabs(fabs(ctx->Origin_Lat) - PI_OVER_2) > 1.0e-10)
+        t = rho * ctx->tc / (ctx->a_mc);
       else
-        t = rho * e4 / (two_Polar_a);
+        t = rho * ctx->e4 / (ctx->two_a);
       PHI = PI_OVER_2 - 2.0 * atan(t);
       while (fabs(PHI - tempPHI) > 1.0e-10)
       {
         tempPHI = PHI;
         sin_PHI = sin(PHI);
-        essin =  es * sin_PHI;
+        essin =  ctx->es * sin_PHI;
         pow_es = POLAR_POW(essin);
         PHI = PI_OVER_2 - 2.0 * atan(t * pow_es);
       }
       *Latitude = PHI;
-      *Longitude = Polar_Origin_Long + atan2(dx, -dy);
+      *Longitude = ctx->Origin_Long + atan2(dx, -dy);
 
       if (*Longitude > PI)
         *Longitude -= TWO_PI;
@@ -491,7 +515,7 @@ long Convert_Polar_Stereographic_To_Geodetic (double Easting,
         *Longitude = -PI;
 
     }
-    if (Southern_Hemisphere != 0)
+    if (ctx->Southern_Hemisphere != 0)
     {
       *Latitude *= -1.0;
       *Longitude *= -1.0;
@@ -499,7 +523,67 @@ long Convert_Polar_Stereographic_To_Geodetic (double Easting,
 
   }
   return (Error_Code);
-} /* END OF Convert_Polar_Stereographic_To_Geodetic */
+} /* END OF Convert_Polar_Stereographic_To_Geodetic_r */
+
+
+/************************************************************************/
+/*                    FUNCTIONS USING THE DEFAULT CONTEXT
+ *
+ *    These are the original, non-reentrant entry points; each calls the
+ *    corresponding _r function with a single, file-static context.
+ */
+
+
+long Set_Polar_Stereographic_Parameters (double a,
+                                         double f,
+                                         double Latitude_of_True_Scale,
+                                         double Longitude_Down_from_Pole,
+                                         double False_Easting,
+                                         double False_Northing)
+{
+  return Set_Polar_Stereographic_Parameters_r(&Polar, a, f,
+                                              Latitude_of_True_Scale,
+                                              Longitude_Down_from_Pole,
+                                              False_Easting,
+                                              False_Northing);
+}
+
+
+void Get_Polar_Stereographic_Parameters (double *a,
+                                         double *f,
+                                         double *Latitude_of_True_Scale,
+                                         double *Longitude_Down_from_Pole,
+                                         double *False_Easting,
+                                         double *False_Northing)
+{
+  Get_Polar_Stereographic_Parameters_r(&Polar, a, f,
+                                       Latitude_of_True_Scale,
+                                       Longitude_Down_from_Pole,
+                                       False_Easting,
+                                       False_Northing);
+}
+
+
+long Convert_Geodetic_To_Polar_Stereographic (double Latitude,
+                                              double Longitude,
+                                              double *Easting,
+                                              double *Northing)
+{
+  return Convert_Geodetic_To_Polar_Stereographic_r(&Polar, 
+                                                   Latitude, Longitude,
+                                                   Easting, Northing);
+}
+
+
+long Convert_Polar_Stereographic_To_Geodetic (double Easting,
+                                              double Northing,
+                                              double *Latitude,
+                                              double *Longitude)
+{
+  return Convert_Polar_Stereographic_To_Geodetic_r(&Polar,
+                                                   Easting, Northing,
+                                                   Latitude, Longitude);
+}
 
 
 
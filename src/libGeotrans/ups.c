@@ -107,17 +107,26 @@
 #define MIN_EAST_NORTH 0
 #define MAX_EAST_NORTH 4000000
 
-/* Ellipsoid Parameters, default to WGS 84  */
-static double UPS_a = 6378137.0;          /* Semi-major axis of ellipsoid in meters   */
-static double UPS_f = 1 / 298.257223563;  /* Flattening of ellipsoid  */
 const double UPS_False_Easting = 2000000;
 const double UPS_False_Northing = 2000000;
-static double UPS_Origin_Latitude = MAX_ORIGIN_LAT;  /*set default = North Hemisphere */
 static double UPS_Origin_Longitude = 0.0;
 static double false_easting = 0.0;
 static double false_northing = 0.0;
-static double UPS_Easting = 0.0;
-static double UPS_Northing = 0.0;
+
+/* The context used by the functions that don't take one; it is
+ * initialized to WGS 84 on first use. */
+static UPS_Context UPS;
+static int         UPS_Initialized = 0;
+
+static UPS_Context *Default_UPS_Context(void)
+{
+  if (!UPS_Initialized)
+  {
+    Init_UPS_Context(&UPS);
+    UPS_Initialized = 1;
+  }
+  return &UPS;
+}
 
 
 /************************************************************************/
@@ -126,14 +135,31 @@ static double UPS_Northing = 0.0;
  */
 
 
-long Set_UPS_Parameters( double a,
-                         double f)
+void Init_UPS_Context( UPS_Context *ctx )
+{
+/*
+ * The function Init_UPS_Context initializes a context to the default
+ * (WGS 84) ellipsoid parameters.
+ *
+ *   ctx   : The context                            (output)
+ */
+
+  Set_UPS_Parameters_r(ctx, 6378137.0, 1 / 298.257223563);
+} /* END OF Init_UPS_Context */
+
+
+long Set_UPS_Parameters_r( UPS_Context *ctx,
+                           double a,
+                           double f)
 {
 /*
- * The function SET_UPS_PARAMETERS receives the ellipsoid parameters and sets
- * the corresponding state variables. If any errors occur, the error code(s)
- * are returned by the function, otherwise UPS_NO_ERROR is returned.
+ * The function Set_UPS_Parameters_r receives the ellipsoid parameters and
+ * sets the corresponding variables in the context.  The Polar Stereographic
+ * projections for both hemispheres are set up here, once, rather than on
+ * each conversion.  If any errors occur, the error code(s) are returned by 
+ * the function, otherwise UPS_NO_ERROR is returned.
  *
+ *   ctx   : The context                            (input/output)
  *   a     : Semi-major axis of ellipsoid in meters (input)
  *   f     : Flattening of ellipsoid					      (input)
  */
@@ -152,42 +178,62 @@ long Set_UPS_Parameters( double a,
 
   if (!Error_Code)
   { /* no errors */
-    UPS_a = a;
-    UPS_f = f;
+    ctx->a = a;
+    ctx->f = f;
+
+    /* Geodetic to UPS uses no false easting and northing; UPS to
+     * Geodetic does. */
+    Set_Polar_Stereographic_Parameters_r(&ctx->Forward[0], a, f, 
+                                         MAX_ORIGIN_LAT, UPS_Origin_Longitude,
+                                         false_easting, false_northing);
+    Set_Polar_Stereographic_Parameters_r(&ctx->Forward[1], a, f, 
+                                         -MAX_ORIGIN_LAT, UPS_Origin_Longitude,
+                                         false_easting, false_northing);
+    Set_Polar_Stereographic_Parameters_r(&ctx->Inverse[0], a, f, 
+                                         MAX_ORIGIN_LAT, UPS_Origin_Longitude,
+                                         UPS_False_Easting, UPS_False_Northing);
+    Set_Polar_Stereographic_Parameters_r(&ctx->Inverse[1], a, f, 
+                                         -MAX_ORIGIN_LAT, UPS_Origin_Longitude,
+                                         UPS_False_Easting, UPS_False_Northing);
   }
   return (Error_Code);
-}  /* END of Set_UPS_Parameters  */
+}  /* END of Set_UPS_Parameters_r  */
 
 
-void Get_UPS_Parameters( double *a,
-                         double *f)
+void Get_UPS_Parameters_r( const UPS_Context *ctx,
+                           double *a,
+                           double *f)
 {
 /*
- * The function Get_UPS_Parameters returns the current ellipsoid parameters.
+ * The function Get_UPS_Parameters_r returns the context's ellipsoid 
+ * parameters.
  *
+ *  ctx    : The context                             (input)
  *  a      : Semi-major axis of ellipsoid, in meters (output)
  *  f      : Flattening of ellipsoid					       (output)
  */
 
-  *a = UPS_a;
-  *f = UPS_f;
+  *a = ctx->a;
+  *f = ctx->f;
   return;
-} /* END OF Get_UPS_Parameters */
+} /* END OF Get_UPS_Parameters_r */
 
 
-long Convert_Geodetic_To_UPS ( double Latitude,
-                               double Longitude,
-                               char   *Hemisphere,
-                               double *Easting,
-                               double *Northing)
+long Convert_Geodetic_To_UPS_r ( const UPS_Context *ctx,
+                                 double Latitude,
+                                 double Longitude,
+                                 char   *Hemisphere,
+                                 double *Easting,
+                                 double *Northing)
 {
 /*
- *  The function Convert_Geodetic_To_UPS converts geodetic (latitude and
+ *  The function Convert_Geodetic_To_UPS_r converts geodetic (latitude and
  *  longitude) coordinates to UPS (hemisphere, easting, and northing)
- *  coordinates, according to the current ellipsoid parameters. If any 
+ *  coordinates, according to the context's ellipsoid parameters. If any 
  *  errors occur, the error code(s) are returned by the function, 
  *  otherwide UPS_NO_ERROR is returned.
  *
+ *    ctx           : The context                               (input)
  *    Latitude      : Latitude in radians                       (input)
  *    Longitude     : Longitude in radians                      (input)
  *    Hemisphere    : Hemisphere either 'N' or 'S'              (output)
@@ -196,6 +242,7 @@ long Convert_Geodetic_To_UPS ( double Latitude,
  */
 
   double tempEasting, tempNorthing;
+  const Polar_Stereographic_Context *polar;
   long Error_Code = UPS_NO_ERROR;
 
   if ((Latitude < -MAX_LAT) || (Latitude > MAX_LAT))
@@ -215,53 +262,44 @@ long Convert_Geodetic_To_UPS ( double Latitude,
   {  /* no errors */
     if (Latitude < 0)
     {
-      UPS_Origin_Latitude = -MAX_ORIGIN_LAT; 
+      polar = &ctx->Forward[1];
       *Hemisphere = 'S';
     }
     else
     {
-      UPS_Origin_Latitude = MAX_ORIGIN_LAT; 
+      polar = &ctx->Forward[0];
       *Hemisphere = 'N';
     }
 
+    Convert_Geodetic_To_Polar_Stereographic_r(polar,
+                                              Latitude,
+                                              Longitude,
+                                              &tempEasting,
+                                              &tempNorthing);
 
-    Set_Polar_Stereographic_Parameters( UPS_a,
-                                        UPS_f,
-                                        UPS_Origin_Latitude,
-                                        UPS_Origin_Longitude,
-                                        false_easting,
-                                        false_northing);
-
-    Convert_Geodetic_To_Polar_Stereographic(Latitude,
-                                            Longitude,
-                                            &tempEasting,
-                                            &tempNorthing);
-
-    UPS_Easting = UPS_False_Easting + tempEasting;
-    UPS_Northing = UPS_False_Northing + tempNorthing;
-
-
-    *Easting = UPS_Easting;
-    *Northing = UPS_Northing;
+    *Easting = UPS_False_Easting + tempEasting;
+    *Northing = UPS_False_Northing + tempNorthing;
   }  /*  END of if(!Error_Code)   */
 
   return (Error_Code);
-}  /* END OF Convert_Geodetic_To_UPS  */
+}  /* END OF Convert_Geodetic_To_UPS_r  */
 
 
-long Convert_UPS_To_Geodetic(char   Hemisphere,
-                             double Easting,
-                             double Northing,
-                             double *Latitude,
-                             double *Longitude)
+long Convert_UPS_To_Geodetic_r(const UPS_Context *ctx,
+                               char   Hemisphere,
+                               double Easting,
+                               double Northing,
+                               double *Latitude,
+                               double *Longitude)
 {
 /*
- *  The function Convert_UPS_To_Geodetic converts UPS (hemisphere, easting, 
+ *  The function Convert_UPS_To_Geodetic_r converts UPS (hemisphere, easting, 
  *  and northing) coordinates to geodetic (latitude and longitude) coordinates
- *  according to the current ellipsoid parameters.  If any errors occur, the 
+ *  according to the context's ellipsoid parameters.  If any errors occur, the 
  *  error code(s) are returned by the function, otherwise UPS_NO_ERROR is 
  *  returned.
  *
+ *    ctx           : The context                               (input)
  *    Hemisphere    : Hemisphere either 'N' or 'S'              (input)
  *    Easting       : Easting/X in meters                       (input)
  *    Northing      : Northing/Y in meters                      (input)
@@ -278,26 +316,14 @@ long Convert_UPS_To_Geodetic(char   Hemisphere,
   if ((Northing < MIN_EAST_NORTH) || (Northing > MAX_EAST_NORTH))
     Error_Code |= UPS_NORTHING_ERROR;
 
-  if (Hemisphere =='N')
-  {UPS_Origin_Latitude = MAX_ORIGIN_LAT;}
-  if (Hemisphere =='S')
-  {UPS_Origin_Latitude = -MAX_ORIGIN_LAT;}
-
   if (!Error_Code)
   {   /*  no errors   */
-    Set_Polar_Stereographic_Parameters( UPS_a,
-                                        UPS_f,
-                                        UPS_Origin_Latitude,
-                                        UPS_Origin_Longitude,
-                                        UPS_False_Easting,
-                                        UPS_False_Northing);
-
-
-
-    Convert_Polar_Stereographic_To_Geodetic( Easting,
-                                             Northing,
-                                             Latitude,
-                                             Longitude); 
+    Convert_Polar_Stereographic_To_Geodetic_r( 
+                                  &ctx->Inverse[Hemisphere == 'S' ? 1 : 0],
+                                  Easting,
+                                  Northing,
+                                  Latitude,
+                                  Longitude); 
 
 
     if ((*Latitude < 0) && (*Latitude > MIN_SOUTH_LAT))
@@ -306,5 +332,49 @@ long Convert_UPS_To_Geodetic(char   Hemisphere,
       Error_Code |= UPS_LAT_ERROR;
   }  /*  END OF if(!Error_Code) */
   return (Error_Code);
-}  /*  END OF Convert_UPS_To_Geodetic  */ 
+}  /*  END OF Convert_UPS_To_Geodetic_r  */
+
+
+/************************************************************************/
+/*                    FUNCTIONS USING THE DEFAULT CONTEXT
+ *
+ *    These are the original, non-reentrant entry points; each calls the
+ *    corresponding _r function with a single, file-static context.
+ */
+
+
+long Set_UPS_Parameters( double a,
+                         double f)
+{
+  return Set_UPS_Parameters_r(Default_UPS_Context(), a, f);
+}
+
+
+void Get_UPS_Parameters( double *a,
+                         double *f)
+{
+  Get_UPS_Parameters_r(Default_UPS_Context(), a, f);
+}
+
+
+long Convert_Geodetic_To_UPS ( double Latitude,
+                               double Longitude,
+                               char   *Hemisphere,
+                               double *Easting,
+                               double *Northing)
+{
+  return Convert_Geodetic_To_UPS_r(Default_UPS_Context(), Latitude, Longitude,
+                                   Hemisphere, Easting, Northing);
+}
+
+
+long Convert_UPS_To_Geodetic(char   Hemisphere,
+                             double Easting,
+                             double Northing,
+                             double *Latitude,
+                             double *Longitude)
+{
+  return Convert_UPS_To_Geodetic_r(Default_UPS_Context(), Hemisphere,
+                                   Easting, Northing, Latitude, Longitude);
+} 
 
@@ -99,9 +99,20 @@
  *                              GLOBAL DECLARATIONS
  */
 
-static double UTM_a = 6378137.0;         /* Semi-major axis of ellipsoid in meters  */
-static double UTM_f = 1 / 298.257223563; /* Flattening of ellipsoid                 */
-static long   UTM_Override = 0;          /* Zone override flag                      */
+/* The context used by the functions that don't take one; it is
+ * initialized to WGS 84 on first use. */
+static UTM_Context UTM;
+static int         UTM_Initialized = 0;
+
+static UTM_Context *Default_UTM_Context(void)
+{
+  if (!UTM_Initialized)
+  {
+    Init_UTM_Context(&UTM);
+    UTM_Initialized = 1;
+  }
+  return &UTM;
+}
 
 
 /***************************************************************************/
@@ -110,16 +121,36 @@ static long   UTM_Override = 0;          /* Zone override flag
  *
  */
 
-long Set_UTM_Parameters(double a,      
-                        double f,
-                        long   override)
+void Init_UTM_Context(UTM_Context *ctx)
 {
 /*
- * The function Set_UTM_Parameters receives the ellipsoid parameters and
- * UTM zone override parameter as inputs, and sets the corresponding state
- * variables.  If any errors occur, the error code(s) are returned by the 
+ * The function Init_UTM_Context initializes a context to the default
+ * (WGS 84) ellipsoid parameters, with no zone override.
+ *
+ *    ctx               : The context                                   (output)
+ */
+
+  ctx->a = 6378137.0;
+  ctx->f = 1 / 298.257223563;
+  ctx->Override = 0;
+  Init_Transverse_Mercator_Context(&ctx->tm);
+} /* END OF Init_UTM_Context */
+
+
+long Set_UTM_Parameters_r(UTM_Context *ctx,
+                          double a,      
+                          double f,
+                          long   override)
+{
+/*
+ * The function Set_UTM_Parameters_r receives the ellipsoid parameters and
+ * UTM zone override parameter as inputs, and sets the corresponding 
+ * variables in the context.  The Transverse Mercator series coefficients
+ * for the ellipsoid are computed here, once, rather than on each 
+ * conversion.  If any errors occur, the error code(s) are returned by the 
  * function, otherwise UTM_NO_ERROR is returned.
  *
+ *    ctx               : The context                                   (input/output)
  *    a                 : Semi-major axis of ellipsoid, in meters       (input)
  *    f                 : Flattening of ellipsoid						            (input)
  *    override          : UTM override zone, zero indicates no override (input)
@@ -142,47 +173,55 @@ long Set_UTM_Parameters(double a,
   }
   if (!Error_Code)
   { /* no errors */
-    UTM_a = a;
-    UTM_f = f;
-    UTM_Override = override;
+    ctx->a = a;
+    ctx->f = f;
+    ctx->Override = override;
+    Set_Transverse_Mercator_Parameters_r(&ctx->tm, a, f, 0, 0, 500000, 0, 
+                                         0.9996);
   }
   return (Error_Code);
-} /* END OF Set_UTM_Parameters */
+} /* END OF Set_UTM_Parameters_r */
 
 
-void Get_UTM_Parameters(double *a,
-                        double *f,
-                        long   *override)
+void Get_UTM_Parameters_r(const UTM_Context *ctx,
+                          double *a,
+                          double *f,
+                          long   *override)
 {
 /*
- * The function Get_UTM_Parameters returns the current ellipsoid
+ * The function Get_UTM_Parameters_r returns the context's ellipsoid
  * parameters and UTM zone override parameter.
  *
+ *    ctx               : The context                                   (input)
  *    a                 : Semi-major axis of ellipsoid, in meters       (output)
  *    f                 : Flattening of ellipsoid						            (output)
  *    override          : UTM override zone, zero indicates no override (output)
  */
 
-  *a = UTM_a;
-  *f = UTM_f;
-  *override = UTM_Override;
-} /* END OF Get_UTM_Parameters */
+  *a = ctx->a;
+  *f = ctx->f;
+  *override = ctx->Override;
+} /* END OF Get_UTM_Parameters_r */
 
 
-long Convert_Geodetic_To_UTM (double Latitude,
-                              double Longitude,
-                              long   *Zone,
-                              char   *Hemisphere,
-                              double *Easting,
-                              double *Northing)
+long Convert_Geodetic_To_UTM_r (const UTM_Context *ctx,
+                                double Latitude,
+                                double Longitude,
+                                long   *Zone,
+                                char   *Hemisphere,
+                                double *Easting,
+                                double *Northing)
 { 
 /*
- * The function Convert_Geodetic_To_UTM converts geodetic (latitude and
+ * The function Convert_Geodetic_To_UTM_r converts geodetic (latitude and
  * longitude) coordinates to UTM projection (zone, hemisphere, easting and
- * northing) coordinates according to the current ellipsoid and UTM zone
+ * northing) coordinates according to the context's ellipsoid and UTM zone
  * override parameters.  If any errors occur, the error code(s) are returned
- * by the function, otherwise UTM_NO_ERROR is returned.
+ * by the function, otherwise UTM_NO_ERROR is returned.  The context is
+ * not modified; the zone's projection is set up in a local copy of its
+ * Transverse Mercator context.
  *
+ *    ctx               : The context                         (input)
  *    Latitude          : Latitude in radians                 (input)
  *    Longitude         : Longitude in radians                (input)
  *    Zone              : UTM zone                            (output)
@@ -200,6 +239,7 @@ long Convert_Geodetic_To_UTM (double Latitude,
   double False_Easting = 500000;
   double False_Northing = 0;
   double Scale = 0.9996;
+  Transverse_Mercator_Context tm = ctx->tm;
 
   if ((Latitude < MIN_LAT) || (Latitude > MAX_LAT))
   { /* Latitude out of range */
@@ -238,14 +278,14 @@ long Convert_Geodetic_To_UTM (double Latitude,
     if ((Lat_Degrees > 71) && (Long_Degrees > 32) && (Long_Degrees < 42))
       temp_zone = 37;
 
-    if (UTM_Override)
+    if (ctx->Override)
     {
-      if ((temp_zone == 1) && (UTM_Override == 60))
-        temp_zone = UTM_Override;
-      else if ((temp_zone == 60) && (UTM_Override == 1))
-        temp_zone = UTM_Override;
-      else if (((temp_zone-1) <= UTM_Override) && (UTM_Override <= (temp_zone+1)))
-        temp_zone = UTM_Override;
+      if ((temp_zone == 1) && (ctx->Override == 60))
+        temp_zone = ctx->Override;
+      else if ((temp_zone == 60) && (ctx->Override == 1))
+        temp_zone = ctx->Override;
+      else if (((temp_zone-1) <= ctx->Override) && (ctx->Override <= (temp_zone+1)))
+        temp_zone = ctx->Override;
       else
         Error_Code = UTM_ZONE_OVERRIDE_ERROR;
     }
@@ -263,10 +303,10 @@ long Convert_Geodetic_To_UTM (double Latitude,
       }
       else
         *Hemisphere = 'N';
-      Set_Transverse_Mercator_Parameters(UTM_a, UTM_f, Origin_Latitude,
-                                         Central_Meridian, False_Easting, False_Northing, Scale);
-      Convert_Geodetic_To_Transverse_Mercator(Latitude, Longitude, Easting,
-                                              Northing);
+      Set_Transverse_Mercator_Parameters_r(&tm, ctx->a, ctx->f, Origin_Latitude,
+                                           Central_Meridian, False_Easting, False_Northing, Scale);
+      Convert_Geodetic_To_Transverse_Mercator_r(&tm, Latitude, Longitude, Easting,
+                                                Northing);
       if ((*Easting < MIN_EASTING) || (*Easting > MAX_EASTING))
         Error_Code = UTM_EASTING_ERROR;
       if ((*Northing < MIN_NORTHING) || (*Northing > MAX_NORTHING))
@@ -274,23 +314,26 @@ long Convert_Geodetic_To_UTM (double Latitude,
     }
   } /* END OF if (!Error_Code) */
   return (Error_Code);
-} /* END OF Convert_Geodetic_To_UTM */
+} /* END OF Convert_Geodetic_To_UTM_r */
 
 
-long Convert_UTM_To_Geodetic(long   Zone,
-                             char   Hemisphere,
-                             double Easting,
-                             double Northing,
-                             double *Latitude,
-                             double *Longitude)
+long Convert_UTM_To_Geodetic_r(const UTM_Context *ctx,
+                               long   Zone,
+                               char   Hemisphere,
+                               double Easting,
+                               double Northing,
+                               double *Latitude,
+                               double *Longitude)
 {
 /*
- * The function Convert_UTM_To_Geodetic converts UTM projection (zone, 
+ * The function Convert_UTM_To_Geodetic_r converts UTM projection (zone, 
  * hemisphere, easting and northing) coordinates to geodetic(latitude
- * and  longitude) coordinates, according to the current ellipsoid
+ * and  longitude) coordinates, according to the context's ellipsoid
  * parameters.  If any errors occur, the error code(s) are returned
- * by the function, otherwise UTM_NO_ERROR is returned.
+ * by the function, otherwise UTM_NO_ERROR is returned.  The context is
+ * not modified.
  *
+ *    ctx               : The context                            (input)
  *    Zone              : UTM zone                               (input)
  *    Hemisphere        : North or South hemisphere              (input)
  *    Easting           : Easting (X) in meters                  (input)
@@ -304,6 +347,7 @@ long Convert_UTM_To_Geodetic(long   Zone,
   double False_Easting = 500000;
   double False_Northing = 0;
   double Scale = 0.9996;
+  Transverse_Mercator_Context tm = ctx->tm;
 
   if ((Zone < 1) || (Zone > 60))
     Error_Code |= UTM_ZONE_ERROR;
@@ -321,9 +365,10 @@ long Convert_UTM_To_Geodetic(long   Zone,
       Central_Meridian = ((6 * Zone + 177) * PI / 180.0 /*+ 0.00000005*/);
     if (Hemisphere == 'S')
       False_Northing = 10000000;
-    Set_Transverse_Mercator_Parameters(UTM_a, UTM_f, Origin_Latitude,
-                                       Central_Meridian, False_Easting, False_Northing, Scale);
-    if (Convert_Transverse_Mercator_To_Geodetic(Easting,
+    Set_Transverse_Mercator_Parameters_r(&tm, ctx->a, ctx->f, Origin_Latitude,
+                                         Central_Meridian, False_Easting, False_Northing, Scale);
+    if (Convert_Transverse_Mercator_To_Geodetic_r(&tm,
+                                                Easting,
                                                 Northing,
                                                 Latitude, 
                                                 Longitude))
@@ -334,4 +379,52 @@ long Convert_UTM_To_Geodetic(long   Zone,
     }
   }
   return (Error_Code);
-} /* END OF Convert_UTM_To_Geodetic */
+} /* END OF Convert_UTM_To_Geodetic_r */
+
+
+/***************************************************************************/
+/*
+ *                   FUNCTIONS USING THE DEFAULT CONTEXT
+ *
+ *    These are the original, non-reentrant entry points; each calls the
+ *    corresponding _r function with a single, file-static context.
+ */
+
+long Set_UTM_Parameters(double a,      
+                        double f,
+                        long   override)
+{
+  return Set_UTM_Parameters_r(Default_UTM_Context(), a, f, override);
+}
+
+
+void Get_UTM_Parameters(double *a,
+                        double *f,
+                        long   *override)
+{
+  Get_UTM_Parameters_r(Default_UTM_Context(), a, f, override);
+}
+
+
+long Convert_Geodetic_To_UTM (double Latitude,
+                              double Longitude,
+                              long   *Zone,
+                              char   *Hemisphere,
+                              double *Easting,
+                              double *Northing)
+{
+  return Convert_Geodetic_To_UTM_r(Default_UTM_Context(), Latitude, Longitude,
+                                   Zone, Hemisphere, Easting, Northing);
+}
+
+
+long Convert_UTM_To_Geodetic(long   Zone,
+                             char   Hemisphere,
+                             double Easting,
+                             double Northing,
+                             double *Latitude,
+                             double *Longitude)
+{
+  return Convert_UTM_To_Geodetic_r(Default_UTM_Context(), Zone, Hemisphere,
+                                   Easting, Northing, Latitude, Longitude);
+}
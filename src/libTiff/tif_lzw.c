@@ -123,6 +123,7 @@ typedef struct code_ent {
 	unsigned short	length;		/* string len, including this token */
 	unsigned char	value;		/* data value */
 	unsigned char	firstchar;	/* first token of string */
+	tsize_t		pos;		/* strip offset of a copy of string */
 } code_t;
 
 typedef	int (*decodeFunc)(TIFF*, tidata_t, tsize_t, tsample_t);
@@ -142,6 +143,8 @@ typedef struct {
 	code_t*	dec_free_entp;		/* next free entry */
 	code_t*	dec_maxcodep;		/* max available entry */
 	code_t*	dec_codetab;		/* kept separate for small machines */
+	tsize_t	dec_outpos;		/* bytes decoded so far in strip */
+	tsize_t	dec_oldpos;		/* strip offset of dec_oldcodep */
 
 	/* Encoding specific data */
 	int	enc_oldcode;		/* last code encountered */
@@ -172,16 +175,18 @@ static  void cl_hash(LZWCodecState*);
 /*
  * This check shouldn't be necessary because each
  * strip is suppose to be terminated with CODE_EOI.
+ * The decoders keep the count of bits left in a local,
+ * bitsleft, while decoding.
  */
 #define	NextCode(_tif, _sp, _bp, _code, _get) {				\
-	if ((_sp)->dec_bitsleft < nbits) {				\
+	if (bitsleft < nbits) {						\
 		TIFFWarningExt(_tif->tif_clientdata, _tif->tif_name,				\
 		    "LZWDecode: Strip %d not terminated with EOI code", \
 		    _tif->tif_curstrip);				\
 		_code = CODE_EOI;					\
 	} else {							\
 		_get(_sp,_bp,_code);					\
-		(_sp)->dec_bitsleft -= nbits;				\
+		bitsleft -= nbits;					\
 	}								\
 }
 #else
@@ -310,6 +315,8 @@ LZWPreDecode(TIFF* tif, tsample_t s)
 	_TIFFmemset(sp->dec_free_entp, 0, (CSIZE-CODE_FIRST)*sizeof (code_t));
 	sp->dec_oldcodep = &sp->dec_codetab[-1];
 	sp->dec_maxcodep = &sp->dec_codetab[sp->dec_nbitsmask-1];
+	sp->dec_outpos = 0;
+	sp->dec_oldpos = -1;
 	return (1);
 }
 
@@ -335,6 +342,17 @@ codeLoop(TIFF* tif)
 	    tif->tif_row);
 }
 
+/*
+ * Each new table entry is the previous string plus one byte, and
+ * the previous string has just been written to the output; so the
+ * entry's string is also in the output, at the offset where the
+ * previous string was written.  LZWDecode records that offset in the
+ * entry, and when the entry's code comes up again copies the string
+ * from there rather than following the entry's chain one byte at a
+ * time.  Offsets are relative to the start of the strip; only strings
+ * written by the current call, and so in the current buffer, are
+ * copied.
+ */
 static int
 LZWDecode(TIFF* tif, tidata_t op0, tsize_t occ0, tsample_t s)
 {
@@ -347,6 +365,12 @@ LZWDecode(TIFF* tif, tidata_t op0, tsize_t occ0, tsample_t s)
 	int len;
 	long nbits, nextbits, nextdata, nbitsmask;
 	code_t *codep, *free_entp, *maxcodep, *oldcodep;
+	code_t *codetab = sp->dec_codetab;
+	tsize_t start = sp->dec_outpos;	/* strip offset of op0 */
+	tsize_t here, oldpos;
+#ifdef LZW_CHECKEOS
+	long bitsleft;
+#endif
 
 	(void) s;
 	assert(sp != NULL);
@@ -366,6 +390,7 @@ LZWDecode(TIFF* tif, tidata_t op0, tsize_t occ0, tsample_t s)
 			 * values in the output buffer, and return.
 			 */
 			sp->dec_restart += occ;
+			sp->dec_outpos += occ;
 			do {
 				codep = codep->next;
 			} while (--residue > occ && codep);
@@ -399,32 +424,38 @@ LZWDecode(TIFF* tif, tidata_t op0, tsize_t occ0, tsample_t s)
 	nextbits = sp->lzw_nextbits;
 	nbitsmask = sp->dec_nbitsmask;
 	oldcodep = sp->dec_oldcodep;
+	oldpos = sp->dec_oldpos;
 	free_entp = sp->dec_free_entp;
 	maxcodep = sp->dec_maxcodep;
+#ifdef LZW_CHECKEOS
+	bitsleft = sp->dec_bitsleft;
+#endif
 
 	while (occ > 0) {
 		NextCode(tif, sp, bp, code, GetNextCode);
 		if (code == CODE_EOI)
 			break;
+		here = start + (tsize_t) (op - (char*) op0);
 		if (code == CODE_CLEAR) {
-			free_entp = sp->dec_codetab + CODE_FIRST;
+			free_entp = codetab + CODE_FIRST;
 			nbits = BITS_MIN;
 			nbitsmask = MAXCODE(BITS_MIN);
-			maxcodep = sp->dec_codetab + nbitsmask-1;
+			maxcodep = codetab + nbitsmask-1;
 			NextCode(tif, sp, bp, code, GetNextCode);
 			if (code == CODE_EOI)
 				break;
 			*op++ = (char)code, occ--;
-			oldcodep = sp->dec_codetab + code;
+			oldcodep = codetab + code;
+			oldpos = here;
 			continue;
 		}
-		codep = sp->dec_codetab + code;
+		codep = codetab + code;
 
 		/*
 	 	 * Add the new entry to the code table.
 	 	 */
-		if (free_entp < &sp->dec_codetab[0] ||
-			free_entp >= &sp->dec_codetab[CSIZE]) {
+		if (free_entp < &codetab[0] ||
+			free_entp >= &codetab[CSIZE]) {
 			TIFFErrorExt(tif->tif_clientdata, tif->tif_name,
 			"LZWDecode: Corrupted LZW table at scanline %d",
 			tif->tif_row);
@@ -432,8 +463,8 @@ LZWDecode(TIFF* tif, tidata_t op0, tsize_t occ0, tsample_t s)
 		}
 
 		free_entp->next = oldcodep;
-		if (free_entp->next < &sp->dec_codetab[0] ||
-			free_entp->next >= &sp->dec_codetab[CSIZE]) {
+		if (free_entp->next < &codetab[0] ||
+			free_entp->next >= &codetab[CSIZE]) {
 			TIFFErrorExt(tif->tif_clientdata, tif->tif_name,
 			"LZWDecode: Corrupted LZW table at scanline %d",
 			tif->tif_row);
@@ -443,13 +474,15 @@ LZWDecode(TIFF* tif, tidata_t op0, tsize_t occ0, tsample_t s)
 		free_entp->length = free_entp->next->length+1;
 		free_entp->value = (codep < free_entp) ?
 		    codep->firstchar : free_entp->firstchar;
+		free_entp->pos = oldpos;
 		if (++free_entp > maxcodep) {
 			if (++nbits > BITS_MAX)		/* should not happen */
 				nbits = BITS_MAX;
 			nbitsmask = MAXCODE(nbits);
-			maxcodep = sp->dec_codetab + nbitsmask-1;
+			maxcodep = codetab + nbitsmask-1;
 		}
 		oldcodep = codep;
+		oldpos = here;
 		if (code >= 256) {
 			/*
 		 	 * Code maps to a string, copy string
@@ -486,6 +519,25 @@ LZWDecode(TIFF* tif, tidata_t op0, tsize_t occ0, tsample_t s)
 				break;
 			}
 			len = codep->length;
+			if (codep->pos >= start && codep->pos < here) {
+				/*
+				 * Copy the string from earlier in the
+				 * output; the copy may overlap its own
+				 * source by a byte, so it goes forward.
+				 */
+				char *cp = (char*) op0 + (codep->pos - start);
+
+				if (here - codep->pos >= len)
+					_TIFFmemcpy(op, cp, len);
+				else {
+					tp = op;
+					do {
+						*tp++ = *cp++;
+					} while (tp < op + len);
+				}
+				op += len, occ -= len;
+				continue;
+			}
 			tp = op + len;
 			do {
 				int t;
@@ -509,8 +561,13 @@ LZWDecode(TIFF* tif, tidata_t op0, tsize_t occ0, tsample_t s)
 	sp->lzw_nextbits = nextbits;
 	sp->dec_nbitsmask = nbitsmask;
 	sp->dec_oldcodep = oldcodep;
+	sp->dec_oldpos = oldpos;
 	sp->dec_free_entp = free_entp;
 	sp->dec_maxcodep = maxcodep;
+#ifdef LZW_CHECKEOS
+	sp->dec_bitsleft = bitsleft;
+#endif
+	sp->dec_outpos = start + (tsize_t) (occ0 - occ);
 
 	if (occ > 0) {
 		TIFFErrorExt(tif->tif_clientdata, tif->tif_name,
@@ -548,6 +605,9 @@ LZWDecodeCompat(TIFF* tif, tidata_t op0, tsize_t occ0, tsample_t s)
 	int code, nbits;
 	long nextbits, nextdata, nbitsmask;
 	code_t *codep, *free_entp, *maxcodep, *oldcodep;
+#ifdef LZW_CHECKEOS
+	long bitsleft;
+#endif
 
 	(void) s;
 	assert(sp != NULL);
@@ -597,6 +657,9 @@ LZWDecodeCompat(TIFF* tif, tidata_t op0, tsize_t occ0, tsample_t s)
 	oldcodep = sp->dec_oldcodep;
 	free_entp = sp->dec_free_entp;
 	maxcodep = sp->dec_maxcodep;
+#ifdef LZW_CHECKEOS
+	bitsleft = sp->dec_bitsleft;
+#endif
 
 	while (occ > 0) {
 		NextCode(tif, sp, bp, code, GetNextCodeCompat);
@@ -694,6 +757,9 @@ LZWDecodeCompat(TIFF* tif, tidata_t op0, tsize_t occ0, tsample_t s)
 	sp->dec_oldcodep = oldcodep;
 	sp->dec_free_entp = free_entp;
 	sp->dec_maxcodep = maxcodep;
+#ifdef LZW_CHECKEOS
+	sp->dec_bitsleft = bitsleft;
+#endif
 
 	if (occ > 0) {
 		TIFFErrorExt(tif->tif_clientdata, tif->tif_name,
@@ -45,6 +45,20 @@ static	int PredictorDecodeRow(TIFF*, tidata_t, tsize_t, tsample_t);
 static	int PredictorDecodeTile(TIFF*, tidata_t, tsize_t, tsample_t);
 static	int PredictorEncodeRow(TIFF*, tidata_t, tsize_t, tsample_t);
 static	int PredictorEncodeTile(TIFF*, tidata_t, tsize_t, tsample_t);
+static	TIFFPostMethod fastAcc(TIFFPredictorState*, TIFFPostMethod);
+static	TIFFPostMethod fastDiff(TIFFPredictorState*, TIFFPostMethod);
+
+/*
+ * SSE2 versions of the horizontal accumulator and differencer are
+ * used on x86 when the processor has SSE2; this is checked once, when
+ * the codec is set up.  Other compilers and processors get the scalar
+ * routines.
+ */
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#define	PREDICTOR_SSE2
+#include <emmintrin.h>
+#define	SSE2_FUNC	__attribute__((target("sse2")))
+#endif
 
 static int
 PredictorSetup(TIFF* tif)
@@ -131,6 +145,7 @@ PredictorSetupDecode(TIFF* tif)
 				tif->tif_postdecode = _TIFFNoPostDecode;
 			} /* else handle 32-bit case... */
 		}
+		sp->pfunc = fastAcc(sp, sp->pfunc);
 	}
 
 	else if (sp->predictor == 3) {
@@ -176,6 +191,7 @@ PredictorSetupEncode(TIFF* tif)
 			case 8:  sp->pfunc = horDiff8; break;
 			case 16: sp->pfunc = horDiff16; break;
 		}
+		sp->pfunc = fastDiff(sp, sp->pfunc);
 		/*
 		 * Override default encoding method with one that does the
 		 * predictor stuff.
@@ -291,6 +307,139 @@ horAcc16(TIFF* tif, tidata_t cp0, tsize_t cc)
 	}
 }
 
+#ifdef PREDICTOR_SSE2
+/*
+ * SSE2 accumulation, 16 bytes at a time.  Each block holds as many
+ * whole pixels as fit; the last pixel of the previous block is added
+ * to the first one, and a prefix sum in log2 steps carries each pixel
+ * into the next.  Bytes past the last whole pixel are put back as they
+ * were, to be done as part of the next block.  The accumulator is
+ * specialized by stride since the byte shifts need constant counts.
+ */
+static const unsigned char sse2Ones[32] = {
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+};
+
+/* Mask of the first n bytes of a block */
+#define	SSE2_MASK(n)	_mm_loadu_si128((const __m128i*) (sse2Ones + 16 - (n)))
+
+#define	SSE2_SCAN(add, v, b)					\
+	v = add(v, _mm_slli_si128(v, (b)));			\
+	if (2*(b) < 16) v = add(v, _mm_slli_si128(v, 2*(b)));	\
+	if (4*(b) < 16) v = add(v, _mm_slli_si128(v, 4*(b)));	\
+	if (8*(b) < 16) v = add(v, _mm_slli_si128(v, 8*(b)))
+
+#define	HORACC_SSE2(name, type, add, S)					\
+static SSE2_FUNC void							\
+name(TIFF* tif, tidata_t cp0, tsize_t cc)				\
+{									\
+	type* cp = (type*) cp0;						\
+	tsize_t n = cc / sizeof (type);					\
+	const int per = 16 / sizeof (type);				\
+	const int k = (per/(S))*(S);					\
+	__m128i keep = SSE2_MASK(k*sizeof (type));			\
+	__m128i first = SSE2_MASK((S)*sizeof (type));			\
+	__m128i carry = _mm_setzero_si128();				\
+	tsize_t i;							\
+									\
+	(void) tif;							\
+	for (i = 0; i + per <= n; i += k) {				\
+		__m128i in = _mm_loadu_si128((__m128i*) (cp + i));	\
+		__m128i v = add(in, carry);				\
+		SSE2_SCAN(add, v, (S)*sizeof (type));			\
+		v = _mm_or_si128(_mm_and_si128(keep, v),		\
+		    _mm_andnot_si128(keep, in));			\
+		_mm_storeu_si128((__m128i*) (cp + i), v);		\
+		carry = _mm_and_si128(first,				\
+		    _mm_srli_si128(v, (k-(S))*sizeof (type)));		\
+	}								\
+	for (i = (i < (S)) ? (S) : i; i < n; i++)			\
+		cp[i] = (type) (cp[i] + cp[i-(S)]);			\
+}
+
+HORACC_SSE2(horAcc8_sse2_1, uint8, _mm_add_epi8, 1)
+HORACC_SSE2(horAcc8_sse2_2, uint8, _mm_add_epi8, 2)
+HORACC_SSE2(horAcc8_sse2_3, uint8, _mm_add_epi8, 3)
+HORACC_SSE2(horAcc8_sse2_4, uint8, _mm_add_epi8, 4)
+HORACC_SSE2(horAcc16_sse2_1, uint16, _mm_add_epi16, 1)
+HORACC_SSE2(horAcc16_sse2_2, uint16, _mm_add_epi16, 2)
+HORACC_SSE2(horAcc16_sse2_3, uint16, _mm_add_epi16, 3)
+HORACC_SSE2(horAcc16_sse2_4, uint16, _mm_add_epi16, 4)
+
+/*
+ * SSE2 differencing.  Each value depends only on the input, so this
+ * works back from the end of the row a block at a time, for any
+ * stride.
+ */
+#define	HORDIFF_SSE2(name, type, sub)					\
+static SSE2_FUNC void							\
+name(TIFF* tif, tidata_t cp0, tsize_t cc)				\
+{									\
+	tsize_t stride = PredictorState(tif)->stride;			\
+	type* cp = (type*) cp0;						\
+	tsize_t n = cc / sizeof (type);					\
+	const int per = 16 / sizeof (type);				\
+	tsize_t i;							\
+									\
+	for (i = n - per; i >= stride; i -= per) {			\
+		__m128i v = _mm_loadu_si128((__m128i*) (cp + i));	\
+		__m128i p = _mm_loadu_si128((__m128i*) (cp + i - stride)); \
+		_mm_storeu_si128((__m128i*) (cp + i), sub(v, p));	\
+	}								\
+	for (i += per - 1; i >= stride; i--)				\
+		cp[i] = (type) (cp[i] - cp[i-stride]);			\
+}
+
+HORDIFF_SSE2(horDiff8_sse2, uint8, _mm_sub_epi8)
+HORDIFF_SSE2(horDiff16_sse2, uint16, _mm_sub_epi16)
+#endif /* PREDICTOR_SSE2 */
+
+/*
+ * Returns a faster equivalent of the accumulator, if there is one.
+ */
+static TIFFPostMethod
+fastAcc(TIFFPredictorState* sp, TIFFPostMethod acc)
+{
+#ifdef PREDICTOR_SSE2
+	static const TIFFPostMethod acc8[] = {
+		horAcc8_sse2_1, horAcc8_sse2_2, horAcc8_sse2_3, horAcc8_sse2_4
+	};
+	static const TIFFPostMethod acc16[] = {
+		horAcc16_sse2_1, horAcc16_sse2_2, horAcc16_sse2_3, horAcc16_sse2_4
+	};
+
+	if (sp->stride < 1 || sp->stride > 4 || !__builtin_cpu_supports("sse2"))
+		return acc;
+	if (acc == horAcc8)
+		return acc8[sp->stride-1];
+	if (acc == horAcc16)
+		return acc16[sp->stride-1];
+#else
+	(void) sp;
+#endif
+	return acc;
+}
+
+/*
+ * Returns a faster equivalent of the differencer, if there is one.
+ */
+static TIFFPostMethod
+fastDiff(TIFFPredictorState* sp, TIFFPostMethod diff)
+{
+	(void) sp;
+#ifdef PREDICTOR_SSE2
+	if (!__builtin_cpu_supports("sse2"))
+		return diff;
+	if (diff == horDiff8)
+		return horDiff8_sse2;
+	if (diff == horDiff16)
+		return horDiff16_sse2;
+#endif
+	return diff;
+}
+
 /*
  * Floating point predictor accumulation routine.
  */
@@ -102,7 +102,7 @@ _tiffMapProc(thandle_t fd, tdata_t* pbase, toff_t* psize)
 	toff_t size = _tiffSizeProc(fd);
 	if (size != (toff_t) -1) {
 		*pbase = (tdata_t)
-		    mmap(0, size, PROT_READ, MAP_SHARED, (int) fd, 0);
+		    mmap(0, size, PROT_READ, MAP_SHARED, (int) (size_t) fd, 0);
 		if (*pbase != (tdata_t) -1) {
 			*psize = size;
 			return (1);
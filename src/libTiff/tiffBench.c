@@ -0,0 +1,272 @@
+/*! \file tiffBench.c
+    \brief  Decode benchmark for libTiff: reads every strip or tile of
+    each image a number of times, as geotiff region and the map loaders
+    in Marsbin do, and reports the decoded bytes/sec.
+
+    Build with "make bench"; run as
+
+        tiffBench ?-reps n? ?file...?
+
+    reps defaults to 5.  With no files, it writes a set of sample
+    images to the current directory, times them, and deletes them;
+    the samples are map-like 8-bit RGB and 16-bit elevation data,
+    LZW-compressed with and without the horizontal predictor, in
+    strips and in tiles.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include "tiffio.h"
+
+#define SAMPLE_SIZE 2048
+
+typedef struct BenchSample {
+    const char *name;      /* file name */
+    int         spp;       /* samples per pixel */
+    int         bits;      /* bits per sample */
+    int         predictor; /* 1 or 2 */
+    int         tiled;     /* 1 for 256x256 tiles, 0 for strips */
+} BenchSample;
+
+static BenchSample samples[] = {
+    { "tiffBench-rgb-lzw.tif",        3,  8, 1, 0 },
+    { "tiffBench-rgb-lzw-pred.tif",   3,  8, 2, 0 },
+    { "tiffBench-rgb-lzw-pred-t.tif", 3,  8, 2, 1 },
+    { "tiffBench-rgba-lzw-pred.tif",  4,  8, 2, 0 },
+    { "tiffBench-dem-lzw-pred.tif",   1, 16, 2, 0 },
+    { NULL, 0, 0, 0, 0 }
+};
+
+static double now(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+
+    return tv.tv_sec + tv.tv_usec/1.0e6;
+}
+
+/* Returns sample s of pixel (x,y) of a made-up map: smooth shading,
+ * flat areas with hard edges where the land classes change, and a
+ * little noise. */
+
+static unsigned int pixel(int x, int y, int s, int bits)
+{
+    unsigned int shade = (unsigned int)(x/3 + y/5);
+    unsigned int zone  = ((x/97) * 7 + (y/61) * 13) % 5;
+    unsigned int noise = (unsigned int)((x * 1103515245u + y * 12345u)
+                                        >> 16) & 3;
+
+    if (bits == 16)
+    {
+        return (shade * 8 + zone * 300 + noise) & 0xffff;
+    }
+
+    if (zone < 2)
+    {
+        return (zone * 90 + s * 40) & 0xff;
+    }
+
+    return (shade + zone * 30 + s * 50 + noise) & 0xff;
+}
+
+/* Writes the sample image; returns 1 on success and 0 on failure. */
+
+static int writeSample(BenchSample *b)
+{
+    TIFF          *tif;
+    unsigned char *buf;
+    int            bpp = b->spp * b->bits/8;
+    int            bw  = b->tiled ? 256 : SAMPLE_SIZE;
+    int            bh  = b->tiled ? 256 : 16;
+    int            bx, by, x, y, s;
+
+    tif = TIFFOpen(b->name, "w");
+
+    if (tif == NULL)
+    {
+        return 0;
+    }
+
+    TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, SAMPLE_SIZE);
+    TIFFSetField(tif, TIFFTAG_IMAGELENGTH, SAMPLE_SIZE);
+    TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, b->bits);
+    TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, b->spp);
+    TIFFSetField(tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+    TIFFSetField(tif, TIFFTAG_PHOTOMETRIC,
+                 b->spp >= 3 ? PHOTOMETRIC_RGB : PHOTOMETRIC_MINISBLACK);
+    TIFFSetField(tif, TIFFTAG_COMPRESSION, COMPRESSION_LZW);
+    TIFFSetField(tif, TIFFTAG_PREDICTOR, b->predictor);
+
+    if (b->spp == 4)
+    {
+        uint16 extra = EXTRASAMPLE_UNASSALPHA;
+
+        TIFFSetField(tif, TIFFTAG_EXTRASAMPLES, 1, &extra);
+    }
+
+    if (b->tiled)
+    {
+        TIFFSetField(tif, TIFFTAG_TILEWIDTH, bw);
+        TIFFSetField(tif, TIFFTAG_TILELENGTH, bh);
+    }
+    else
+    {
+        TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, bh);
+    }
+
+    buf = (unsigned char *)malloc(bw * bh * bpp);
+
+    for (by = 0; by < SAMPLE_SIZE; by += bh)
+    {
+        for (bx = 0; bx < SAMPLE_SIZE; bx += bw)
+        {
+            for (y = 0; y < bh; y++)
+            {
+                for (x = 0; x < bw; x++)
+                {
+                    for (s = 0; s < b->spp; s++)
+                    {
+                        unsigned int v = pixel(bx + x, by + y, s, b->bits);
+                        int          i = (y * bw + x) * b->spp + s;
+
+                        if (b->bits == 16)
+                        {
+                            ((uint16 *)buf)[i] = (uint16)v;
+                        }
+                        else
+                        {
+                            buf[i] = (unsigned char)v;
+                        }
+                    }
+                }
+            }
+
+            if (b->tiled)
+            {
+                TIFFWriteEncodedTile(tif, TIFFComputeTile(tif, bx, by, 0, 0),
+                                     buf, bw * bh * bpp);
+            }
+            else
+            {
+                TIFFWriteEncodedStrip(tif, by/bh, buf, bw * bh * bpp);
+            }
+        }
+    }
+
+    free(buf);
+    TIFFClose(tif);
+
+    return 1;
+}
+
+/* Decodes every strip or tile of the file reps times, and prints the
+ * rate; returns 1 on success and 0 on failure. */
+
+static int bench(const char *name, int reps)
+{
+    TIFF      *tif;
+    tdata_t    buf;
+    tsize_t    size;
+    ttile_t    nblocks, i;
+    uint16     compression, predictor = 1;
+    double     start, elapsed, total = 0.0;
+    int        tiled, r;
+
+    tif = TIFFOpen(name, "r");
+
+    if (tif == NULL)
+    {
+        return 0;
+    }
+
+    tiled   = TIFFIsTiled(tif);
+    nblocks = tiled ? TIFFNumberOfTiles(tif) : TIFFNumberOfStrips(tif);
+    size    = tiled ? TIFFTileSize(tif) : TIFFStripSize(tif);
+    buf     = _TIFFmalloc(size);
+
+    TIFFGetField(tif, TIFFTAG_COMPRESSION, &compression);
+    TIFFGetField(tif, TIFFTAG_PREDICTOR, &predictor);
+
+    start = now();
+
+    for (r = 0; r < reps; r++)
+    {
+        for (i = 0; i < nblocks; i++)
+        {
+            tsize_t n = tiled
+                ? TIFFReadEncodedTile(tif, i, buf, size)
+                : TIFFReadEncodedStrip(tif, i, buf, size);
+
+            if (n < 0)
+            {
+                _TIFFfree(buf);
+                TIFFClose(tif);
+                return 0;
+            }
+
+            total += n;
+        }
+    }
+
+    elapsed = now() - start;
+
+    printf("%-32s comp %d pred %d %s %8.1f MB/s\n", name, compression,
+           predictor, tiled ? "tiles " : "strips", total/elapsed/1.0e6);
+
+    _TIFFfree(buf);
+    TIFFClose(tif);
+
+    return 1;
+}
+
+int main(int argc, char *argv[])
+{
+    int reps = 5;
+    int first = 1;
+    int i;
+
+    if (argc > 2 && strcmp(argv[1], "-reps") == 0)
+    {
+        reps  = atoi(argv[2]);
+        first = 3;
+    }
+
+    if (reps < 1)
+    {
+        fprintf(stderr, "usage: tiffBench ?-reps n? ?file...?\n");
+        return 1;
+    }
+
+    if (first < argc)
+    {
+        for (i = first; i < argc; i++)
+        {
+            if (!bench(argv[i], reps))
+            {
+                fprintf(stderr, "tiffBench: could not read %s\n", argv[i]);
+                return 1;
+            }
+        }
+
+        return 0;
+    }
+
+    for (i = 0; samples[i].name != NULL; i++)
+    {
+        int ok = writeSample(&samples[i]) && bench(samples[i].name, reps);
+
+        remove(samples[i].name);
+
+        if (!ok)
+        {
+            fprintf(stderr, "tiffBench: could not benchmark %s\n",
+                    samples[i].name);
+            return 1;
+        }
+    }
+
+    return 0;
+}